@@ -0,0 +1,182 @@
+//
+// arena.hh - Bump-pointer arena
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Bump-pointer arena
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_ARENA_HH
+#define INFORMAVE_ARGON_ARENA_HH
+
+#include "argon/fwd.hh"
+
+#include <cstddef>
+#include <new>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Bump-pointer arena
+///
+/// Memory is taken from large chunks and never freed individually.
+/// Objects created with create<T>() are destroyed in reverse order of
+/// their creation when the arena is destroyed, afterwards all chunks
+/// are released at once. The bookkeeping for destructors lives in the
+/// arena itself, so creating an object costs no heap allocation
+/// unless a new chunk is required.
+///
+/// @since 0.0.1
+/// @brief Bump-pointer arena
+class Arena
+{
+public:
+    /// @brief Default chunk size
+    static const size_t default_chunk_size = 64 * 1024;
+
+    Arena(size_t chunksize = default_chunk_size);
+
+    ~Arena(void);
+
+    /// @brief Allocate raw memory, aligned for any type
+    inline void* allocate(size_t size)
+    {
+        size = align(size);
+        if(static_cast<size_t>(this->m_end - this->m_ptr) < size)
+            return this->allocateChunk(size);
+        void *p = this->m_ptr;
+        this->m_ptr += size;
+        return p;
+    }
+
+    /// @brief Create a new object owned by the arena
+    template<typename T>
+    inline T* create(void)
+    {
+        Destructor *d = static_cast<Destructor*>(this->allocate(sizeof(Destructor)));
+        T *obj = new(this->allocate(sizeof(T))) T();
+        this->registerObject(d, obj, &destroy<T>);
+        return obj;
+    }
+
+    /// @brief Create a new object owned by the arena
+    template<typename T, typename A1>
+    inline T* create(const A1 &a1)
+    {
+        Destructor *d = static_cast<Destructor*>(this->allocate(sizeof(Destructor)));
+        T *obj = new(this->allocate(sizeof(T))) T(a1);
+        this->registerObject(d, obj, &destroy<T>);
+        return obj;
+    }
+
+    /// @brief Number of chunks requested from the heap
+    inline size_t chunkCount(void) const
+    {
+        return this->m_chunkcount;
+    }
+
+    /// @brief Number of objects owned by the arena
+    inline size_t objectCount(void) const
+    {
+        return this->m_objcount;
+    }
+
+    /// @brief Total bytes requested from the heap
+    inline size_t bytesReserved(void) const
+    {
+        return this->m_reserved;
+    }
+
+protected:
+    struct Chunk
+    {
+        Chunk *next;
+    };
+
+    struct Destructor
+    {
+        void        (*fn)(void*);
+        void         *obj;
+        Destructor   *next;
+    };
+
+    union max_align
+    {
+        long double   ld;
+        long long     ll;
+        double        d;
+        void         *p;
+        void        (*fp)(void);
+    };
+
+    static inline size_t align(size_t size)
+    {
+        const size_t a = sizeof(max_align);
+        return (size + a - 1) / a * a;
+    }
+
+    template<typename T>
+    static void destroy(void *obj)
+    {
+        static_cast<T*>(obj)->~T();
+    }
+
+    inline void registerObject(Destructor *d, void *obj, void (*fn)(void*))
+    {
+        d->fn = fn;
+        d->obj = obj;
+        d->next = this->m_dtors;
+        this->m_dtors = d;
+        ++this->m_objcount;
+    }
+
+    void* allocateChunk(size_t size);
+
+    size_t        m_chunksize;
+    Chunk        *m_chunks;
+    char         *m_ptr;
+    char         *m_end;
+    Destructor   *m_dtors;
+    size_t        m_chunkcount;
+    size_t        m_objcount;
+    size_t        m_reserved;
+
+private:
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
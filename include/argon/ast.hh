@@ -30,8 +30,11 @@
 
 #include "argon/fwd.hh"
 #include "argon/token.hh"
+#include "argon/arena.hh"
+#include "argon/interner.hh"
 
-#include <list>
+#include <vector>
+#include <functional>
 
 ARGON_NAMESPACE_BEGIN
 
@@ -45,10 +48,19 @@ struct LogNode;
 struct TaskExecNode;
 struct LiteralNode;
 struct ColumnNode;
+struct ObjectNode;
+struct SectionNode;
+struct ColAssignNode;
+struct NullNode;
+struct NumberNode;
+struct ParallelNode;
+struct StdValueNode;
 class Visitor;
 class ParseTree;
 
-typedef std::list<Node*> NodeList;
+/// Temporary node list, only used by the parser to collect nodes
+/// before they are linked to their parent
+typedef std::vector<Node*> NodeList;
 
 
 
@@ -56,21 +68,53 @@ typedef std::list<Node*> NodeList;
 //--------------------------------------------------------------------------
 /// Node base class
 ///
+/// Children are linked intrusively (first child, next sibling). All
+/// nodes live in the ParseTree arena, so walking the tree touches the
+/// nodes only and never allocates.
+///
 /// @since 0.0.1
 /// @brief Node base class
 class Node
 {
 public:
-    typedef NodeList nodelist_type;
-
-    Node(void);
+    /// @brief Node kinds
+    ///
+    /// The values are part of the bundle format (see bundle.hh), don't
+    /// renumber existing kinds.
+    typedef enum {
+        kind_tree = 1,
+        kind_conn = 2,
+        kind_connspec = 3,
+        kind_task = 4,
+        kind_log = 5,
+        kind_literal = 6,
+        kind_id = 7,
+        kind_taskexec = 8,
+        kind_column = 9,
+        kind_token = 10,
+        kind_object = 11,
+        kind_section = 12,
+        kind_colassign = 13,
+        kind_null = 14,
+        kind_number = 15,
+        kind_parallel = 16,
+        kind_stdvalue = 17
+    } node_kind;
+
+    Node(node_kind kind);
 
     virtual ~Node(void);
 
-    /// @brief Get all child nodes
-    inline nodelist_type& getChilds(void)
+    /// @brief First child node or NULL
+    inline Node* firstChild(void) const
+    {
+        return this->m_firstChild;
+    }
+
+    /// @brief Next sibling node or NULL
+    inline Node* nextSibling(void) const
     {
-        return this->m_childs; 
+        return this->m_nextSibling;
     }
 
     /// @brief Add a new child
@@ -85,16 +129,32 @@ public:
     /// @brief Update information
     void updateSourceInfo(const SourceInfo &info);
 
+    /// @brief Replace information (used when a tree is restored)
+    void setSourceInfo(const SourceInfo &info);
+
     /// @brief String representation (used for debugging)
     virtual String str(void) const = 0;
 
     /// @brief Visitor function
     virtual void accept(Visitor &visitor) = 0;
 
+    /// @brief Node kind
+    inline node_kind kind(void) const
+    {
+        return this->m_kind;
+    }
+
 
 protected:
-    nodelist_type m_childs;
+    Node *m_firstChild;
+    Node *m_lastChild;
+    Node *m_nextSibling;
     SourceInfo m_sinfo;
+    node_kind m_kind;
+
+private:
+    Node(const Node&);
+    Node& operator=(const Node&);
 };
 
 
@@ -122,6 +182,13 @@ public:
     virtual void visit(LogNode *node);
     virtual void visit(TaskExecNode *node);
     virtual void visit(ColumnNode *node);
+    virtual void visit(ObjectNode *node);
+    virtual void visit(SectionNode *node);
+    virtual void visit(ColAssignNode *node);
+    virtual void visit(NullNode *node);
+    virtual void visit(NumberNode *node);
+    virtual void visit(ParallelNode *node);
+    virtual void visit(StdValueNode *node);
 
     void operator()(Node *node);
 
@@ -134,11 +201,20 @@ protected:
 
 
 
+//--------------------------------------------------------------------------
+/// Identifier
+///
+/// Handle to a name interned by the engine's Interner. Comparing and
+/// hashing compare the handles only, never the characters. Identifiers
+/// from different engines must not be mixed.
+///
+/// @since 0.0.1
+/// @brief Identifier
 struct Identifier
 {
-    Identifier() : m_name() { }
+    Identifier() : m_name(0) { }
 
-    Identifier(const String& name) : m_name(name)
+    explicit Identifier(const String *interned) : m_name(interned)
     { }
 
     bool operator==(const Identifier &o) const
@@ -147,21 +223,25 @@ struct Identifier
     bool operator!=(const Identifier &o) const
     { return ! operator==(o); }
 
+    /// Orders by handle, not alphabetically
     bool operator<(const Identifier &o) const
-    { return this->m_name < o.m_name; }
+    { return std::less<const String*>()(this->m_name, o.m_name); }
+
+    size_t hash(void) const
+    { return reinterpret_cast<size_t>(this->m_name) / sizeof(String); }
 
     String name(void) const
     {
-        return this->m_name;
+        return this->m_name ? *this->m_name : String();
     }
 
     String str(void) const
     {
-        return this->m_name;
+        return this->name();
     }
 
 protected:
-    String m_name;
+    const String *m_name;
 };
 
 
@@ -190,6 +270,12 @@ struct TokenNode : public Node
     virtual void accept(Visitor &visitor);
     virtual ~TokenNode(void) {}
     virtual String str(void) const;
+
+    /// @brief The token
+    inline Token* token(void) const
+    {
+        return this->m_token;
+    }
     
 protected:
     Token *m_token;
@@ -233,7 +319,7 @@ struct ColumnNode : public Node
 {
     ColumnNode(void);
 
-    void init(String data);
+    void init(String data, bool result = false);
 
     virtual void accept(Visitor &visitor);
     virtual ~ColumnNode(void) {}
@@ -243,6 +329,178 @@ struct ColumnNode : public Node
     virtual String colname(void) const;
 
     String m_data;
+    bool   m_result;   ///< %column, a column of the destination
+};
+
+
+struct NullNode : public Node
+{
+    NullNode(void);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~NullNode(void) {}
+
+    virtual String str(void) const;
+};
+
+
+struct NumberNode : public Node
+{
+    NumberNode(void);
+
+    void init(String data);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~NumberNode(void) {}
+
+    virtual String str(void) const;
+
+    String m_data;
+};
+
+
+//--------------------------------------------------------------------------
+/// Object node
+///
+/// Inline object of a template argument, e.g. table(dbc, "name").
+/// The children are the object arguments (IdNode or LiteralNode).
+///
+/// @since 0.0.1
+/// @brief Object node
+struct ObjectNode : public Node
+{
+    typedef enum {
+        obj_table = 1,
+        obj_view = 2,
+        obj_procedure = 3,
+        obj_sql = 4
+    } object_type;
+
+    ObjectNode(void);
+
+    void init(object_type type);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~ObjectNode(void) {}
+
+    virtual String str(void) const;
+
+    object_type m_type;
+};
+
+
+//--------------------------------------------------------------------------
+/// Parallel option
+///
+/// Argument of a source object, parallel(readers, key [, split, ...]).
+/// The children are the number of readers (NumberNode), the key column
+/// (ColumnNode) and the optional split values (NumberNode or
+/// LiteralNode).
+///
+/// @since 0.0.1
+/// @brief Parallel option
+struct ParallelNode : public Node
+{
+    ParallelNode(void);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~ParallelNode(void) {}
+
+    virtual String str(void) const;
+};
+
+
+//--------------------------------------------------------------------------
+/// Standard value
+///
+/// The @ operator, the child is the value which is replaced by the
+/// standard value of its type if it is NULL.
+///
+/// @since 0.0.1
+/// @brief Standard value
+struct StdValueNode : public Node
+{
+    StdValueNode(void);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~StdValueNode(void) {}
+
+    virtual String str(void) const;
+
+    /// @brief The value
+    inline Node* value(void) const
+    {
+        return this->firstChild();
+    }
+};
+
+
+//--------------------------------------------------------------------------
+/// Section node
+///
+/// Marks the start of a section (rules:, after: ...) in a task body.
+/// All following body nodes up to the next section marker belong to
+/// this section.
+///
+/// @since 0.0.1
+/// @brief Section node
+struct SectionNode : public Node
+{
+    typedef enum {
+        sec_initialization = 1,
+        sec_before = 2,
+        sec_rules = 3,
+        sec_after = 4,
+        sec_finalization = 5,
+        sec_except = 6
+    } section_type;
+
+    SectionNode(void);
+
+    /// @brief Init from the section keyword
+    void init(const String &keyword);
+
+    void init(section_type section);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~SectionNode(void) {}
+
+    virtual String str(void) const;
+
+    section_type m_section;
+    String       m_state;     ///< SQLSTATE of an except section, empty for all
+};
+
+
+//--------------------------------------------------------------------------
+/// Column assignment
+///
+/// The first child is the destination column, the second child the
+/// assigned value (ColumnNode, NullNode, LiteralNode, NumberNode,
+/// StdValueNode or IdNode).
+///
+/// @since 0.0.1
+/// @brief Column assignment
+struct ColAssignNode : public Node
+{
+    ColAssignNode(void);
+
+    virtual void accept(Visitor &visitor);
+    virtual ~ColAssignNode(void) {}
+
+    virtual String str(void) const;
+
+    /// @brief Destination column
+    inline ColumnNode* dest(void) const
+    {
+        return static_cast<ColumnNode*>(this->firstChild());
+    }
+
+    /// @brief Assigned value
+    inline Node* value(void) const
+    {
+        return this->firstChild()->nextSibling();
+    }
 };
 
 
@@ -275,10 +533,15 @@ struct ConnSpec : public Node
 
     void init(String _type, String _dbcstr);
 
+    /// @brief Set the pool size (number strings)
+    void setPool(String _poolMin, String _poolMax);
+
     virtual void accept(Visitor &visitor);
 
     String type;
     String dbcstr;
+    String poolMin;     ///< empty if not given
+    String poolMax;
 
 
     virtual ~ConnSpec(void)
@@ -291,13 +554,31 @@ struct ConnSpec : public Node
 
 struct TaskNode : public Node
 {
+    /// @brief Task templates
+    ///
+    /// The values are part of the bundle format.
+    typedef enum {
+        tmpl_void = 0,
+        tmpl_fetch = 1,
+        tmpl_store = 2,
+        tmpl_transfer = 3
+    } template_type;
+
     TaskNode(void);
 
     void init(Identifier _id);
 
+    /// @brief Set the template from the template keyword
+    void setTemplate(const String &keyword);
+
+    /// @brief Position of parameter @a name, -1 if the task has none
+    int paramIndex(Identifier name) const;
+
     virtual void accept(Visitor &visitor);
 
     Identifier id;
+    template_type tmpl;
+    std::vector<Identifier> params;    ///< parameter names in order
 
     virtual ~TaskNode(void)
     {}
@@ -334,10 +615,11 @@ struct LogNode : public Node
 class ParseTree : public Node
 {
 public:
-    ParseTree(void)
-        : m_nodelists(),
-          m_nodes(),
-          m_tokens()
+    ParseTree(Interner &interner)
+        : Node(kind_tree),
+          m_arena(),
+          m_lastToken(0),
+          m_interner(interner)
     {}
 
     virtual ~ParseTree(void);
@@ -353,17 +635,19 @@ public:
 
     inline NodeList* newNodeList(void)
     {
-        NodeList* n = new NodeList();
-        m_nodelists.push_back(n);
-        return n;
+        return m_arena.create<NodeList>();
+    }
+
+    /// @brief Temporary list of identifiers (parameter names)
+    inline std::vector<Identifier>* newIdentList(void)
+    {
+        return m_arena.create<std::vector<Identifier> >();
     }
 
     /// @brief Create a new token node
     inline TokenNode* newTokenNode(Token *t)
     {
-        TokenNode *node = new TokenNode(t);
-        m_nodes.push_back(node);
-        return node;
+        return m_arena.create<TokenNode>(t);
     }
    
 
@@ -371,20 +655,37 @@ public:
     template<typename T>
     inline T* newNode(void)
     {
-        T *tmp = new T();
-        m_nodes.push_back(tmp); 
-        return tmp;
+        return m_arena.create<T>();
+    }
+
+    /// @brief Get the identifier for a name
+    inline Identifier ident(const String &name)
+    {
+        return Identifier(this->m_interner.intern(name));
+    }
+
+    /// @brief Get the source file handle for SourceInfo, NULL for
+    /// the unnamed source
+    inline const String* sourceFile(const String &name)
+    {
+        return name.empty() ? 0 : this->m_interner.intern(name);
+    }
+
+    /// @brief Arena owning all nodes, nodelists and tokens
+    inline const Arena& arena(void) const
+    {
+        return this->m_arena;
     }
 
 protected:
-    /// @brief All allocated nodelists, cleaned up by the destructor
-    std::list<NodeList*>  m_nodelists;
+    /// @brief All nodes, nodelists and tokens, released by the destructor
+    Arena                 m_arena;
 
-    /// @brief All allocated nodes, cleaned up by the destructor
-    NodeList              m_nodes;
+    /// @brief Last token passed to the parser (for error reporting)
+    Token                *m_lastToken;
 
-    /// @brief All allocated tokens, cleaned up by the destructor
-    std::list<Token*>     m_tokens;
+    /// @brief Interner of the engine
+    Interner             &m_interner;
 
 private:
     ParseTree(const ParseTree&);
@@ -394,46 +695,40 @@ private:
 
 
 
+/// @brief Walks the tree, the visitor is passed by reference
 template<typename Op>
-inline void foreach_node(Node::nodelist_type &nodes, Op op, int deep = -1)
+inline void walk_node(Node *node, Op &op, int deep)
 {
+    op(node);
+    if(deep > 0)
+        --deep;
+
     if(deep != 0)
     {
-        Node::nodelist_type childs = nodes;
+        for(Node *child = node->firstChild(); child; child = child->nextSibling())
+            walk_node(child, op, deep);
+    }
+}
 
 
-        for(Node::nodelist_type::iterator i = childs.begin();
-            i != childs.end();
-            ++i)
-        {
-            foreach_node(*i, op, deep);
-        }
+/// @brief Calls op for all children of node (and their children up to deep)
+template<typename Op>
+inline void foreach_child(Node *node, Op op, int deep = -1)
+{
+    if(deep != 0)
+    {
+        for(Node *child = node->firstChild(); child; child = child->nextSibling())
+            walk_node(child, op, deep);
     }
-
 }
 
 
+/// @brief Calls op for node and its children (up to deep)
 template<typename Op>
 inline void foreach_node(Node *node, Op op, int deep = -1)
 {
     if(deep != 0)
-    {
-        op(node);
-        if(deep > 0)
-            --deep;
-
-        if(deep != 0)
-        {
-            Node::nodelist_type childs = node->getChilds();
-            
-            for(Node::nodelist_type::iterator i = childs.begin();
-                i != childs.end();
-                ++i)
-            {
-                foreach_node(*i, op, deep);
-            }
-        }
-    }
+        walk_node(node, op, deep);
 }
 
 
@@ -463,8 +758,13 @@ public:
     virtual void visit(LogNode *node);
     virtual void visit(TaskExecNode *node);
     virtual void visit(ColumnNode *node);
-
-
+    virtual void visit(ObjectNode *node);
+    virtual void visit(SectionNode *node);
+    virtual void visit(ColAssignNode *node);
+    virtual void visit(NullNode *node);
+    virtual void visit(NumberNode *node);
+    virtual void visit(ParallelNode *node);
+    virtual void visit(StdValueNode *node);
 };
 
 
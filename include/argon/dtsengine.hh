@@ -30,12 +30,17 @@
 #include "argon/fwd.hh"
 #include "argon/ast.hh"
 #include "argon/token.hh"
+#include "argon/vm.hh"
+#include "argon/value.hh"
+#include "argon/transfer.hh"
 
 #include <iterator>
+#include <string>
 #include <map>
 #include <deque>
 #include <vector>
 #include <list>
+#include <memory>
 
 #include <dbwtl/dbobjects>
 #include <dbwtl/dal/engines/generic>
@@ -44,17 +49,8 @@
 ARGON_NAMESPACE_BEGIN
 
 
-class Value
-{
-public:
-    bool isVoid(void) const { return true; }
-
-    // add value token
-    // IVariant?
-
-};
-
-typedef std::list<Value> ArgumentList;
+class ConnectionPool;
+class PoolLease;
 
 
 //--------------------------------------------------------------------------
@@ -97,16 +93,117 @@ private:
 
 
 
+//--------------------------------------------------------------------------
+/// Connection factory
+///
+/// Opens further connections for a connection passed to
+/// DTSEngine::addConnection(), so its pool can grow beyond the
+/// connection given by the application.
+///
+/// @since 0.0.1
+/// @brief Connection factory
+class ConnectionFactory
+{
+public:
+    virtual ~ConnectionFactory(void)
+    {}
+
+    /// @brief Open a new connection
+    ///
+    /// The pool owns the returned connection and deletes it when the
+    /// script is done.
+    virtual db::Connection* newConnection(void) = 0;
+};
+
+
+typedef std::map<Identifier, ConnectionFactory*> ConnectionFactoryMap;
+
+
+
+//--------------------------------------------------------------------------
+/// Pool size of a connection
+///
+/// @since 0.0.1
+/// @brief Pool size of a connection
+struct PoolOptions
+{
+    PoolOptions(void)
+        : minSize(1),
+          maxSize(4),
+          statements(32)
+    {}
+
+    size_t   minSize;     ///< connections opened on first use
+    size_t   maxSize;     ///< connections open at most
+    size_t   statements;  ///< prepared statements kept, 0 disables the cache
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Pool counters
+///
+/// @since 0.0.1
+/// @brief Pool counters
+struct PoolStats
+{
+    PoolStats(void)
+        : opened(0),
+          checkouts(0),
+          waits(0),
+          waitTime(0),
+          waitMax(0),
+          peak(0),
+          statementHits(0),
+          statementMisses(0)
+    {}
+
+    size_t   opened;      ///< connections opened by the pool
+    size_t   checkouts;
+    size_t   waits;       ///< checkouts which had to wait
+    double   waitTime;    ///< seconds spent waiting
+    double   waitMax;     ///< longest wait
+    size_t   peak;        ///< connections checked out at the same time
+    size_t   statementHits;     ///< statements found in the cache
+    size_t   statementMisses;   ///< statements prepared
+};
+
+
+
 //--------------------------------------------------------------------------
 /// CONNECTION Command
 ///
+/// Each connection element has a pool of database connections. The
+/// pool opens connections on first use and hands them out for a whole
+/// task, so tasks running at the same time and the readers of a
+/// partitioned source do not share a handle.
+///
 /// @since 0.0.1
 class Connection : public Element
 {
 public:
-    Connection(Processor &proc, ConnNode *node, db::ConnectionMap &userConns);
-    
-    db::Connection& getDbc(void);
+    Connection(Processor &proc, ConnNode *node, db::ConnectionMap &userConns,
+               ConnectionFactoryMap &factories, const PoolOptions &defaults);
+
+    /// @brief The connection pool
+    inline ConnectionPool& pool(void)
+    {
+        return *this->m_pool;
+    }
+
+    /// @brief Open the first connections of the pool
+    ///
+    /// Throws ConnectionErr if a connection can not be opened.
+    void open(void);
+
+    /// @brief Check out connections for a task
+    ///
+    /// See ConnectionPool::checkout(), throws ConnectionErr if a new
+    /// connection can not be opened.
+    void checkout(PoolLease &lease, size_t need, size_t want);
+
+    /// @brief Pool counters
+    PoolStats poolStats(void) const;
 
     inline Identifier id(void) const { return m_node->id; }
 
@@ -118,16 +215,14 @@ public:
 
     virtual SourceInfo getSourceInfo(void) const;
 
-    virtual ~Connection(void)
-    {}
+    virtual ~Connection(void);
 
 protected:
-    ConnNode      *m_node;
-    db::Connection  *m_dbc;
+    ConnNode                           *m_node;
 
     // keep correct order for destruction
-    db::Env::ptr m_alloc_env;
-    db::Connection::ptr m_alloc_dbc;
+    std::auto_ptr<ConnectionFactory>    m_alloc_factory;
+    ConnectionPool                     *m_pool;
 
 private:
     Connection(const Connection &);
@@ -151,6 +246,9 @@ public:
 
     inline Identifier id(void) const { return m_node->id; }
 
+    /// @brief Task definition
+    inline TaskNode* node(void) const { return m_node; }
+
     virtual String str(void) const;
 
     virtual String name(void) const;
@@ -160,8 +258,18 @@ public:
 
     virtual Value run(const ArgumentList &args);
 
+    /// @brief Compile the task body to bytecode
+    virtual void compile(void);
+
+    /// @brief Compiled task body
+    inline const Code& code(void) const
+    {
+        return this->m_code;
+    }
+
 protected:
     TaskNode *m_node;
+    Code      m_code;
 
 private:
     Task(const Task&);
@@ -170,6 +278,167 @@ private:
 
 
 
+//--------------------------------------------------------------------------
+/// TRANSFER task
+///
+/// The first template argument is the destination, the second the
+/// source object. Source rows are fetched in batches, the column
+/// assignments of the rules section are applied to the whole batch and
+/// the result is inserted into the destination. The before, rules and
+/// after statements run once per batch, or once per row of the batch
+/// if they pass a source column to a task, initialization and
+/// finalization once per task run. A rejected row runs the except
+/// section for its SQLSTATE, or its class, else an except section
+/// without state; rows no section handles go to the reject sink or
+/// fail the task.
+///
+/// @since 0.0.1
+class TransferTask : public Task
+{
+public:
+    TransferTask(Processor &proc, TaskNode *node);
+
+    virtual ~TransferTask(void)
+    {}
+
+    virtual void compile(void);
+
+    virtual Value run(const ArgumentList &args);
+
+    /// @brief Rows written by the last run
+    inline size_t rows(void) const
+    {
+        return this->m_rows;
+    }
+
+    /// @brief Pipeline statistics of the last run
+    inline const TransferStats& stats(void) const
+    {
+        return this->m_stats;
+    }
+
+protected:
+    struct TaskTransfer;
+    class TaskWriter;
+
+    /// An except section and the SQLSTATE it handles
+    struct ExceptHandler
+    {
+        ExceptHandler(void) : state(), code()
+        {}
+
+        String      state;   ///< SQLSTATE or class, empty for every state
+        Code        code;
+    };
+
+    /// Compiled template argument
+    struct Object
+    {
+        Object(void) : type(ObjectNode::obj_table), conn(0), name(), info(),
+                       readers(0), key(), splits()
+        {}
+
+        ObjectNode::object_type   type;
+        unsigned int              conn;    ///< connection slot
+        String                    name;    ///< table name or SQL text
+        SourceInfo                info;
+        size_t                    readers; ///< parallel readers, 0 if not partitioned
+        String                    key;     ///< partition key column
+        std::vector<Value>        splits;  ///< key split values, sampled if empty
+    };
+
+    void compileObject(ObjectNode *node, Object &obj);
+
+    void compileParallel(ParallelNode *node, Object &obj);
+
+    void compileRule(ColAssignNode *node);
+
+    void collectColumns(Node *node);
+
+    void addColumnRef(const String &name, const SourceInfo &info);
+
+    String selectList(void) const;
+
+    void checkColumns(db::Connection &dbc, const String &from) const;
+
+    void openSource(BatchReader &reader, db::Connection &dbc, const String &from) const;
+
+    void bindColumns(RuleList &rules, std::vector<size_t> &refs, BatchReader &src,
+                     db::Connection &dbc, StatementCache *cache) const;
+
+    String plan(bool shared, db::Connection &dbc, const String &from, StatementCache *cache);
+
+    String select(const RuleList &rules, const String &from, String &reason) const;
+
+    void bind(RuleList &rules, std::vector<size_t> &refs, BatchReader &src,
+              BatchReader &dest) const;
+
+    Code& section(SectionNode::section_type sec);
+
+    const ExceptHandler* exceptHandler(const String &sqlstate) const;
+
+    Object                m_dest;
+    Object                m_src;
+    Code                  m_initialization;
+    Code                  m_before;
+    Code                  m_after;
+    Code                  m_finalization;
+    std::vector<ExceptHandler> m_excepts;
+    RuleList              m_rules;
+    std::vector<String>   m_destColumns;
+    std::vector<String>   m_srcColumns;    ///< source column name per rule
+    std::vector<SourceInfo> m_destInfos;   ///< first assignment per destination column
+    std::vector<String>   m_srcRefs;       ///< source columns read by the task
+    std::vector<SourceInfo> m_srcRefInfos; ///< first reference per source column
+    size_t                m_rows;
+    TransferStats         m_stats;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// STORE task
+///
+/// The template argument is the destination object. Each call adds
+/// one row built from the column assignments and the arguments of
+/// the call to a buffer of the task, the buffered rows are inserted
+/// as one batch when the buffer is full, before the calling transfer commits or rolls back, when the
+/// calling task finishes and before a transfer reads. A store called
+/// while its caller writes on the same connection inserts into the
+/// caller's transaction.
+///
+/// @since 0.0.1
+class StoreTask : public Task
+{
+public:
+    StoreTask(Processor &proc, TaskNode *node);
+
+    virtual ~StoreTask(void)
+    {}
+
+    virtual void compile(void);
+
+    virtual Value run(const ArgumentList &args);
+
+    /// @brief Insert the buffered rows
+    void flush(void);
+
+    /// @brief Rows inserted
+    size_t rows(void) const;
+
+    /// @brief Batches inserted
+    size_t flushes(void) const;
+
+protected:
+    unsigned int                   m_conn;       ///< connection slot
+    String                         m_table;
+    RuleList                       m_rules;
+    std::vector<String>            m_columns;
+    std::auto_ptr<StoreBuffer>     m_buffer;
+};
+
+
+
 //--------------------------------------------------------------------------
 /// LOG Command
 ///
@@ -241,7 +510,8 @@ class Processor
 
 public:
     typedef std::deque<Element*>            stack_type;
-    typedef std::map<Identifier, Element*>  element_map;
+    typedef std::map<Identifier, unsigned int>  symbol_map;
+    typedef std::vector<Element*>               slot_table;
 
 
     Processor(DTSEngine &engine);
@@ -252,9 +522,21 @@ public:
     /// @brief Run compiled structure
     void run(void);
 
-    /// @brief Get call stack
+    /// @brief Get call stack of the calling thread
     const stack_type& getStack(void);
 
+    /// @brief Use a separate call stack on the calling thread
+    ///
+    /// Tasks run by the scheduler on other threads need their own
+    /// stack, NULL switches back to the main stack.
+    void setThreadStack(stack_type *stack);
+
+    /// @brief Write a line to the console
+    ///
+    /// Tasks may run on several threads, the line is written as a
+    /// whole.
+    void print(const String &line);
+
     /// @brief Adds a new symbol to the symbol table
     inline void addSymbol(Identifier name, Element *symbol);
 
@@ -262,14 +544,54 @@ public:
     /// Throws if symbol is not of type T
     template<typename T> T* getSymbol(Identifier name);
 
+    /// @brief Get the slot index of a symbol
+    ///
+    /// Used by the compiler to bind references once, throws
+    /// NotDeclared if the symbol is unknown.
+    unsigned int resolveSymbol(Identifier name, const SourceInfo &info);
+
+    /// @brief Get the element stored in a slot
+    inline Element* slot(unsigned int index)
+    {
+        return this->m_slots[index];
+    }
+
 
     /// @bug remove me - NOT!
     Value call(Element *obj, const ArgumentList &args);
 
+    /// @brief Remember a store task with buffered rows
+    ///
+    /// The rows are inserted when the task which called the store
+    /// finishes, before a commit or rollback of the calling writer or
+    /// by the next flushStores() covering the caller.
+    void pendingStore(StoreTask *task);
+
+    /// @brief Insert the buffered rows of the calling thread's stores
+    /// called from stack depth @a depth or deeper
+    void flushStores(size_t depth = 0);
+
+    /// @brief Like flushStores(), for a task which failed: errors are
+    /// printed instead of thrown
+    void flushStoresAfterFailure(size_t depth);
+
+    /// @brief The engine
+    inline DTSEngine& engine(void)
+    {
+        return this->m_engine;
+    }
+
 
 protected:
     db::ConnectionMap& getConnections(void);
 
+    ConnectionFactoryMap& getFactories(void);
+
+    /// @brief Open the connections used by a task and its callees
+    void openConnections(TaskNode *task);
+
+    stack_type& stack(void);
+
     template<typename T>
     inline T* toHeap(T* elem)
     {
@@ -280,7 +602,8 @@ protected:
     DTSEngine    &m_engine;
     stack_type    m_stack;
     ParseTree    *m_tree;
-    element_map   m_symbols;
+    symbol_map    m_symbols;
+    slot_table    m_slots;
 
 private:
     /// @brief Allocated elements
@@ -307,11 +630,36 @@ public:
 
     /// @brief Adds a new connection to the internal connection list
     void addConnection(String name, db::Connection *dbc);
+
+    /// @brief Adds a connection which can be opened more than once
+    ///
+    /// The pool of the connection starts with @a dbc (may be NULL)
+    /// and opens further connections with the factory. The engine
+    /// does not own the factory.
+    void addConnection(String name, db::Connection *dbc, ConnectionFactory *factory);
  
 
     /// @bug fixme
     void load(std::istreambuf_iterator<wchar_t> in);
 
+    /// @brief Load a UTF-8 script file
+    ///
+    /// The file is memory mapped and tokenized in place.
+    void load(const std::string &path);
+
+    /// @brief Load a script from a contiguous UTF-8 buffer
+    void load(const char *data, size_t len, String srcname = String("<buffer>"));
+
+    /// @brief Load a precompiled script bundle
+    ///
+    /// The bundle is used if it is valid and matches the current
+    /// source file, otherwise the source file is parsed. Returns true
+    /// if the bundle was used.
+    bool loadBundle(const std::string &bundle, const std::string &srcpath);
+
+    /// @brief Write the loaded script as precompiled bundle
+    void writeBundle(const std::string &bundle, const std::string &srcpath);
+
     /// @brief Execute the loaded script
     void exec(void);
 
@@ -321,6 +669,53 @@ public:
     /// @brief Get task by identifier
     Task& getTask(Identifier id);
 
+    /// @brief Get the identifier for a name
+    inline Identifier ident(const String &name)
+    {
+        return Identifier(this->m_interner.intern(name));
+    }
+
+    /// @brief Options for transfer tasks
+    inline TransferOptions& transferOptions(void)
+    {
+        return this->m_transferOptions;
+    }
+
+    /// @brief Maximum number of tasks run at the same time
+    ///
+    /// With more than one job the statements of the main task are
+    /// scheduled by their data dependencies (see TaskGraph).
+    inline void setJobs(size_t jobs)
+    {
+        this->m_jobs = jobs ? jobs : 1;
+    }
+
+    inline size_t jobs(void) const
+    {
+        return this->m_jobs;
+    }
+
+    /// @brief Pool size for connections without a pool clause
+    inline PoolOptions& poolOptions(void)
+    {
+        return this->m_poolOptions;
+    }
+
+    /// @brief Receiver of rejected rows (not owned, may be NULL)
+    ///
+    /// Rows a transfer destination does not accept are passed to the
+    /// except section of the task, or to the sink if the task has
+    /// none. Without either a failing row fails the transfer.
+    inline void setRejectSink(RejectSink *sink)
+    {
+        this->m_rejectSink = sink;
+    }
+
+    inline RejectSink* rejectSink(void) const
+    {
+        return this->m_rejectSink;
+    }
+
 
 protected:
     typedef std::map<Identifier, Connection*>   connection_map;
@@ -328,10 +723,18 @@ protected:
 
     db::ConnectionMap& getConnections(void);
 
+    ConnectionFactoryMap& getFactories(void);
+
+    Interner                    m_interner;
     std::auto_ptr<ParseTree>    m_tree;
     connection_map              m_connections;
     task_map                    m_tasks;
     db::ConnectionMap           m_userConns;
+    ConnectionFactoryMap        m_factories;
+    TransferOptions             m_transferOptions;
+    PoolOptions                 m_poolOptions;
+    RejectSink                 *m_rejectSink;
+    size_t                      m_jobs;
 
 private:
     DTSEngine(const DTSEngine&);
@@ -346,10 +749,10 @@ private:
 template<typename T> T*
 Processor::getSymbol(Identifier name)
 {
-    element_map::iterator i = this->m_symbols.find(name);
+    symbol_map::iterator i = this->m_symbols.find(name);
     if(i != this->m_symbols.end())
     {
-        T* ptr = dynamic_cast<T*>(i->second);
+        T* ptr = dynamic_cast<T*>(this->m_slots[i->second]);
         if(!ptr)
             throw std::runtime_error("invalid element type");
         else
@@ -58,18 +58,85 @@ public:
 
     virtual const char* what(void) const throw();
 
+    /// @brief Copy with the dynamic type, to pass the exception to
+    /// another thread
+    virtual Exception* clone(void) const
+    { return new Exception(*this); }
+
+    /// @brief Throw the exception with its dynamic type
+    virtual void raise(void) const
+    { throw *this; }
+
     mutable std::string m_tmp;
     String m_what;
 };
 
 
+//--------------------------------------------------------------------------
+/// Compile-error exception
+///
+/// @since 0.0.1
+/// @brief Compile-error exception
+class CompileError : public Exception
+{
+public:
+    CompileError(const SourceInfo &info, const String &msg);
+
+    virtual ~CompileError(void) throw()
+    {}
+
+    virtual Exception* clone(void) const
+    { return new CompileError(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
+
+protected:
+    CompileError(void) : Exception()
+    {}
+};
+
+
 //--------------------------------------------------------------------------
 /// Not-declared exception
 ///
 /// @since 0.0.1
 /// @brief Not-declared exception
-class NotDeclared : public Exception
+class NotDeclared : public CompileError
 {
+public:
+    NotDeclared(const Identifier &id, const SourceInfo &info);
+
+    virtual ~NotDeclared(void) throw()
+    {}
+
+    virtual Exception* clone(void) const
+    { return new NotDeclared(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
+};
+
+
+//--------------------------------------------------------------------------
+/// Type-mismatch exception
+///
+/// @since 0.0.1
+/// @brief Type-mismatch exception
+class TypeMismatch : public CompileError
+{
+public:
+    TypeMismatch(const Identifier &id, const String &expected, const String &found,
+                 const SourceInfo &info);
+
+    virtual ~TypeMismatch(void) throw()
+    {}
+
+    virtual Exception* clone(void) const
+    { return new TypeMismatch(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
 };
 
 
@@ -80,6 +147,17 @@ class NotDeclared : public Exception
 /// @brief connection-error exception
 class ConnectionErr : public Exception
 {
+public:
+    ConnectionErr(const Identifier &id, const SourceInfo &info, const String &msg);
+
+    virtual ~ConnectionErr(void) throw()
+    {}
+
+    virtual Exception* clone(void) const
+    { return new ConnectionErr(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
 };
 
 
@@ -96,6 +174,12 @@ public:
     virtual ~SyntaxError(void) throw()
     {}
 
+    virtual Exception* clone(void) const
+    { return new SyntaxError(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
+
 };
 
 
@@ -106,6 +190,12 @@ public:
 /// @brief parse-error exception
 class ParseError : public Exception
 {
+public:
+    virtual Exception* clone(void) const
+    { return new ParseError(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
 };
 
 
@@ -122,6 +212,12 @@ public:
     virtual ~RuntimeError(void) throw()
     {}
 
+    virtual Exception* clone(void) const
+    { return new RuntimeError(*this); }
+
+    virtual void raise(void) const
+    { throw *this; }
+
 protected:
     const Processor::stack_type m_stack;
 };
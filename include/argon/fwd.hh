@@ -62,6 +62,12 @@ namespace db
     
     typedef informave::db::dal::IDbc                    Connection;
     typedef informave::db::dal::IEnv                    Env;
+    typedef informave::db::dal::IStmt                   Statement;
+    typedef informave::db::dal::IResult                 Result;
+    typedef informave::db::dal::IVariant                IVariant;
+    typedef informave::db::dal::Variant                 Variant;
+    typedef informave::db::Exception                    Exception;
+    typedef informave::db::SqlstateException            SqlstateException;
     typedef std::map<Identifier, Connection*>           ConnectionMap;
     
     typedef informave::db::Database<informave::db::dal::generic> Database;
@@ -0,0 +1,188 @@
+//
+// inlinevector.hh - Vector with inline storage
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Vector with inline storage
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_INLINEVECTOR_HH
+#define INFORMAVE_ARGON_INLINEVECTOR_HH
+
+#include "argon/fwd.hh"
+
+#include <cstddef>
+#include <new>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Vector with inline storage
+///
+/// The first N elements are stored inside the object, the heap is only
+/// used if the vector grows beyond N elements.
+///
+/// @since 0.0.1
+/// @brief Vector with inline storage
+template<typename T, size_t N>
+class InlineVector
+{
+public:
+    typedef T              value_type;
+    typedef T*             iterator;
+    typedef const T*       const_iterator;
+    typedef size_t         size_type;
+
+    InlineVector(void)
+        : m_data(inlineData()),
+          m_size(0),
+          m_capacity(N)
+    {}
+
+    InlineVector(const InlineVector &other)
+        : m_data(inlineData()),
+          m_size(0),
+          m_capacity(N)
+    {
+        this->reserve(other.m_size);
+        for(size_type i = 0; i < other.m_size; ++i)
+            this->push_back(other.m_data[i]);
+    }
+
+    ~InlineVector(void)
+    {
+        this->clear();
+        if(this->m_data != inlineData())
+            ::operator delete(this->m_data);
+    }
+
+    InlineVector& operator=(const InlineVector &other)
+    {
+        if(this != &other)
+        {
+            this->clear();
+            this->reserve(other.m_size);
+            for(size_type i = 0; i < other.m_size; ++i)
+                this->push_back(other.m_data[i]);
+        }
+        return *this;
+    }
+
+    inline void push_back(const T &value)
+    {
+        if(this->m_size == this->m_capacity)
+        {
+            // value may refer to an element of this vector
+            T tmp(value);
+            this->reserve(this->m_capacity * 2);
+            new(this->m_data + this->m_size) T(tmp);
+        }
+        else
+            new(this->m_data + this->m_size) T(value);
+        ++this->m_size;
+    }
+
+    inline void pop_back(void)
+    {
+        this->m_data[--this->m_size].~T();
+    }
+
+    void clear(void)
+    {
+        while(this->m_size)
+            this->pop_back();
+    }
+
+    void reserve(size_type capacity)
+    {
+        if(capacity <= this->m_capacity)
+            return;
+
+        T *data = static_cast<T*>(::operator new(capacity * sizeof(T)));
+        for(size_type i = 0; i < this->m_size; ++i)
+        {
+            new(data + i) T(this->m_data[i]);
+            this->m_data[i].~T();
+        }
+        if(this->m_data != inlineData())
+            ::operator delete(this->m_data);
+        this->m_data = data;
+        this->m_capacity = capacity;
+    }
+
+    inline size_type size(void) const          { return this->m_size; }
+    inline size_type capacity(void) const      { return this->m_capacity; }
+    inline bool empty(void) const              { return this->m_size == 0; }
+
+    /// @brief True if the elements are stored inside the object
+    inline bool isInline(void) const           { return this->m_data == inlineData(); }
+
+    inline T& operator[](size_type i)             { return this->m_data[i]; }
+    inline const T& operator[](size_type i) const { return this->m_data[i]; }
+
+    inline iterator begin(void)                { return this->m_data; }
+    inline iterator end(void)                  { return this->m_data + this->m_size; }
+    inline const_iterator begin(void) const    { return this->m_data; }
+    inline const_iterator end(void) const      { return this->m_data + this->m_size; }
+
+protected:
+    inline T* inlineData(void) const
+    {
+        return reinterpret_cast<T*>(const_cast<char*>(this->m_inline.bytes));
+    }
+
+    union max_align
+    {
+        long double   ld;
+        long long     ll;
+        double        d;
+        void         *p;
+    };
+
+    union Storage
+    {
+        char        bytes[N * sizeof(T)];
+        max_align   align;
+    };
+
+    Storage     m_inline;
+    T          *m_data;
+    size_type   m_size;
+    size_type   m_capacity;
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,83 @@
+//
+// interner.hh - String interner
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief String interner
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_INTERNER_HH
+#define INFORMAVE_ARGON_INTERNER_HH
+
+#include "argon/fwd.hh"
+
+#include <set>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// String interner
+///
+/// Keeps one copy of every distinct string. The returned pointers stay
+/// valid until the interner is destroyed, so two interned strings are
+/// equal if and only if their pointers are equal. Each DTSEngine owns
+/// one interner for all identifiers of its scripts.
+///
+/// @since 0.0.1
+/// @brief String interner
+class Interner
+{
+public:
+    Interner(void);
+
+    /// @brief Get the unique copy of str
+    const String* intern(const String &str);
+
+    /// @brief Number of distinct strings
+    inline size_t size(void) const
+    {
+        return this->m_strings.size();
+    }
+
+protected:
+    std::set<String>   m_strings;
+
+private:
+    Interner(const Interner&);
+    Interner& operator=(const Interner&);
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
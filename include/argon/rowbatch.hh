@@ -0,0 +1,352 @@
+//
+// rowbatch.hh - Columnar row batch
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Columnar row batch
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_ROWBATCH_HH
+#define INFORMAVE_ARGON_ROWBATCH_HH
+
+#include "argon/fwd.hh"
+#include "argon/value.hh"
+
+#include <vector>
+#include <cassert>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Column vector
+///
+/// Values of one column of a row batch. The column takes the type of
+/// the first value stored after clear() and keeps its rows in a plain
+/// array of that type: integers, decimals (unscaled integers and
+/// scales), floats and dates inline, strings as offset and length into
+/// a character arena which belongs to the column. NULL is a cleared
+/// bit in the validity bitmap. A value of another type (or a LOB)
+/// turns the column into an array of generic values until the next
+/// clear().
+///
+/// The arrays are allocated with the first value of their type and
+/// reused by later batches, the arena only grows.
+///
+/// Columns of different types are converted by kernels, one per type
+/// pair, which convert a whole column at once (see kernel()).
+///
+/// @since 0.0.1
+/// @brief Column vector
+class ColumnVector
+{
+public:
+    typedef enum
+    {
+        col_empty = 0,   ///< no value since clear(), all rows are NULL
+        col_int,
+        col_decimal,
+        col_float,
+        col_date,
+        col_string,
+        col_value        ///< mixed types, generic values
+    } column_type;
+
+    ColumnVector(size_t capacity);
+
+    inline column_type type(void) const
+    {
+        return static_cast<column_type>(this->m_type);
+    }
+
+    inline size_t capacity(void) const
+    {
+        return this->m_capacity;
+    }
+
+    /// @brief Value type of the rows, void if the column is empty or
+    /// has mixed types
+    Value::value_type valueType(void) const;
+
+    inline bool isNull(size_t row) const
+    {
+        assert(row < this->m_capacity);
+        return ! (this->m_valid[row / word_bits] & (1UL << (row % word_bits)));
+    }
+
+    /// @brief Value of a row, NULL if the row has no value
+    Value get(size_t row) const;
+
+    /// @brief Store a value, NULL and void clear the row
+    void set(size_t row, const Value &value);
+
+    void setNull(size_t row);
+
+    void setInt(size_t row, long long v);
+
+    void setFloat(size_t row, double v);
+
+    void setDate(size_t row, const DateTime &dt);
+
+    /// @brief Store a string, the characters are copied to the arena
+    void setString(size_t row, const wchar_t *str, size_t len);
+
+    // Typed access, only valid for a non-NULL row of a column of the
+    // matching type
+
+    /// @brief Integer or unscaled decimal
+    inline long long intAt(size_t row) const
+    {
+        return this->m_ints[row];
+    }
+
+    inline unsigned int scaleAt(size_t row) const
+    {
+        return this->m_scales[row];
+    }
+
+    inline double floatAt(size_t row) const
+    {
+        return this->m_floats[row];
+    }
+
+    inline const DateTime& dateAt(size_t row) const
+    {
+        return this->m_dates[row];
+    }
+
+    inline const wchar_t* strData(size_t row) const
+    {
+        return this->m_chars.empty() ? L"" : &this->m_chars[0] + this->m_offsets[row];
+    }
+
+    inline size_t strLength(size_t row) const
+    {
+        return this->m_lengths[row];
+    }
+
+    inline const Value& valueAt(size_t row) const
+    {
+        return this->m_values[row];
+    }
+
+    /// @brief Make all rows NULL and forget the type
+    void clear(void);
+
+    /// @brief Replace rows [0, rows) by those of @a src
+    ///
+    /// The arrays are copied as a whole, the strings of @a src are
+    /// copied with its arena.
+    void copy(const ColumnVector &src, size_t rows);
+
+    /// @brief Replace rows [0, n) by the rows @a sel of @a src
+    void gather(const ColumnVector &src, const size_t *sel, size_t n);
+
+    /// @brief Set rows [0, rows) to @a value
+    ///
+    /// A string is stored once, all rows refer to it.
+    void fill(const Value &value, size_t rows);
+
+    /// @brief Set rows [0, rows) to NULL
+    void fillNull(size_t rows);
+
+    /// @brief Set the NULL rows of [0, rows) to @a value
+    ///
+    /// Only the words of the bitmap which have NULL rows are visited.
+    void fillNulls(const Value &value, size_t rows);
+
+    /// @brief Conversion kernel: replaces rows [0, n) of @a dest by
+    /// the rows @a sel of @a src (rows [0, n) if @a sel is null),
+    /// converted to the type of the kernel
+    typedef void (*Kernel)(const ColumnVector &src, ColumnVector &dest, const size_t *sel, size_t n);
+
+    /// @brief Kernel converting @a from to @a to, null if the values
+    /// are copied as they are
+    ///
+    /// A column whose values do not have the type @a from is copied.
+    static Kernel kernel(Value::value_type from, Value::value_type to);
+
+protected:
+    template<int From, int To> friend struct ConvertCell;
+    template<int From, int To> friend struct ConvertColumn;
+
+    static const size_t word_bits = sizeof(unsigned long) * 8;
+
+    inline void setValid(size_t row)
+    {
+        this->m_valid[row / word_bits] |= 1UL << (row % word_bits);
+    }
+
+    /// Mark rows [0, rows) as not NULL
+    void setValidRange(size_t rows);
+
+    /// Column type of a value type
+    static column_type kindOf(const Value &value);
+
+    /// True if the column can take a value of @a type without
+    /// falling back to generic values
+    inline bool accept(column_type type)
+    {
+        if(this->m_type == type)
+            return true;
+        if(this->m_type != col_empty)
+            return false;
+        this->init(type);
+        return true;
+    }
+
+    /// Set the type and allocate its arrays
+    void init(column_type type);
+
+    /// Fall back to generic values, keeps the stored rows
+    void promote(void);
+
+    void setValue(size_t row, const Value &value);
+
+    size_t                       m_capacity;
+    unsigned char                m_type;
+    std::vector<unsigned long>   m_valid;     ///< validity bitmap, set bit: not NULL
+    std::vector<long long>       m_ints;      ///< integers, unscaled decimals
+    std::vector<unsigned char>   m_scales;    ///< decimal scales
+    std::vector<double>          m_floats;
+    std::vector<DateTime>        m_dates;
+    std::vector<size_t>          m_offsets;   ///< string start in m_chars
+    std::vector<size_t>          m_lengths;   ///< string length
+    std::vector<wchar_t>         m_chars;     ///< string arena
+    std::vector<Value>           m_values;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Row batch
+///
+/// Fixed capacity block of rows, stored column by column. The columns
+/// are reused by the next batch, so fetching a batch does not
+/// allocate once the arrays and arenas are large enough.
+///
+/// A selection vector restricts the batch to some of its rows, in the
+/// given order. The rules and the batch writer only process the
+/// selected rows, without a selection all rows are active.
+///
+/// @since 0.0.1
+/// @brief Row batch
+class RowBatch
+{
+public:
+    RowBatch(size_t columns, size_t capacity);
+
+    inline ColumnVector& column(size_t col)
+    {
+        return this->m_cols[col];
+    }
+
+    inline const ColumnVector& column(size_t col) const
+    {
+        return this->m_cols[col];
+    }
+
+    /// @brief Value of a column (0-based) in a row
+    inline Value value(size_t row, size_t col) const
+    {
+        return this->m_cols[col].get(row);
+    }
+
+    inline void set(size_t row, size_t col, const Value &value)
+    {
+        this->m_cols[col].set(row, value);
+    }
+
+    /// @brief Number of rows in the batch
+    inline size_t rows(void) const
+    {
+        return this->m_rows;
+    }
+
+    inline size_t columns(void) const
+    {
+        return this->m_columns;
+    }
+
+    inline size_t capacity(void) const
+    {
+        return this->m_capacity;
+    }
+
+    /// @brief Set the number of rows, must not exceed the capacity
+    void resize(size_t rows);
+
+    /// @brief Remove all rows and the selection, all columns are NULL
+    void clear(void);
+
+    /// @brief Restrict the batch to the rows @a sel
+    void select(const std::vector<size_t> &sel);
+
+    /// @brief Make all rows active
+    void selectAll(void);
+
+    /// @brief True if a selection is set
+    inline bool isSelective(void) const
+    {
+        return this->m_selective;
+    }
+
+    inline const std::vector<size_t>& selection(void) const
+    {
+        return this->m_selection;
+    }
+
+    /// @brief Number of active rows
+    inline size_t active(void) const
+    {
+        return this->m_selective ? this->m_selection.size() : this->m_rows;
+    }
+
+    /// @brief Row index of the i-th active row
+    inline size_t activeRow(size_t i) const
+    {
+        return this->m_selective ? this->m_selection[i] : i;
+    }
+
+protected:
+    size_t                       m_columns;
+    size_t                       m_capacity;
+    size_t                       m_rows;
+    std::vector<ColumnVector>    m_cols;
+    std::vector<size_t>          m_selection;
+    bool                         m_selective;
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -39,12 +39,16 @@ ARGON_NAMESPACE_BEGIN
 //--------------------------------------------------------------------------
 /// Token source information
 ///
+/// The source file is a handle to its name in the Interner of the
+/// engine which loaded the script (see ParseTree::sourceFile()), NULL
+/// for the unnamed source. The name is valid as long as the engine.
+///
 /// @since 0.0.1
 /// @brief Provides information about token source
 class SourceInfo
 {
 public:
-    SourceInfo(String file = "",
+    SourceInfo(const String *file = 0,
                std::streamsize chpos = 0, size_t len = 0, size_t line = 0);
 
     /// @brief Update/expand the current info
@@ -65,13 +69,18 @@ public:
         return this->m_line;
     }
 
-    inline String sourceName(void) const
+    inline const String* file(void) const
     {
         return this->m_file;
     }
 
+    inline String sourceName(void) const
+    {
+        return this->m_file ? *this->m_file : String();
+    }
+
 protected:
-    String            m_file;
+    const String     *m_file;
     std::streamsize   m_offset;
     size_t            m_len;
     size_t            m_line;
@@ -112,7 +121,7 @@ public:
     void setData(const String &str);
 
     /// @brief Get the raw data
-    String data(void) const;
+    const String& data(void) const;
 
     /// @brief Get the token ID used by the parser
     int id(void) const;
@@ -0,0 +1,817 @@
+//
+// transfer.hh - Batched transfer runtime
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Batched transfer runtime
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_TRANSFER_HH
+#define INFORMAVE_ARGON_TRANSFER_HH
+
+#include "argon/fwd.hh"
+#include "argon/value.hh"
+#include "argon/rowbatch.hh"
+#include "argon/token.hh"
+
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <string>
+
+ARGON_NAMESPACE_BEGIN
+
+
+class StatementCache;
+class Mutex;
+
+
+//--------------------------------------------------------------------------
+/// Transfer options
+///
+/// @since 0.0.1
+/// @brief Transfer options
+struct TransferOptions
+{
+    TransferOptions(void)
+        : batchSize(1000),
+          commitInterval(10000),
+          evaluators(0),
+          queueDepth(4),
+          explain(false)
+    {}
+
+    /// @brief Rows fetched from the source per batch
+    size_t   batchSize;
+
+    /// @brief Rows per destination transaction, 0 commits once at the end
+    size_t   commitInterval;
+
+    /// @brief Rule evaluator threads, 0 runs the transfer on the calling thread
+    size_t   evaluators;
+
+    /// @brief Batches in flight between the pipeline stages
+    size_t   queueDepth;
+
+    /// @brief Print the path each transfer task takes and why
+    bool     explain;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Pipeline stage statistics
+///
+/// @since 0.0.1
+/// @brief Pipeline stage statistics
+struct StageStats
+{
+    StageStats(void)
+        : batches(0),
+          stall(0),
+          depthMax(0),
+          depthSum(0)
+    {}
+
+    /// @brief Add the counters of another thread of the same stage
+    void merge(const StageStats &s);
+
+    /// @brief Average depth of the output queue
+    double depthAvg(void) const;
+
+    size_t   batches;    ///< batches passed to the next stage
+    double   stall;      ///< seconds spent waiting for a batch or a free slot
+    size_t   depthMax;   ///< max. depth of the output queue after a push
+    size_t   depthSum;   ///< sum of the output queue depths after each push
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Transfer statistics
+///
+/// A stage that stalls a lot waits for its neighbours, the bottleneck
+/// is the stage with the least stall time. A full queue in front of a
+/// stage means that the stage can not keep up.
+///
+/// @since 0.0.1
+/// @brief Transfer statistics
+struct TransferStats
+{
+    TransferStats(void)
+        : reader(),
+          evaluator(),
+          writer(),
+          queueCapacity(0),
+          rows(0),
+          readers(0),
+          chunks(0),
+          rejected(0),
+          pipelined(false)
+    {}
+
+    StageStats   reader;        ///< all reader threads, output queue: read batches
+    StageStats   evaluator;     ///< all evaluator threads, output queue: evaluated batches
+    StageStats   writer;
+    size_t       queueCapacity;
+    size_t       rows;
+    size_t       readers;       ///< reader threads
+    size_t       chunks;        ///< key range chunks read, 0 if not partitioned
+    size_t       rejected;      ///< rows the destination did not accept
+    bool         pipelined;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Column rule
+///
+/// Compiled form of a column assignment in the rules section. The
+/// source column is bound to its position and declared type when the
+/// task opens its objects, a destination column (%column) refers to
+/// a column assigned by an earlier rule.
+///
+/// @since 0.0.1
+/// @brief Column rule
+struct ColumnRule
+{
+    typedef enum
+    {
+        rule_copy = 0,   ///< copy source column <src>
+        rule_const,      ///< assign <value>
+        rule_null,       ///< assign NULL
+        rule_default     ///< copy source column <src>, NULL becomes the standard value
+    } rule_type;
+
+    ColumnRule(void)
+        : type(rule_null),
+          dest(0),
+          src(0),
+          result(false),
+          srcType(Value::type_void),
+          destType(Value::type_void),
+          convert(0),
+          value()
+    {}
+
+    rule_type           type;
+    size_t              dest;       ///< destination column (0-based)
+    size_t              src;        ///< source column (0-based)
+    bool                result;     ///< <src> is a destination column
+    Value::value_type   srcType;    ///< declared type of <src>, void if unknown
+    Value::value_type   destType;   ///< declared type of <dest>, void if unknown
+    ColumnVector::Kernel convert;   ///< converts <src> to destType, null copies it
+
+    /// Constant, or for rule_default the standard value of the declared
+    /// source column type. The standard value of the fetched type is
+    /// used instead if a batch has one.
+    Value        value;
+};
+
+typedef std::vector<ColumnRule> RuleList;
+
+
+/// @brief Standard value of the @ operator: 0, 0.0 or an empty
+/// string, void for dates, LOBs and unknown types
+Value standard_value(Value::value_type type);
+
+/// @brief Apply the rules to the active rows of a batch, column by column
+void apply_rules(const RuleList &rules, const RowBatch &src, RowBatch &dest);
+
+
+
+//--------------------------------------------------------------------------
+/// Prepared statement
+///
+/// Takes the statement from a StatementCache if one is given and
+/// gives it back when released, otherwise the statement is prepared
+/// for this object only.
+///
+/// @since 0.0.1
+/// @brief Prepared statement
+class CachedStatement
+{
+public:
+    CachedStatement(void)
+        : m_cache(0),
+          m_stmt(0)
+    {}
+
+    ~CachedStatement(void)
+    {
+        this->release();
+    }
+
+    /// @brief Get a statement prepared for @a sql
+    void prepare(db::Connection &dbc, const String &sql, StatementCache *cache = 0);
+
+    void release(void);
+
+    inline db::Statement* operator->(void)
+    {
+        return this->m_stmt;
+    }
+
+    inline db::Statement& operator*(void)
+    {
+        return *this->m_stmt;
+    }
+
+    inline db::Statement* get(void)
+    {
+        return this->m_stmt;
+    }
+
+protected:
+    StatementCache    *m_cache;
+    db::Statement     *m_stmt;
+
+private:
+    CachedStatement(const CachedStatement&);
+    CachedStatement& operator=(const CachedStatement&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Savepoint
+///
+/// The name is unique among the savepoints alive at the same time, so
+/// writers nested on one connection do not replace each other's
+/// savepoint. dbwtl has no call to release a savepoint: release()
+/// sends RELEASE SAVEPOINT and, if the driver rejects it (SQL Server,
+/// Oracle), does nothing from then on, the savepoints are dropped with
+/// the transaction there.
+///
+/// @since 0.0.1
+/// @brief Savepoint
+class Savepoint
+{
+public:
+    explicit Savepoint(db::Connection &dbc);
+
+    /// @brief Set the savepoint
+    void set(void);
+
+    /// @brief Roll back to the savepoint
+    void rollback(void);
+
+    /// @brief Release the savepoint, if the driver supports it
+    void release(void);
+
+    inline const String& name(void) const
+    {
+        return this->m_name;
+    }
+
+protected:
+    db::Connection    &m_dbc;
+    String             m_name;
+    bool               m_release;   ///< false if the driver has no release
+
+private:
+    Savepoint(const Savepoint&);
+    Savepoint& operator=(const Savepoint&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Batch reader
+///
+/// Executes a query and fetches the result in batches.
+///
+/// @since 0.0.1
+/// @brief Batch reader
+class BatchReader
+{
+public:
+    BatchReader(db::Connection &dbc, const String &sql,
+                const std::vector<Value> &params = std::vector<Value>(),
+                StatementCache *cache = 0);
+
+    /// @brief Prepare the query, bind the parameters and execute it
+    void open(void);
+
+    /// @brief Fetch the next rows into the batch
+    ///
+    /// Fills up to batch.capacity() rows and returns the number of
+    /// rows, 0 if the result is exhausted.
+    size_t fetch(RowBatch &batch);
+
+    /// @brief Number of result columns
+    size_t columnCount(void) const;
+
+    /// @brief Index (0-based) of a result column, throws if unknown
+    size_t columnIndex(const String &name) const;
+
+    /// @brief Index (0-based) of a result column, npos if unknown
+    ///
+    /// An exact match wins, otherwise the case is ignored.
+    size_t findColumn(const String &name) const;
+
+    /// @brief Fetch only the columns @a cols (0-based), the others
+    /// stay NULL. An empty list fetches all columns.
+    void useColumns(const std::vector<size_t> &cols);
+
+    inline const std::vector<size_t>& usedColumns(void) const
+    {
+        return this->m_used;
+    }
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+    /// @brief Value type of a result column by its declared type,
+    /// void if the driver does not know it
+    Value::value_type columnType(size_t col) const;
+
+protected:
+    db::Connection                 &m_dbc;
+    String                          m_sql;
+    std::vector<Value>              m_params;
+    StatementCache                 *m_cache;
+    CachedStatement                 m_stmt;
+    db::Result                     *m_result;
+    std::vector<size_t>             m_used;
+
+private:
+    BatchReader(const BatchReader&);
+    BatchReader& operator=(const BatchReader&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Batch writer
+///
+/// Inserts batches into a table through a single prepared statement
+/// and commits every TransferOptions::commitInterval rows. If the
+/// writer is destroyed before close() the open transaction is rolled
+/// back.
+///
+/// A writer opened on a connection which already has a writer
+/// transaction on the same thread inserts into that transaction and
+/// leaves the commit to its owner.
+///
+/// If failures are isolated, a batch is inserted after a savepoint.
+/// A row which fails rolls the batch back to the savepoint, the rows
+/// before it are inserted again and the row is passed to
+/// rejectRow(), then the writer goes on with the next row. Commits
+/// are only made between batches then.
+///
+/// @since 0.0.1
+/// @brief Batch writer
+class BatchWriter
+{
+public:
+    BatchWriter(db::Connection &dbc, const String &table,
+                const std::vector<String> &columns, size_t commitInterval,
+                StatementCache *cache = 0);
+
+    virtual ~BatchWriter(void);
+
+    /// @brief True if a writer of the calling thread has a
+    /// transaction open on @a dbc
+    static bool inTransaction(db::Connection &dbc);
+
+    /// @brief Prepare the insert statement and start a transaction
+    void open(void);
+
+    /// @brief Pass failing rows to rejectRow() instead of throwing
+    inline void isolateFailures(bool on)
+    {
+        this->m_isolate = on;
+    }
+
+    /// @brief Insert the active rows of the batch
+    void write(const RowBatch &batch);
+
+    /// @brief Insert the rows of a query on the destination
+    /// connection with one INSERT ... SELECT statement
+    ///
+    /// The columns of @a select are the destination columns in
+    /// order. Needs no open(), close() commits.
+    void insertFrom(const String &select);
+
+    /// @brief Commit the pending rows and release the statement
+    void close(void);
+
+    /// @brief Number of rows written
+    inline size_t rows(void) const
+    {
+        return this->m_rows;
+    }
+
+    /// @brief Number of rows rejected
+    inline size_t rejected(void) const
+    {
+        return this->m_rejected;
+    }
+
+    /// @brief Number of destination columns
+    inline size_t columns(void) const
+    {
+        return this->m_columns;
+    }
+
+    /// @brief The insert statement
+    inline const String& sql(void) const
+    {
+        return this->m_sql;
+    }
+
+protected:
+    /// @brief Called before each commit of the writer's transaction
+    virtual void beforeCommit(void)
+    {}
+
+    /// @brief Called for each row which failed with @a sqlstate and
+    /// @a error
+    virtual void rejectRow(const RowBatch &batch, size_t row, const String &sqlstate,
+                           const String &error)
+    {}
+
+    /// @brief Insert the active rows [begin, end), the position of
+    /// the first failing row is returned in @a failed
+    bool insert(const RowBatch &batch, size_t begin, size_t end, size_t &failed,
+                String &sqlstate, String &error);
+
+    void writeIsolated(const RowBatch &batch);
+
+    /// @brief Start a transaction unless the calling thread has one
+    void begin(void);
+
+    db::Connection                 &m_dbc;
+    String                          m_target;   ///< INSERT INTO table (columns)
+    String                          m_sql;
+    size_t                          m_columns;
+    size_t                          m_commitInterval;
+    size_t                          m_pending;
+    size_t                          m_rows;
+    size_t                          m_rejected;
+    bool                            m_inTrans;
+    bool                            m_isolate;
+    StatementCache                 *m_cache;
+    CachedStatement                 m_stmt;
+    Savepoint                       m_savepoint;
+
+private:
+    BatchWriter(const BatchWriter&);
+    BatchWriter& operator=(const BatchWriter&);
+};
+
+
+//--------------------------------------------------------------------------
+/// Reject record
+///
+/// A row the destination of a transfer did not accept.
+///
+/// @since 0.0.1
+/// @brief Reject record
+struct RejectRecord
+{
+    RejectRecord(void)
+        : task(),
+          sqlstate(),
+          info(),
+          error(),
+          columns(0),
+          values()
+    {}
+
+    /// @brief The row as "column=value, ..."
+    String rowText(void) const;
+
+    String                        task;
+    String                        sqlstate;   ///< HY000 if the driver gave none
+    SourceInfo                    info;       ///< task definition, valid with the engine
+    String                        error;
+    const std::vector<String>    *columns;    ///< destination columns
+    std::vector<Value>            values;     ///< destination row
+};
+
+
+
+
+//--------------------------------------------------------------------------
+/// Reject sink
+///
+/// Receives the rows a transfer destination did not accept, if the
+/// task has no except section. Transfers running at the same time
+/// share the sink of the engine.
+///
+/// @since 0.0.1
+/// @brief Reject sink
+class RejectSink
+{
+public:
+    virtual ~RejectSink(void)
+    {}
+
+    /// @brief Take a rejected row
+    virtual void reject(const RejectRecord &rec) = 0;
+
+    /// @brief Write buffered records, called when a transfer which
+    /// rejected rows ends
+    virtual void flush(void)
+    {}
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Reject file
+///
+/// Appends one tab separated line per record (task, SQLSTATE,
+/// file:line, error, row) to a file. Records are written in batches.
+///
+/// @since 0.0.1
+/// @brief Reject file
+class RejectFile : public RejectSink
+{
+public:
+    RejectFile(const std::string &path, size_t batch = 1000);
+
+    virtual ~RejectFile(void);
+
+    virtual void reject(const RejectRecord &rec);
+
+    virtual void flush(void);
+
+    /// @brief Records taken
+    size_t records(void) const;
+
+protected:
+    void write(void);
+
+    std::ofstream      m_file;
+    std::string        m_buffer;
+    size_t             m_batch;
+    size_t             m_pending;
+    size_t             m_records;
+    Mutex             *m_lock;
+
+private:
+    RejectFile(const RejectFile&);
+    RejectFile& operator=(const RejectFile&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Reject table
+///
+/// Inserts the records in batches into a table with the text columns
+/// task, sqlstate, source, error and rowdata, each batch in a
+/// transaction of its own. While a transfer of the calling thread
+/// writes on the same connection, the records are kept and inserted
+/// by the first flush() after its transaction ended, so a rollback of
+/// the transfer does not take them along. A connection of its own
+/// avoids the wait.
+///
+/// @since 0.0.1
+/// @brief Reject table
+class RejectTable : public RejectSink
+{
+public:
+    RejectTable(db::Connection &dbc, const String &table, size_t batch = 1000);
+
+    virtual ~RejectTable(void);
+
+    virtual void reject(const RejectRecord &rec);
+
+    virtual void flush(void);
+
+    /// @brief Records taken
+    size_t records(void) const;
+
+protected:
+    void write(void);
+
+    void grow(void);
+
+    db::Connection         &m_dbc;
+    String                  m_table;
+    std::auto_ptr<RowBatch> m_batch;
+    size_t                  m_records;
+    Mutex                  *m_lock;
+
+private:
+    RejectTable(const RejectTable&);
+    RejectTable& operator=(const RejectTable&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Store buffer
+///
+/// Collects the rows of single row stores to one table and inserts
+/// them as one batch. The rules of a store assign constants, NULL or
+/// the arguments of the call.
+///
+/// @since 0.0.1
+/// @brief Store buffer
+class StoreBuffer
+{
+public:
+    StoreBuffer(const String &table, const std::vector<String> &columns, size_t capacity);
+
+    /// @brief Add a row, returns true if the buffer is full
+    ///
+    /// Copy rules take their value from @a args.
+    bool add(const RuleList &rules, const ArgumentList &args);
+
+    /// @brief Insert the buffered rows
+    ///
+    /// The rows go into an open writer transaction of the calling
+    /// thread on @a dbc, otherwise they are committed at once.
+    void flush(db::Connection &dbc, StatementCache *cache = 0);
+
+    /// @brief Rows not yet inserted
+    inline size_t pending(void) const
+    {
+        return this->m_batch.rows();
+    }
+
+    /// @brief Rows inserted
+    inline size_t rows(void) const
+    {
+        return this->m_rows;
+    }
+
+    /// @brief Batches inserted
+    inline size_t flushes(void) const
+    {
+        return this->m_flushes;
+    }
+
+protected:
+    String                  m_table;
+    std::vector<String>     m_columns;
+    RowBatch                m_batch;
+    size_t                  m_rows;
+    size_t                  m_flushes;
+};
+
+
+//--------------------------------------------------------------------------
+/// Key range chunk
+///
+/// Query for a part of a partitioned source, the parameters are the
+/// key bounds.
+///
+/// @since 0.0.1
+/// @brief Key range chunk
+struct KeyChunk
+{
+    String               sql;
+    std::vector<Value>   params;
+};
+
+typedef std::vector<KeyChunk> ChunkList;
+
+
+/// @brief Split a source into key range chunks
+///
+/// @a from is a table name in SQL (see sql_identifier()) or a
+/// parenthesized query with an alias, @a key a column name. The
+/// ascending @a splits divide the key space, the first chunk reads
+/// all keys below the first split value and the last one all keys
+/// from the last split value on. Without split values the range
+/// between MIN(key) and MAX(key) is divided into @a chunks ranges of
+/// equal width, which requires a numeric key. Rows with a NULL key
+/// are read by an extra chunk. The chunks select @a columns.
+ChunkList split_key_range(db::Connection &dbc, const String &from, const String &key,
+                          size_t chunks, const std::vector<Value> &splits,
+                          const String &columns = String("*"));
+
+
+
+//--------------------------------------------------------------------------
+/// Transfer
+///
+/// Moves all rows from a reader through the rules into a writer. With
+/// TransferOptions::evaluators > 0 the transfer is pipelined: a reader
+/// thread fetches batches, evaluator threads apply the rules and the
+/// calling thread writes the batches. The stages are connected by
+/// bounded lock-free queues, so a slow stage blocks the stages in
+/// front of it when all batches are in flight. With more than one
+/// evaluator the batches may be written out of order.
+///
+/// The reader and the writer must use different connections if the
+/// transfer is pipelined.
+///
+/// A partitioned transfer reads key range chunks with one reader
+/// thread per connection. The readers take the chunks from a shared
+/// queue, so a reader that got a dense range does not hold up the
+/// others. The reader passed to the constructor only provides the
+/// column layout then. Partitioned transfers are always pipelined,
+/// without evaluator threads the readers apply the rules.
+///
+/// @since 0.0.1
+/// @brief Transfer
+class Transfer
+{
+public:
+    Transfer(BatchReader &reader, BatchWriter &writer, const RuleList &rules,
+             const TransferOptions &opts);
+
+    virtual ~Transfer(void)
+    {}
+
+    /// @brief Read the source in key range chunks
+    ///
+    /// Each connection is used by one reader thread and must not be
+    /// the connection of the writer. The chunk queries are prepared
+    /// through @a cache if given.
+    void partition(const ChunkList &chunks, const std::vector<db::Connection*> &readers,
+                   StatementCache *cache = 0);
+
+    /// @brief Run until the source is exhausted
+    void run(void);
+
+    inline const TransferStats& stats(void) const
+    {
+        return this->m_stats;
+    }
+
+protected:
+    /// @brief Called on the calling thread before a batch is
+    /// written, @a in holds the fetched rows
+    virtual void beforeBatch(const RowBatch &in)
+    {}
+
+    /// @brief Called on the calling thread after a batch is written
+    virtual void afterBatch(const RowBatch &in)
+    {}
+
+    void runSerial(void);
+
+    void runPipelined(void);
+
+    BatchReader                    &m_reader;
+    BatchWriter                    &m_writer;
+    const RuleList                 &m_rules;
+    TransferOptions                 m_opts;
+    TransferStats                   m_stats;
+    ChunkList                       m_chunks;
+    std::vector<db::Connection*>    m_readerDbcs;
+    StatementCache                 *m_cache;
+
+private:
+    Transfer(const Transfer&);
+    Transfer& operator=(const Transfer&);
+};
+
+
+/// @brief Convert a dbwtl value
+Value to_value(const db::IVariant &var);
+
+/// @brief Convert a value for binding
+db::Variant to_variant(const Value &value);
+
+/// @brief Parse a number literal (integer or decimal)
+Value parse_number(const String &str);
+
+/// @brief SQL text of a table or column name
+///
+/// Each dot-separated part which is not a regular identifier is put
+/// in double quotes. Regular parts are kept as written, so the
+/// database still folds their case, and a name starting with a quote
+/// is taken as quoted already.
+String sql_identifier(const String &name);
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,233 @@
+//
+// value.hh - Value
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Value
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_VALUE_HH
+#define INFORMAVE_ARGON_VALUE_HH
+
+#include "argon/fwd.hh"
+#include "argon/inlinevector.hh"
+
+#include <cstddef>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Date/time value
+///
+/// @since 0.0.1
+/// @brief Date/time value
+struct DateTime
+{
+    short           year;
+    unsigned char   month;
+    unsigned char   day;
+    unsigned char   hour;
+    unsigned char   minute;
+    unsigned char   second;
+    unsigned int    fraction;    ///< nanoseconds
+
+    bool operator==(const DateTime &o) const;
+};
+
+
+//--------------------------------------------------------------------------
+/// Value
+///
+/// Tagged union of all values a script can handle. Integers, decimals
+/// (scaled 64 bit integers), floats, dates and strings of up to
+/// Value::short_string_max characters are stored inline, creating or
+/// copying them never touches the heap. Longer strings and LOBs are
+/// kept in a reference counted heap block which is shared by copies.
+/// The reference count is updated atomically, so copies of a value may
+/// be used by different threads. A single Value object must not be
+/// modified by two threads at the same time.
+///
+/// A default constructed value is void (no value at all), NULL is a
+/// value of its own.
+///
+/// @since 0.0.1
+/// @brief Value
+class Value
+{
+public:
+    typedef enum
+    {
+        type_void = 0,
+        type_null,
+        type_int,
+        type_decimal,
+        type_float,
+        type_date,
+        type_string,
+        type_lob
+    } value_type;
+
+    /// @brief Max. number of characters stored inline
+    static const size_t short_string_max = 24 / sizeof(wchar_t);
+
+    /// @brief Max. decimal scale
+    static const unsigned int max_scale = 18;
+
+    Value(void) : m_type(type_void), m_len(0)
+    {}
+
+    Value(int v) : m_type(type_int), m_len(0)
+    { this->m_data.i = v; }
+
+    Value(long long v) : m_type(type_int), m_len(0)
+    { this->m_data.i = v; }
+
+    Value(double v) : m_type(type_float), m_len(0)
+    { this->m_data.f = v; }
+
+    Value(const String &str);
+
+    Value(const wchar_t *str);
+
+    /// @brief String of @a len characters, need not be null-terminated
+    Value(const wchar_t *str, size_t len);
+
+    Value(const Value &v);
+
+    ~Value(void)
+    {
+        if(this->isHeap())
+            this->release();
+    }
+
+    Value& operator=(const Value &v);
+
+    /// @brief NULL value
+    static Value null(void);
+
+    /// @brief Decimal value, unscaled / 10^scale
+    static Value decimal(long long unscaled, unsigned int scale);
+
+    /// @brief Date value
+    static Value date(const DateTime &dt);
+
+    /// @brief Binary large object, the data is copied
+    static Value lob(const void *data, size_t size);
+
+    inline value_type type(void) const    { return static_cast<value_type>(this->m_type); }
+    inline bool isVoid(void) const        { return this->m_type == type_void; }
+    inline bool isNull(void) const        { return this->m_type == type_null; }
+
+    /// @brief True if the value uses a heap block (long strings, LOBs)
+    inline bool isHeap(void) const
+    {
+        return this->m_type == type_lob || (this->m_type == type_string && this->m_len == heap_len);
+    }
+
+    /// @brief Integer value (decimals are truncated)
+    long long asInt(void) const;
+
+    /// @brief Floating point value of a number
+    double asDouble(void) const;
+
+    /// @brief Unscaled decimal digits and scale of a number
+    long long asDecimal(unsigned int &scale) const;
+
+    const DateTime& asDate(void) const;
+
+    /// @brief Characters of a string, not null-terminated
+    const wchar_t* strData(void) const;
+
+    /// @brief Number of characters of a string
+    size_t strLength(void) const;
+
+    const char* lobData(void) const;
+    size_t lobSize(void) const;
+
+    /// @brief String representation (used by LOG and for conversions)
+    String asString(void) const;
+
+    /// @brief Values of different types are never equal
+    bool operator==(const Value &v) const;
+
+    bool operator!=(const Value &v) const
+    { return ! this->operator==(v); }
+
+protected:
+    /// m_len of a string kept in a heap block
+    static const unsigned char heap_len = 0xFF;
+
+    struct HeapBlock
+    {
+        volatile unsigned long   refs;     ///< see atomic_increment()
+        size_t                   size;     ///< characters for strings, bytes for LOBs
+    };
+
+    struct Decimal
+    {
+        long long      unscaled;
+        unsigned int   scale;
+    };
+
+    void assignString(const wchar_t *str, size_t len);
+
+    void release(void);
+
+    inline void* heapData(void) const
+    {
+        return this->m_data.heap + 1;
+    }
+
+    unsigned char   m_type;
+    unsigned char   m_len;     ///< inline string length or heap_len
+
+    union
+    {
+        long long      i;
+        double         f;
+        Decimal        dec;
+        DateTime       date;
+        wchar_t        str[short_string_max];
+        HeapBlock     *heap;
+    } m_data;
+};
+
+
+/// @brief Argument list of task and function calls
+typedef InlineVector<Value, 4> ArgumentList;
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,239 @@
+//
+// vm.hh - Bytecode and interpreter for task bodies
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Bytecode and interpreter for task bodies
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+
+#ifndef INFORMAVE_ARGON_VM_HH
+#define INFORMAVE_ARGON_VM_HH
+
+#include "argon/fwd.hh"
+#include "argon/ast.hh"
+#include "argon/value.hh"
+
+#include <vector>
+
+ARGON_NAMESPACE_BEGIN
+
+
+class RowBatch;
+
+
+/// @brief VM opcodes
+///
+/// Keep the label table in Interpreter::exec() in sync.
+typedef enum
+{
+    op_ret = 0,      ///< return from task
+    op_log_begin,    ///< start a new log line
+    op_log_lit,      ///< append string constant <arg>
+    op_log_sym,      ///< append the string of the symbol in slot <arg>
+    op_log_param,    ///< append the string of parameter <arg>
+    op_log_reject,   ///< append the SQLSTATE (0) or error (1) of the rejected row
+    op_log_end,      ///< write the log line
+    op_arg_const,    ///< pass constant <arg> to the next call
+    op_arg_param,    ///< pass parameter <arg> to the next call
+    op_arg_column,   ///< pass source column <arg> of the current row to the next call
+    op_arg_result,   ///< pass destination column <arg> of the rejected row to the next call
+    op_arg_reject,   ///< pass the SQLSTATE (0) or error (1) of the rejected row to the next call
+    op_call,         ///< call the task in slot <arg> with the passed values
+    op_count
+} opcode;
+
+
+//--------------------------------------------------------------------------
+/// Bytecode instruction
+///
+/// @since 0.0.1
+/// @brief Bytecode instruction
+struct Instr
+{
+    opcode         op;
+    unsigned int   arg;
+};
+
+
+//--------------------------------------------------------------------------
+/// Compile scope
+///
+/// The names a statement can read besides the symbols: the parameters
+/// of its task and, in the sections of a transfer which run for the
+/// fetched rows, the source columns. An except section reads the
+/// destination columns of the rejected row and its sqlstate and
+/// sqlerror.
+///
+/// @since 0.0.1
+/// @brief Compile scope
+struct CodeScope
+{
+    CodeScope(const TaskNode *t, const std::vector<String> *c = 0,
+              const std::vector<String> *r = 0)
+        : task(t),
+          columns(c),
+          results(r)
+    {}
+
+    const TaskNode               *task;
+    const std::vector<String>    *columns;   ///< 0 if there is no current row
+    const std::vector<String>    *results;   ///< 0 outside an except section
+};
+
+
+//--------------------------------------------------------------------------
+/// Compiled task body
+///
+/// A flat instruction array plus the string and value constants the
+/// instructions refer to. Symbol references are bound to processor slots by
+/// compile(), so unknown or mistyped symbols are reported before the
+/// script runs. Code is read-only afterwards.
+///
+/// @since 0.0.1
+/// @brief Compiled task body
+class Code
+{
+public:
+    Code(void);
+
+    /// @brief Lower the body of the given task
+    ///
+    /// Throws CompileError if a symbol can not be resolved.
+    void compile(Processor &proc, TaskNode *node);
+
+    /// @brief Lower a single statement
+    ///
+    /// Used by templates which split the body into sections, the code
+    /// must be terminated by finish().
+    void compileStatement(Processor &proc, Node *node, const CodeScope &scope);
+
+    /// @brief Terminate the code with op_ret
+    void finish(void);
+
+    /// @brief First instruction
+    inline const Instr* instructions(void) const
+    {
+        return &this->m_code[0];
+    }
+
+    /// @brief Number of instructions
+    inline size_t size(void) const
+    {
+        return this->m_code.size();
+    }
+
+    inline const String& string(unsigned int i) const
+    {
+        return this->m_strings[i];
+    }
+
+    inline const Value& value(unsigned int i) const
+    {
+        return this->m_values[i];
+    }
+
+    /// @brief True if the code passes columns of the current row
+    inline bool readsRow(void) const
+    {
+        return this->m_readsRow;
+    }
+
+    /// @brief Dump instructions (used for debugging)
+    String str(void) const;
+
+protected:
+    void emit(opcode op, unsigned int arg = 0);
+
+    void compileLog(Processor &proc, LogNode *node, const CodeScope &scope);
+
+    void compileArg(Node *node, const CodeScope &scope);
+
+    unsigned int addString(const String &str);
+
+    unsigned int addValue(const Value &value);
+
+    std::vector<Instr>        m_code;
+    std::vector<String>       m_strings;
+    std::vector<Value>        m_values;
+    bool                      m_readsRow;
+};
+
+
+//--------------------------------------------------------------------------
+/// Bytecode interpreter
+///
+/// Uses threaded dispatch (computed goto) if the compiler supports it,
+/// a switch loop otherwise.
+///
+/// @since 0.0.1
+/// @brief Bytecode interpreter
+class Interpreter
+{
+public:
+    /// @param params Arguments of the running task, 0 if there are none
+    Interpreter(Processor &proc, const ArgumentList *params = 0);
+
+    /// @brief Read the source columns from row @a row of @a batch
+    ///
+    /// @a columns maps the columns of the compile scope to the
+    /// columns of the batch.
+    void setRow(const RowBatch &batch, const std::vector<size_t> &columns, size_t row);
+
+    /// @brief Read the destination columns from row @a row of @a batch,
+    /// which the destination rejected with @a sqlstate and @a error
+    void setReject(const RowBatch &batch, size_t row, const String &sqlstate,
+                   const String &error);
+
+    /// @brief Run the code until op_ret
+    void exec(const Code &code);
+
+protected:
+    Value param(unsigned int i) const;
+
+    Processor                   &m_proc;
+    String                       m_log;
+    const ArgumentList          *m_params;
+    ArgumentList                 m_args;      ///< values passed to the next call
+    const RowBatch              *m_batch;
+    const std::vector<size_t>   *m_columns;
+    size_t                       m_row;
+    Value                        m_reject[2];  ///< SQLSTATE and error of the rejected row
+
+private:
+    Interpreter(const Interpreter&);
+    Interpreter& operator=(const Interpreter&);
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,101 @@
+//
+// arena.cc - Bump-pointer arena (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Bump-pointer arena (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/arena.hh"
+
+ARGON_NAMESPACE_BEGIN
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////////// Arena
+
+/// @details
+/// 
+Arena::Arena(size_t chunksize)
+    : m_chunksize(chunksize),
+      m_chunks(0),
+      m_ptr(0),
+      m_end(0),
+      m_dtors(0),
+      m_chunkcount(0),
+      m_objcount(0),
+      m_reserved(0)
+{}
+
+
+/// @details
+/// Objects are destroyed in reverse order of their creation, then
+/// the chunks are released.
+Arena::~Arena(void)
+{
+    for(Destructor *d = this->m_dtors; d; d = d->next)
+        d->fn(d->obj);
+
+    while(this->m_chunks)
+    {
+        Chunk *next = this->m_chunks->next;
+        ::operator delete(this->m_chunks);
+        this->m_chunks = next;
+    }
+}
+
+
+/// @details
+/// Requests larger than the chunk size get their own chunk. The space
+/// left in the current chunk is kept for later requests in this case.
+void*
+Arena::allocateChunk(size_t size)
+{
+    const size_t header = align(sizeof(Chunk));
+    const bool oversized = size > this->m_chunksize;
+    const size_t bytes = header + (oversized ? size : this->m_chunksize);
+
+    Chunk *chunk = static_cast<Chunk*>(::operator new(bytes));
+    chunk->next = this->m_chunks;
+    this->m_chunks = chunk;
+    ++this->m_chunkcount;
+    this->m_reserved += bytes;
+
+    char *p = reinterpret_cast<char*>(chunk) + header;
+    if(! oversized)
+    {
+        this->m_ptr = p + size;
+        this->m_end = p + this->m_chunksize;
+    }
+    return p;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -30,10 +30,13 @@
 #include "argon/dtsengine.hh"
 #include "argon/token.hh"
 #include "argon/exceptions.hh"
+#include "parserapi.hh"
+#include "keywords.hh"
 
 
 #include <cstdlib>
 #include <cstdio>
+#include <cassert>
 #include <memory>
 #include <iostream>
 #include <algorithm>
@@ -56,6 +59,13 @@ void LiteralNode::accept(Visitor &visitor)  { visitor.visit(this); }
 void IdNode::accept(Visitor &visitor)       { visitor.visit(this); }
 void TaskExecNode::accept(Visitor &visitor) { visitor.visit(this); }
 void ColumnNode::accept(Visitor &visitor)   { visitor.visit(this); }
+void ObjectNode::accept(Visitor &visitor)   { visitor.visit(this); }
+void SectionNode::accept(Visitor &visitor)  { visitor.visit(this); }
+void ColAssignNode::accept(Visitor &visitor) { visitor.visit(this); }
+void NullNode::accept(Visitor &visitor)     { visitor.visit(this); }
+void NumberNode::accept(Visitor &visitor)   { visitor.visit(this); }
+void ParallelNode::accept(Visitor &visitor) { visitor.visit(this); }
+void StdValueNode::accept(Visitor &visitor) { visitor.visit(this); }
 void TokenNode::accept(Visitor &visitor)    { /* visitor.visit(this); */ }
 
 
@@ -70,6 +80,11 @@ String IdNode::str(void) const       { return String("IdNode: ") + this->data().
 String TaskExecNode::str(void) const       { return "taskexecnode"; }
 String ColumnNode::str(void) const       { return "columnnode"; }
 String TokenNode::str(void) const       { return "tokennode"; }
+String ColAssignNode::str(void) const    { return "colassignnode"; }
+String NullNode::str(void) const         { return "NULL"; }
+String NumberNode::str(void) const       { return this->m_data; }
+String ParallelNode::str(void) const     { return "parallelnode"; }
+String StdValueNode::str(void) const     { return "stdvaluenode"; }
 
 
 
@@ -79,9 +94,12 @@ String TokenNode::str(void) const       { return "tokennode"; }
 
 /// @details
 /// 
-Node::Node(void)
-    : m_childs(),
-      m_sinfo()
+Node::Node(node_kind kind)
+    : m_firstChild(0),
+      m_lastChild(0),
+      m_nextSibling(0),
+      m_sinfo(),
+      m_kind(kind)
 {}
 
 
@@ -106,23 +124,28 @@ void
 Node::addChilds(const NodeList *list)
 {
     assert(list && "Nodelist is null");
-    std::copy(list->begin(), list->end(), std::back_insert_iterator<NodeList>(this->m_childs));
 
     for(NodeList::const_iterator i = list->begin();
         i != list->end();
         ++i)
     {
-        this->updateSourceInfo((*i)->getSourceInfo());
+        this->addChild(*i);
     }
 }
 
 
 /// @details
-/// 
+/// A node can only be linked to one parent.
 void 
 Node::addChild(Node *child)
 {
-    this->m_childs.push_back(child);
+    assert(child && ! child->m_nextSibling && child != this->m_lastChild);
+
+    if(this->m_lastChild)
+        this->m_lastChild->m_nextSibling = child;
+    else
+        this->m_firstChild = child;
+    this->m_lastChild = child;
     this->updateSourceInfo(child->getSourceInfo());
 }
 
@@ -136,6 +159,16 @@ Node::updateSourceInfo(const SourceInfo &info)
 }
 
 
+/// @details
+/// Unlike updateSourceInfo() the information is not merged, the
+/// bundle reader restores the exact ranges the parser built.
+void
+Node::setSourceInfo(const SourceInfo &info)
+{
+    m_sinfo = info;
+}
+
+
 
 //..............................................................................
 //////////////////////////////////////////////////////////////////////// Visitor
@@ -170,6 +203,13 @@ DEFAULT_VISIT(IdNode)
 DEFAULT_VISIT(LiteralNode)
 DEFAULT_VISIT(TaskExecNode)
 DEFAULT_VISIT(ColumnNode)
+DEFAULT_VISIT(ObjectNode)
+DEFAULT_VISIT(SectionNode)
+DEFAULT_VISIT(ColAssignNode)
+DEFAULT_VISIT(NullNode)
+DEFAULT_VISIT(NumberNode)
+DEFAULT_VISIT(ParallelNode)
+DEFAULT_VISIT(StdValueNode)
 
 
 /// @details
@@ -188,7 +228,8 @@ Visitor::operator()(Node *node)
 /// @details
 /// 
 TokenNode::TokenNode(Token *tok)
-    : m_token(tok)
+    : Node(kind_token),
+      m_token(tok)
 {
     m_sinfo = tok->getSourceInfo();
 }
@@ -201,16 +242,19 @@ TokenNode::TokenNode(Token *tok)
 /// @details
 /// 
 ColumnNode::ColumnNode(void)
-    : m_data()
+    : Node(kind_column),
+      m_data(),
+      m_result(false)
 {}
 
 
 /// @details
 /// 
 void
-ColumnNode::init(String name)
+ColumnNode::init(String name, bool result)
 {
     this->m_data = name;
+    this->m_result = result;
 }
 
 
@@ -224,13 +268,179 @@ ColumnNode::colname(void) const
 
 
 
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// NullNode
+
+/// @details
+/// 
+NullNode::NullNode(void)
+    : Node(kind_null)
+{}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////// NumberNode
+
+/// @details
+/// 
+NumberNode::NumberNode(void)
+    : Node(kind_number),
+      m_data()
+{}
+
+
+/// @details
+/// 
+void
+NumberNode::init(String data)
+{
+    this->m_data = data;
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// ParallelNode
+
+/// @details
+/// 
+ParallelNode::ParallelNode(void)
+    : Node(kind_parallel)
+{}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// StdValueNode
+
+/// @details
+/// 
+StdValueNode::StdValueNode(void)
+    : Node(kind_stdvalue)
+{}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////// ObjectNode
+
+/// @details
+/// 
+ObjectNode::ObjectNode(void)
+    : Node(kind_object),
+      m_type(obj_table)
+{}
+
+
+/// @details
+/// 
+void
+ObjectNode::init(object_type type)
+{
+    this->m_type = type;
+}
+
+
+/// @details
+/// 
+String
+ObjectNode::str(void) const
+{
+    switch(this->m_type)
+    {
+    case obj_table:      return "table";
+    case obj_view:       return "view";
+    case obj_procedure:  return "procedure";
+    case obj_sql:        return "sql";
+    }
+    return "";
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// SectionNode
+
+/// @details
+/// 
+SectionNode::SectionNode(void)
+    : Node(kind_section),
+      m_section(sec_rules),
+      m_state()
+{}
+
+
+/// @details
+/// Section names are context keywords, the tokenizer passes them as
+/// written. The keyword table gives the name in upper case.
+void
+SectionNode::init(const String &keyword)
+{
+    const Keyword *kw = find_keyword(keyword.data(), keyword.length());
+    String name = kw ? String(kw->name) : String();
+
+    if(name == String("INITIALIZATION"))
+        this->m_section = sec_initialization;
+    else if(name == String("BEFORE"))
+        this->m_section = sec_before;
+    else if(name == String("AFTER"))
+        this->m_section = sec_after;
+    else if(name == String("FINALIZATION"))
+        this->m_section = sec_finalization;
+    else if(name == String("EXCEPT"))
+        this->m_section = sec_except;
+    else
+        this->m_section = sec_rules;
+}
+
+
+/// @details
+/// 
+void
+SectionNode::init(section_type section)
+{
+    this->m_section = section;
+}
+
+
+/// @details
+/// 
+String
+SectionNode::str(void) const
+{
+    switch(this->m_section)
+    {
+    case sec_initialization:  return "initialization";
+    case sec_before:          return "before";
+    case sec_rules:           return "rules";
+    case sec_after:           return "after";
+    case sec_finalization:    return "finalization";
+    case sec_except:          return "except";
+    }
+    return "";
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////// ColAssignNode
+
+/// @details
+/// 
+ColAssignNode::ColAssignNode(void)
+    : Node(kind_colassign)
+{}
+
+
+
 //..............................................................................
 /////////////////////////////////////////////////////////////////// TaskExecNode
 
 /// @details
 /// 
 TaskExecNode::TaskExecNode(void)
-    : Node(),
+    : Node(kind_taskexec),
       m_taskid()
 {}
 
@@ -259,7 +469,7 @@ TaskExecNode::taskid(void) const
 /// @details
 /// 
 LiteralNode::LiteralNode(void)
-    : Node(),
+    : Node(kind_literal),
       m_data()
 {}
 
@@ -278,7 +488,7 @@ LiteralNode::init(String data)
 /// @details
 /// 
 IdNode::IdNode(void)
-    : Node(),
+    : Node(kind_id),
       m_data()
 {}
 
@@ -306,7 +516,10 @@ IdNode::data(void) const
 /// @details
 /// 
 TaskNode::TaskNode(void)
-    : id()
+    : Node(kind_task),
+      id(),
+      tmpl(tmpl_void),
+      params()
 {}
 
 
@@ -319,6 +532,36 @@ TaskNode::init(Identifier _id)
 }
 
 
+/// @details
+/// The tokenizer passes the keyword in upper case.
+void
+TaskNode::setTemplate(const String &keyword)
+{
+    if(keyword == String("FETCH"))
+        this->tmpl = tmpl_fetch;
+    else if(keyword == String("STORE"))
+        this->tmpl = tmpl_store;
+    else if(keyword == String("TRANSFER"))
+        this->tmpl = tmpl_transfer;
+    else
+        this->tmpl = tmpl_void;
+}
+
+
+/// @details
+/// 
+int
+TaskNode::paramIndex(Identifier name) const
+{
+    for(size_t i = 0; i < this->params.size(); ++i)
+    {
+        if(this->params[i] == name)
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+
 
 //..............................................................................
 /////////////////////////////////////////////////////////////////////// ConnNode
@@ -326,7 +569,8 @@ TaskNode::init(Identifier _id)
 /// @details
 /// 
 ConnNode::ConnNode(void)
-    : id(),
+    : Node(kind_conn),
+      id(),
       spec()
 {}
 
@@ -347,8 +591,11 @@ ConnNode::init(Identifier _id, ConnSpec *_spec)
 /// @details
 /// 
 ConnSpec::ConnSpec(void)
-    : type(),
-      dbcstr()
+    : Node(kind_connspec),
+      type(),
+      dbcstr(),
+      poolMin(),
+      poolMax()
 {}
 
 
@@ -362,12 +609,23 @@ ConnSpec::init(String _type, String _dbcstr)
 }
 
 
+/// @details
+/// 
+void
+ConnSpec::setPool(String _poolMin, String _poolMax)
+{
+    this->poolMin = _poolMin;
+    this->poolMax = _poolMax;
+}
+
+
 //..............................................................................
 //////////////////////////////////////////////////////////////////////// LogNode
 
 /// @details
 /// 
 LogNode::LogNode(void)
+    : Node(kind_log)
 {}
 
 
@@ -381,31 +639,16 @@ LogNode::LogNode(void)
 Token*
 ParseTree::newToken(const Token& t)
 {
-    Token* tok = new Token(t);
-    this->m_tokens.push_back(tok);
+    Token* tok = this->m_arena.create<Token>(t);
+    this->m_lastToken = tok;
     return tok;
 }
 
 
-
-struct delete_ptr
-{
-    template<class T>
-    inline void operator()(T& ref)
-    {
-        delete ref;
-    }
-};
-
-
 /// @details
-/// 
+/// The arena destroys all nodes, nodelists and tokens.
 ParseTree::~ParseTree(void)
-{
-    std::for_each(m_nodes.begin(), m_nodes.end(), delete_ptr());
-    std::for_each(m_tokens.begin(), m_tokens.end(), delete_ptr());
-    std::for_each(m_nodelists.begin(), m_nodelists.end(), delete_ptr());
-}
+{}
 
 
 /// @details
@@ -413,8 +656,8 @@ ParseTree::~ParseTree(void)
 void
 ParseTree::raiseSyntaxError(void)
 {
-    Token *t = *this->m_tokens.rbegin();
-    throw SyntaxError(t);
+    assert(this->m_lastToken);
+    throw SyntaxError(this->m_lastToken);
 }
 
 
@@ -446,7 +689,7 @@ PrintTreeVisitor::PrintTreeVisitor(const PrintTreeVisitor& pt)
 void 
 PrintTreeVisitor::next(Node *node)
 {
-    foreach_node(node->getChilds(), PrintTreeVisitor(*this), 1);
+    foreach_child(node, PrintTreeVisitor(*this), 1);
 }
 
        
@@ -463,7 +706,10 @@ PrintTreeVisitor::visit(ConnNode *node)
 void
 PrintTreeVisitor::visit(TaskNode *node)
 {
-    m_stream << this->m_indent << "TaskNode: " << node->str() << std::endl;
+    m_stream << this->m_indent << "TaskNode: " << node->str() << "(";
+    for(size_t i = 0; i < node->params.size(); ++i)
+        m_stream << (i ? ", " : "") << node->params[i].str();
+    m_stream << ")" << std::endl;
     next(node);
 }
 
@@ -511,6 +757,58 @@ PrintTreeVisitor::visit(LiteralNode *node)
     next(node);
 }
 
+void
+PrintTreeVisitor::visit(ObjectNode *node)
+{
+    m_stream << this->m_indent << "ObjectNode: " << node->str() << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(SectionNode *node)
+{
+    m_stream << this->m_indent << "SectionNode: " << node->str();
+    if(! node->m_state.empty())
+        m_stream << " " << node->m_state;
+    m_stream << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(ColAssignNode *node)
+{
+    m_stream << this->m_indent << "ColAssignNode" << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(NullNode *node)
+{
+    m_stream << this->m_indent << "NullNode" << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(NumberNode *node)
+{
+    m_stream << this->m_indent << "NumberNode: " << node->str() << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(ParallelNode *node)
+{
+    m_stream << this->m_indent << "ParallelNode" << std::endl;
+    next(node);
+}
+
+void
+PrintTreeVisitor::visit(StdValueNode *node)
+{
+    m_stream << this->m_indent << "StdValueNode" << std::endl;
+    next(node);
+}
+
 
 
 /// @details
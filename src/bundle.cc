@@ -0,0 +1,551 @@
+//
+// bundle.cc - Precompiled script bundles (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Precompiled script bundles (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "bundle.hh"
+#include "utf8.hh"
+
+#include "argon/token.hh"
+
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// FNV-1a hash
+static bundle_word
+bundle_checksum(const char *data, size_t len)
+{
+    bundle_word h = 2166136261U;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619U;
+    }
+    return h;
+}
+
+
+/// Round up to the word size
+static inline size_t
+bundle_align(size_t n)
+{
+    return (n + sizeof(bundle_word) - 1) / sizeof(bundle_word) * sizeof(bundle_word);
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// SourceStamp
+
+/// @details
+/// 
+bool
+SourceStamp::read(const std::string &path)
+{
+    struct stat st;
+    if(::stat(path.c_str(), &st) != 0)
+        return false;
+
+    const double size = static_cast<double>(st.st_size);
+    const double mtime = static_cast<double>(st.st_mtime);
+
+    this->sizeLo = static_cast<bundle_word>(st.st_size);
+    this->sizeHi = static_cast<bundle_word>(size / 4294967296.0);
+    this->timeLo = static_cast<bundle_word>(st.st_mtime);
+    this->timeHi = static_cast<bundle_word>(mtime / 4294967296.0);
+    return true;
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// BundleWriter
+
+/// @details
+/// 
+BundleWriter::BundleWriter(void)
+    : m_nodes(),
+      m_strings(),
+      m_blob(),
+      m_stringIds()
+{
+    // string 0 is the empty string
+    this->m_strings.push_back(0);
+    this->m_strings.push_back(0);
+}
+
+
+/// @details
+/// Equal strings share one table entry.
+bundle_word
+BundleWriter::addString(const String &str)
+{
+    if(str.empty())
+        return 0;
+
+    std::string bytes(utf8_encode(str));
+
+    std::map<std::string, bundle_word>::iterator i = this->m_stringIds.find(bytes);
+    if(i != this->m_stringIds.end())
+        return i->second;
+
+    bundle_word id = static_cast<bundle_word>(this->m_strings.size() / 2);
+    this->m_strings.push_back(static_cast<bundle_word>(this->m_blob.size()));
+    this->m_strings.push_back(static_cast<bundle_word>(bytes.size()));
+    this->m_blob.append(bytes);
+    this->m_stringIds[bytes] = id;
+    return id;
+}
+
+
+/// @details
+/// Nodes are written in pre-order, so children always have a higher
+/// index than their parent.
+bundle_word
+BundleWriter::addNode(Node *node)
+{
+    bundle_word index = static_cast<bundle_word>(this->m_nodes.size());
+
+    BundleNode rec;
+    std::memset(&rec, 0, sizeof(rec));
+
+    SourceInfo si = node->getSourceInfo();
+    rec.kind = node->kind();
+    rec.file = this->addString(si.sourceName());
+    rec.offset = static_cast<bundle_word>(si.offset());
+    rec.length = static_cast<bundle_word>(si.length());
+    rec.line = static_cast<bundle_word>(si.linenum());
+
+    switch(node->kind())
+    {
+    case Node::kind_tree:
+    case Node::kind_log:
+    case Node::kind_colassign:
+    case Node::kind_null:
+    case Node::kind_parallel:
+    case Node::kind_stdvalue:
+        break;
+    case Node::kind_conn:
+    {
+        ConnNode *n = static_cast<ConnNode*>(node);
+        rec.str[0] = this->addString(n->id.name());
+        if(n->spec)
+        {
+            rec.str[1] = this->addString(n->spec->type);
+            rec.str[2] = this->addString(n->spec->dbcstr);
+            rec.str[3] = this->addString(n->spec->poolMin);
+            rec.str[4] = this->addString(n->spec->poolMax);
+        }
+        break;
+    }
+    case Node::kind_task:
+    {
+        // parameter names can't contain a comma
+        TaskNode *n = static_cast<TaskNode*>(node);
+        String params;
+        for(size_t i = 0; i < n->params.size(); ++i)
+        {
+            if(i)
+                params.append(",");
+            params.append(n->params[i].name());
+        }
+        rec.str[0] = this->addString(n->id.name());
+        rec.str[1] = this->addString(params);
+        rec.aux = static_cast<bundle_word>(n->tmpl);
+        break;
+    }
+    case Node::kind_object:
+        rec.aux = static_cast<bundle_word>(static_cast<ObjectNode*>(node)->m_type);
+        break;
+    case Node::kind_section:
+        rec.str[0] = this->addString(static_cast<SectionNode*>(node)->m_state);
+        rec.aux = static_cast<bundle_word>(static_cast<SectionNode*>(node)->m_section);
+        break;
+    case Node::kind_number:
+        rec.str[0] = this->addString(static_cast<NumberNode*>(node)->m_data);
+        break;
+    case Node::kind_literal:
+        rec.str[0] = this->addString(static_cast<LiteralNode*>(node)->m_data);
+        break;
+    case Node::kind_id:
+        rec.str[0] = this->addString(static_cast<IdNode*>(node)->data().name());
+        break;
+    case Node::kind_taskexec:
+        rec.str[0] = this->addString(static_cast<TaskExecNode*>(node)->taskid().name());
+        break;
+    case Node::kind_column:
+        rec.str[0] = this->addString(static_cast<ColumnNode*>(node)->colname());
+        rec.aux = static_cast<ColumnNode*>(node)->m_result ? 1 : 0;
+        break;
+    case Node::kind_token:
+    {
+        Token *tok = static_cast<TokenNode*>(node)->token();
+        rec.str[0] = this->addString(tok->data());
+        rec.aux = static_cast<bundle_word>(tok->id());
+        break;
+    }
+    default:
+        throw std::runtime_error("can not write node to bundle");
+    }
+
+    this->m_nodes.push_back(rec);
+
+    bundle_word prev = 0;
+    for(Node *c = node->firstChild(); c; c = c->nextSibling())
+    {
+        bundle_word child = this->addNode(c);
+        if(prev == 0)
+            this->m_nodes[index].firstChild = child;
+        else
+            this->m_nodes[prev].nextSibling = child;
+        prev = child;
+    }
+    return index;
+}
+
+
+/// @details
+/// The bundle is written to a temporary file first and renamed, so a
+/// concurrent reader never sees a partially written bundle.
+void
+BundleWriter::write(ParseTree *tree, const SourceStamp &stamp, const std::string &path)
+{
+    this->addNode(tree);
+
+    BundleHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, ARGON_BUNDLE_MAGIC, 4);
+    hdr.bom = ARGON_BUNDLE_BOM;
+    hdr.version = ARGON_BUNDLE_VERSION;
+    hdr.headerSize = sizeof(BundleHeader);
+    hdr.srcSizeLo = stamp.sizeLo;
+    hdr.srcSizeHi = stamp.sizeHi;
+    hdr.srcTimeLo = stamp.timeLo;
+    hdr.srcTimeHi = stamp.timeHi;
+    hdr.stringCount = static_cast<bundle_word>(this->m_strings.size() / 2);
+    hdr.stringOffset = sizeof(BundleHeader);
+    hdr.blobOffset = hdr.stringOffset + static_cast<bundle_word>(this->m_strings.size() * sizeof(bundle_word));
+    hdr.blobSize = static_cast<bundle_word>(this->m_blob.size());
+    hdr.nodeCount = static_cast<bundle_word>(this->m_nodes.size());
+    hdr.nodeOffset = static_cast<bundle_word>(bundle_align(hdr.blobOffset + hdr.blobSize));
+
+    std::string body;
+    body.append(reinterpret_cast<const char*>(&this->m_strings[0]),
+                this->m_strings.size() * sizeof(bundle_word));
+    body.append(this->m_blob);
+    body.append(hdr.nodeOffset - hdr.blobOffset - hdr.blobSize, '\0');
+    body.append(reinterpret_cast<const char*>(&this->m_nodes[0]),
+                this->m_nodes.size() * sizeof(BundleNode));
+
+    hdr.checksum = bundle_checksum(body.data(), body.size());
+
+    std::string tmp(path + ".tmp");
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        out.write(body.data(), body.size());
+        out.close();
+        if(! out)
+            throw std::runtime_error("can not write bundle: " + path);
+    }
+    std::remove(path.c_str());
+    if(std::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("can not write bundle: " + path);
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// BundleReader
+
+/// @details
+/// Checks everything that is required to read the tables without
+/// running out of the mapped region.
+BundleReader::BundleReader(const char *data, size_t size)
+    : m_data(data),
+      m_size(size),
+      m_header(0),
+      m_strings(0),
+      m_blob(0),
+      m_nodes(0),
+      m_cache(),
+      m_cached()
+{
+    if(size < sizeof(BundleHeader))
+        throw BundleError("bundle too small");
+
+    const BundleHeader *hdr = reinterpret_cast<const BundleHeader*>(data);
+
+    if(std::memcmp(hdr->magic, ARGON_BUNDLE_MAGIC, 4) != 0)
+        throw BundleError("not a bundle");
+    if(hdr->bom != ARGON_BUNDLE_BOM)
+        throw BundleError("bundle byte order mismatch");
+    if(hdr->version != ARGON_BUNDLE_VERSION)
+        throw BundleError("bundle version mismatch");
+    if(hdr->headerSize != sizeof(BundleHeader))
+        throw BundleError("bundle header mismatch");
+
+    if(hdr->stringCount == 0 || hdr->nodeCount == 0
+       || hdr->stringOffset % sizeof(bundle_word) != 0
+       || hdr->nodeOffset % sizeof(bundle_word) != 0
+       || hdr->stringOffset < sizeof(BundleHeader)
+       || (size - hdr->stringOffset) / (2 * sizeof(bundle_word)) < hdr->stringCount
+       || hdr->blobOffset > size || size - hdr->blobOffset < hdr->blobSize
+       || hdr->nodeOffset > size
+       || (size - hdr->nodeOffset) / sizeof(BundleNode) < hdr->nodeCount)
+        throw BundleError("bundle is truncated");
+
+    if(bundle_checksum(data + sizeof(BundleHeader), size - sizeof(BundleHeader)) != hdr->checksum)
+        throw BundleError("bundle checksum mismatch");
+
+    this->m_header = hdr;
+    this->m_strings = reinterpret_cast<const bundle_word*>(data + hdr->stringOffset);
+    this->m_blob = data + hdr->blobOffset;
+    this->m_nodes = reinterpret_cast<const BundleNode*>(data + hdr->nodeOffset);
+
+    for(bundle_word i = 0; i < hdr->stringCount; ++i)
+    {
+        bundle_word off = this->m_strings[2*i];
+        bundle_word len = this->m_strings[2*i+1];
+        if(off > hdr->blobSize || hdr->blobSize - off < len)
+            throw BundleError("bundle string table corrupt");
+    }
+
+    this->m_cache.resize(hdr->stringCount);
+    this->m_cached.resize(hdr->stringCount, false);
+}
+
+
+/// @details
+/// 
+bool
+BundleReader::isCurrent(const SourceStamp &stamp) const
+{
+    return this->m_header->srcSizeLo == stamp.sizeLo
+        && this->m_header->srcSizeHi == stamp.sizeHi
+        && this->m_header->srcTimeLo == stamp.timeLo
+        && this->m_header->srcTimeHi == stamp.timeHi;
+}
+
+
+/// @details
+/// 
+const String&
+BundleReader::string(bundle_word id)
+{
+    if(id >= this->m_header->stringCount)
+        throw BundleError("bundle string id out of range");
+
+    if(! this->m_cached[id])
+    {
+        const char *p = this->m_blob + this->m_strings[2*id];
+        this->m_cache[id] = utf8_decode(p, p + this->m_strings[2*id+1]);
+        this->m_cached[id] = true;
+    }
+    return this->m_cache[id];
+}
+
+
+/// @details
+/// All nodes are created first, then linked. Links must point forward
+/// (pre-order) and every node must have exactly one parent, so a
+/// corrupt node table can not create cycles. Linking expands the
+/// source information of the parents, so the recorded information is
+/// set afterwards.
+void
+BundleReader::read(ParseTree *tree)
+{
+    const bundle_word count = this->m_header->nodeCount;
+    std::vector<Node*> nodes(count, static_cast<Node*>(0));
+    std::vector<SourceInfo> infos(count);
+
+    if(this->m_nodes[0].kind != Node::kind_tree)
+        throw BundleError("bundle root is not a parse tree");
+
+    for(bundle_word i = 0; i < count; ++i)
+    {
+        const BundleNode &rec = this->m_nodes[i];
+        SourceInfo si(tree->sourceFile(this->string(rec.file)),
+                      rec.offset, rec.length, rec.line);
+        Node *node = 0;
+
+        switch(rec.kind)
+        {
+        case Node::kind_tree:
+            if(i != 0)
+                throw BundleError("bundle contains nested parse tree");
+            node = tree;
+            break;
+        case Node::kind_log:
+            node = tree->newNode<LogNode>();
+            break;
+        case Node::kind_conn:
+        {
+            ConnSpec *spec = tree->newNode<ConnSpec>();
+            spec->init(this->string(rec.str[1]), this->string(rec.str[2]));
+            spec->setPool(this->string(rec.str[3]), this->string(rec.str[4]));
+            ConnNode *n = tree->newNode<ConnNode>();
+            n->init(tree->ident(this->string(rec.str[0])), spec);
+            node = n;
+            break;
+        }
+        case Node::kind_task:
+        {
+            if(rec.aux > TaskNode::tmpl_transfer)
+                throw BundleError("bundle contains unknown task template");
+            TaskNode *n = tree->newNode<TaskNode>();
+            n->init(tree->ident(this->string(rec.str[0])));
+            n->tmpl = static_cast<TaskNode::template_type>(rec.aux);
+            std::wstring params = this->string(rec.str[1]);
+            for(size_t b = 0; b < params.size(); )
+            {
+                size_t e = params.find(L',', b);
+                if(e == std::wstring::npos)
+                    e = params.size();
+                n->params.push_back(tree->ident(String(params.substr(b, e - b))));
+                b = e + 1;
+            }
+            node = n;
+            break;
+        }
+        case Node::kind_object:
+        {
+            if(rec.aux < ObjectNode::obj_table || rec.aux > ObjectNode::obj_sql)
+                throw BundleError("bundle contains unknown object type");
+            ObjectNode *n = tree->newNode<ObjectNode>();
+            n->init(static_cast<ObjectNode::object_type>(rec.aux));
+            node = n;
+            break;
+        }
+        case Node::kind_section:
+        {
+            if(rec.aux < SectionNode::sec_initialization || rec.aux > SectionNode::sec_except)
+                throw BundleError("bundle contains unknown section");
+            SectionNode *n = tree->newNode<SectionNode>();
+            n->init(static_cast<SectionNode::section_type>(rec.aux));
+            n->m_state = this->string(rec.str[0]);
+            node = n;
+            break;
+        }
+        case Node::kind_colassign:
+            node = tree->newNode<ColAssignNode>();
+            break;
+        case Node::kind_null:
+            node = tree->newNode<NullNode>();
+            break;
+        case Node::kind_parallel:
+            node = tree->newNode<ParallelNode>();
+            break;
+        case Node::kind_stdvalue:
+            node = tree->newNode<StdValueNode>();
+            break;
+        case Node::kind_number:
+        {
+            NumberNode *n = tree->newNode<NumberNode>();
+            n->init(this->string(rec.str[0]));
+            node = n;
+            break;
+        }
+        case Node::kind_literal:
+        {
+            LiteralNode *n = tree->newNode<LiteralNode>();
+            n->init(this->string(rec.str[0]));
+            node = n;
+            break;
+        }
+        case Node::kind_id:
+        {
+            IdNode *n = tree->newNode<IdNode>();
+            n->init(tree->ident(this->string(rec.str[0])));
+            node = n;
+            break;
+        }
+        case Node::kind_taskexec:
+        {
+            TaskExecNode *n = tree->newNode<TaskExecNode>();
+            n->init(tree->ident(this->string(rec.str[0])));
+            node = n;
+            break;
+        }
+        case Node::kind_column:
+        {
+            ColumnNode *n = tree->newNode<ColumnNode>();
+            n->init(this->string(rec.str[0]), rec.aux != 0);
+            node = n;
+            break;
+        }
+        case Node::kind_token:
+        {
+            Token t(static_cast<int>(rec.aux), si);
+            t.setData(this->string(rec.str[0]));
+            node = tree->newTokenNode(tree->newToken(t));
+            break;
+        }
+        default:
+            throw BundleError("bundle contains unknown node kind");
+        }
+
+        infos[i] = si;
+        nodes[i] = node;
+    }
+
+    std::vector<bool> attached(count, false);
+
+    for(bundle_word i = 0; i < count; ++i)
+    {
+        bundle_word prev = i;
+        for(bundle_word c = this->m_nodes[i].firstChild;
+            c != 0;
+            prev = c, c = this->m_nodes[c].nextSibling)
+        {
+            if(c <= prev || c >= count || attached[c])
+                throw BundleError("bundle node table corrupt");
+            attached[c] = true;
+            nodes[i]->addChild(nodes[c]);
+        }
+    }
+
+    for(bundle_word i = 0; i < count; ++i)
+        nodes[i]->setSourceInfo(infos[i]);
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,229 @@
+//
+// bundle.hh - Precompiled script bundles (.argc)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Precompiled script bundles (.argc)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+///
+/// A bundle is a flat image of a ParseTree:
+///
+///  - header (magic, version, checksum, source fingerprint)
+///  - string table (offset/length pairs into a UTF-8 blob)
+///  - node table (fixed size records, pre-order, linked by
+///    first-child/next-sibling indices)
+///
+/// All values are 32 bit words in host byte order. The header carries
+/// a byte order mark, bundles written on a host with another byte
+/// order are rejected like stale bundles.
+
+#ifndef INFORMAVE_ARGON_BUNDLE_HH
+#define INFORMAVE_ARGON_BUNDLE_HH
+
+#include "argon/argon_config.hh"
+#include "argon/fwd.hh"
+#include "argon/ast.hh"
+
+#if defined(ARGON_HAVE_STDINT_H)
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+ARGON_NAMESPACE_BEGIN
+
+#if defined(ARGON_HAVE_STDINT_H)
+typedef uint32_t bundle_word;
+#else
+typedef unsigned __int32 bundle_word;
+#endif
+
+
+/// Bump this version if the node set or the record layout changes
+#define ARGON_BUNDLE_VERSION 8
+
+#define ARGON_BUNDLE_MAGIC "ARGC"
+
+#define ARGON_BUNDLE_BOM 0x01020304
+
+
+//--------------------------------------------------------------------------
+/// Bundle header
+///
+/// @since 0.0.1
+/// @brief Bundle header
+struct BundleHeader
+{
+    char          magic[4];
+    bundle_word   bom;
+    bundle_word   version;
+    bundle_word   headerSize;
+    bundle_word   checksum;      ///< FNV-1a over everything after the header
+    bundle_word   srcSizeLo;     ///< size of the source file
+    bundle_word   srcSizeHi;
+    bundle_word   srcTimeLo;     ///< modification time of the source file
+    bundle_word   srcTimeHi;
+    bundle_word   stringCount;
+    bundle_word   stringOffset;
+    bundle_word   blobOffset;
+    bundle_word   blobSize;
+    bundle_word   nodeCount;
+    bundle_word   nodeOffset;
+};
+
+
+//--------------------------------------------------------------------------
+/// Bundle node record
+///
+/// Index 0 is always the root (ParseTree), so 0 is used as "no node"
+/// for child and sibling links. String id 0 is the empty string.
+///
+/// @since 0.0.1
+/// @brief Bundle node record
+struct BundleNode
+{
+    bundle_word   kind;
+    bundle_word   firstChild;
+    bundle_word   nextSibling;
+    bundle_word   file;
+    bundle_word   offset;
+    bundle_word   length;
+    bundle_word   line;
+    bundle_word   aux;           ///< token id, task template, object type or section
+    bundle_word   str[5];
+};
+
+
+//--------------------------------------------------------------------------
+/// Source file fingerprint
+///
+/// @since 0.0.1
+/// @brief Source file fingerprint
+struct SourceStamp
+{
+    SourceStamp(void) : sizeLo(0), sizeHi(0), timeLo(0), timeHi(0)
+    {}
+
+    /// @brief Stat the given file, returns false if it does not exist
+    bool read(const std::string &path);
+
+    bundle_word   sizeLo;
+    bundle_word   sizeHi;
+    bundle_word   timeLo;
+    bundle_word   timeHi;
+};
+
+
+//--------------------------------------------------------------------------
+/// Invalid or stale bundle
+///
+/// @since 0.0.1
+/// @brief Invalid or stale bundle
+class BundleError : public std::runtime_error
+{
+public:
+    BundleError(const std::string &what) : std::runtime_error(what)
+    {}
+};
+
+
+//--------------------------------------------------------------------------
+/// Bundle writer
+///
+/// @since 0.0.1
+/// @brief Bundle writer
+class BundleWriter
+{
+public:
+    BundleWriter(void);
+
+    /// @brief Serialize the tree and write it to the given file
+    void write(ParseTree *tree, const SourceStamp &stamp, const std::string &path);
+
+protected:
+    bundle_word addString(const String &str);
+
+    bundle_word addNode(Node *node);
+
+    std::vector<BundleNode>              m_nodes;
+    std::vector<bundle_word>             m_strings;
+    std::string                          m_blob;
+    std::map<std::string, bundle_word>   m_stringIds;
+
+private:
+    BundleWriter(const BundleWriter&);
+    BundleWriter& operator=(const BundleWriter&);
+};
+
+
+//--------------------------------------------------------------------------
+/// Bundle reader
+///
+/// Validates a mapped bundle and rebuilds the parse tree from the node
+/// table. Throws BundleError if the bundle is invalid or stale.
+///
+/// @since 0.0.1
+/// @brief Bundle reader
+class BundleReader
+{
+public:
+    BundleReader(const char *data, size_t size);
+
+    /// @brief Check the source fingerprint
+    bool isCurrent(const SourceStamp &stamp) const;
+
+    /// @brief Build the parse tree
+    void read(ParseTree *tree);
+
+protected:
+    const String& string(bundle_word id);
+
+    const char            *m_data;
+    size_t                 m_size;
+    const BundleHeader    *m_header;
+    const bundle_word     *m_strings;
+    const char            *m_blob;
+    const BundleNode      *m_nodes;
+    std::vector<String>    m_cache;
+    std::vector<bool>      m_cached;
+
+private:
+    BundleReader(const BundleReader&);
+    BundleReader& operator=(const BundleReader&);
+};
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
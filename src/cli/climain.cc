@@ -28,6 +28,61 @@
 //ARGONCLIMP.010 *-p, --parse-only*::
 //ARGONCLIMP.010     Only parse the input file, but does not executes anything.
 //ARGONCLIMP.010 
+//ARGONCLIMP.010 *-c, --compile*::
+//ARGONCLIMP.010     Parse the input file and write a precompiled bundle, but does
+//ARGONCLIMP.010     not executes anything. The bundle is named like the input file
+//ARGONCLIMP.010     with the extension replaced by '.argc'.
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *-o, --output* 'BUNDLE'::
+//ARGONCLIMP.010     Use 'BUNDLE' as name for the precompiled bundle.
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--batch-size* 'ROWS'::
+//ARGONCLIMP.010     Number of rows a transfer task fetches and processes at once
+//ARGONCLIMP.010     (default: 1000).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--commit-every* 'ROWS'::
+//ARGONCLIMP.010     Commit the destination of a transfer task every 'ROWS' rows,
+//ARGONCLIMP.010     0 commits once at the end (default: 10000).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--pipeline* 'THREADS'::
+//ARGONCLIMP.010     Run transfer tasks as a pipeline: a reader thread, 'THREADS'
+//ARGONCLIMP.010     rule evaluator threads and the writer. 0 runs transfers on a
+//ARGONCLIMP.010     single thread (default: 0).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--queue-depth* 'BATCHES'::
+//ARGONCLIMP.010     Number of batches in flight between the pipeline stages
+//ARGONCLIMP.010     (default: 4).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--explain*::
+//ARGONCLIMP.010     Print for each transfer task whether it runs as a single
+//ARGONCLIMP.010     INSERT ... SELECT on the database or moves the rows through
+//ARGONCLIMP.010     argon, and why.
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *-j, --jobs* 'N'::
+//ARGONCLIMP.010     Run up to 'N' statements of the main task at the same time.
+//ARGONCLIMP.010     Statements which touch the same objects or share a connection
+//ARGONCLIMP.010     whose pool has one connection, or write log lines, keep their
+//ARGONCLIMP.010     order (default: 1).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--pool-min* 'N'::
+//ARGONCLIMP.010     Number of connections a connection opens on first use, for
+//ARGONCLIMP.010     connections without a pool clause (default: 1).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--pool-max* 'N'::
+//ARGONCLIMP.010     Number of connections a connection keeps open at most, for
+//ARGONCLIMP.010     connections without a pool clause (default: 4).
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *--reject-file* 'FILE'::
+//ARGONCLIMP.010     Append the rows a transfer destination does not accept to
+//ARGONCLIMP.010     'FILE', one tab separated line per row (task, SQLSTATE,
+//ARGONCLIMP.010     file:line of the task, error, row), and go on with the next
+//ARGONCLIMP.010     row. Tasks with an except section handle their rows
+//ARGONCLIMP.010     themselves. Without this option a rejected row fails the
+//ARGONCLIMP.010     task.
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 If a bundle exists and matches the size and modification time of
+//ARGONCLIMP.010 the input file, it is loaded instead of parsing the input file.
+//ARGONCLIMP.010 
 
 
 //ARGONCLIMP.010 
@@ -47,6 +102,9 @@
 //ARGONCLIMP.010 
 //ARGONCLIMP.010 *argoncli* --parse-only myscript.dts
 //ARGONCLIMP.010 
+//ARGONCLIMP.010 
+//ARGONCLIMP.010 *argoncli* --compile myscript.dts
+//ARGONCLIMP.010 
 
 //ARGONCLIMP.010 
 //ARGONCLIMP.010 BUGS
@@ -75,15 +133,160 @@
 #include <argon/dtsengine>
 
 #include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <memory>
+
 
-int main(void)
+/// Default bundle name: the script name with the extension replaced
+static std::string bundle_name(const std::string &script)
 {
-	std::cout << "Argon command line interface (c) 2010 Daniel Vogelbacher" << std::endl
-		<< std::endl;
+	std::string::size_type dot = script.find_last_of('.');
+	std::string::size_type sep = script.find_last_of("/\\");
+	if(dot == std::string::npos || (sep != std::string::npos && dot < sep))
+		return script + ".argc";
+	return script.substr(0, dot) + ".argc";
+}
 
-	//foo();
 
-	return 0;
+static int usage(void)
+{
+	std::cerr << "usage: argoncli [-v] [-p | -c] [-o BUNDLE] [-j N] [--batch-size ROWS]"
+		" [--commit-every ROWS]\n"
+		"                [--pipeline THREADS] [--queue-depth BATCHES] [--explain]\n"
+		"                [--pool-min N] [--pool-max N] [--reject-file FILE] FILE" << std::endl;
+	return 1;
+}
+
 
+/// Parse a row count, returns false if the argument is not a number
+static bool parse_rows(const char *arg, size_t &rows)
+{
+	char *end = 0;
+	long v = std::strtol(arg, &end, 10);
+	if(*arg == '\0' || *end != '\0' || v < 0)
+		return false;
+	rows = static_cast<size_t>(v);
+	return true;
 }
 
+
+int main(int argc, char **argv)
+{
+	bool verbose = false, parseonly = false, compile = false;
+	std::string script, bundle, rejects;
+	informave::argon::TransferOptions transfer;
+	size_t jobs = 1;
+	informave::argon::PoolOptions pool;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		if(!std::strcmp(arg, "-v") || !std::strcmp(arg, "--verbose"))
+			verbose = true;
+		else if(!std::strcmp(arg, "-p") || !std::strcmp(arg, "--parse-only"))
+			parseonly = true;
+		else if(!std::strcmp(arg, "-c") || !std::strcmp(arg, "--compile"))
+			compile = true;
+		else if(!std::strcmp(arg, "-o") || !std::strcmp(arg, "--output"))
+		{
+			if(++i == argc)
+				return usage();
+			bundle = argv[i];
+		}
+		else if(!std::strcmp(arg, "--batch-size"))
+		{
+			if(++i == argc || !parse_rows(argv[i], transfer.batchSize) || transfer.batchSize == 0)
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--commit-every"))
+		{
+			if(++i == argc || !parse_rows(argv[i], transfer.commitInterval))
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--explain"))
+			transfer.explain = true;
+		else if(!std::strcmp(arg, "-j") || !std::strcmp(arg, "--jobs"))
+		{
+			if(++i == argc || !parse_rows(argv[i], jobs) || jobs == 0)
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--pipeline"))
+		{
+			if(++i == argc || !parse_rows(argv[i], transfer.evaluators))
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--queue-depth"))
+		{
+			if(++i == argc || !parse_rows(argv[i], transfer.queueDepth) || transfer.queueDepth == 0)
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--pool-min"))
+		{
+			if(++i == argc || !parse_rows(argv[i], pool.minSize))
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--pool-max"))
+		{
+			if(++i == argc || !parse_rows(argv[i], pool.maxSize) || pool.maxSize == 0)
+				return usage();
+		}
+		else if(!std::strcmp(arg, "--reject-file"))
+		{
+			if(++i == argc)
+				return usage();
+			rejects = argv[i];
+		}
+		else if(arg[0] == '-' || !script.empty())
+			return usage();
+		else
+			script = arg;
+	}
+
+	if(script.empty() || pool.minSize > pool.maxSize)
+		return usage();
+	if(bundle.empty())
+		bundle = bundle_name(script);
+
+	if(verbose)
+		std::cout << "Argon command line interface (c) 2010 Daniel Vogelbacher" << std::endl
+			<< std::endl;
+
+	try
+	{
+		std::auto_ptr<informave::argon::RejectFile> sink;
+		if(!rejects.empty() && !parseonly && !compile)
+			sink.reset(new informave::argon::RejectFile(rejects));
+
+		informave::argon::DTSEngine engine;
+		engine.setRejectSink(sink.get());
+		engine.transferOptions() = transfer;
+		engine.setJobs(jobs);
+		engine.poolOptions() = pool;
+
+		if(compile)
+		{
+			engine.load(script);
+			engine.writeBundle(bundle, script);
+			if(verbose)
+				std::cout << "bundle written: " << bundle << std::endl;
+			return 0;
+		}
+
+		bool cached = engine.loadBundle(bundle, script);
+		if(verbose)
+			std::cout << (cached ? "using bundle: " + bundle : "parsed: " + script) << std::endl;
+
+		if(!parseonly)
+			engine.exec();
+	}
+	catch(std::exception &e)
+	{
+		std::cerr << "argoncli: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,391 @@
+//
+// connpool.cc - Connection pool (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Connection pool (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "connpool.hh"
+
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// SpecFactory
+
+/// @details
+/// 
+SpecFactory::SpecFactory(const String &type, const String &dbcstr)
+    : m_env(type),
+      m_dbcstr(dbcstr)
+{}
+
+
+/// @details
+/// 
+db::Connection*
+SpecFactory::newConnection(void)
+{
+    std::auto_ptr<db::Connection> dbc(this->m_env.newConnection());
+    dbc->connect(this->m_dbcstr);
+    return dbc.release();
+}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////// ConnectionPool
+
+static const size_t npos = static_cast<size_t>(-1);
+
+
+/// @details
+/// 
+ConnectionPool::ConnectionPool(db::Connection *dbc, ConnectionFactory *factory, const PoolOptions &opts)
+    : m_factory(factory),
+      m_opts(opts),
+      m_mutex(),
+      m_cond(),
+      m_idle(),
+      m_owned(),
+      m_leases(),
+      m_open(0),
+      m_stats(),
+      m_statements(opts.statements)
+{
+    if(dbc)
+    {
+        this->m_idle.push_back(dbc);
+        this->m_open = 1;
+    }
+}
+
+
+/// @details
+/// Connections which are still checked out are closed, too.
+ConnectionPool::~ConnectionPool(void)
+{
+    for(size_t i = 0; i < this->m_idle.size(); ++i)
+        this->m_statements.invalidate(this->m_idle[i]);
+    for(size_t i = 0; i < this->m_owned.size(); ++i)
+    {
+        this->m_statements.invalidate(this->m_owned[i]);
+        delete this->m_owned[i];
+    }
+}
+
+
+/// @details
+/// A pool without a factory can not grow.
+size_t
+ConnectionPool::maxSize(void) const
+{
+    if(! this->m_factory)
+        return this->m_open;
+    return std::max(this->m_opts.maxSize, std::max<size_t>(this->m_open, 1));
+}
+
+
+/// @details
+/// 
+size_t
+ConnectionPool::closed(void) const
+{
+    return this->maxSize() - this->m_open;
+}
+
+
+/// @details
+/// Returns the index of the first lease of the thread or npos.
+size_t
+ConnectionPool::held(atomic_word thread) const
+{
+    for(size_t i = 0; i < this->m_leases.size(); ++i)
+    {
+        if(this->m_leases[i].thread == thread)
+            return i;
+    }
+    return npos;
+}
+
+
+/// @details
+/// Connections are opened without holding the lock, so a slow server
+/// does not block checkouts of idle connections.
+size_t
+ConnectionPool::checkout(size_t need, size_t want, std::vector<db::Connection*> &dbcs)
+{
+    const atomic_word self = thread_id();
+    std::vector<db::Connection*> taken;
+    size_t opening = 0;
+    size_t keep = 0;
+
+    {
+        ScopedLock lock(this->m_mutex);
+
+        const size_t max = this->maxSize();
+        if(max == 0)
+            throw std::runtime_error("connection pool has no connection");
+        need = std::min(std::max<size_t>(need, 1), max);
+        want = std::min(std::max(want, need), max);
+
+        this->prune();
+        ++this->m_stats.checkouts;
+        double start = 0;
+        while(this->m_idle.size() + this->closed() < need)
+        {
+            size_t i = this->held(self);
+            if(i != npos)
+            {
+                ++this->m_leases[i].refs;
+                dbcs.push_back(this->m_leases[i].dbc);
+                return 1;
+            }
+            if(start == 0)
+            {
+                start = monotonic_time();
+                ++this->m_stats.waits;
+            }
+            this->m_cond.wait(this->m_mutex);
+        }
+        if(start != 0)
+        {
+            double waited = monotonic_time() - start;
+            this->m_stats.waitTime += waited;
+            this->m_stats.waitMax = std::max(this->m_stats.waitMax, waited);
+        }
+
+        while(taken.size() < want && ! this->m_idle.empty())
+        {
+            taken.push_back(this->m_idle.back());
+            this->m_idle.pop_back();
+        }
+        // the first checkout also opens the minimum connections
+        const size_t min = std::min(this->m_opts.minSize, max);
+        keep = std::min(want - taken.size(), this->closed());
+        opening = std::max(keep, this->m_open < min ? min - this->m_open : 0);
+        this->m_open += opening;
+
+        for(size_t i = 0; i < taken.size(); ++i)
+        {
+            Lease lease = { taken[i], self, 1 };
+            this->m_leases.push_back(lease);
+        }
+        this->m_stats.peak = std::max(this->m_stats.peak, this->m_leases.size() + keep);
+    }
+
+    std::vector<db::Connection*> opened;
+    try
+    {
+        this->openReserved(opening, opened);
+    }
+    catch(...)
+    {
+        for(size_t i = 0; i < taken.size(); ++i)
+            this->release(taken[i]);
+        throw;
+    }
+
+    if(opening)
+    {
+        ScopedLock lock(this->m_mutex);
+        this->m_stats.opened += opening;
+        this->m_owned.insert(this->m_owned.end(), opened.begin(), opened.end());
+        for(size_t i = 0; i < opening; ++i)
+        {
+            if(i < keep)
+            {
+                Lease lease = { opened[i], self, 1 };
+                this->m_leases.push_back(lease);
+                taken.push_back(opened[i]);
+            }
+            else
+                this->m_idle.push_back(opened[i]);
+        }
+        if(opening > keep)
+            this->m_cond.broadcast();
+    }
+
+    dbcs.insert(dbcs.end(), taken.begin(), taken.end());
+    return taken.size();
+}
+
+
+/// @details
+/// 
+void
+ConnectionPool::open(void)
+{
+    size_t opening = 0;
+    {
+        ScopedLock lock(this->m_mutex);
+        const size_t min = std::min(std::max<size_t>(this->m_opts.minSize, 1), this->maxSize());
+        opening = this->m_open < min ? min - this->m_open : 0;
+        this->m_open += opening;
+    }
+
+    std::vector<db::Connection*> opened;
+    this->openReserved(opening, opened);
+
+    ScopedLock lock(this->m_mutex);
+    this->m_stats.opened += opening;
+    this->m_owned.insert(this->m_owned.end(), opened.begin(), opened.end());
+    this->m_idle.insert(this->m_idle.end(), opened.begin(), opened.end());
+    this->m_cond.broadcast();
+}
+
+
+/// @details
+/// Called without the lock. If a connection can not be opened, the
+/// ones opened before become idle and the rest of the reservation is
+/// dropped.
+void
+ConnectionPool::openReserved(size_t n, std::vector<db::Connection*> &opened)
+{
+    try
+    {
+        while(opened.size() < n)
+        {
+            std::auto_ptr<db::Connection> dbc(this->m_factory->newConnection());
+            opened.push_back(dbc.get());
+            dbc.release();
+        }
+    }
+    catch(...)
+    {
+        ScopedLock lock(this->m_mutex);
+        this->m_open -= n - opened.size();
+        this->m_stats.opened += opened.size();
+        this->m_owned.insert(this->m_owned.end(), opened.begin(), opened.end());
+        this->m_idle.insert(this->m_idle.end(), opened.begin(), opened.end());
+        this->m_cond.broadcast();
+        throw;
+    }
+}
+
+
+/// @details
+/// 
+void
+ConnectionPool::release(db::Connection *dbc)
+{
+    ScopedLock lock(this->m_mutex);
+    for(size_t i = 0; i < this->m_leases.size(); ++i)
+    {
+        if(this->m_leases[i].dbc != dbc)
+            continue;
+        if(--this->m_leases[i].refs == 0)
+        {
+            this->m_leases.erase(this->m_leases.begin() + i);
+            this->m_idle.push_back(dbc);
+            this->m_cond.broadcast();
+        }
+        return;
+    }
+}
+
+
+/// @details
+/// Called with the lock held. A user-supplied connection is only
+/// forgotten, the others are closed.
+void
+ConnectionPool::prune(void)
+{
+    size_t i = 0;
+    while(i < this->m_idle.size())
+    {
+        db::Connection *dbc = this->m_idle[i];
+        if(dbc->isConnected())
+        {
+            ++i;
+            continue;
+        }
+        this->m_statements.invalidate(dbc);
+        this->m_idle.erase(this->m_idle.begin() + i);
+        --this->m_open;
+        std::vector<db::Connection*>::iterator o = std::find(this->m_owned.begin(), this->m_owned.end(), dbc);
+        if(o != this->m_owned.end())
+        {
+            this->m_owned.erase(o);
+            delete dbc;
+        }
+    }
+}
+
+
+/// @details
+/// 
+PoolStats
+ConnectionPool::stats(void)
+{
+    PoolStats stats;
+    {
+        ScopedLock lock(this->m_mutex);
+        stats = this->m_stats;
+    }
+    stats.statementHits = this->m_statements.hits();
+    stats.statementMisses = this->m_statements.misses();
+    return stats;
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// PoolLease
+
+/// @details
+/// 
+void
+PoolLease::checkout(ConnectionPool &pool, size_t need, size_t want)
+{
+    this->release();
+    this->m_pool = &pool;
+    pool.checkout(need, want, this->m_dbcs);
+}
+
+
+/// @details
+/// 
+void
+PoolLease::release(void)
+{
+    for(size_t i = 0; i < this->m_dbcs.size(); ++i)
+        this->m_pool->release(this->m_dbcs[i]);
+    this->m_dbcs.clear();
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
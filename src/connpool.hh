@@ -0,0 +1,216 @@
+//
+// connpool.hh - Connection pool
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Connection pool
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_CONNPOOL_HH
+#define INFORMAVE_ARGON_CONNPOOL_HH
+
+#include "argon/dtsengine.hh"
+#include "thread.hh"
+#include "stmtcache.hh"
+
+#include <vector>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Factory for script connections
+///
+/// Opens connections with the type and connection string of a
+/// connection definition.
+///
+/// @since 0.0.1
+/// @brief Factory for script connections
+class SpecFactory : public ConnectionFactory
+{
+public:
+    SpecFactory(const String &type, const String &dbcstr);
+
+    virtual db::Connection* newConnection(void);
+
+protected:
+    db::Database::Environment    m_env;
+    String                       m_dbcstr;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Connection pool
+///
+/// Connections are opened on the first checkout, the first one opens
+/// minSize connections at once. Further connections are opened when
+/// all open ones are checked out, up to maxSize. A pool without a
+/// factory only has its initial connection.
+///
+/// A checkout takes all connections it needs at once. Tasks check out
+/// the pools they use in slot order, so two tasks never wait for each
+/// other. A task called by a task that holds a connection of the pool
+/// gets that connection if the pool is exhausted, as both run on the
+/// same thread.
+///
+/// An idle connection which lost its connection is dropped at the
+/// next checkout, together with its cached statements.
+///
+/// @since 0.0.1
+/// @brief Connection pool
+class ConnectionPool
+{
+public:
+    /// @brief Create a pool
+    ///
+    /// @a dbc is the first connection (not owned, may be NULL), the
+    /// factory (not owned, may be NULL) opens the others.
+    ConnectionPool(db::Connection *dbc, ConnectionFactory *factory, const PoolOptions &opts);
+
+    ~ConnectionPool(void);
+
+    /// @brief Check out between @a need and @a want connections
+    ///
+    /// Waits until @a need connections can be had, takes as many as
+    /// available up to @a want. Both are limited to the pool size.
+    /// Returns the number of connections added to @a dbcs.
+    size_t checkout(size_t need, size_t want, std::vector<db::Connection*> &dbcs);
+
+    /// @brief Return a connection
+    void release(db::Connection *dbc);
+
+    /// @brief Open the minimum number of connections, at least one
+    ///
+    /// Does nothing if they are open already.
+    void open(void);
+
+    /// @brief Connections which can be open at the same time
+    size_t maxSize(void) const;
+
+    PoolStats stats(void);
+
+    /// @brief Prepared statements of the pool connections
+    inline StatementCache& statements(void)
+    {
+        return this->m_statements;
+    }
+
+protected:
+    struct Lease
+    {
+        db::Connection   *dbc;
+        atomic_word       thread;
+        size_t            refs;
+    };
+
+    /// @brief Connections which could still be opened
+    size_t closed(void) const;
+
+    size_t held(atomic_word thread) const;
+
+    /// @brief Open @a n connections already counted in m_open
+    void openReserved(size_t n, std::vector<db::Connection*> &opened);
+
+    /// @brief Drop idle connections which are no longer connected
+    void prune(void);
+
+    ConnectionFactory               *m_factory;
+    PoolOptions                      m_opts;
+    Mutex                            m_mutex;
+    Condition                        m_cond;
+    std::vector<db::Connection*>     m_idle;
+    std::vector<db::Connection*>     m_owned;
+    std::vector<Lease>               m_leases;
+    size_t                           m_open;      ///< open or being opened
+    PoolStats                        m_stats;
+    StatementCache                   m_statements;
+
+private:
+    ConnectionPool(const ConnectionPool&);
+    ConnectionPool& operator=(const ConnectionPool&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Checked out connections
+///
+/// Returns the connections to the pool when destroyed.
+///
+/// @since 0.0.1
+/// @brief Checked out connections
+class PoolLease
+{
+public:
+    PoolLease(void)
+        : m_pool(0),
+          m_dbcs()
+    {}
+
+    ~PoolLease(void)
+    {
+        this->release();
+    }
+
+    /// @brief Check out connections, see ConnectionPool::checkout()
+    void checkout(ConnectionPool &pool, size_t need, size_t want);
+
+    void release(void);
+
+    inline db::Connection& operator[](size_t i)
+    {
+        return *this->m_dbcs[i];
+    }
+
+    inline size_t size(void) const
+    {
+        return this->m_dbcs.size();
+    }
+
+    inline const std::vector<db::Connection*>& dbcs(void) const
+    {
+        return this->m_dbcs;
+    }
+
+protected:
+    ConnectionPool                  *m_pool;
+    std::vector<db::Connection*>     m_dbcs;
+
+private:
+    PoolLease(const PoolLease&);
+    PoolLease& operator=(const PoolLease&);
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
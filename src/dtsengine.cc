@@ -55,6 +55,8 @@
 
 #include "parserapi.hh"
 #include "tokenizer.hh"
+#include "mappedfile.hh"
+#include "bundle.hh"
 
 #include <cstdlib>
 #include <cstdio>
@@ -69,10 +71,16 @@ ARGON_NAMESPACE_BEGIN
 /// @details
 /// 
 DTSEngine::DTSEngine(void)
-    : m_tree(),
+    : m_interner(),
+      m_tree(),
       m_connections(),
       m_tasks(),
-      m_userConns()
+      m_userConns(),
+      m_factories(),
+      m_transferOptions(),
+      m_poolOptions(),
+      m_rejectSink(0),
+      m_jobs(1)
 {}
 
 /// @details
@@ -80,7 +88,17 @@ DTSEngine::DTSEngine(void)
 void 
 DTSEngine::addConnection(String name, db::Connection *dbc)
 {
-    this->m_userConns[Identifier(name)] = dbc;
+    this->m_userConns[this->ident(name)] = dbc;
+}
+
+
+/// @details
+/// 
+void 
+DTSEngine::addConnection(String name, db::Connection *dbc, ConnectionFactory *factory)
+{
+    this->m_userConns[this->ident(name)] = dbc;
+    this->m_factories[this->ident(name)] = factory;
 }
 
 
@@ -117,6 +135,15 @@ DTSEngine::getConnections(void)
 }
 
 
+/// @details
+/// 
+ConnectionFactoryMap&
+DTSEngine::getFactories(void)
+{
+    return this->m_factories;
+}
+
+
 /// @details
 /// 
 void
@@ -131,16 +158,13 @@ DTSEngine::exec(void)
 
 
 /// @details
-/// 
-void
-DTSEngine::load(std::istreambuf_iterator<wchar_t> in)
+/// Feeds all tokens from the tokenizer to the parser
+template<typename TokenizerT>
+static void
+parse_tokens(TokenizerT &tz, ParseTree *tree)
 {
     Token t;
     Parser p;
-    Tokenizer<wchar_t> tz(in);
-    tz.setSourceName(String("<unknown>"));
-
-    this->m_tree.reset(new ParseTree);
 
     //p.trace(stdout, "[LEMON] ");
 
@@ -152,11 +176,11 @@ DTSEngine::load(std::istreambuf_iterator<wchar_t> in)
         {
             if(t.id() != 0)
             {
-                Token *tp = this->m_tree->newToken(t);
-                p.parse(t.id(), tp, this->m_tree.get());
+                Token *tp = tree->newToken(t);
+                p.parse(t.id(), tp, tree);
             }
             else
-                p.parse(0, NULL, this->m_tree.get());
+                p.parse(0, NULL, tree);
         }
         catch(int) /// @bug fix lexical exceptions
         {
@@ -166,6 +190,96 @@ DTSEngine::load(std::istreambuf_iterator<wchar_t> in)
     while(t != Token::eof());
 }
 
+
+/// @details
+/// 
+void
+DTSEngine::load(std::istreambuf_iterator<wchar_t> in)
+{
+    this->m_tree.reset(new ParseTree(this->m_interner));
+
+    Tokenizer< StreamInput<wchar_t> > tz(in);
+    tz.setSourceName(this->m_tree->sourceFile(String("<unknown>")));
+
+    parse_tokens(tz, this->m_tree.get());
+}
+
+
+/// @details
+/// The mapping is only required while tokenizing, all token data
+/// is copied to the parse tree.
+void
+DTSEngine::load(const std::string &path)
+{
+    MappedFile file(path);
+
+    this->load(file.data(), file.size(), String(path));
+}
+
+
+/// @details
+/// 
+void
+DTSEngine::load(const char *data, size_t len, String srcname)
+{
+    this->m_tree.reset(new ParseTree(this->m_interner));
+
+    Tokenizer<Utf8Input> tz(Utf8Input(data, data + len));
+    tz.setSourceName(this->m_tree->sourceFile(srcname));
+
+    parse_tokens(tz, this->m_tree.get());
+}
+
+
+/// @details
+/// A missing, corrupt, foreign or stale bundle is never an error, the
+/// source file is parsed instead.
+bool
+DTSEngine::loadBundle(const std::string &bundle, const std::string &srcpath)
+{
+    SourceStamp stamp, bstamp;
+    if(stamp.read(srcpath) && bstamp.read(bundle))
+    {
+        try
+        {
+            MappedFile file(bundle);
+            BundleReader reader(file.data(), file.size());
+
+            if(reader.isCurrent(stamp))
+            {
+                std::auto_ptr<ParseTree> tree(new ParseTree(this->m_interner));
+                reader.read(tree.get());
+                this->m_tree = tree;
+                return true;
+            }
+        }
+        catch(std::runtime_error &)
+        {
+            // fall back to the source
+        }
+    }
+
+    this->load(srcpath);
+    return false;
+}
+
+
+/// @details
+/// 
+void
+DTSEngine::writeBundle(const std::string &bundle, const std::string &srcpath)
+{
+    if(! this->m_tree.get())
+        throw std::runtime_error("no script loaded");
+
+    SourceStamp stamp;
+    if(! stamp.read(srcpath))
+        throw std::runtime_error("can not stat source file: " + srcpath);
+
+    BundleWriter writer;
+    writer.write(this->m_tree.get(), stamp, bundle);
+}
+
 ARGON_NAMESPACE_END
 
 
@@ -26,55 +26,17 @@
 
 #include "argon/dtsengine.hh"
 #include "argon/exceptions.hh"
+#include "connpool.hh"
 
 
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <sstream>
 
 ARGON_NAMESPACE_BEGIN
 
 
-//--------------------------------------------------------------------------
-/// Task Child Visitor
-///
-/// @since 0.0.1
-/// @brief Task Child Visitor
-struct TaskChildVisitor : public Visitor
-{
-public:
-    TaskChildVisitor(Processor &proc, Task &task)
-        : Visitor(Visitor::ignore_none),
-          m_proc(proc),
-          m_task(task)
-    {}
-
-
-    virtual void visit(LogNode *node)
-    {
-        LogCmd cmd(this->m_proc, node);
-        cmd.exec();
-    }
-
-    
-    virtual void visit(TaskExecNode *node)
-    {
-        std::cout << "calling task: " << node->taskid().str() << std::endl;
-        //foreach_node(node->getChilds(), PrintTreeVisitor(this->m_proc, std::wcout), 1);
-
-        Task* task = this->m_proc.getSymbol<Task>(node->taskid());
-
-        // get arguments
-        this->m_proc.call(task, ArgumentList());
-    }
-
-private:
-    Processor &m_proc;
-    Task      &m_task;
-};
-
-
-
-
 //--------------------------------------------------------------------------
 /// Log Child Visitor
 ///
@@ -175,7 +137,7 @@ LogCmd::exec(void)
 
     std::wstringstream ss;
 
-    foreach_node(this->m_node->getChilds(), LogChildVisitor(this->proc(), ss), 1);
+    foreach_child(this->m_node, LogChildVisitor(this->proc(), ss), 1);
 
     std::wcout << L"[LOG]: " << ss.str() << std::endl;
 }
@@ -189,7 +151,8 @@ LogCmd::exec(void)
 /// 
 Task::Task(Processor &proc, TaskNode *node)
     : Element(proc),
-      m_node(node)
+      m_node(node),
+      m_code()
 {
     std::cout << "Processing task: " << node->id << std::endl;
 }
@@ -234,28 +197,1069 @@ Task::getSourceInfo(void) const
 }
 
 
+/// @details
+/// 
+void
+Task::compile(void)
+{
+    this->m_code.compile(this->proc(), this->m_node);
+}
+
+
 /// @details
 /// 
 Value
 Task::run(const ArgumentList &args)
 {
-    std::cout << "running task: " << this->id() << std::endl;
+    Interpreter vm(this->proc(), &args);
+    vm.exec(this->m_code);
+
+    return Value();
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// TransferTask
+
+/// @details
+/// 
+TransferTask::TransferTask(Processor &proc, TaskNode *node)
+    : Task(proc, node),
+      m_dest(),
+      m_src(),
+      m_initialization(),
+      m_before(),
+      m_after(),
+      m_finalization(),
+      m_excepts(),
+      m_rules(),
+      m_destColumns(),
+      m_srcColumns(),
+      m_destInfos(),
+      m_srcRefs(),
+      m_srcRefInfos(),
+      m_rows(0),
+      m_stats()
+{}
+
+
+/// @details
+/// Statements before the first section marker belong to the rules
+/// section. The rules section code is kept in m_code.
+void
+TransferTask::compile(void)
+{
+    SectionNode::section_type sec = SectionNode::sec_rules;
+    int objects = 0;
+
+    for(Node *child = this->m_node->firstChild(); child; child = child->nextSibling())
+    {
+        switch(child->kind())
+        {
+        case Node::kind_object:
+            if(objects > 1)
+                throw CompileError(child->getSourceInfo(), "transfer takes a destination and a source object");
+            this->compileObject(static_cast<ObjectNode*>(child), objects == 0 ? this->m_dest : this->m_src);
+            ++objects;
+            break;
+        case Node::kind_id:
+            throw CompileError(child->getSourceInfo(), "declared objects are not supported as transfer arguments");
+        case Node::kind_section:
+        {
+            SectionNode *section = static_cast<SectionNode*>(child);
+            sec = section->m_section;
+            if(sec == SectionNode::sec_except)
+            {
+                if(! section->m_state.empty() && section->m_state.size() != 2
+                   && section->m_state.size() != 5)
+                    throw CompileError(child->getSourceInfo(), "a SQLSTATE has 5 characters, its class 2");
+                this->m_excepts.push_back(ExceptHandler());
+                this->m_excepts.back().state = section->m_state;
+            }
+            else if(! section->m_state.empty())
+                throw CompileError(child->getSourceInfo(), "only except sections take a SQLSTATE");
+            break;
+        }
+        case Node::kind_colassign:
+            if(sec != SectionNode::sec_rules)
+                throw CompileError(child->getSourceInfo(), "column assignments are only allowed in the rules section");
+            this->compileRule(static_cast<ColAssignNode*>(child));
+            break;
+        default:
+        {
+            // the before, rules and after statements can pass the
+            // columns of each fetched row, the except statements those
+            // of the rejected row
+            const bool row = sec == SectionNode::sec_before || sec == SectionNode::sec_rules
+                || sec == SectionNode::sec_after;
+            if(row)
+                this->collectColumns(child);
+            this->section(sec).compileStatement(this->proc(), child,
+                                                CodeScope(this->m_node, row ? &this->m_srcRefs : 0,
+                                                          sec == SectionNode::sec_except
+                                                          ? &this->m_destColumns : 0));
+            break;
+        }
+        }
+    }
+
+    if(objects != 2)
+        throw CompileError(this->getSourceInfo(), "transfer takes a destination and a source object");
+    if(this->m_dest.type != ObjectNode::obj_table && this->m_dest.type != ObjectNode::obj_view)
+        throw CompileError(this->m_dest.info, "transfer destination must be a table or view");
+    if(this->m_src.type == ObjectNode::obj_procedure)
+        throw CompileError(this->m_src.info, "procedures are not supported as transfer source");
+    if(this->m_dest.readers)
+        throw CompileError(this->m_dest.info, "parallel() is only allowed for the transfer source");
+    if(this->m_rules.empty())
+        throw CompileError(this->getSourceInfo(), "transfer task without column assignments");
+
+    this->m_initialization.finish();
+    this->m_before.finish();
+    this->m_code.finish();
+    this->m_after.finish();
+    this->m_finalization.finish();
+    for(size_t i = 0; i < this->m_excepts.size(); ++i)
+        this->m_excepts[i].code.finish();
+}
+
+
+/// @details
+/// Objects take a connection and a table name (or SQL text),
+/// optionally followed by parallel().
+void
+TransferTask::compileObject(ObjectNode *node, Object &obj)
+{
+    Node *conn = node->firstChild();
+    Node *name = conn ? conn->nextSibling() : 0;
+    Node *option = name ? name->nextSibling() : 0;
+
+    if(! conn || conn->kind() != Node::kind_id || ! name || name->kind() != Node::kind_literal
+       || (option && (option->kind() != Node::kind_parallel || option->nextSibling())))
+        throw CompileError(node->getSourceInfo(), "object arguments must be a connection and a name");
+
+    Identifier id = static_cast<IdNode*>(conn)->data();
+    obj.conn = this->proc().resolveSymbol(id, conn->getSourceInfo());
+    if(! dynamic_cast<Connection*>(this->proc().slot(obj.conn)))
+        throw TypeMismatch(id, "CONNECTION", this->proc().slot(obj.conn)->type(), conn->getSourceInfo());
+
+    obj.type = node->m_type;
+    obj.name = static_cast<LiteralNode*>(name)->m_data;
+    obj.info = node->getSourceInfo();
+
+    if(option)
+        this->compileParallel(static_cast<ParallelNode*>(option), obj);
+}
+
+
+/// @details
+/// Split values must be in ascending order, only numbers are checked
+/// here.
+void
+TransferTask::compileParallel(ParallelNode *node, Object &obj)
+{
+    NumberNode *readers = static_cast<NumberNode*>(node->firstChild());
+    ColumnNode *key = static_cast<ColumnNode*>(readers->nextSibling());
+
+    Value n;
+    try
+    {
+        n = parse_number(readers->m_data);
+    }
+    catch(std::runtime_error &e)
+    {
+        throw CompileError(readers->getSourceInfo(), e.what());
+    }
+    if(n.type() != Value::type_int || n.asInt() < 1)
+        throw CompileError(readers->getSourceInfo(), "parallel() needs a positive number of readers");
+
+    obj.readers = static_cast<size_t>(n.asInt());
+    obj.key = key->colname();
+
+    for(Node *split = key->nextSibling(); split; split = split->nextSibling())
+    {
+        if(split->kind() == Node::kind_literal)
+        {
+            obj.splits.push_back(Value(static_cast<LiteralNode*>(split)->m_data));
+            continue;
+        }
+        try
+        {
+            obj.splits.push_back(parse_number(static_cast<NumberNode*>(split)->m_data));
+        }
+        catch(std::runtime_error &e)
+        {
+            throw CompileError(split->getSourceInfo(), e.what());
+        }
+        size_t i = obj.splits.size() - 1;
+        if(i > 0 && obj.splits[i - 1].type() != Value::type_string
+           && obj.splits[i - 1].asDouble() >= obj.splits[i].asDouble())
+            throw CompileError(split->getSourceInfo(), "parallel() split values must be ascending");
+    }
+}
+
+
+/// Compile the value of a column assignment into @a rule, returns
+/// the column name of a copy rule. The standard value of a constant
+/// is the constant.
+static String compile_rule_value(Node *value, ColumnRule &rule)
+{
+    String src;
+    switch(value->kind())
+    {
+    case Node::kind_column:
+        rule.type = ColumnRule::rule_copy;
+        rule.result = static_cast<ColumnNode*>(value)->m_result;
+        src = static_cast<ColumnNode*>(value)->colname();
+        break;
+    case Node::kind_null:
+        rule.type = ColumnRule::rule_null;
+        break;
+    case Node::kind_literal:
+        rule.type = ColumnRule::rule_const;
+        rule.value = Value(static_cast<LiteralNode*>(value)->m_data);
+        break;
+    case Node::kind_number:
+        rule.type = ColumnRule::rule_const;
+        try
+        {
+            rule.value = parse_number(static_cast<NumberNode*>(value)->m_data);
+        }
+        catch(std::runtime_error &e)
+        {
+            throw CompileError(value->getSourceInfo(), e.what());
+        }
+        break;
+    case Node::kind_stdvalue:
+        src = compile_rule_value(static_cast<StdValueNode*>(value)->value(), rule);
+        if(rule.type == ColumnRule::rule_null)
+            throw CompileError(value->getSourceInfo(), "NULL has no standard value");
+        if(rule.type == ColumnRule::rule_copy)
+            rule.type = ColumnRule::rule_default;
+        break;
+    default:
+        throw CompileError(value->getSourceInfo(), "symbols can not be assigned to columns");
+    }
+    return src;
+}
+
+
+/// Destination column index of a column name, new names are appended
+static size_t column_index(std::vector<String> &columns, const String &name)
+{
+    size_t i = 0;
+    while(i < columns.size() && columns[i] != name)
+        ++i;
+    if(i == columns.size())
+        columns.push_back(name);
+    return i;
+}
+
+
+/// @details
+/// Source columns are bound by name when the source is opened, see
+/// bind(). A %column is the value of a destination column assigned
+/// by an earlier rule. A column assigned twice gets the value of the
+/// last assignment.
+void
+TransferTask::compileRule(ColAssignNode *node)
+{
+    ColumnRule rule;
+    String src = compile_rule_value(node->value(), rule);
+
+    if(rule.result)
+    {
+        std::vector<String>::const_iterator i =
+            std::find(this->m_destColumns.begin(), this->m_destColumns.end(), src);
+        if(i == this->m_destColumns.end())
+            throw CompileError(node->value()->getSourceInfo(),
+                               "destination column " + std::string(src) + " is not assigned before");
+        rule.src = i - this->m_destColumns.begin();
+        src = String();
+    }
+
+    rule.dest = column_index(this->m_destColumns, node->dest()->colname());
+    if(rule.dest == this->m_destInfos.size())
+        this->m_destInfos.push_back(node->getSourceInfo());
+
+    this->m_rules.push_back(rule);
+    this->m_srcColumns.push_back(src);
+    if(! src.empty())
+        this->addColumnRef(src, node->value()->getSourceInfo());
+}
+
+
+/// @details
+/// Collects the source columns ($column) a statement of a section
+/// passes on, e.g. as arguments of exec task.
+void
+TransferTask::collectColumns(Node *node)
+{
+    for(Node *child = node->firstChild(); child; child = child->nextSibling())
+    {
+        if(child->kind() == Node::kind_column)
+        {
+            ColumnNode *col = static_cast<ColumnNode*>(child);
+            if(! col->m_result)
+                this->addColumnRef(col->colname(), col->getSourceInfo());
+        }
+        else
+            this->collectColumns(child);
+    }
+}
+
+
+/// @details
+/// 
+void
+TransferTask::addColumnRef(const String &name, const SourceInfo &info)
+{
+    if(std::find(this->m_srcRefs.begin(), this->m_srcRefs.end(), name) == this->m_srcRefs.end())
+    {
+        this->m_srcRefs.push_back(name);
+        this->m_srcRefInfos.push_back(info);
+    }
+}
+
+
+/// @details
+/// The select list of a table or view source: the referenced columns
+/// in the order of their first reference, a constant if the rules do
+/// not read the source.
+String
+TransferTask::selectList(void) const
+{
+    if(this->m_src.type == ObjectNode::obj_sql)
+        return String("*");
+    if(this->m_srcRefs.empty())
+        return String("1");
+    String list;
+    for(size_t i = 0; i < this->m_srcRefs.size(); ++i)
+    {
+        if(i)
+            list.append(", ");
+        list.append(sql_identifier(this->m_srcRefs[i]));
+    }
+    return list;
+}
+
+
+/// @details
+/// If the projected query of a table or view fails, a column the
+/// task references but the source does not have is reported with its
+/// position, other errors are passed on.
+void
+TransferTask::openSource(BatchReader &reader, db::Connection &dbc, const String &from) const
+{
+    try
+    {
+        reader.open();
+    }
+    catch(std::exception &)
+    {
+        if(this->m_src.type != ObjectNode::obj_sql)
+            this->checkColumns(dbc, from);
+        throw;
+    }
+}
+
+
+/// @details
+/// The destination columns are read from an empty result of the
+/// destination table.
+void
+TransferTask::bindColumns(RuleList &rules, std::vector<size_t> &refs, BatchReader &src,
+                          db::Connection &dbc, StatementCache *cache) const
+{
+    String probe = String("SELECT * FROM ") + sql_identifier(this->m_dest.name) + String(" WHERE 1 = 0");
+    BatchReader dest(dbc, probe, std::vector<Value>(), cache);
+    dest.open();
+    this->bind(rules, refs, src, dest);
+
+    for(size_t i = 0; i < rules.size(); ++i)
+    {
+        if(rules[i].type == ColumnRule::rule_default)
+            rules[i].value = standard_value(rules[i].srcType);
+    }
+}
+
+
+/// SQL literal of a constant, false if the type has none
+static bool sql_literal(const Value &value, String &sql)
+{
+    switch(value.type())
+    {
+    case Value::type_void:
+    case Value::type_null:
+        sql = String("NULL");
+        return true;
+    case Value::type_int:
+    case Value::type_decimal:
+        sql = value.asString();
+        return true;
+    case Value::type_float:
+    {
+        // keep a float a float: 2 would be an integer
+        std::wstring s = value.asString();
+        if(s.find_first_of(L".eEnN") == std::wstring::npos)
+            s.append(L".0");
+        sql = s;
+        return true;
+    }
+    case Value::type_string:
+    {
+        std::wstring s(L"'");
+        for(size_t i = 0; i < value.strLength(); ++i)
+        {
+            if(value.strData()[i] == L'\'')
+                s.push_back(L'\'');
+            s.push_back(value.strData()[i]);
+        }
+        s.push_back(L'\'');
+        sql = s;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
 
-//    std::cout << debug::ArgsPrinter(args) << std::endl;
 
-    foreach_node( this->m_node->getChilds(), TaskChildVisitor(this->proc(), *this), 1);
+/// @details
+/// A task takes the row path if it needs the rows on the client:
+/// statements of the before, rules or after section run for each
+/// batch, rejected rows go to the except section or the reject sink,
+/// or the source is read in parallel. Otherwise the source and the
+/// rules are bound against empty results and compiled by select().
+/// Returns the query for BatchWriter::insertFrom(), an empty string
+/// for the row path.
+String
+TransferTask::plan(bool shared, db::Connection &dbc, const String &from, StatementCache *cache)
+{
+    String select, reason;
+
+    if(! shared)
+        reason = String("source and destination use different connections");
+    else if(this->m_src.readers)
+        reason = String("parallel() source");
+    else if(this->m_before.size() > 1 || this->m_code.size() > 1 || this->m_after.size() > 1)
+        reason = String("statements run for each batch");
+    else if(! this->m_excepts.empty())
+        reason = String("the except section handles rejected rows");
+    else if(this->proc().engine().rejectSink())
+        reason = String("rejected rows go to the reject sink");
+    else
+    {
+        BatchReader reader(dbc, String("SELECT ") + this->selectList() + String(" FROM ")
+                           + from + String(" WHERE 1 = 0"), std::vector<Value>(), cache);
+        this->openSource(reader, dbc, from);
+        RuleList rules(this->m_rules);
+        std::vector<size_t> refs;
+        this->bindColumns(rules, refs, reader, dbc, cache);
+        select = this->select(rules, from, reason);
+    }
+
+    if(this->proc().engine().transferOptions().explain)
+    {
+        std::wstringstream ss;
+        ss << L"[EXPLAIN] " << this->name() << L": ";
+        if(select.empty())
+            ss << L"row path, " << reason;
+        else
+            ss << L"INSERT ... SELECT on one connection: " << select;
+        this->proc().print(ss.str());
+    }
+    return select;
+}
 
 
-    if(this->id() != Identifier("main"))
-        throw RuntimeError(this->proc().getStack());
+/// @details
+/// The expression of a destination column is the one of its last
+/// rule, a %column the expression assigned to it so far. A standard
+/// value is taken from the declared type of the source column, so
+/// the database can not evaluate @ on a column of unknown type.
+String
+TransferTask::select(const RuleList &rules, const String &from, String &reason) const
+{
+    std::vector<String> exprs(this->m_destColumns.size(), String("NULL"));
 
+    for(size_t r = 0; r < rules.size(); ++r)
+    {
+        const ColumnRule &rule = rules[r];
+        const String col = rule.result ? exprs[rule.src] : sql_identifier(this->m_srcColumns[r]);
+        String &expr = exprs[rule.dest];
+
+        switch(rule.type)
+        {
+        case ColumnRule::rule_null:
+            expr = String("NULL");
+            break;
+        case ColumnRule::rule_const:
+            if(! sql_literal(rule.value, expr))
+            {
+                reason = String("no SQL literal for the value of ") + this->m_destColumns[rule.dest];
+                return String();
+            }
+            break;
+        case ColumnRule::rule_copy:
+            expr = col;
+            break;
+        case ColumnRule::rule_default:
+        {
+            String dflt;
+            if(rule.srcType == Value::type_void)
+            {
+                reason = String("the type of ") + col + String(" is unknown, @ needs the fetched values");
+                return String();
+            }
+            if(rule.value.isVoid() || ! sql_literal(rule.value, dflt))
+                expr = col;
+            else
+                expr = String("COALESCE(") + col + String(", ") + dflt + String(")");
+            break;
+        }
+        }
+    }
+
+    String sql("SELECT ");
+    for(size_t c = 0; c < exprs.size(); ++c)
+    {
+        if(c)
+            sql.append(", ");
+        sql.append(exprs[c]);
+    }
+    sql.append(" FROM ").append(from);
+    return sql;
+}
+
+
+/// @details
+/// Called if the projected query of the source failed: a column the
+/// task references but the source does not have is reported with its
+/// position, other errors are left to the caller.
+void
+TransferTask::checkColumns(db::Connection &dbc, const String &from) const
+{
+    BatchReader probe(dbc, String("SELECT * FROM ") + from + String(" WHERE 1 = 0"));
+    probe.open();
+    for(size_t i = 0; i < this->m_srcRefs.size(); ++i)
+    {
+        if(probe.findColumn(this->m_srcRefs[i]) == BatchReader::npos)
+            throw CompileError(this->m_srcRefInfos[i], "unknown source column "
+                               + std::string(this->m_srcRefs[i]));
+    }
+}
+
+
+/// @details
+/// Resolves the source column of each copy rule to its position in
+/// @a src and records the declared types of both ends, so an unknown
+/// column fails before the first row is read. @a dest is a result
+/// of the destination table. @a refs gets the position of each
+/// referenced source column. Only these columns are fetched.
+void
+TransferTask::bind(RuleList &rules, std::vector<size_t> &refs, BatchReader &src,
+                   BatchReader &dest) const
+{
+    std::vector<Value::value_type> destTypes(this->m_destColumns.size(), Value::type_void);
+    for(size_t c = 0; c < this->m_destColumns.size(); ++c)
+    {
+        size_t i = dest.findColumn(this->m_destColumns[c]);
+        if(i == BatchReader::npos)
+            throw CompileError(this->m_destInfos[c], "unknown destination column "
+                               + std::string(this->m_destColumns[c]) + " in "
+                               + std::string(this->m_dest.name));
+        destTypes[c] = dest.columnType(i);
+    }
+
+    std::vector<bool> used;
+    refs.resize(this->m_srcRefs.size());
+    for(size_t i = 0; i < this->m_srcRefs.size(); ++i)
+    {
+        refs[i] = src.findColumn(this->m_srcRefs[i]);
+        if(refs[i] == BatchReader::npos)
+            throw CompileError(this->m_srcRefInfos[i], "unknown source column "
+                               + std::string(this->m_srcRefs[i]));
+        // also the columns the sections pass on
+        if(used.size() <= refs[i])
+            used.resize(refs[i] + 1, false);
+        used[refs[i]] = true;
+    }
+
+    for(size_t r = 0; r < rules.size(); ++r)
+    {
+        ColumnRule &rule = rules[r];
+        rule.destType = destTypes[rule.dest];
+        if(rule.type != ColumnRule::rule_copy && rule.type != ColumnRule::rule_default)
+            continue;
+        if(rule.result)
+        {
+            rule.srcType = destTypes[rule.src];
+            if(rule.type == ColumnRule::rule_copy)
+                rule.convert = ColumnVector::kernel(rule.srcType, rule.destType);
+            continue;
+        }
+        rule.src = src.findColumn(this->m_srcColumns[r]);
+        assert(rule.src != BatchReader::npos);
+        rule.srcType = src.columnType(rule.src);
+        // @ fills in the standard value of the source type first
+        if(rule.type == ColumnRule::rule_copy)
+            rule.convert = ColumnVector::kernel(rule.srcType, rule.destType);
+        if(used.size() <= rule.src)
+            used.resize(rule.src + 1, false);
+        used[rule.src] = true;
+    }
+
+    std::vector<size_t> cols;
+    for(size_t c = 0; c < used.size(); ++c)
+    {
+        if(used[c])
+            cols.push_back(c);
+    }
+    // a source without used columns still fetches its rows
+    if(cols.empty() && src.columnCount())
+        cols.push_back(0);
+    src.useColumns(cols);
+}
+
+
+/// @details
+/// 
+Code&
+TransferTask::section(SectionNode::section_type sec)
+{
+    switch(sec)
+    {
+    case SectionNode::sec_initialization:  return this->m_initialization;
+    case SectionNode::sec_before:          return this->m_before;
+    case SectionNode::sec_after:           return this->m_after;
+    case SectionNode::sec_finalization:    return this->m_finalization;
+    case SectionNode::sec_except:          return this->m_excepts.back().code;
+    default:                               return this->m_code;
+    }
+}
+
+
+/// @details
+/// A section for the state or its class wins over one without state,
+/// otherwise the first in the source does. Returns 0 if no except
+/// section handles @a sqlstate.
+const TransferTask::ExceptHandler*
+TransferTask::exceptHandler(const String &sqlstate) const
+{
+    const ExceptHandler *any = 0;
+    for(size_t i = 0; i < this->m_excepts.size(); ++i)
+    {
+        const ExceptHandler &h = this->m_excepts[i];
+        if(h.state.empty())
+        {
+            if(! any)
+                any = &h;
+        }
+        else if(sqlstate.compare(0, h.state.size(), h.state) == 0)
+            return &h;
+    }
+    return any;
+}
+
+
+/// Runs the before and rules statements ahead of each batch and the
+/// after statements behind it, always on the thread of the task. A
+/// section which passes source columns runs once for each fetched
+/// row, with the values of that row. @a refs are the positions of
+/// the source columns in the fetched batch (see bind()).
+struct TransferTask::TaskTransfer : public Transfer
+{
+    TaskTransfer(BatchReader &reader, BatchWriter &writer, const RuleList &rules,
+                 const TransferOptions &opts, Interpreter &vm, const TransferTask &task,
+                 const std::vector<size_t> &refs)
+        : Transfer(reader, writer, rules, opts),
+          m_vm(vm),
+          m_task(task),
+          m_refs(refs)
+    {}
+
+protected:
+    virtual void beforeBatch(const RowBatch &in)
+    {
+        this->exec(this->m_task.m_before, in);
+        this->exec(this->m_task.m_code, in);
+    }
+
+    virtual void afterBatch(const RowBatch &in)
+    {
+        this->exec(this->m_task.m_after, in);
+    }
+
+    void exec(const Code &code, const RowBatch &in)
+    {
+        if(! code.readsRow())
+        {
+            this->m_vm.exec(code);
+            return;
+        }
+        for(size_t i = 0; i < in.active(); ++i)
+        {
+            this->m_vm.setRow(in, this->m_refs, in.activeRow(i));
+            this->m_vm.exec(code);
+        }
+    }
+
+    Interpreter                 &m_vm;
+    const TransferTask          &m_task;
+    const std::vector<size_t>   &m_refs;
+};
+
+
+/// Writer of a transfer task, buffered rows of stores called from the
+/// sections are inserted before each commit, and before the rollback
+/// of a failed transfer so they share the fate of its rows. Rejected
+/// rows go to the except section or the reject sink of the engine.
+class TransferTask::TaskWriter : public BatchWriter
+{
+public:
+    TaskWriter(TransferTask &task, Interpreter &vm, db::Connection &dbc, StatementCache *cache)
+        : BatchWriter(dbc, task.m_dest.name, task.m_destColumns,
+                      task.proc().engine().transferOptions().commitInterval, cache),
+          m_task(task),
+          m_vm(vm),
+          m_sink(task.proc().engine().rejectSink())
+    {
+        this->isolateFailures(! task.m_excepts.empty() || this->m_sink);
+    }
+
+    virtual ~TaskWriter(void)
+    {
+        // still open, so the transfer failed and ~BatchWriter rolls back
+        if(this->m_inTrans)
+            this->m_task.proc().flushStoresAfterFailure(this->m_task.proc().getStack().size());
+    }
+
+protected:
+    virtual void beforeCommit(void)
+    {
+        this->m_task.proc().flushStores();
+    }
+
+    virtual void rejectRow(const RowBatch &batch, size_t row, const String &sqlstate,
+                           const String &error)
+    {
+        const ExceptHandler *handler = this->m_task.exceptHandler(sqlstate);
+        if(handler)
+        {
+            this->m_vm.setReject(batch, row, sqlstate, error);
+            this->m_vm.exec(handler->code);
+            return;
+        }
+        if(! this->m_sink)
+            throw std::runtime_error(std::string(error));
+
+        RejectRecord rec;
+        rec.task = this->m_task.name();
+        rec.sqlstate = sqlstate;
+        rec.info = this->m_task.getSourceInfo();
+        rec.error = error;
+        rec.columns = &this->m_task.m_destColumns;
+        rec.values.reserve(batch.columns());
+        for(size_t c = 0; c < batch.columns(); ++c)
+            rec.values.push_back(batch.value(row, c));
+        this->m_sink->reject(rec);
+    }
+
+    TransferTask    &m_task;
+    Interpreter     &m_vm;
+    RejectSink      *m_sink;
+};
+
+
+/// @details
+/// 
+Value
+TransferTask::run(const ArgumentList &args)
+{
+    const TransferOptions &opts = this->proc().engine().transferOptions();
+    Connection *src = static_cast<Connection*>(this->proc().slot(this->m_src.conn));
+    Connection *dest = static_cast<Connection*>(this->proc().slot(this->m_dest.conn));
+    Interpreter vm(this->proc(), &args);
+
+    vm.exec(this->m_initialization);
+
+    // the source may read the rows of stores called before
+    this->proc().flushStores();
+
+    String from, sql;
+    if(this->m_src.type == ObjectNode::obj_sql)
+    {
+        from.append("(").append(this->m_src.name).append(") argon_src");
+        sql = this->m_src.name;
+    }
+    else
+    {
+        from = sql_identifier(this->m_src.name);
+        sql.append("SELECT ").append(this->selectList()).append(" FROM ").append(from);
+    }
+
+    // a connection handle must not be used by two threads. The
+    // connections are checked out for the whole task, pools in slot
+    // order, so tasks running at the same time never wait for each
+    // other.
+    const size_t wanted = this->m_src.readers ? this->m_src.readers : 1;
+    PoolLease srcLease, destLease;
+    if(src == dest)
+        dest->checkout(destLease, 1, this->m_src.readers ? 1 + wanted : 1);
+    else if(this->m_src.conn < this->m_dest.conn)
+    {
+        src->checkout(srcLease, 1, wanted);
+        dest->checkout(destLease, 1, 1);
+    }
+    else
+    {
+        dest->checkout(destLease, 1, 1);
+        src->checkout(srcLease, 1, wanted);
+    }
+    db::Connection &destDbc = destLease[0];
+    db::Connection &srcDbc = src == dest ? destLease[0] : srcLease[0];
+
+    // the readers of a partitioned source start after the columns are
+    // known, so the first source connection is also the first reader
+    std::vector<db::Connection*> readers;
+    if(this->m_src.readers)
+    {
+        if(src == dest)
+            readers.assign(destLease.dbcs().begin() + 1, destLease.dbcs().end());
+        else
+            readers = srcLease.dbcs();
+    }
+
+    // partitioned sources read the chunks, this reader only
+    // provides the columns
+    if(! readers.empty())
+        sql = String("SELECT ") + this->selectList() + String(" FROM ") + from + String(" WHERE 1 = 0");
+
+    String select = this->plan(src == dest, destDbc, from, &dest->pool().statements());
+    if(! select.empty())
+    {
+        TaskWriter writer(*this, vm, destDbc, &dest->pool().statements());
+        writer.insertFrom(select);
+        writer.close();
+        this->m_rows = writer.rows();
+        this->m_stats = TransferStats();
+        this->m_stats.rows = this->m_rows;
+
+        vm.exec(this->m_finalization);
+        return Value();
+    }
+
+    BatchReader reader(srcDbc, sql, std::vector<Value>(), &src->pool().statements());
+    this->openSource(reader, srcDbc, from);
+
+    RuleList rules(this->m_rules);
+    std::vector<size_t> refs;
+    this->bindColumns(rules, refs, reader, destDbc, &dest->pool().statements());
+
+    TaskWriter writer(*this, vm, destDbc, &dest->pool().statements());
+    writer.open();
+
+    TransferOptions topts(opts);
+    if(&srcDbc == &destDbc && readers.empty())
+        topts.evaluators = 0;
+
+    TaskTransfer transfer(reader, writer, rules, topts, vm, *this, refs);
+    if(! readers.empty())
+    {
+        // more chunks than readers, so a dense key range does not
+        // leave the other readers idle
+        transfer.partition(split_key_range(srcDbc, from, this->m_src.key,
+                                           readers.size() * 4, this->m_src.splits,
+                                           this->selectList()),
+                           readers, &src->pool().statements());
+    }
+    transfer.run();
+
+    writer.close();
+    this->m_rows = writer.rows();
+    this->m_stats = transfer.stats();
+    this->m_stats.rejected = writer.rejected();
+
+    if(this->m_stats.rejected)
+    {
+        RejectSink *sink = this->proc().engine().rejectSink();
+        if(sink)
+            sink->flush();
+
+        std::wstringstream ss;
+        ss << L"[TRANSFER] " << this->name() << L": " << this->m_stats.rejected << L" rows rejected";
+        this->proc().print(ss.str());
+    }
+
+    if(this->m_stats.pipelined)
+    {
+        const TransferStats &s = this->m_stats;
+        const StageStats &feed = s.evaluator.batches ? s.evaluator : s.reader;
+        std::wstringstream ss;
+        ss << L"[TRANSFER] " << this->name() << L": " << s.rows << L" rows";
+        if(s.chunks)
+            ss << L", " << s.readers << L" readers, " << s.chunks << L" chunks";
+        ss << L", stall reader " << s.reader.stall << L"s"
+           << L" evaluator " << s.evaluator.stall << L"s"
+           << L" writer " << s.writer.stall << L"s"
+           << L", queue depth " << feed.depthAvg()
+           << L" avg " << feed.depthMax << L" max of " << s.queueCapacity;
+        this->proc().print(ss.str());
+    }
+
+    vm.exec(this->m_finalization);
 
     return Value();
+}
+
+
 
-    //this->proc().call(t);
+//..............................................................................
+////////////////////////////////////////////////////////////////////// StoreTask
 
+/// @details
+/// 
+StoreTask::StoreTask(Processor &proc, TaskNode *node)
+    : Task(proc, node),
+      m_conn(0),
+      m_table(),
+      m_rules(),
+      m_columns(),
+      m_buffer()
+{}
 
-    //this->m_script.getTask(Identifier("foo"));
+
+/// @details
+/// Statements besides the column assignments run on every call,
+/// before the row is added. A parameter assigned to a column is a
+/// copy rule whose source is the argument.
+void
+StoreTask::compile(void)
+{
+    int objects = 0;
+
+    for(Node *child = this->m_node->firstChild(); child; child = child->nextSibling())
+    {
+        switch(child->kind())
+        {
+        case Node::kind_object:
+        {
+            ObjectNode *obj = static_cast<ObjectNode*>(child);
+            Node *conn = obj->firstChild();
+            Node *name = conn ? conn->nextSibling() : 0;
+            if(objects > 0)
+                throw CompileError(child->getSourceInfo(), "store takes a destination object");
+            if(obj->m_type != ObjectNode::obj_table && obj->m_type != ObjectNode::obj_view)
+                throw CompileError(child->getSourceInfo(), "store destination must be a table or view");
+            if(! conn || conn->kind() != Node::kind_id || ! name || name->kind() != Node::kind_literal
+               || name->nextSibling())
+                throw CompileError(child->getSourceInfo(), "object arguments must be a connection and a name");
+
+            Identifier id = static_cast<IdNode*>(conn)->data();
+            this->m_conn = this->proc().resolveSymbol(id, conn->getSourceInfo());
+            if(! dynamic_cast<Connection*>(this->proc().slot(this->m_conn)))
+                throw TypeMismatch(id, "CONNECTION", this->proc().slot(this->m_conn)->type(),
+                                   conn->getSourceInfo());
+            this->m_table = static_cast<LiteralNode*>(name)->m_data;
+            ++objects;
+            break;
+        }
+        case Node::kind_id:
+            throw CompileError(child->getSourceInfo(), "declared objects are not supported as store arguments");
+        case Node::kind_colassign:
+        {
+            ColAssignNode *assign = static_cast<ColAssignNode*>(child);
+            ColumnRule rule;
+            if(assign->value()->kind() == Node::kind_id)
+            {
+                Identifier id = static_cast<IdNode*>(assign->value())->data();
+                int param = this->m_node->paramIndex(id);
+                if(param < 0)
+                    throw CompileError(assign->value()->getSourceInfo(),
+                                       std::string(id.str()) + " is not a parameter of the task");
+                rule.type = ColumnRule::rule_copy;
+                rule.src = static_cast<size_t>(param);
+                rule.dest = column_index(this->m_columns, assign->dest()->colname());
+                this->m_rules.push_back(rule);
+                break;
+            }
+            compile_rule_value(assign->value(), rule);
+            if(rule.result)
+                throw CompileError(assign->value()->getSourceInfo(), "store tasks can not read destination columns");
+            if(rule.type == ColumnRule::rule_copy || rule.type == ColumnRule::rule_default)
+                throw CompileError(assign->value()->getSourceInfo(), "store tasks have no source columns");
+            rule.dest = column_index(this->m_columns, assign->dest()->colname());
+            this->m_rules.push_back(rule);
+            break;
+        }
+        default:
+            this->m_code.compileStatement(this->proc(), child, CodeScope(this->m_node));
+            break;
+        }
+    }
+
+    if(objects != 1)
+        throw CompileError(this->getSourceInfo(), "store takes a destination object");
+    if(this->m_rules.empty())
+        throw CompileError(this->getSourceInfo(), "store task without column assignments");
+
+    this->m_code.finish();
+}
+
+
+/// @details
+/// The buffer holds a batch (TransferOptions::batchSize) of rows.
+Value
+StoreTask::run(const ArgumentList &args)
+{
+    Interpreter vm(this->proc(), &args);
+    vm.exec(this->m_code);
+
+    if(! this->m_buffer.get())
+        this->m_buffer.reset(new StoreBuffer(this->m_table, this->m_columns,
+                                             this->proc().engine().transferOptions().batchSize));
+    if(! this->m_buffer->pending())
+        this->proc().pendingStore(this);
+    if(this->m_buffer->add(this->m_rules, args))
+        this->flush();
+
+    return Value();
+}
+
+
+/// @details
+/// A caller holding the only connection of the pool shares it, so
+/// the rows go into the caller's transaction.
+void
+StoreTask::flush(void)
+{
+    if(! this->m_buffer.get() || ! this->m_buffer->pending())
+        return;
+
+    Connection *dest = static_cast<Connection*>(this->proc().slot(this->m_conn));
+    PoolLease lease;
+    dest->checkout(lease, 1, 1);
+    this->m_buffer->flush(lease[0], &dest->pool().statements());
+}
+
+
+/// @details
+/// 
+size_t
+StoreTask::rows(void) const
+{
+    return this->m_buffer.get() ? this->m_buffer->rows() : 0;
+}
+
+
+/// @details
+/// 
+size_t
+StoreTask::flushes(void) const
+{
+    return this->m_buffer.get() ? this->m_buffer->flushes() : 0;
 }
 
 
@@ -263,21 +1267,53 @@ Task::run(const ArgumentList &args)
 //..............................................................................
 ///////////////////////////////////////////////////////////////////// Connection
 
+/// Pool sizes are plain numbers
+static size_t pool_size(const String &str, const SourceInfo &info)
+{
+    Value n;
+    try
+    {
+        n = parse_number(str);
+    }
+    catch(std::runtime_error &e)
+    {
+        throw CompileError(info, e.what());
+    }
+    if(n.type() != Value::type_int || n.asInt() < 0)
+        throw CompileError(info, "pool sizes must be whole numbers");
+    return static_cast<size_t>(n.asInt());
+}
+
+
 /// @details
-/// 
-Connection::Connection(Processor &proc, ConnNode *node, db::ConnectionMap &userConns)
+/// No connection is opened here, the pool opens them on first use.
+Connection::Connection(Processor &proc, ConnNode *node, db::ConnectionMap &userConns,
+                       ConnectionFactoryMap &factories, const PoolOptions &defaults)
     : Element(proc),
       m_node(node),
-      m_dbc(0),
-      m_alloc_env(),
-      m_alloc_dbc()
+      m_alloc_factory(),
+      m_pool(0)
 {
     std::cout << "Processing connection: " << node->id << std::endl;
 
-    if(userConns[node->id])
+    PoolOptions opts(defaults);
+    if(! node->spec->poolMin.empty())
+    {
+        opts.minSize = pool_size(node->spec->poolMin, node->getSourceInfo());
+        opts.maxSize = pool_size(node->spec->poolMax, node->getSourceInfo());
+        if(opts.maxSize < 1 || opts.maxSize < opts.minSize)
+            throw CompileError(node->getSourceInfo(), "pool size must be at least 1 and not below the minimum");
+    }
+
+    db::Connection *dbc = 0;
+    ConnectionFactory *factory = 0;
+    if(userConns[node->id] || factories[node->id])
     {
         std::cout << "Using user-supplied connection: " << node->id << std::endl;
-        this->m_dbc = userConns[node->id];
+        dbc = userConns[node->id];
+        factory = factories[node->id];
+        if(dbc && ! dbc->isConnected())
+            throw ConnectionErr(node->id, node->getSourceInfo(), "dbc is not connected");
     }
     else
     {
@@ -285,14 +1321,62 @@ Connection::Connection(Processor &proc, ConnNode *node, db::ConnectionMap &userC
         {
             throw std::runtime_error("no dbc type given");
         }
-        this->m_alloc_env.reset(new db::Database::Environment(node->spec->type));
-        this->m_alloc_dbc.reset(this->m_alloc_env->newConnection());
-        this->m_dbc = this->m_alloc_dbc.get();
-        this->m_dbc->connect(node->spec->dbcstr);
+        this->m_alloc_factory.reset(new SpecFactory(node->spec->type, node->spec->dbcstr));
+        factory = this->m_alloc_factory.get();
+    }
+    this->m_pool = new ConnectionPool(dbc, factory, opts);
+}
+
+
+/// @details
+/// The pool closes its connections before the factory goes away.
+Connection::~Connection(void)
+{
+    delete this->m_pool;
+}
+
+
+/// @details
+/// 
+void
+Connection::open(void)
+{
+    try
+    {
+        this->m_pool->open();
+    }
+    catch(std::exception &e)
+    {
+        throw ConnectionErr(this->id(), this->getSourceInfo(), e.what());
+    }
+}
+
+
+/// @details
+/// 
+void
+Connection::checkout(PoolLease &lease, size_t need, size_t want)
+{
+    try
+    {
+        lease.checkout(*this->m_pool, need, want);
+    }
+    catch(std::exception &e)
+    {
+        throw ConnectionErr(this->id(), this->getSourceInfo(), e.what());
     }
 }
 
 
+/// @details
+/// 
+PoolStats
+Connection::poolStats(void) const
+{
+    return this->m_pool->stats();
+}
+
+
 /// @details
 /// 
 String
@@ -332,16 +1416,6 @@ Connection::type(void) const
 }
 
 
-/// @details
-/// 
-db::Connection&
-Connection::getDbc(void)
-{
-    assert(this->m_dbc);
-    return *this->m_dbc;
-}
-
-
 ARGON_NAMESPACE_END
 
 
@@ -78,6 +78,78 @@ SyntaxError::SyntaxError(Token *t)
 }
 
 
+//..............................................................................
+/////////////////////////////////////////////////////////////////// CompileError
+
+/// @details
+/// 
+CompileError::CompileError(const SourceInfo &info, const String &msg)
+    : Exception()
+{
+    std::wstringstream ss;
+    ss << info.sourceName() << L":" << info.linenum() << L": "
+       << L"(AEC6000) "
+       << msg;
+
+    this->m_what = ss.str();
+}
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// NotDeclared
+
+/// @details
+/// 
+NotDeclared::NotDeclared(const Identifier &id, const SourceInfo &info)
+    : CompileError()
+{
+    std::wstringstream ss;
+    ss << info.sourceName() << L":" << info.linenum() << L": "
+       << L"(AEC6001) "
+       << L"Symbol not declared: "
+       << id.str();
+
+    this->m_what = ss.str();
+}
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// TypeMismatch
+
+/// @details
+/// 
+TypeMismatch::TypeMismatch(const Identifier &id, const String &expected, const String &found,
+                           const SourceInfo &info)
+    : CompileError()
+{
+    std::wstringstream ss;
+    ss << info.sourceName() << L":" << info.linenum() << L": "
+       << L"(AEC6002) "
+       << L"Symbol " << id.str() << L" is a " << found
+       << L", expected " << expected;
+
+    this->m_what = ss.str();
+}
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////// ConnectionErr
+
+/// @details
+/// 
+ConnectionErr::ConnectionErr(const Identifier &id, const SourceInfo &info, const String &msg)
+    : Exception()
+{
+    std::wstringstream ss;
+    ss << info.sourceName() << L":" << info.linenum() << L": "
+       << L"(AEC7001) "
+       << L"Can not open connection " << id.str()
+       << L": " << msg;
+
+    this->m_what = ss.str();
+}
+
+
 /// @details
 /// 
 const char*
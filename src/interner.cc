@@ -0,0 +1,61 @@
+//
+// interner.cc - String interner (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief String interner (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/interner.hh"
+
+ARGON_NAMESPACE_BEGIN
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// Interner
+
+/// @details
+/// 
+Interner::Interner(void)
+    : m_strings()
+{}
+
+
+/// @details
+/// Elements of a std::set never move, so the address of the stored
+/// string is a stable handle.
+const String*
+Interner::intern(const String &str)
+{
+    return &*this->m_strings.insert(str).first;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
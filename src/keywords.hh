@@ -0,0 +1,198 @@
+//
+// keywords.hh - Keyword table (generated by keywords.py, do not edit)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Keyword table (perfect hash)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_KEYWORDS_HH
+#define INFORMAVE_ARGON_KEYWORDS_HH
+
+#include "argon/fwd.hh"
+
+#include <cstddef>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Keyword table entry
+///
+/// @since 0.0.1
+/// @brief Keyword table entry
+struct Keyword
+{
+    const char   *name;
+    size_t        len;
+    int           id;
+    bool          context;  ///< may be an identifier, see parser.y
+};
+
+
+#define ARGON_KEYWORD_MIN_LEN 2
+#define ARGON_KEYWORD_MAX_LEN 14
+#define ARGON_KEYWORD_TABLE_SIZE 64
+
+
+/// Associated values, indexed by ASCII code (case-insensitive)
+static const unsigned char keyword_asso[128] =
+{
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  4,  0,
+     3,  4, 28, 63, 56, 14, 24,  1, 23,  7,  0,  0,  0,  0,  0,  0,
+     0, 30, 26, 47, 53, 53, 10, 18, 20, 61, 44, 15, 60, 21, 30, 24,
+    29, 45, 39, 23, 15, 42, 13, 12, 11, 47, 53,  0,  0,  0,  0, 35,
+     0, 30, 26, 47, 53, 53, 10, 18, 20, 61, 44, 15, 60, 21, 30, 24,
+    29, 45, 39, 23, 15, 42, 13, 12, 11, 47, 53,  0,  0,  0,  0,  0,
+};
+
+
+/// Keywords, indexed by hash value
+static const Keyword keyword_table[ARGON_KEYWORD_TABLE_SIZE] =
+{
+    { "TASK", 4, ARGON_TOK_TASK, false },
+    { 0, 0, 0, false },
+    { "PROCEDURE", 9, ARGON_TOK_PROCEDURE, false },
+    { "SQL", 3, ARGON_TOK_SQL, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "INITIALIZATION", 14, ARGON_TOK_SECTION, true },
+    { "NULL", 4, ARGON_TOK_NULL, true },
+    { 0, 0, 0, false },
+    { "BEFORE", 6, ARGON_TOK_SECTION, true },
+    { "END", 3, ARGON_TOK_END, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "AS", 2, ARGON_TOK_AS, false },
+    { 0, 0, 0, false },
+    { "PROGRAM.", 8, ARGON_TOK_PROGRAM, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "AFTER", 5, ARGON_TOK_SECTION, true },
+    { "EXCEPT", 6, ARGON_TOK_SECTION, true },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "FETCH", 5, ARGON_TOK_TEMPLATE, false },
+    { 0, 0, 0, false },
+    { "VIEW", 4, ARGON_TOK_VIEW, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "VOID", 4, ARGON_TOK_TEMPLATE, false },
+    { 0, 0, 0, false },
+    { "STORE", 5, ARGON_TOK_TEMPLATE, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "TRANSFER", 8, ARGON_TOK_TEMPLATE, false },
+    { "DECLARE", 7, ARGON_TOK_DECLARE, false },
+    { "TABLE", 5, ARGON_TOK_TABLE, false },
+    { 0, 0, 0, false },
+    { "LOG", 3, ARGON_TOK_LOG, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "RULES", 5, ARGON_TOK_SECTION, true },
+    { 0, 0, 0, false },
+    { "CONNECTION", 10, ARGON_TOK_CONNECTION, false },
+    { 0, 0, 0, false },
+    { "FINALIZATION", 12, ARGON_TOK_SECTION, true },
+    { "BEGIN", 5, ARGON_TOK_BEGIN, false },
+    { "EXEC", 4, ARGON_TOK_EXEC, false },
+    { 0, 0, 0, false },
+    { "POOL", 4, ARGON_TOK_POOL, true },
+    { 0, 0, 0, false },
+    { "TYPE", 4, ARGON_TOK_TYPE, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "DBCSTR", 6, ARGON_TOK_DBCSTR, false },
+    { 0, 0, 0, false },
+    { 0, 0, 0, false },
+    { "PARALLEL", 8, ARGON_TOK_PARALLEL, true },
+};
+
+
+
+/// @brief ASCII code of a character, or 128 for anything else
+inline unsigned int keyword_code(char c)
+{
+    return static_cast<unsigned char>(c) < 128 ? static_cast<unsigned char>(c) : 128;
+}
+
+inline unsigned int keyword_code(wchar_t c)
+{
+    return (c >= 0 && c < 128) ? static_cast<unsigned int>(c) : 128;
+}
+
+
+/// @brief Look up a keyword (ASCII case-insensitive)
+///
+/// Returns the table entry or NULL if the given characters are not a
+/// keyword. No memory is allocated.
+template<typename CharT>
+inline const Keyword* find_keyword(const CharT *s, size_t len)
+{
+    if(len < ARGON_KEYWORD_MIN_LEN || len > ARGON_KEYWORD_MAX_LEN)
+        return 0;
+
+    unsigned int c0 = keyword_code(s[0]);
+    unsigned int c1 = keyword_code(s[1]);
+    unsigned int cn = keyword_code(s[len-1]);
+    if(c0 > 127 || c1 > 127 || cn > 127)
+        return 0;
+
+    const Keyword &kw = keyword_table[(len + keyword_asso[c0] + keyword_asso[c1] + keyword_asso[cn])
+                                      % ARGON_KEYWORD_TABLE_SIZE];
+    if(kw.len != len)
+        return 0;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned int c = keyword_code(s[i]);
+        if(c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        if(c != static_cast<unsigned char>(kw.name[i]))
+            return 0;
+    }
+    return &kw;
+}
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
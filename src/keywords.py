@@ -0,0 +1,237 @@
+#!/usr/bin/env python
+#
+# keywords.py - Generate the keyword table for the Tokenizer
+#
+# Copyright (C)         informave.org
+#   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+#
+# Lesser GPL 3.0 License
+#
+# Searches associated values for a perfect hash over
+#   (length, first char, second char, last char)
+# and writes keywords.hh. Run this script after changing the list
+# below:
+#
+#   ./keywords.py > keywords.hh
+#
+
+import random
+import sys
+
+KEYWORDS = [
+    ("CONNECTION", "ARGON_TOK_CONNECTION"),
+    ("TYPE",       "ARGON_TOK_TYPE"),
+    ("DBCSTR",     "ARGON_TOK_DBCSTR"),
+    ("PROGRAM.",   "ARGON_TOK_PROGRAM"),
+    ("TASK",       "ARGON_TOK_TASK"),
+    ("AS",         "ARGON_TOK_AS"),
+    ("BEGIN",      "ARGON_TOK_BEGIN"),
+    ("END",        "ARGON_TOK_END"),
+
+    ("DECLARE",    "ARGON_TOK_DECLARE"),
+    ("TABLE",      "ARGON_TOK_TABLE"),
+    ("VIEW",       "ARGON_TOK_VIEW"),
+    ("PROCEDURE",  "ARGON_TOK_PROCEDURE"),
+    ("SQL",        "ARGON_TOK_SQL"),
+    ("PARALLEL",   "ARGON_TOK_PARALLEL"),
+    ("POOL",       "ARGON_TOK_POOL"),
+
+    ("LOG",        "ARGON_TOK_LOG"),
+    ("EXEC",       "ARGON_TOK_EXEC"),
+    ("NULL",       "ARGON_TOK_NULL"),
+
+    # task sections
+    ("INITIALIZATION", "ARGON_TOK_SECTION"),
+    ("BEFORE",     "ARGON_TOK_SECTION"),
+    ("RULES",      "ARGON_TOK_SECTION"),
+    ("AFTER",      "ARGON_TOK_SECTION"),
+    ("FINALIZATION", "ARGON_TOK_SECTION"),
+    ("EXCEPT",     "ARGON_TOK_SECTION"),
+
+    # templates
+    ("VOID",       "ARGON_TOK_TEMPLATE"),
+    ("FETCH",      "ARGON_TOK_TEMPLATE"),
+    ("STORE",      "ARGON_TOK_TEMPLATE"),
+    ("TRANSFER",   "ARGON_TOK_TEMPLATE"),
+]
+
+# context keywords: the parser takes them as an ID where the keyword
+# does not fit (%fallback in parser.y)
+CONTEXT = set(["ARGON_TOK_SECTION", "ARGON_TOK_NULL",
+               "ARGON_TOK_POOL", "ARGON_TOK_PARALLEL"])
+
+CHARS = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._"
+
+
+def search(size):
+    rnd = random.Random(size)
+    for _ in range(1000000):
+        asso = dict((c, rnd.randrange(size)) for c in CHARS)
+        slots = {}
+        for name, tok in KEYWORDS:
+            h = (len(name) + asso[name[0]] + asso[name[1]] + asso[name[-1]]) % size
+            if h in slots:
+                break
+            slots[h] = (name, tok)
+        else:
+            return asso, slots
+    return None
+
+
+def main():
+    size = 32
+    while len(KEYWORDS) * 2 > size:
+        size *= 2
+    res = search(size)
+    while res is None:
+        size *= 2
+        res = search(size)
+    asso, slots = res
+
+    table = []
+    for c in range(128):
+        ch = chr(c).upper()
+        table.append(asso.get(ch, 0))
+
+    out = sys.stdout
+    out.write("""//
+// keywords.hh - Keyword table (generated by keywords.py, do not edit)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Keyword table (perfect hash)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_KEYWORDS_HH
+#define INFORMAVE_ARGON_KEYWORDS_HH
+
+#include "argon/fwd.hh"
+
+#include <cstddef>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Keyword table entry
+///
+/// @since 0.0.1
+/// @brief Keyword table entry
+struct Keyword
+{
+    const char   *name;
+    size_t        len;
+    int           id;
+    bool          context;  ///< may be an identifier, see parser.y
+};
+
+
+#define ARGON_KEYWORD_MIN_LEN %d
+#define ARGON_KEYWORD_MAX_LEN %d
+#define ARGON_KEYWORD_TABLE_SIZE %d
+
+
+/// Associated values, indexed by ASCII code (case-insensitive)
+static const unsigned char keyword_asso[128] =
+{
+""" % (min(len(k) for k, t in KEYWORDS), max(len(k) for k, t in KEYWORDS), size))
+
+    for i in range(0, 128, 16):
+        out.write("    " + ", ".join("%2d" % v for v in table[i:i+16]) + ",\n")
+    out.write("};\n\n\n")
+
+    out.write("/// Keywords, indexed by hash value\n")
+    out.write("static const Keyword keyword_table[ARGON_KEYWORD_TABLE_SIZE] =\n{\n")
+    for h in range(size):
+        if h in slots:
+            name, tok = slots[h]
+            out.write('    { "%s", %d, %s, %s },\n'
+                      % (name, len(name), tok, tok in CONTEXT and "true" or "false"))
+        else:
+            out.write('    { 0, 0, 0, false },\n')
+    out.write("};\n")
+
+    out.write("""
+
+
+/// @brief ASCII code of a character, or 128 for anything else
+inline unsigned int keyword_code(char c)
+{
+    return static_cast<unsigned char>(c) < 128 ? static_cast<unsigned char>(c) : 128;
+}
+
+inline unsigned int keyword_code(wchar_t c)
+{
+    return (c >= 0 && c < 128) ? static_cast<unsigned int>(c) : 128;
+}
+
+
+/// @brief Look up a keyword (ASCII case-insensitive)
+///
+/// Returns the table entry or NULL if the given characters are not a
+/// keyword. No memory is allocated.
+template<typename CharT>
+inline const Keyword* find_keyword(const CharT *s, size_t len)
+{
+    if(len < ARGON_KEYWORD_MIN_LEN || len > ARGON_KEYWORD_MAX_LEN)
+        return 0;
+
+    unsigned int c0 = keyword_code(s[0]);
+    unsigned int c1 = keyword_code(s[1]);
+    unsigned int cn = keyword_code(s[len-1]);
+    if(c0 > 127 || c1 > 127 || cn > 127)
+        return 0;
+
+    const Keyword &kw = keyword_table[(len + keyword_asso[c0] + keyword_asso[c1] + keyword_asso[cn])
+                                      % ARGON_KEYWORD_TABLE_SIZE];
+    if(kw.len != len)
+        return 0;
+
+    for(size_t i = 0; i < len; ++i)
+    {
+        unsigned int c = keyword_code(s[i]);
+        if(c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        if(c != static_cast<unsigned char>(kw.name[i]))
+            return 0;
+    }
+    return &kw;
+}
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
+""")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,158 @@
+//
+// mappedfile.cc - Read-only memory mapped files (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Read-only memory mapped files (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/argon_config.hh"
+#include "mappedfile.hh"
+
+#include <stdexcept>
+
+#if defined(ARGON_ON_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+ARGON_NAMESPACE_BEGIN
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////// MappedFile
+
+#if defined(ARGON_ON_WIN32)
+
+/// @details
+/// 
+MappedFile::MappedFile(const std::string &path)
+    : m_data(0),
+      m_size(0),
+      m_handle(0)
+{
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("can not open file: " + path);
+
+    LARGE_INTEGER size;
+    if(! ::GetFileSizeEx(file, &size))
+    {
+        ::CloseHandle(file);
+        throw std::runtime_error("can not stat file: " + path);
+    }
+    this->m_size = static_cast<size_t>(size.QuadPart);
+
+    if(this->m_size > 0)
+    {
+        HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        ::CloseHandle(file);
+        if(! mapping)
+            throw std::runtime_error("can not map file: " + path);
+
+        this->m_data = static_cast<const char*>(::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        this->m_handle = mapping;
+        if(! this->m_data)
+        {
+            ::CloseHandle(mapping);
+            throw std::runtime_error("can not map file: " + path);
+        }
+    }
+    else
+        ::CloseHandle(file);
+}
+
+
+/// @details
+/// 
+MappedFile::~MappedFile(void)
+{
+    if(this->m_data)
+        ::UnmapViewOfFile(this->m_data);
+    if(this->m_handle)
+        ::CloseHandle(static_cast<HANDLE>(this->m_handle));
+}
+
+#else
+
+/// @details
+/// 
+MappedFile::MappedFile(const std::string &path)
+    : m_data(0),
+      m_size(0),
+      m_handle(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("can not open file: " + path);
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("can not stat file: " + path);
+    }
+    this->m_size = static_cast<size_t>(st.st_size);
+
+    if(this->m_size > 0)
+    {
+        void *p = ::mmap(0, this->m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("can not map file: " + path);
+        }
+#if defined(MADV_SEQUENTIAL)
+        ::madvise(p, this->m_size, MADV_SEQUENTIAL);
+#endif
+        this->m_data = static_cast<const char*>(p);
+    }
+    ::close(fd);
+}
+
+
+/// @details
+/// 
+MappedFile::~MappedFile(void)
+{
+    if(this->m_data)
+        ::munmap(const_cast<char*>(this->m_data), this->m_size);
+}
+
+#endif
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,89 @@
+//
+// mappedfile.hh - Read-only memory mapped files
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Read-only memory mapped files
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_MAPPEDFILE_HH
+#define INFORMAVE_ARGON_MAPPEDFILE_HH
+
+#include "argon/fwd.hh"
+
+#include <string>
+#include <cstddef>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Read-only memory mapped file
+///
+/// The whole file is mapped on construction and unmapped by the
+/// destructor. Empty files are valid and have a null data pointer.
+///
+/// @since 0.0.1
+/// @brief Read-only memory mapped file
+class MappedFile
+{
+public:
+    /// @brief Map the given file, throws std::runtime_error on failure
+    MappedFile(const std::string &path);
+
+    ~MappedFile(void);
+
+    /// @brief Start of the mapped region
+    inline const char* data(void) const
+    {
+        return this->m_data;
+    }
+
+    /// @brief Size of the mapped region in bytes
+    inline size_t size(void) const
+    {
+        return this->m_size;
+    }
+
+protected:
+    const char   *m_data;
+    size_t        m_size;
+    void         *m_handle;
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
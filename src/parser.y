@@ -47,6 +47,11 @@
               tree->raiseSyntaxError();
 } 
 
+// Context keywords: where the keyword does not fit, the token is
+// parsed as an identifier, e.g. a connection named pool or a task
+// named after. See CONTEXT in keywords.py.
+%fallback ID SECTION NULL POOL PARALLEL.
+
 //%left PLUS MINUS.   
 //%left DIVIDE TIMES.  
    
@@ -79,32 +84,112 @@ callArgList(A) ::= callArgItem(B). {
 
 callArgItem(A) ::= ID(B). {
                CREATE_NODE(IdNode);
-               node->init(Identifier(B->data()));
+               node->init(tree->ident(B->data()));
+               node->updateSourceInfo(B->getSourceInfo());
                A = node;
 }
 
 callArgItem(A) ::= LITERAL(B). {
                CREATE_NODE(LiteralNode);
                node->init(B->data());
+               node->updateSourceInfo(B->getSourceInfo());
+               A = node;
+}
+
+callArgItem(A) ::= NUMBER(B). {
+               CREATE_NODE(NumberNode);
+               node->init(B->data());
+               node->updateSourceInfo(B->getSourceInfo());
                A = node;
 }
 
 callArgItem(A) ::= COLUMN(B). {
                CREATE_NODE(ColumnNode);
                node->init(B->data());
+               node->updateSourceInfo(B->getSourceInfo());
+               A = node;
+}
+
+callArgItem(A) ::= RESCOLUMN(B). {
+               CREATE_NODE(ColumnNode);
+               node->init(B->data(), true);
+               node->updateSourceInfo(B->getSourceInfo());
                A = node;
 }
 
 /// other
 
 
-arglist ::= LP arglistx RP.
-arglistx ::= arglistx argitem COMMA.
-arglistx ::= arglistx argitem.
-arglistx ::= .
+%type arglist { NodeList* }
+%type arglistx { NodeList* }
+
+arglist(A) ::= LP arglistx(B) RP. { A = B; }
+
+arglistx(A) ::= arglistx(B) argitem(C) COMMA. {
+         A = B;
+         A->push_back(C);
+}
+
+arglistx(A) ::= arglistx(B) argitem(C). {
+         A = B;
+         A->push_back(C);
+}
+
+arglistx(A) ::= . { A = tree->newNodeList(); }
+
+argitem(A) ::= ID(B). {
+        CREATE_NODE(IdNode);
+        node->init(tree->ident(B->data()));
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
+
+argitem(A) ::= LITERAL(B). {
+        CREATE_NODE(LiteralNode);
+        node->init(B->data());
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
+
+/// parallel(readers, key-column [, split, ...])
+argitem(A) ::= PARALLEL(T) LP NUMBER(B) COMMA ID(C) splitlist(D) RP. {
+        CREATE_NODE(ParallelNode);
+        NumberNode *readers = tree->newNode<NumberNode>();
+        readers->init(B->data());
+        readers->updateSourceInfo(B->getSourceInfo());
+        ColumnNode *key = tree->newNode<ColumnNode>();
+        key->init(C->data());
+        key->updateSourceInfo(C->getSourceInfo());
+        node->addChild(readers);
+        node->addChild(key);
+        node->addChilds(D);
+        node->updateSourceInfo(T->getSourceInfo());
+        A = node;
+}
+
+%type splitlist { NodeList* }
+%type splitval { Node* }
+
+splitlist(A) ::= splitlist(B) COMMA splitval(C). {
+          A = B;
+          A->push_back(C);
+}
+
+splitlist(A) ::= . { A = tree->newNodeList(); }
+
+splitval(A) ::= NUMBER(B). {
+        CREATE_NODE(NumberNode);
+        node->init(B->data());
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
 
-argitem ::= ID.
-argitem ::= LITERAL.
+splitval(A) ::= LITERAL(B). {
+        CREATE_NODE(LiteralNode);
+        node->init(B->data());
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
 
 
 start ::= setuplist PROGRAM inslist.
@@ -117,10 +202,39 @@ decl ::= DECLARE ID(A) declArgList AS otype SEP. {
      std::cout << "Declare: " << A->data() << std::endl; 
 }
 
-otype ::= TABLE arglist declBody.
-otype ::= VIEW arglist declBody.
-otype ::= PROCEDURE arglist declBody.
-otype ::= SQL arglist declBody.
+%type otype { ObjectNode* }
+
+otype(A) ::= TABLE(T) arglist(B) declBody. {
+      CREATE_NODE(ObjectNode);
+      node->init(ObjectNode::obj_table);
+      node->addChilds(B);
+      node->updateSourceInfo(T->getSourceInfo());
+      A = node;
+}
+
+otype(A) ::= VIEW(T) arglist(B) declBody. {
+      CREATE_NODE(ObjectNode);
+      node->init(ObjectNode::obj_view);
+      node->addChilds(B);
+      node->updateSourceInfo(T->getSourceInfo());
+      A = node;
+}
+
+otype(A) ::= PROCEDURE(T) arglist(B) declBody. {
+      CREATE_NODE(ObjectNode);
+      node->init(ObjectNode::obj_procedure);
+      node->addChilds(B);
+      node->updateSourceInfo(T->getSourceInfo());
+      A = node;
+}
+
+otype(A) ::= SQL(T) arglist(B) declBody. {
+      CREATE_NODE(ObjectNode);
+      node->init(ObjectNode::obj_sql);
+      node->addChilds(B);
+      node->updateSourceInfo(T->getSourceInfo());
+      A = node;
+}
 
 declBody ::= BEGIN bodyExpr END.
 declBody ::= .
@@ -152,7 +266,7 @@ declArgItem ::= ID.
 
 conn ::= CONNECTION(Y) ID(A) connspec(B) SEP(Z). {
      CREATE_NODE(ConnNode);
-     node->init(Identifier(A->data()), B);
+     node->init(tree->ident(A->data()), B);
      tree->addChild(node);
 
      ADD_TOKEN(node, Y);
@@ -173,6 +287,13 @@ connspec(A) ::= . {
 }
 
 
+/// pool min max
+connspec(A) ::= connspec(B) POOL NUMBER(C) NUMBER(D). {
+            A = B;
+            A->setPool(C->data(), D->data());
+}
+
+
 ////////////// Instructions ////////////////////////////
 
 
@@ -213,13 +334,15 @@ logArgs(A) ::= . { A = tree->newNodeList(); }
 
 logArg(A) ::= ID(B). {
    CREATE_NODE(IdNode);
-   node->init(Identifier(B->data()));
+   node->init(tree->ident(B->data()));
+   node->updateSourceInfo(B->getSourceInfo());
    A = node;
 }
 
 logArg(A) ::= LITERAL(B). {
    CREATE_NODE(LiteralNode);
    node->init(B->data());
+   node->updateSourceInfo(B->getSourceInfo());
    A = node;
 }
 
@@ -231,13 +354,17 @@ logArg(A) ::= LITERAL(B). {
 
 %type taskbody { NodeList* }
 
-task ::= TASK(Y) ID(A) LP taskargs RP AS TEMPLATE tmplargs taskbody(B) SEP(Z).
+task ::= TASK(Y) ID(A) LP taskargs(P) RP AS TEMPLATE(T) tmplargs(C) taskbody(B) SEP(Z).
 {
    CREATE_NODE(TaskNode);
-   node->init(A->data());
+   node->init(tree->ident(A->data()));
+   node->setTemplate(T->data());
+   node->params.swap(*P);
    tree->addChild(node);
 
-   assert(B);
+   // template arguments first, then the body
+   assert(B && C);
+   node->addChilds(C);
    node->addChilds(B);
 
    ADD_TOKEN(node, Y);
@@ -246,14 +373,6 @@ task ::= TASK(Y) ID(A) LP taskargs RP AS TEMPLATE tmplargs taskbody(B) SEP(Z).
    //std::cout << node->getSourceInfo() << std::endl;
    //std::cout << Z->getSourceInfo() << std::endl;
 
-
-
-/*
-   node->addArgs(Args);
-   node->addBody();
-   node->setTemplate(T->data());
-   node->setTemplateArgs(TA);
-*/
 }
 
 
@@ -278,7 +397,22 @@ bodyExprList(A) ::= bodyExprList(B) bodyExpr(C). {
 
 bodyExprList(A) ::= . { A = tree->newNodeList(); }
 
-bodyExpr(A) ::= colAssignExpr. { A = 0; }
+bodyExpr(A) ::= colAssignExpr(B). { A = B; }
+
+bodyExpr(A) ::= SECTION(B) COLON. {
+         CREATE_NODE(SectionNode);
+         node->init(B->data());
+         node->updateSourceInfo(B->getSourceInfo());
+         A = node;
+}
+
+bodyExpr(A) ::= SECTION(B) LITERAL(S) COLON. {
+         CREATE_NODE(SectionNode);
+         node->init(B->data());
+         node->m_state = S->data();
+         node->updateSourceInfo(B->getSourceInfo());
+         A = node;
+}
 
 bodyExpr(A) ::= log(C). { A = C; }
 
@@ -290,7 +424,7 @@ bodyExpr(A) ::= taskExecExpr(B). { A = B; }
 
 taskExecExpr(A) ::= EXEC(Y) TASK ID(B) callArgs(C) SEP(Z). { 
                 CREATE_NODE(TaskExecNode);
-                node->init(B->data());
+                node->init(tree->ident(B->data()));
                 node->addChilds(C);
                 ADD_TOKEN(node, Y);
                 ADD_TOKEN(node, Z);
@@ -301,28 +435,116 @@ taskExecExpr(A) ::= EXEC(Y) TASK ID(B) callArgs(C) SEP(Z). {
 
 
 
-colAssignExpr ::= COLUMN ASSIGNOP value SEP.
+%type colAssignExpr { ColAssignNode* }
+
+colAssignExpr(A) ::= COLUMN(B) ASSIGNOP value(C) SEP(Z). {
+              CREATE_NODE(ColAssignNode);
+              ColumnNode *dest = tree->newNode<ColumnNode>();
+              dest->init(B->data());
+              dest->updateSourceInfo(B->getSourceInfo());
+              node->addChild(dest);
+              node->addChild(C);
+              node->updateSourceInfo(Z->getSourceInfo());
+              A = node;
+}
+
+value(A) ::= COLUMN(B). {
+      CREATE_NODE(ColumnNode);
+      node->init(B->data());
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= RESCOLUMN(B). {
+      CREATE_NODE(ColumnNode);
+      node->init(B->data(), true);
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= STDVAL(B) value(C). {
+      CREATE_NODE(StdValueNode);
+      node->addChild(C);
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= NULL(B). {
+      CREATE_NODE(NullNode);
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= LITERAL(B). {
+      CREATE_NODE(LiteralNode);
+      node->init(B->data());
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= NUMBER(B). {
+      CREATE_NODE(NumberNode);
+      node->init(B->data());
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+value(A) ::= ID(B). {
+      CREATE_NODE(IdNode);
+      node->init(tree->ident(B->data()));
+      node->updateSourceInfo(B->getSourceInfo());
+      A = node;
+}
+
+
+%type taskargs { std::vector<Identifier>* }
+
+taskargs(A) ::= taskargs(B) ID(C) COMMA. {
+         A = B;
+         A->push_back(tree->ident(C->data()));
+}
+
+taskargs(A) ::= taskargs(B) ID(C). {
+         A = B;
+         A->push_back(tree->ident(C->data()));
+}
+
+taskargs(A) ::= . { A = tree->newIdentList(); }
+
+%type tmplargs { NodeList* }
+%type tmplargsx { NodeList* }
+
+tmplargs(A) ::= LB tmplargsx(B) RB. { A = B; }
+tmplargs(A) ::= . { A = tree->newNodeList(); }
+
+tmplargsx(A) ::= tmplargsx(B) tmplarg(C) COMMA. {
+          A = B;
+          A->push_back(C);
+}
 
-value ::= COLUMN.
-value ::= NULL.
-value ::= LITERAL.
-value ::= NUMBER.
-value ::= ID.
+tmplargsx(A) ::= tmplargsx(B) tmplarg(C). {
+          A = B;
+          A->push_back(C);
+}
 
+tmplargsx(A) ::= . { A = tree->newNodeList(); }
 
-taskargs ::= taskargs ID COMMA.
-taskargs ::= taskargs ID.
-taskargs ::= .
+/// declared objects are passed as IdNode
+tmplarg(A) ::= ID(B). {
+        CREATE_NODE(IdNode);
+        node->init(tree->ident(B->data()));
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
 
-tmplargs ::= LB tmplargsx RB.
-tmplargs ::= .
-tmplargsx ::= tmplargsx tmplarg COMMA.
-tmplargsx ::= tmplargsx tmplarg.
-tmplargsx ::= .
+tmplarg(A) ::= ID(B) LP tmplArgParams RP. {
+        CREATE_NODE(IdNode);
+        node->init(tree->ident(B->data()));
+        node->updateSourceInfo(B->getSourceInfo());
+        A = node;
+}
 
-tmplarg ::= ID.
-tmplarg ::= ID LP tmplArgParams RP.
-tmplarg ::= otype.
+tmplarg(A) ::= otype(B). { A = B; }
 
 tmplArgParams ::= tmplArgParams tmplArgParam.
 tmplArgParams ::= .
@@ -26,13 +26,38 @@
 
 
 #include "argon/dtsengine.hh"
+#include "argon/exceptions.hh"
+#include "scheduler.hh"
+#include "thread.hh"
 
 #include <iostream>
+#include <sstream>
 #include <stack>
+#include <set>
+#include <memory>
+#include <algorithm>
 
 ARGON_NAMESPACE_BEGIN
 
 
+/// Call stack of scheduler threads
+static ThreadLocal thread_stack;
+
+/// Serializes console lines of tasks running on different threads
+static Mutex console_lock;
+
+/// Store tasks with buffered rows, per thread
+static ThreadLocal thread_stores;
+
+
+/// A store with buffered rows and the depth of its outermost caller
+struct PendingStore
+{
+    StoreTask   *task;
+    size_t       depth;
+};
+
+
 //--------------------------------------------------------------------------
 /// Scoped stack-push
 ///
@@ -58,6 +83,45 @@ protected:
 
 
 
+/// Opens the first connections of a pool on a thread of its own
+class ConnectWorker : public Thread
+{
+public:
+    ConnectWorker(Connection &conn)
+        : Thread(),
+          m_conn(conn),
+          m_error()
+    {}
+
+    virtual ~ConnectWorker(void)
+    {
+        this->join();
+    }
+
+    Connection                      &m_conn;
+    std::auto_ptr<ConnectionErr>     m_error;
+
+protected:
+    virtual void run(void)
+    {
+        try
+        {
+            this->m_conn.open();
+        }
+        catch(ConnectionErr &e)
+        {
+            this->m_error.reset(new ConnectionErr(e));
+        }
+        catch(...)
+        {
+            this->m_error.reset(new ConnectionErr(this->m_conn.id(), this->m_conn.getSourceInfo(),
+                                                  "unknown error"));
+        }
+    }
+};
+
+
+
 //..............................................................................
 ///////////////////////////////////////////////////////////////// ProcTreeWalker
 
@@ -73,14 +137,11 @@ ProcTreeWalker::ProcTreeWalker(Processor &proc)
 void
 ProcTreeWalker::visit(ConnNode *node)
 {
-    Connection *elem = this->proc().toHeap( new Connection(this->proc(), node, this->m_proc.getConnections()) );
+    Connection *elem = this->proc().toHeap( new Connection(this->proc(), node, this->m_proc.getConnections(),
+                                                           this->m_proc.getFactories(),
+                                                           this->m_proc.engine().poolOptions()) );
     this->proc().addSymbol(node->id, elem);
 
-    if(! elem->getDbc().isConnected())
-    {
-        throw std::runtime_error("dbc is not connected");
-    }
-
     this->m_proc.getSymbol<Element>(node->id);
 
     //this->m_proc.getSymbol<Task>(id).exec(argumentlist);
@@ -93,7 +154,13 @@ void
 ProcTreeWalker::visit(TaskNode *node)
 {
     /// @bug is this good style?
-    Task *elem = this->proc().toHeap( new Task(this->proc(), node) );
+    Task *elem = 0;
+    if(node->tmpl == TaskNode::tmpl_transfer)
+        elem = this->proc().toHeap( new TransferTask(this->proc(), node) );
+    else if(node->tmpl == TaskNode::tmpl_store)
+        elem = this->proc().toHeap( new StoreTask(this->proc(), node) );
+    else
+        elem = this->proc().toHeap( new Task(this->proc(), node) );
     this->proc().addSymbol(node->id, elem);
 
 }
@@ -146,6 +213,7 @@ Processor::Processor(DTSEngine &engine)
       m_stack(),
       m_tree(0),
       m_symbols(),
+      m_slots(),
       m_heap()
 {}
 
@@ -159,6 +227,15 @@ Processor::getConnections(void)
 }
 
 
+/// @details
+/// 
+ConnectionFactoryMap&
+Processor::getFactories(void)
+{
+    return this->m_engine.getFactories();
+}
+
+
 /// @details
 /// 
 void
@@ -170,6 +247,95 @@ Processor::compile(ParseTree *tree)
     foreach_node(this->m_tree, PrintTreeVisitor(*this, std::wcout), 1);
 
     foreach_node( this->m_tree, ProcTreeWalker(*this), 2); // only deep 2
+
+    // all symbols are known now, lower the task bodies
+    for(Node *node = this->m_tree->firstChild(); node; node = node->nextSibling())
+    {
+        if(node->kind() == Node::kind_task)
+            this->getSymbol<Task>(static_cast<TaskNode*>(node)->id)->compile();
+    }
+
+    symbol_map::iterator i = this->m_symbols.find(this->m_engine.ident("main"));
+    Task *main = i != this->m_symbols.end() ? dynamic_cast<Task*>(this->m_slots[i->second]) : 0;
+    if(main)
+        this->openConnections(main->node());
+}
+
+
+/// Adds the connections of the objects of a task and of the tasks it
+/// calls
+static void collect_connections(Processor &proc, TaskNode *task, std::set<TaskNode*> &visited,
+                                std::vector<Connection*> &conns)
+{
+    if(! visited.insert(task).second)
+        return;
+
+    for(Node *node = task->firstChild(); node; node = node->nextSibling())
+    {
+        Node *id = node->firstChild();
+        if(node->kind() == Node::kind_object && id && id->kind() == Node::kind_id)
+        {
+            unsigned int slot = proc.resolveSymbol(static_cast<IdNode*>(id)->data(), id->getSourceInfo());
+            Connection *conn = dynamic_cast<Connection*>(proc.slot(slot));
+            if(conn && std::find(conns.begin(), conns.end(), conn) == conns.end())
+                conns.push_back(conn);
+        }
+        else if(node->kind() == Node::kind_taskexec)
+        {
+            TaskExecNode *exec = static_cast<TaskExecNode*>(node);
+            unsigned int slot = proc.resolveSymbol(exec->taskid(), node->getSourceInfo());
+            collect_connections(proc, static_cast<Task*>(proc.slot(slot))->node(), visited, conns);
+        }
+    }
+}
+
+
+/// @details
+/// Connections no reachable task uses are not opened. The others are
+/// opened at the same time, so startup takes as long as the slowest
+/// connect and not the sum of all. The first failed connection in
+/// declaration order is reported.
+void
+Processor::openConnections(TaskNode *task)
+{
+    std::set<TaskNode*> visited;
+    std::vector<Connection*> conns;
+    collect_connections(*this, task, visited, conns);
+
+    std::cout << "Opening " << conns.size() << " connections" << std::endl;
+
+    if(conns.size() == 1)
+    {
+        conns[0]->open();
+        return;
+    }
+
+    std::vector<ConnectWorker*> workers;
+    try
+    {
+        for(size_t i = 0; i < conns.size(); ++i)
+        {
+            workers.push_back(new ConnectWorker(*conns[i]));
+            workers.back()->start();
+        }
+    }
+    catch(...)
+    {
+        for(size_t i = 0; i < workers.size(); ++i)
+            delete workers[i];
+        throw;
+    }
+
+    std::auto_ptr<ConnectionErr> error;
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i]->join();
+        if(workers[i]->m_error.get() && ! error.get())
+            error = workers[i]->m_error;
+        delete workers[i];
+    }
+    if(error.get())
+        throw ConnectionErr(*error);
 }
 
 
@@ -178,22 +344,191 @@ Processor::compile(ParseTree *tree)
 Value
 Processor::call(Element *obj, const ArgumentList &args)
 {
-    ScopedStackPush _ssp(this->m_stack, obj);
-    return obj->run(args);
+    ScopedStackPush _ssp(this->stack(), obj);
+
+    // stores only buffer their row, the task inserts the rows of the
+    // stores it called when it finishes
+    if(dynamic_cast<StoreTask*>(obj))
+        return obj->run(args);
+
+    const size_t depth = this->stack().size();
+    Value v;
+    try
+    {
+        v = obj->run(args);
+    }
+    catch(...)
+    {
+        // the stores which ran would have inserted their rows already,
+        // the error of the task is the one thrown
+        this->flushStoresAfterFailure(depth);
+        throw;
+    }
+    this->flushStores(depth);
+    return v;
+}
+
+
+/// @details
+/// The store itself is on top of the stack, its caller below. A
+/// store called from several frames keeps the outermost one, so its
+/// rows stay buffered until that caller finishes.
+void
+Processor::pendingStore(StoreTask *task)
+{
+    std::vector<PendingStore> *stores = static_cast<std::vector<PendingStore>*>(thread_stores.get());
+    if(! stores)
+    {
+        stores = new std::vector<PendingStore>();
+        thread_stores.set(stores);
+    }
+
+    const size_t depth = this->stack().size() - 1;
+    for(size_t i = 0; i < stores->size(); ++i)
+    {
+        if((*stores)[i].task == task)
+        {
+            (*stores)[i].depth = std::min((*stores)[i].depth, depth);
+            return;
+        }
+    }
+    PendingStore p;
+    p.task = task;
+    p.depth = depth;
+    stores->push_back(p);
+}
+
+
+/// @details
+/// A store whose insert fails loses its rows (see StoreBuffer::flush),
+/// the other stores still insert theirs, as they would have without
+/// buffering. The first error is rethrown, the others are printed.
+void
+Processor::flushStores(size_t depth)
+{
+    std::vector<PendingStore> *stores = static_cast<std::vector<PendingStore>*>(thread_stores.get());
+    if(! stores)
+        return;
+
+    std::vector<StoreTask*> tasks;
+    for(std::vector<PendingStore>::iterator i = stores->begin(); i != stores->end(); )
+    {
+        if(i->depth >= depth)
+        {
+            tasks.push_back(i->task);
+            i = stores->erase(i);
+        }
+        else
+            ++i;
+    }
+    if(stores->empty())
+    {
+        delete stores;
+        thread_stores.set(0);
+    }
+
+    for(size_t i = 0; i < tasks.size(); ++i)
+    {
+        try
+        {
+            tasks[i]->flush();
+        }
+        catch(...)
+        {
+            for(size_t j = i + 1; j < tasks.size(); ++j)
+            {
+                try
+                {
+                    tasks[j]->flush();
+                }
+                catch(std::exception &e)
+                {
+                    this->print(String("[STORE] ") + tasks[j]->name() + String(": ") + String(e.what()));
+                }
+            }
+            throw;
+        }
+    }
 }
 
 
 /// @details
 /// 
+void
+Processor::flushStoresAfterFailure(size_t depth)
+{
+    try
+    {
+        this->flushStores(depth);
+    }
+    catch(std::exception &e)
+    {
+        this->print(String("[STORE] rows lost: ") + String(e.what()));
+    }
+    catch(...)
+    {
+        this->print(String("[STORE] rows lost"));
+    }
+}
+
+
+/// @details
+/// With more than one job, the statements of a void main task are
+/// run by the scheduler.
 void Processor::run(void)
 {
     std::cout << std::endl << "Running script.." << std::endl;
 
-    Task *task = this->getSymbol<Task>(Identifier("main"));
-    Value v = this->call(task, ArgumentList());
+    Task *task = this->getSymbol<Task>(this->m_engine.ident("main"));
+    const size_t jobs = this->m_engine.jobs();
+
+    if(jobs > 1 && task->node()->tmpl == TaskNode::tmpl_void)
+    {
+        TaskGraph graph(*this, task->node());
+        std::cout << "Scheduling " << graph.size() << " statements, "
+                  << graph.edges() << " dependencies, " << jobs << " jobs" << std::endl;
+
+        ScopedStackPush _ssp(this->stack(), task);
+        Scheduler sched(*this, graph, task, jobs);
+        sched.run();
+    }
+    else
+    {
+        Value v = this->call(task, ArgumentList());
+    }
 
     assert(this->m_stack.size() == 0);
 
+    for(size_t i = 0; i < this->m_slots.size(); ++i)
+    {
+        StoreTask *store = dynamic_cast<StoreTask*>(this->m_slots[i]);
+        if(! store || ! store->flushes())
+            continue;
+        std::wstringstream ss;
+        ss << L"[STORE] " << store->name() << L": " << store->rows() << L" rows in "
+           << store->flushes() << L" batches";
+        this->print(ss.str());
+    }
+
+    // only pools which grew, made a task wait or reused a statement
+    // are worth a line
+    for(size_t i = 0; i < this->m_slots.size(); ++i)
+    {
+        Connection *conn = dynamic_cast<Connection*>(this->m_slots[i]);
+        if(! conn)
+            continue;
+        PoolStats ps = conn->poolStats();
+        if(ps.opened < 2 && ps.waits == 0 && ps.statementHits == 0)
+            continue;
+        std::wstringstream ss;
+        ss << L"[POOL] " << conn->name() << L": " << ps.opened << L" opened, "
+           << ps.checkouts << L" checkouts, " << ps.peak << L" peak, "
+           << ps.waits << L" waits, wait " << ps.waitTime << L"s total "
+           << ps.waitMax << L"s max, statements " << ps.statementHits << L" hits "
+           << ps.statementMisses << L" misses";
+        this->print(ss.str());
+    }
+
     //this->call( this->getSymbol<Connection>(Identifier("c1")) );
 
 }
@@ -206,10 +541,23 @@ Processor::addSymbol(Identifier name, Element *symbol)
 {
     assert(name.str().length() > 0);
             
-    element_map::iterator i = this->m_symbols.find(name);
+    symbol_map::iterator i = this->m_symbols.find(name);
     if(i != this->m_symbols.end())
         throw std::runtime_error("duplicated symbol error: " + std::string(name.str()));
-    this->m_symbols[name] = symbol;
+    this->m_symbols[name] = static_cast<unsigned int>(this->m_slots.size());
+    this->m_slots.push_back(symbol);
+}
+
+
+/// @details
+/// 
+unsigned int
+Processor::resolveSymbol(Identifier name, const SourceInfo &info)
+{
+    symbol_map::iterator i = this->m_symbols.find(name);
+    if(i == this->m_symbols.end())
+        throw NotDeclared(name, info);
+    return i->second;
 }
 
 
@@ -218,7 +566,36 @@ Processor::addSymbol(Identifier name, Element *symbol)
 const Processor::stack_type&
 Processor::getStack(void)
 {
-    return this->m_stack;
+    return this->stack();
+}
+
+
+/// @details
+/// 
+Processor::stack_type&
+Processor::stack(void)
+{
+    stack_type *s = static_cast<stack_type*>(thread_stack.get());
+    return s ? *s : this->m_stack;
+}
+
+
+/// @details
+/// 
+void
+Processor::setThreadStack(stack_type *stack)
+{
+    thread_stack.set(stack);
+}
+
+
+/// @details
+/// 
+void
+Processor::print(const String &line)
+{
+    ScopedLock lock(console_lock);
+    std::wcout << line << std::endl;
 }
 
 
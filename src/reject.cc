@@ -0,0 +1,307 @@
+//
+// reject.cc - Reject sinks (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+
+/// @file
+/// @brief Reject sinks (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/transfer.hh"
+#include "thread.hh"
+
+#include <sstream>
+#include <stdexcept>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// RejectRecord
+
+/// @details
+/// 
+String
+RejectRecord::rowText(void) const
+{
+    std::wstringstream ss;
+    for(size_t i = 0; i < this->values.size(); ++i)
+    {
+        if(i)
+            ss << L", ";
+        if(this->columns && i < this->columns->size())
+            ss << (*this->columns)[i] << L"=";
+        const Value &v = this->values[i];
+        if(v.isNull() || v.isVoid())
+            ss << L"NULL";
+        else
+            ss << v.asString();
+    }
+    return ss.str();
+}
+
+
+/// Replace tabs and line breaks, a record is one line
+static String one_line(const String &str)
+{
+    String s(str);
+    for(size_t i = 0; i < s.length(); ++i)
+    {
+        if(s[i] == L'\t' || s[i] == L'\n' || s[i] == L'\r')
+            s[i] = L' ';
+    }
+    return s;
+}
+
+
+/// file:line of a record
+static String source_text(const SourceInfo &info)
+{
+    std::wstringstream ss;
+    ss << info.sourceName() << L":" << info.linenum();
+    return ss.str();
+}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////// RejectFile
+
+/// @details
+/// 
+RejectFile::RejectFile(const std::string &path, size_t batch)
+    : m_file(path.c_str(), std::ios::out | std::ios::app),
+      m_buffer(),
+      m_batch(batch ? batch : 1),
+      m_pending(0),
+      m_records(0),
+      m_lock(new Mutex())
+{
+    if(! this->m_file)
+    {
+        delete this->m_lock;
+        throw std::runtime_error("can not open reject file: " + path);
+    }
+}
+
+
+/// @details
+/// 
+RejectFile::~RejectFile(void)
+{
+    try
+    {
+        this->write();
+    }
+    catch(...)
+    {}
+    delete this->m_lock;
+}
+
+
+/// @details
+/// 
+void
+RejectFile::reject(const RejectRecord &rec)
+{
+    std::wstringstream ss;
+    ss << one_line(rec.task) << L'\t' << rec.sqlstate << L'\t' << source_text(rec.info) << L'\t'
+       << one_line(rec.error) << L'\t' << one_line(rec.rowText()) << L'\n';
+
+    ScopedLock lock(*this->m_lock);
+    this->m_buffer.append(std::string(String(ss.str())));
+    ++this->m_records;
+    if(++this->m_pending == this->m_batch)
+        this->write();
+}
+
+
+/// @details
+/// 
+void
+RejectFile::flush(void)
+{
+    ScopedLock lock(*this->m_lock);
+    this->write();
+}
+
+
+/// @details
+/// 
+size_t
+RejectFile::records(void) const
+{
+    ScopedLock lock(*this->m_lock);
+    return this->m_records;
+}
+
+
+/// @details
+/// Called with the lock held.
+void
+RejectFile::write(void)
+{
+    if(this->m_buffer.empty())
+        return;
+    this->m_file.write(this->m_buffer.data(), static_cast<std::streamsize>(this->m_buffer.size()));
+    this->m_file.flush();
+    this->m_buffer.clear();
+    this->m_pending = 0;
+    if(! this->m_file)
+        throw std::runtime_error("can not write reject file");
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// RejectTable
+
+/// Columns of a reject table
+static std::vector<String> reject_columns(void)
+{
+    static const char *names[] = { "task", "sqlstate", "source", "error", "rowdata" };
+    return std::vector<String>(names, names + 5);
+}
+
+
+/// @details
+/// 
+RejectTable::RejectTable(db::Connection &dbc, const String &table, size_t batch)
+    : m_dbc(dbc),
+      m_table(table),
+      m_batch(new RowBatch(5, batch ? batch : 1)),
+      m_records(0),
+      m_lock(new Mutex())
+{}
+
+
+/// @details
+/// The transactions on the connection have ended by now.
+RejectTable::~RejectTable(void)
+{
+    try
+    {
+        this->write();
+    }
+    catch(...)
+    {}
+    delete this->m_lock;
+}
+
+
+/// @details
+/// 
+void
+RejectTable::reject(const RejectRecord &rec)
+{
+    ScopedLock lock(*this->m_lock);
+
+    const size_t r = this->m_batch->rows();
+    this->m_batch->resize(r + 1);
+    this->m_batch->set(r, 0, Value(rec.task));
+    this->m_batch->set(r, 1, Value(rec.sqlstate));
+    this->m_batch->set(r, 2, Value(source_text(rec.info)));
+    this->m_batch->set(r, 3, Value(rec.error));
+    this->m_batch->set(r, 4, Value(rec.rowText()));
+    ++this->m_records;
+
+    if(this->m_batch->rows() < this->m_batch->capacity())
+        return;
+    if(BatchWriter::inTransaction(this->m_dbc))
+        this->grow();
+    else
+        this->write();
+}
+
+
+/// @details
+/// 
+void
+RejectTable::flush(void)
+{
+    ScopedLock lock(*this->m_lock);
+    this->write();
+}
+
+
+/// @details
+/// 
+size_t
+RejectTable::records(void) const
+{
+    ScopedLock lock(*this->m_lock);
+    return this->m_records;
+}
+
+
+/// @details
+/// Called with the lock held. The records are committed at once,
+/// never in the transaction of a writer on the same connection.
+void
+RejectTable::write(void)
+{
+    if(! this->m_batch->rows() || BatchWriter::inTransaction(this->m_dbc))
+        return;
+
+    BatchWriter writer(this->m_dbc, this->m_table, reject_columns(), 0);
+    try
+    {
+        writer.open();
+        writer.write(*this->m_batch);
+        writer.close();
+    }
+    catch(...)
+    {
+        this->m_batch->clear();
+        throw;
+    }
+    this->m_batch->clear();
+}
+
+
+/// @details
+/// Called with the lock held, doubles the capacity of the buffer.
+void
+RejectTable::grow(void)
+{
+    const RowBatch &old = *this->m_batch;
+    std::auto_ptr<RowBatch> batch(new RowBatch(old.columns(), old.capacity() * 2));
+    batch->resize(old.rows());
+    for(size_t r = 0; r < old.rows(); ++r)
+    {
+        for(size_t c = 0; c < old.columns(); ++c)
+            batch->set(r, c, old.value(r, c));
+    }
+    this->m_batch = batch;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,822 @@
+//
+// rowbatch.cc - Columnar row batch (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Columnar row batch (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/rowbatch.hh"
+
+#include <algorithm>
+#include <functional>
+
+ARGON_NAMESPACE_BEGIN
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////// ColumnVector
+
+/// @details
+/// 
+ColumnVector::ColumnVector(size_t capacity)
+    : m_capacity(capacity),
+      m_type(col_empty),
+      m_valid((capacity + word_bits - 1) / word_bits),
+      m_ints(),
+      m_scales(),
+      m_floats(),
+      m_dates(),
+      m_offsets(),
+      m_lengths(),
+      m_chars(),
+      m_values()
+{}
+
+
+/// @details
+/// 
+ColumnVector::column_type
+ColumnVector::kindOf(const Value &value)
+{
+    switch(value.type())
+    {
+    case Value::type_int:
+        return col_int;
+    case Value::type_decimal:
+        return col_decimal;
+    case Value::type_float:
+        return col_float;
+    case Value::type_date:
+        return col_date;
+    case Value::type_string:
+        return col_string;
+    default:
+        return col_value;
+    }
+}
+
+
+/// @details
+/// 
+Value::value_type
+ColumnVector::valueType(void) const
+{
+    switch(this->m_type)
+    {
+    case col_int:
+        return Value::type_int;
+    case col_decimal:
+        return Value::type_decimal;
+    case col_float:
+        return Value::type_float;
+    case col_date:
+        return Value::type_date;
+    case col_string:
+        return Value::type_string;
+    default:
+        return Value::type_void;
+    }
+}
+
+
+/// @details
+/// The arrays of other types are kept for later batches.
+void
+ColumnVector::init(column_type type)
+{
+    const size_t n = this->m_capacity;
+    this->m_type = type;
+
+    switch(type)
+    {
+    case col_decimal:
+        if(this->m_scales.size() < n)
+            this->m_scales.resize(n);
+        // fall through
+    case col_int:
+        if(this->m_ints.size() < n)
+            this->m_ints.resize(n);
+        break;
+    case col_float:
+        if(this->m_floats.size() < n)
+            this->m_floats.resize(n);
+        break;
+    case col_date:
+        if(this->m_dates.size() < n)
+            this->m_dates.resize(n);
+        break;
+    case col_string:
+        if(this->m_offsets.size() < n)
+        {
+            this->m_offsets.resize(n);
+            this->m_lengths.resize(n);
+        }
+        break;
+    case col_value:
+        if(this->m_values.size() < n)
+            this->m_values.resize(n);
+        break;
+    case col_empty:
+        break;
+    }
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::promote(void)
+{
+    if(this->m_type == col_value)
+        return;
+
+    std::vector<Value> values(this->m_capacity);
+    for(size_t r = 0; r < this->m_capacity; ++r)
+    {
+        if(! this->isNull(r))
+            values[r] = this->get(r);
+    }
+    this->m_values.swap(values);
+    this->m_type = col_value;
+    this->m_chars.clear();
+}
+
+
+/// @details
+/// 
+Value
+ColumnVector::get(size_t row) const
+{
+    if(this->isNull(row))
+        return Value::null();
+
+    switch(this->m_type)
+    {
+    case col_int:
+        return Value(this->m_ints[row]);
+    case col_decimal:
+        return Value::decimal(this->m_ints[row], this->m_scales[row]);
+    case col_float:
+        return Value(this->m_floats[row]);
+    case col_date:
+        return Value::date(this->m_dates[row]);
+    case col_string:
+        return Value(this->strData(row), this->m_lengths[row]);
+    case col_value:
+        return this->m_values[row];
+    case col_empty:
+        break;
+    }
+    return Value::null();
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::set(size_t row, const Value &value)
+{
+    switch(value.type())
+    {
+    case Value::type_void:
+    case Value::type_null:
+        this->setNull(row);
+        return;
+    case Value::type_int:
+        this->setInt(row, value.asInt());
+        return;
+    case Value::type_decimal:
+        if(this->accept(col_decimal))
+        {
+            unsigned int scale = 0;
+            this->m_ints[row] = value.asDecimal(scale);
+            this->m_scales[row] = static_cast<unsigned char>(scale);
+            this->setValid(row);
+            return;
+        }
+        break;
+    case Value::type_float:
+        this->setFloat(row, value.asDouble());
+        return;
+    case Value::type_date:
+        this->setDate(row, value.asDate());
+        return;
+    case Value::type_string:
+        this->setString(row, value.strData(), value.strLength());
+        return;
+    case Value::type_lob:
+        break;
+    }
+    this->setValue(row, value);
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setValue(size_t row, const Value &value)
+{
+    this->promote();
+    this->m_values[row] = value;
+    this->setValid(row);
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setNull(size_t row)
+{
+    this->m_valid[row / word_bits] &= ~(1UL << (row % word_bits));
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setInt(size_t row, long long v)
+{
+    if(! this->accept(col_int))
+    {
+        this->setValue(row, Value(v));
+        return;
+    }
+    this->m_ints[row] = v;
+    this->setValid(row);
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setFloat(size_t row, double v)
+{
+    if(! this->accept(col_float))
+    {
+        this->setValue(row, Value(v));
+        return;
+    }
+    this->m_floats[row] = v;
+    this->setValid(row);
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setDate(size_t row, const DateTime &dt)
+{
+    if(! this->accept(col_date))
+    {
+        this->setValue(row, Value::date(dt));
+        return;
+    }
+    this->m_dates[row] = dt;
+    this->setValid(row);
+}
+
+
+/// @details
+/// A row which is set twice leaves its first string in the arena
+/// until the next clear().
+void
+ColumnVector::setString(size_t row, const wchar_t *str, size_t len)
+{
+    if(! this->accept(col_string))
+    {
+        this->setValue(row, Value(str, len));
+        return;
+    }
+    this->m_offsets[row] = this->m_chars.size();
+    this->m_lengths[row] = len;
+    this->m_chars.insert(this->m_chars.end(), str, str + len);
+    this->setValid(row);
+}
+
+
+/// @details
+/// Generic values are dropped, so the heap blocks they share are not
+/// held by the next batch.
+void
+ColumnVector::clear(void)
+{
+    if(this->m_type == col_value)
+        std::fill(this->m_values.begin(), this->m_values.end(), Value());
+    std::fill(this->m_valid.begin(), this->m_valid.end(), 0UL);
+    this->m_chars.clear();
+    this->m_type = col_empty;
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::setValidRange(size_t rows)
+{
+    const size_t full = rows / word_bits;
+    std::fill(this->m_valid.begin(), this->m_valid.begin() + full, ~0UL);
+    if(rows % word_bits)
+        this->m_valid[full] |= (1UL << (rows % word_bits)) - 1;
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::copy(const ColumnVector &src, size_t rows)
+{
+    assert(rows <= this->m_capacity && rows <= src.m_capacity);
+
+    if(&src == this)
+        return;
+    if(this->m_type == col_value && src.m_type != col_value)
+        std::fill(this->m_values.begin(), this->m_values.end(), Value());
+    this->init(static_cast<column_type>(src.m_type));
+
+    const size_t words = (rows + word_bits - 1) / word_bits;
+    std::copy(src.m_valid.begin(), src.m_valid.begin() + words, this->m_valid.begin());
+
+    switch(src.m_type)
+    {
+    case col_decimal:
+        std::copy(src.m_scales.begin(), src.m_scales.begin() + rows, this->m_scales.begin());
+        // fall through
+    case col_int:
+        std::copy(src.m_ints.begin(), src.m_ints.begin() + rows, this->m_ints.begin());
+        break;
+    case col_float:
+        std::copy(src.m_floats.begin(), src.m_floats.begin() + rows, this->m_floats.begin());
+        break;
+    case col_date:
+        std::copy(src.m_dates.begin(), src.m_dates.begin() + rows, this->m_dates.begin());
+        break;
+    case col_string:
+        std::copy(src.m_offsets.begin(), src.m_offsets.begin() + rows, this->m_offsets.begin());
+        std::copy(src.m_lengths.begin(), src.m_lengths.begin() + rows, this->m_lengths.begin());
+        this->m_chars.assign(src.m_chars.begin(), src.m_chars.end());
+        break;
+    case col_value:
+        std::copy(src.m_values.begin(), src.m_values.begin() + rows, this->m_values.begin());
+        break;
+    case col_empty:
+        break;
+    }
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::gather(const ColumnVector &src, const size_t *sel, size_t n)
+{
+    assert(n <= this->m_capacity);
+
+    this->clear();
+    this->init(static_cast<column_type>(src.m_type));
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        const size_t r = sel[i];
+        if(src.isNull(r))
+            continue;
+        switch(src.m_type)
+        {
+        case col_decimal:
+            this->m_scales[i] = src.m_scales[r];
+            // fall through
+        case col_int:
+            this->m_ints[i] = src.m_ints[r];
+            break;
+        case col_float:
+            this->m_floats[i] = src.m_floats[r];
+            break;
+        case col_date:
+            this->m_dates[i] = src.m_dates[r];
+            break;
+        case col_string:
+            this->m_offsets[i] = this->m_chars.size();
+            this->m_lengths[i] = src.m_lengths[r];
+            this->m_chars.insert(this->m_chars.end(), src.strData(r), src.strData(r) + src.m_lengths[r]);
+            break;
+        case col_value:
+            this->m_values[i] = src.m_values[r];
+            break;
+        case col_empty:
+            break;
+        }
+        this->setValid(i);
+    }
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::fill(const Value &value, size_t rows)
+{
+    assert(rows <= this->m_capacity);
+
+    this->clear();
+    if(value.isNull() || value.isVoid())
+        return;
+
+    this->init(kindOf(value));
+    switch(this->m_type)
+    {
+    case col_int:
+        std::fill(this->m_ints.begin(), this->m_ints.begin() + rows, value.asInt());
+        break;
+    case col_decimal:
+    {
+        unsigned int scale = 0;
+        std::fill(this->m_ints.begin(), this->m_ints.begin() + rows, value.asDecimal(scale));
+        std::fill(this->m_scales.begin(), this->m_scales.begin() + rows,
+                  static_cast<unsigned char>(scale));
+        break;
+    }
+    case col_float:
+        std::fill(this->m_floats.begin(), this->m_floats.begin() + rows, value.asDouble());
+        break;
+    case col_date:
+        std::fill(this->m_dates.begin(), this->m_dates.begin() + rows, value.asDate());
+        break;
+    case col_string:
+        this->m_chars.assign(value.strData(), value.strData() + value.strLength());
+        std::fill(this->m_offsets.begin(), this->m_offsets.begin() + rows, size_t(0));
+        std::fill(this->m_lengths.begin(), this->m_lengths.begin() + rows, value.strLength());
+        break;
+    case col_value:
+        std::fill(this->m_values.begin(), this->m_values.begin() + rows, value);
+        break;
+    case col_empty:
+        break;
+    }
+    this->setValidRange(rows);
+}
+
+
+/// @details
+/// 
+void
+ColumnVector::fillNull(size_t rows)
+{
+    assert(rows <= this->m_capacity);
+    this->clear();
+}
+
+
+
+/// @details
+/// A value of another type than the column makes the column generic,
+/// the string of a string column is stored once.
+void
+ColumnVector::fillNulls(const Value &value, size_t rows)
+{
+    assert(rows <= this->m_capacity);
+
+    if(value.isNull() || value.isVoid())
+        return;
+    if(this->m_type == col_empty)
+    {
+        this->fill(value, rows);
+        return;
+    }
+    if(this->m_type != kindOf(value))
+        this->promote();
+
+    unsigned int scale = 0;
+    const long long unscaled = this->m_type == col_decimal ? value.asDecimal(scale) : 0;
+    size_t offset = 0;
+    bool stored = false;
+
+    const size_t words = (rows + word_bits - 1) / word_bits;
+    for(size_t w = 0; w < words; ++w)
+    {
+        const unsigned long nulls = ~this->m_valid[w];
+        if(! nulls)
+            continue;
+
+        const size_t end = std::min(rows, (w + 1) * word_bits);
+        for(size_t r = w * word_bits; r < end; ++r)
+        {
+            if(! (nulls & (1UL << (r % word_bits))))
+                continue;
+            switch(this->m_type)
+            {
+            case col_int:
+                this->m_ints[r] = value.asInt();
+                break;
+            case col_decimal:
+                this->m_ints[r] = unscaled;
+                this->m_scales[r] = static_cast<unsigned char>(scale);
+                break;
+            case col_float:
+                this->m_floats[r] = value.asDouble();
+                break;
+            case col_date:
+                this->m_dates[r] = value.asDate();
+                break;
+            case col_string:
+                if(! stored)
+                {
+                    offset = this->m_chars.size();
+                    this->m_chars.insert(this->m_chars.end(), value.strData(),
+                                         value.strData() + value.strLength());
+                    stored = true;
+                }
+                this->m_offsets[r] = offset;
+                this->m_lengths[r] = value.strLength();
+                break;
+            case col_value:
+                this->m_values[r] = value;
+                break;
+            case col_empty:
+                break;
+            }
+            this->setValid(r);
+        }
+    }
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////// Conversion kernels
+
+/// Powers of ten for decimal scales, as in value.cc
+static const long long pow10_table[Value::max_scale + 1] =
+{
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL,
+    1000000000000LL, 10000000000000LL, 100000000000000LL,
+    1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL
+};
+
+
+/// Write the digits of @a v backwards from @a end, returns the first
+/// character. At least @a width digits are written.
+static wchar_t* format_digits(unsigned long long v, wchar_t *end, size_t width = 1)
+{
+    wchar_t *p = end;
+    do
+    {
+        *--p = static_cast<wchar_t>(L'0' + v % 10);
+        v /= 10;
+    }
+    while(v || static_cast<size_t>(end - p) < width);
+    return p;
+}
+
+
+/// Magnitude of @a v, also for the smallest integer
+static inline unsigned long long magnitude(long long v)
+{
+    return v < 0 ? 0ULL - static_cast<unsigned long long>(v) : static_cast<unsigned long long>(v);
+}
+
+
+/// Converts a non-NULL cell, specialized per type pair. The result
+/// matches the conversion of a Value (asDouble(), asDecimal(),
+/// asString()).
+template<int From, int To>
+struct ConvertCell;
+
+
+template<>
+struct ConvertCell<ColumnVector::col_int, ColumnVector::col_float>
+{
+    static inline void convert(const ColumnVector &src, size_t s, ColumnVector &dest, size_t d)
+    {
+        dest.m_floats[d] = static_cast<double>(src.m_ints[s]);
+    }
+};
+
+
+template<>
+struct ConvertCell<ColumnVector::col_int, ColumnVector::col_decimal>
+{
+    static inline void convert(const ColumnVector &src, size_t s, ColumnVector &dest, size_t d)
+    {
+        dest.m_ints[d] = src.m_ints[s];
+        dest.m_scales[d] = 0;
+    }
+};
+
+
+template<>
+struct ConvertCell<ColumnVector::col_int, ColumnVector::col_string>
+{
+    static inline void convert(const ColumnVector &src, size_t s, ColumnVector &dest, size_t d)
+    {
+        wchar_t buf[24];
+        wchar_t *end = buf + sizeof(buf) / sizeof(wchar_t);
+        const long long v = src.m_ints[s];
+        wchar_t *p = format_digits(magnitude(v), end);
+        if(v < 0)
+            *--p = L'-';
+        dest.m_offsets[d] = dest.m_chars.size();
+        dest.m_lengths[d] = end - p;
+        dest.m_chars.insert(dest.m_chars.end(), p, end);
+    }
+};
+
+
+template<>
+struct ConvertCell<ColumnVector::col_decimal, ColumnVector::col_float>
+{
+    static inline void convert(const ColumnVector &src, size_t s, ColumnVector &dest, size_t d)
+    {
+        dest.m_floats[d] = static_cast<double>(src.m_ints[s])
+            / static_cast<double>(pow10_table[src.m_scales[s]]);
+    }
+};
+
+
+template<>
+struct ConvertCell<ColumnVector::col_decimal, ColumnVector::col_string>
+{
+    static inline void convert(const ColumnVector &src, size_t s, ColumnVector &dest, size_t d)
+    {
+        wchar_t buf[48];
+        wchar_t *end = buf + sizeof(buf) / sizeof(wchar_t);
+        const long long v = src.m_ints[s];
+        const unsigned int scale = src.m_scales[s];
+        const unsigned long long m = magnitude(v);
+        const unsigned long long p10 = static_cast<unsigned long long>(pow10_table[scale]);
+        wchar_t *p = end;
+        if(scale)
+        {
+            p = format_digits(m % p10, p, scale);
+            *--p = L'.';
+        }
+        p = format_digits(m / p10, p);
+        if(v < 0)
+            *--p = L'-';
+        dest.m_offsets[d] = dest.m_chars.size();
+        dest.m_lengths[d] = end - p;
+        dest.m_chars.insert(dest.m_chars.end(), p, end);
+    }
+};
+
+
+/// Converts a whole column with the cells of the type pair. A column
+/// whose values are not of type From (the fetched values do not have
+/// the declared type) is copied as it is.
+template<int From, int To>
+struct ConvertColumn
+{
+    static void run(const ColumnVector &src, ColumnVector &dest, const size_t *sel, size_t n)
+    {
+        assert(n <= dest.m_capacity);
+
+        if(src.m_type != From)
+        {
+            if(sel)
+                dest.gather(src, sel, n);
+            else
+                dest.copy(src, n);
+            return;
+        }
+
+        dest.clear();
+        dest.init(static_cast<ColumnVector::column_type>(To));
+        for(size_t i = 0; i < n; ++i)
+        {
+            const size_t r = sel ? sel[i] : i;
+            if(src.isNull(r))
+                continue;
+            ConvertCell<From, To>::convert(src, r, dest, i);
+            dest.setValid(i);
+        }
+    }
+};
+
+
+/// Kernel of a type pair
+struct KernelEntry
+{
+    Value::value_type      from;
+    Value::value_type      to;
+    ColumnVector::Kernel   kernel;
+};
+
+
+/// Type pairs with a kernel, constant-initialized
+static const KernelEntry kernel_table[] =
+{
+    { Value::type_int,     Value::type_float,    &ConvertColumn<ColumnVector::col_int, ColumnVector::col_float>::run },
+    { Value::type_int,     Value::type_decimal,  &ConvertColumn<ColumnVector::col_int, ColumnVector::col_decimal>::run },
+    { Value::type_int,     Value::type_string,   &ConvertColumn<ColumnVector::col_int, ColumnVector::col_string>::run },
+    { Value::type_decimal, Value::type_float,    &ConvertColumn<ColumnVector::col_decimal, ColumnVector::col_float>::run },
+    { Value::type_decimal, Value::type_string,   &ConvertColumn<ColumnVector::col_decimal, ColumnVector::col_string>::run }
+};
+
+
+/// @details
+/// Only pairs without loss or a format of the database's own are
+/// converted here, the others (e.g. float to string) are left to the
+/// driver. Equal types need no kernel.
+ColumnVector::Kernel
+ColumnVector::kernel(Value::value_type from, Value::value_type to)
+{
+    for(size_t i = 0; i < sizeof(kernel_table) / sizeof(kernel_table[0]); ++i)
+    {
+        if(kernel_table[i].from == from && kernel_table[i].to == to)
+            return kernel_table[i].kernel;
+    }
+    return 0;
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// RowBatch
+
+/// @details
+/// 
+RowBatch::RowBatch(size_t columns, size_t capacity)
+    : m_columns(columns),
+      m_capacity(capacity),
+      m_rows(0),
+      m_cols(columns, ColumnVector(capacity)),
+      m_selection(),
+      m_selective(false)
+{}
+
+
+/// @details
+/// 
+void
+RowBatch::resize(size_t rows)
+{
+    assert(rows <= this->m_capacity);
+    this->m_rows = rows;
+}
+
+
+/// @details
+/// 
+void
+RowBatch::clear(void)
+{
+    for(size_t c = 0; c < this->m_columns; ++c)
+        this->m_cols[c].clear();
+    this->m_rows = 0;
+    this->selectAll();
+}
+
+
+/// @details
+/// 
+void
+RowBatch::select(const std::vector<size_t> &sel)
+{
+    assert(std::find_if(sel.begin(), sel.end(),
+                        std::bind2nd(std::greater_equal<size_t>(), this->m_rows)) == sel.end());
+    this->m_selection = sel;
+    this->m_selective = true;
+}
+
+
+/// @details
+/// 
+void
+RowBatch::selectAll(void)
+{
+    this->m_selection.clear();
+    this->m_selective = false;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,537 @@
+//
+// scheduler.cc - Task dependency graph and scheduler (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Task dependency graph and scheduler (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "scheduler.hh"
+#include "connpool.hh"
+#include "argon/exceptions.hh"
+
+#include <sstream>
+#include <stdexcept>
+#include <memory>
+#include <new>
+#include <algorithm>
+#include <cwctype>
+#include <cassert>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// AccessSet
+
+/// Object names are compared case-insensitive, like SQL does for
+/// unquoted names
+static String object_name(const String &name)
+{
+    std::wstringstream ss;
+    ss << name;
+    std::wstring s = ss.str();
+    for(size_t i = 0; i < s.size(); ++i)
+        s[i] = static_cast<wchar_t>(std::towlower(s[i]));
+    return s;
+}
+
+
+/// True if an object of @a a is in @a b, "*" matches all objects of
+/// the connection
+static bool intersects(const AccessSet::object_set &a, const AccessSet::object_set &b)
+{
+    for(AccessSet::object_set::const_iterator i = a.begin(); i != a.end(); ++i)
+    {
+        if(b.count(*i) || b.count(AccessSet::object_key(i->first, String("*"))))
+            return true;
+        if(i->second == String("*"))
+        {
+            for(AccessSet::object_set::const_iterator j = b.begin(); j != b.end(); ++j)
+            {
+                if(j->first == i->first)
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/// @details
+/// 
+void
+AccessSet::merge(const AccessSet &set)
+{
+    this->conns.insert(set.conns.begin(), set.conns.end());
+    this->reads.insert(set.reads.begin(), set.reads.end());
+    this->writes.insert(set.writes.begin(), set.writes.end());
+    this->console = this->console || set.console;
+    this->all = this->all || set.all;
+}
+
+
+/// @details
+/// 
+bool
+AccessSet::conflicts(const AccessSet &set) const
+{
+    if(this->all || set.all)
+        return true;
+    if(this->console && set.console)
+        return true;
+    for(std::set<unsigned int>::const_iterator i = this->conns.begin(); i != this->conns.end(); ++i)
+    {
+        if(set.conns.count(*i))
+            return true;
+    }
+    return intersects(this->writes, set.writes)
+        || intersects(this->writes, set.reads)
+        || intersects(this->reads, set.writes);
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// TaskGraph
+
+/// @details
+/// Each statement of the body becomes a step, token nodes are
+/// skipped. The body was compiled before, so all references are
+/// known.
+TaskGraph::TaskGraph(Processor &proc, TaskNode *body)
+    : m_proc(proc),
+      m_steps(),
+      m_edges(0)
+{
+    for(Node *node = body->firstChild(); node; node = node->nextSibling())
+    {
+        if(node->kind() != Node::kind_log && node->kind() != Node::kind_taskexec)
+            continue;
+
+        Step step;
+        step.join = node->kind() == Node::kind_log;
+        task_set visited;
+        visited.insert(body);
+        this->collectStatement(node, step.access, visited);
+        step.code.compileStatement(proc, node, CodeScope(body));
+        step.code.finish();
+        this->m_steps.push_back(step);
+    }
+
+    for(size_t j = 0; j < this->m_steps.size(); ++j)
+    {
+        for(size_t i = 0; i < j; ++i)
+        {
+            if(this->m_steps[j].join || this->m_steps[i].access.conflicts(this->m_steps[j].access))
+            {
+                this->m_steps[i].succ.push_back(j);
+                ++this->m_steps[j].preds;
+                ++this->m_edges;
+            }
+        }
+    }
+}
+
+
+/// @details
+/// Transfer tasks write the first object and read the second one.
+/// Objects of other templates are taken as written.
+void
+TaskGraph::collect(TaskNode *task, AccessSet &set, task_set &visited)
+{
+    if(! visited.insert(task).second)
+        return;
+
+    int objects = 0;
+    for(Node *node = task->firstChild(); node; node = node->nextSibling())
+    {
+        switch(node->kind())
+        {
+        case Node::kind_object:
+            this->collectObject(static_cast<ObjectNode*>(node),
+                                task->tmpl != TaskNode::tmpl_transfer || objects == 0, set);
+            ++objects;
+            break;
+        case Node::kind_id:
+            set.all = true;
+            break;
+        default:
+            this->collectStatement(node, set, visited);
+            break;
+        }
+    }
+}
+
+
+/// @details
+/// 
+void
+TaskGraph::collectStatement(Node *node, AccessSet &set, task_set &visited)
+{
+    switch(node->kind())
+    {
+    case Node::kind_log:
+        set.console = true;
+        break;
+    case Node::kind_taskexec:
+    {
+        TaskExecNode *exec = static_cast<TaskExecNode*>(node);
+        Task *task = static_cast<Task*>(this->m_proc.slot(this->m_proc.resolveSymbol(exec->taskid(),
+                                                                                     node->getSourceInfo())));
+        this->collect(task->node(), set, visited);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+
+/// @details
+/// 
+void
+TaskGraph::collectObject(ObjectNode *node, bool write, AccessSet &set)
+{
+    Node *conn = node->firstChild();
+    Node *name = conn ? conn->nextSibling() : 0;
+    if(! conn || conn->kind() != Node::kind_id || ! name || name->kind() != Node::kind_literal)
+    {
+        set.all = true;
+        return;
+    }
+
+    unsigned int slot = this->m_proc.resolveSymbol(static_cast<IdNode*>(conn)->data(), conn->getSourceInfo());
+    AccessSet::object_key key(slot, node->m_type == ObjectNode::obj_sql
+                              ? String("*")
+                              : object_name(static_cast<LiteralNode*>(name)->m_data));
+
+    // tasks get their own connection from a pool which can open more
+    // than one
+    Connection *elem = dynamic_cast<Connection*>(this->m_proc.slot(slot));
+    if(! elem || elem->pool().maxSize() < 2)
+        set.conns.insert(slot);
+    if(write)
+        set.writes.insert(key);
+    else
+        set.reads.insert(key);
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// StepError
+
+/// Copy of an exception of type E
+template<typename E>
+class StepErrorCopy : public StepError
+{
+public:
+    explicit StepErrorCopy(const E &e)
+        : m_error(e)
+    {}
+
+    virtual void raise(void) const
+    {
+        throw this->m_error;
+    }
+
+protected:
+    E    m_error;
+};
+
+
+/// Clone of an exception of the engine, which keeps its dynamic type
+class StepErrorClone : public StepError
+{
+public:
+    explicit StepErrorClone(const Exception &e)
+        : m_error(e.clone())
+    {}
+
+    virtual void raise(void) const
+    {
+        this->m_error->raise();
+    }
+
+protected:
+    std::auto_ptr<Exception>   m_error;
+};
+
+
+/// @details
+/// Driver errors keep their type as far as argon knows it, other
+/// std::exceptions become a std::runtime_error with their message.
+StepError*
+StepError::capture(void)
+{
+    try
+    {
+        throw;
+    }
+    catch(Exception &e)
+    {
+        return new StepErrorClone(e);
+    }
+    catch(db::SqlstateException &e)
+    {
+        return new StepErrorCopy<db::SqlstateException>(e);
+    }
+    catch(db::Exception &e)
+    {
+        return new StepErrorCopy<db::Exception>(e);
+    }
+    catch(std::bad_alloc &e)
+    {
+        return new StepErrorCopy<std::bad_alloc>(e);
+    }
+    catch(std::exception &e)
+    {
+        return new StepErrorCopy<std::runtime_error>(std::runtime_error(e.what()));
+    }
+    catch(...)
+    {
+        return new StepErrorCopy<std::runtime_error>(std::runtime_error("unknown error in scheduled task"));
+    }
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// Scheduler
+
+/// Pool thread
+class SchedulerWorker : public Thread
+{
+public:
+    SchedulerWorker(Scheduler &sched, size_t index)
+        : Thread(),
+          m_sched(sched),
+          m_index(index)
+    {}
+
+protected:
+    virtual void run(void)
+    {
+        this->m_sched.work(this->m_index);
+    }
+
+    Scheduler   &m_sched;
+    size_t       m_index;
+};
+
+
+/// @details
+/// 
+Scheduler::Scheduler(Processor &proc, const TaskGraph &graph, Element *caller, size_t jobs)
+    : m_proc(proc),
+      m_graph(graph),
+      m_caller(caller),
+      m_queues(),
+      m_pending(graph.size()),
+      m_done(0),
+      m_steals(0),
+      m_failed(0),
+      m_error(0)
+{
+    const size_t workers = std::max<size_t>(std::min(jobs, graph.size()), 1);
+    for(size_t i = 0; i < workers; ++i)
+    {
+        this->m_queues.push_back(0);
+        this->m_queues.back() = new WorkQueue();
+    }
+
+    // spread the initially ready steps over the workers
+    size_t next = 0;
+    for(size_t i = 0; i < graph.size(); ++i)
+    {
+        this->m_pending[i] = static_cast<atomic_word>(graph.step(i).preds);
+        if(graph.step(i).preds == 0)
+            this->m_queues[next++ % workers]->steps.push_back(i);
+    }
+}
+
+
+/// @details
+/// 
+Scheduler::~Scheduler(void)
+{
+    for(size_t i = 0; i < this->m_queues.size(); ++i)
+        delete this->m_queues[i];
+    delete this->m_error;
+}
+
+
+/// @details
+/// 
+void
+Scheduler::run(void)
+{
+    std::vector<SchedulerWorker*> workers;
+
+    try
+    {
+        for(size_t i = 1; i < this->m_queues.size(); ++i)
+        {
+            workers.push_back(0);
+            workers.back() = new SchedulerWorker(*this, i);
+            workers.back()->start();
+        }
+    }
+    catch(...)
+    {
+        this->fail(StepError::capture());
+    }
+
+    this->work(0);
+
+    for(size_t i = 0; i < workers.size(); ++i)
+    {
+        if(workers[i])
+            workers[i]->join();
+        delete workers[i];
+    }
+
+    if(this->m_failed)
+        this->m_error->raise();
+}
+
+
+/// @details
+/// Worker 0 is the calling thread and uses the main call stack.
+void
+Scheduler::work(size_t worker)
+{
+    Processor::stack_type stack;
+    if(worker > 0)
+    {
+        stack.push_front(this->m_caller);
+        this->m_proc.setThreadStack(&stack);
+    }
+
+    const atomic_word total = static_cast<atomic_word>(this->m_graph.size());
+    unsigned int round = 0;
+
+    while(! atomic_load(&this->m_failed) && atomic_load(&this->m_done) < total)
+    {
+        size_t i;
+        if(! this->take(worker, i))
+        {
+            thread_pause(round);
+            continue;
+        }
+        round = 0;
+
+        try
+        {
+            Interpreter vm(this->m_proc);
+            vm.exec(this->m_graph.step(i).code);
+            this->m_proc.flushStores();
+        }
+        catch(...)
+        {
+            StepError *error = StepError::capture();
+            this->m_proc.flushStoresAfterFailure(0);
+            this->fail(error);
+            break;
+        }
+
+        const std::vector<size_t> &succ = this->m_graph.step(i).succ;
+        for(size_t s = 0; s < succ.size(); ++s)
+        {
+            if(atomic_decrement(&this->m_pending[succ[s]]) == 0)
+                this->push(worker, succ[s]);
+        }
+        atomic_increment(&this->m_done);
+    }
+
+    if(worker > 0)
+        this->m_proc.setThreadStack(0);
+}
+
+
+/// @details
+/// 
+void
+Scheduler::push(size_t worker, size_t step)
+{
+    WorkQueue &q = *this->m_queues[worker];
+    ScopedLock lock(q.lock);
+    q.steps.push_back(step);
+}
+
+
+/// @details
+/// 
+bool
+Scheduler::take(size_t worker, size_t &step)
+{
+    {
+        WorkQueue &q = *this->m_queues[worker];
+        ScopedLock lock(q.lock);
+        if(! q.steps.empty())
+        {
+            step = q.steps.back();
+            q.steps.pop_back();
+            return true;
+        }
+    }
+
+    const size_t n = this->m_queues.size();
+    for(size_t k = 1; k < n; ++k)
+    {
+        WorkQueue &q = *this->m_queues[(worker + k) % n];
+        ScopedLock lock(q.lock);
+        if(! q.steps.empty())
+        {
+            step = q.steps.front();
+            q.steps.pop_front();
+            atomic_increment(&this->m_steals);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/// @details
+/// Takes @a error, the errors after the first are dropped.
+void
+Scheduler::fail(StepError *error)
+{
+    if(atomic_cas(&this->m_failed, 0, 1))
+        this->m_error = error;
+    else
+        delete error;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
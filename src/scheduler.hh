@@ -0,0 +1,248 @@
+//
+// scheduler.hh - Task dependency graph and scheduler
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Task dependency graph and scheduler
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_SCHEDULER_HH
+#define INFORMAVE_ARGON_SCHEDULER_HH
+
+#include "argon/dtsengine.hh"
+#include "thread.hh"
+
+#include <vector>
+#include <deque>
+#include <set>
+#include <utility>
+
+ARGON_NAMESPACE_BEGIN
+
+
+//--------------------------------------------------------------------------
+/// Data accessed by a statement
+///
+/// Objects are identified by connection slot and table name. An sql()
+/// source may read any object of its connection ("*"). Declared
+/// objects can not be resolved statically and conflict with
+/// everything.
+///
+/// @since 0.0.1
+/// @brief Data accessed by a statement
+struct AccessSet
+{
+    typedef std::pair<unsigned int, String>  object_key;
+    typedef std::set<object_key>             object_set;
+
+    AccessSet(void)
+        : conns(),
+          reads(),
+          writes(),
+          console(false),
+          all(false)
+    {}
+
+    /// @brief Add the accesses of another set
+    void merge(const AccessSet &set);
+
+    /// @brief True if the statements must keep their order
+    bool conflicts(const AccessSet &set) const;
+
+    std::set<unsigned int>   conns;     ///< single-connection pools used
+    object_set               reads;
+    object_set               writes;
+    bool                     console;   ///< writes log lines
+    bool                     all;       ///< unknown accesses
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Task dependency graph
+///
+/// Static analysis of the statements of a task body. The accesses of
+/// an exec task statement are those of the called task and all tasks
+/// it calls. A statement depends on every earlier statement it
+/// conflicts with:
+///  - both write an object, or one writes what the other reads
+///  - both use the same connection and its pool has only one
+///    connection (a handle can only be used by one thread at a time)
+///  - both write log lines, which keeps the log in program order
+///
+/// A log statement of the body also waits for all earlier statements,
+/// so a message like "copy done" is written after the copy.
+///
+/// @since 0.0.1
+/// @brief Task dependency graph
+class TaskGraph
+{
+public:
+    struct Step
+    {
+        Step(void)
+            : code(),
+              access(),
+              succ(),
+              preds(0),
+              join(false)
+        {}
+
+        Code                  code;      ///< the statement
+        AccessSet             access;
+        std::vector<size_t>   succ;      ///< steps depending on this one
+        size_t                preds;     ///< number of steps this one depends on
+        bool                  join;      ///< depends on all earlier steps
+    };
+
+    /// @brief Analyse the statements of a task body
+    TaskGraph(Processor &proc, TaskNode *body);
+
+    inline size_t size(void) const
+    {
+        return this->m_steps.size();
+    }
+
+    inline const Step& step(size_t i) const
+    {
+        return this->m_steps[i];
+    }
+
+    /// @brief Number of dependencies
+    inline size_t edges(void) const
+    {
+        return this->m_edges;
+    }
+
+protected:
+    typedef std::set<TaskNode*> task_set;
+
+    void collect(TaskNode *task, AccessSet &set, task_set &visited);
+
+    void collectStatement(Node *node, AccessSet &set, task_set &visited);
+
+    void collectObject(ObjectNode *node, bool write, AccessSet &set);
+
+    Processor            &m_proc;
+    std::vector<Step>     m_steps;
+    size_t                m_edges;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Error of a scheduled step
+///
+/// Keeps a copy of the exception a worker caught, so the thread of
+/// the scheduler can throw it again with its type.
+///
+/// @since 0.0.1
+/// @brief Error of a scheduled step
+class StepError
+{
+public:
+    virtual ~StepError(void)
+    {}
+
+    /// @brief Throw the exception
+    virtual void raise(void) const = 0;
+
+    /// @brief Copy the exception being handled, call from a catch block
+    static StepError* capture(void);
+};
+
+
+//--------------------------------------------------------------------------
+/// Task scheduler
+///
+/// Runs the steps of a TaskGraph on a work-stealing thread pool. A
+/// step becomes ready when all steps it depends on are done. Each
+/// worker keeps its own queue of ready steps: it runs the newest step
+/// of its own queue and steals the oldest step of another queue if
+/// its own queue is empty. The calling thread is the first worker.
+///
+/// The first failing step stops the scheduling of new steps, run()
+/// rethrows its error with its type after the running steps are
+/// done.
+///
+/// @since 0.0.1
+/// @brief Task scheduler
+class Scheduler
+{
+public:
+    /// @param caller Element pushed on the call stack of each worker
+    Scheduler(Processor &proc, const TaskGraph &graph, Element *caller, size_t jobs);
+
+    ~Scheduler(void);
+
+    /// @brief Run all steps
+    void run(void);
+
+    /// @brief Worker loop
+    void work(size_t worker);
+
+    /// @brief Steps taken from the queue of another worker
+    inline size_t steals(void) const
+    {
+        return static_cast<size_t>(this->m_steals);
+    }
+
+protected:
+    struct WorkQueue
+    {
+        Mutex                 lock;
+        std::deque<size_t>    steps;
+    };
+
+    void push(size_t worker, size_t step);
+
+    bool take(size_t worker, size_t &step);
+
+    void fail(StepError *error);
+
+    Processor                   &m_proc;
+    const TaskGraph             &m_graph;
+    Element                     *m_caller;
+    std::vector<WorkQueue*>      m_queues;
+    std::vector<atomic_word>     m_pending;   ///< unfinished predecessors per step
+    volatile atomic_word         m_done;
+    volatile atomic_word         m_steals;
+    volatile atomic_word         m_failed;
+    StepError                   *m_error;     ///< error of the first failing step
+
+private:
+    Scheduler(const Scheduler&);
+    Scheduler& operator=(const Scheduler&);
+};
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,235 @@
+//
+// stmtcache.cc - Prepared statement cache (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Prepared statement cache (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "stmtcache.hh"
+
+#include <memory>
+#include <sstream>
+#include <cwctype>
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// @details
+/// Quoted literals and identifiers are kept as they are.
+String
+normalize_sql(const String &sql)
+{
+    std::wstringstream ss;
+    ss << sql;
+    const std::wstring in = ss.str();
+
+    std::wstring out;
+    out.reserve(in.size());
+    wchar_t quote = 0;
+    bool blank = false;
+    for(size_t i = 0; i < in.size(); ++i)
+    {
+        wchar_t c = in[i];
+        if(quote)
+        {
+            if(c == quote)
+                quote = 0;
+        }
+        else if(std::iswspace(c))
+        {
+            blank = true;
+            continue;
+        }
+        else if(c == L'\'' || c == L'"')
+            quote = c;
+
+        if(blank && ! out.empty())
+            out += L' ';
+        blank = false;
+        out += c;
+    }
+    return out;
+}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////// StatementCache
+
+/// @details
+/// 
+StatementCache::StatementCache(size_t capacity)
+    : m_capacity(capacity),
+      m_mutex(),
+      m_entries(),
+      m_keys(),
+      m_stmts(),
+      m_hits(0),
+      m_misses(0)
+{}
+
+
+/// @details
+/// All statements must be released before.
+StatementCache::~StatementCache(void)
+{
+    for(entry_list::iterator i = this->m_entries.begin(); i != this->m_entries.end(); ++i)
+        delete i->stmt;
+}
+
+
+/// @details
+/// The statement is prepared without holding the lock, the
+/// connection is only used by the calling thread.
+db::Statement*
+StatementCache::acquire(db::Connection &dbc, const String &sql)
+{
+    key_type key(&dbc, normalize_sql(sql));
+    {
+        ScopedLock lock(this->m_mutex);
+        key_map::iterator k = this->m_keys.find(key);
+        if(k != this->m_keys.end() && ! k->second->busy)
+        {
+            ++this->m_hits;
+            k->second->busy = true;
+            this->m_entries.splice(this->m_entries.begin(), this->m_entries, k->second);
+            return k->second->stmt;
+        }
+        ++this->m_misses;
+    }
+
+    std::auto_ptr<db::Statement> stmt(dbc.newStatement());
+    stmt->prepare(sql);
+
+    ScopedLock lock(this->m_mutex);
+    Entry entry = { key, stmt.get(), true, false };
+    this->m_entries.push_front(entry);
+    this->m_stmts[stmt.get()] = this->m_entries.begin();
+    if(this->m_capacity && ! this->m_keys.count(key))
+        this->m_keys[key] = this->m_entries.begin();
+    else
+        this->m_entries.front().stale = true;
+    this->evict();
+    return stmt.release();
+}
+
+
+/// @details
+/// 
+void
+StatementCache::release(db::Statement *stmt)
+{
+    ScopedLock lock(this->m_mutex);
+    stmt_map::iterator s = this->m_stmts.find(stmt);
+    if(s == this->m_stmts.end())
+        return;
+    s->second->busy = false;
+    if(s->second->stale)
+        this->erase(s->second);
+    else
+        this->evict();
+}
+
+
+/// @details
+/// 
+void
+StatementCache::invalidate(db::Connection *dbc)
+{
+    ScopedLock lock(this->m_mutex);
+    entry_list::iterator i = this->m_entries.begin();
+    while(i != this->m_entries.end())
+    {
+        entry_list::iterator e = i++;
+        if(e->key.first != dbc)
+            continue;
+        if(e->busy)
+        {
+            if(! e->stale)
+                this->m_keys.erase(e->key);
+            e->stale = true;
+        }
+        else
+            this->erase(e);
+    }
+}
+
+
+/// @details
+/// Called with the lock held.
+void
+StatementCache::evict(void)
+{
+    entry_list::iterator i = this->m_entries.end();
+    while(this->m_keys.size() > this->m_capacity && i != this->m_entries.begin())
+    {
+        --i;
+        if(! i->busy && ! i->stale)
+            this->erase(i++);
+    }
+}
+
+
+/// @details
+/// Called with the lock held.
+void
+StatementCache::erase(entry_list::iterator i)
+{
+    if(! i->stale)
+        this->m_keys.erase(i->key);
+    this->m_stmts.erase(i->stmt);
+    delete i->stmt;
+    this->m_entries.erase(i);
+}
+
+
+/// @details
+/// 
+size_t
+StatementCache::hits(void)
+{
+    ScopedLock lock(this->m_mutex);
+    return this->m_hits;
+}
+
+
+/// @details
+/// 
+size_t
+StatementCache::misses(void)
+{
+    ScopedLock lock(this->m_mutex);
+    return this->m_misses;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,130 @@
+//
+// stmtcache.hh - Prepared statement cache
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Prepared statement cache
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_STMTCACHE_HH
+#define INFORMAVE_ARGON_STMTCACHE_HH
+
+#include "argon/fwd.hh"
+#include "thread.hh"
+
+#include <list>
+#include <map>
+#include <utility>
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// @brief SQL text with runs of whitespace outside of quotes
+/// collapsed to one blank and no leading or trailing whitespace
+String normalize_sql(const String &sql);
+
+
+
+//--------------------------------------------------------------------------
+/// Prepared statement cache
+///
+/// Keeps the least recently used statements prepared, keyed by
+/// connection handle and normalized SQL text. A statement is used by
+/// one caller at a time. If the statement for a key is in use, the
+/// second caller gets a private statement which is deleted when it is
+/// released.
+///
+/// The statements of a connection must be invalidated before the
+/// handle is closed or connected again.
+///
+/// @since 0.0.1
+/// @brief Prepared statement cache
+class StatementCache
+{
+public:
+    StatementCache(size_t capacity);
+
+    ~StatementCache(void);
+
+    /// @brief Get a prepared statement
+    db::Statement* acquire(db::Connection &dbc, const String &sql);
+
+    /// @brief Return a statement from acquire()
+    void release(db::Statement *stmt);
+
+    /// @brief Drop the statements of a connection
+    ///
+    /// Statements in use are deleted when they are released.
+    void invalidate(db::Connection *dbc);
+
+    /// @brief Statements found prepared
+    size_t hits(void);
+
+    /// @brief Statements prepared
+    size_t misses(void);
+
+protected:
+    typedef std::pair<db::Connection*, String> key_type;
+
+    struct Entry
+    {
+        key_type          key;
+        db::Statement    *stmt;
+        bool              busy;
+        bool              stale;     ///< delete on release
+    };
+
+    typedef std::list<Entry>                                    entry_list;
+    typedef std::map<key_type, entry_list::iterator>            key_map;
+    typedef std::map<db::Statement*, entry_list::iterator>      stmt_map;
+
+    /// @brief Delete unused statements beyond the capacity
+    void evict(void);
+
+    void erase(entry_list::iterator i);
+
+    size_t          m_capacity;
+    Mutex           m_mutex;
+    entry_list      m_entries;     ///< most recently used first
+    key_map         m_keys;
+    stmt_map        m_stmts;
+    size_t          m_hits;
+    size_t          m_misses;
+
+private:
+    StatementCache(const StatementCache&);
+    StatementCache& operator=(const StatementCache&);
+};
+
+
+ARGON_NAMESPACE_END
+
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,349 @@
+//
+// thread.cc - Threads (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Threads (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "thread.hh"
+
+#include <stdexcept>
+#include <cassert>
+
+#if ! defined(ARGON_ON_WIN32)
+#include <sched.h>
+#include <time.h>
+#endif
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// @details
+/// 
+double
+monotonic_time(void)
+{
+#if defined(ARGON_ON_WIN32)
+    LARGE_INTEGER freq, now;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&now);
+    return static_cast<double>(now.QuadPart) / static_cast<double>(freq.QuadPart);
+#else
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+#endif
+}
+
+
+/// @details
+/// 
+void
+thread_pause(unsigned int &round)
+{
+    ++round;
+    if(round < 64)
+        return;
+#if defined(ARGON_ON_WIN32)
+    ::Sleep(round < 128 ? 0 : 1);
+#else
+    if(round < 128)
+        ::sched_yield();
+    else
+    {
+        struct timespec ts = { 0, 50000 };
+        ::nanosleep(&ts, 0);
+    }
+#endif
+}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////////// Thread
+
+/// @details
+/// 
+Thread::Thread(void)
+    : m_handle(),
+      m_running(false)
+{}
+
+
+/// @details
+/// 
+Thread::~Thread(void)
+{
+    assert(! this->m_running && "thread not joined");
+}
+
+
+/// @details
+/// 
+void
+Thread::start(void)
+{
+    assert(! this->m_running);
+#if defined(ARGON_ON_WIN32)
+    this->m_handle = ::CreateThread(NULL, 0, &Thread::entry, this, 0, NULL);
+    if(! this->m_handle)
+        throw std::runtime_error("can not create thread");
+#else
+    if(::pthread_create(&this->m_handle, 0, &Thread::entry, this) != 0)
+        throw std::runtime_error("can not create thread");
+#endif
+    this->m_running = true;
+}
+
+
+/// @details
+/// 
+void
+Thread::join(void)
+{
+    if(! this->m_running)
+        return;
+#if defined(ARGON_ON_WIN32)
+    ::WaitForSingleObject(this->m_handle, INFINITE);
+    ::CloseHandle(this->m_handle);
+#else
+    ::pthread_join(this->m_handle, 0);
+#endif
+    this->m_running = false;
+}
+
+
+#if defined(ARGON_ON_WIN32)
+/// @details
+/// 
+DWORD WINAPI
+Thread::entry(LPVOID arg)
+{
+    static_cast<Thread*>(arg)->run();
+    return 0;
+}
+#else
+/// @details
+/// 
+void*
+Thread::entry(void *arg)
+{
+    static_cast<Thread*>(arg)->run();
+    return 0;
+}
+#endif
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////////// Mutex
+
+/// @details
+/// 
+Mutex::Mutex(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::InitializeCriticalSection(&this->m_cs);
+#else
+    ::pthread_mutex_init(&this->m_mutex, 0);
+#endif
+}
+
+
+/// @details
+/// 
+Mutex::~Mutex(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::DeleteCriticalSection(&this->m_cs);
+#else
+    ::pthread_mutex_destroy(&this->m_mutex);
+#endif
+}
+
+
+/// @details
+/// 
+void
+Mutex::lock(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::EnterCriticalSection(&this->m_cs);
+#else
+    ::pthread_mutex_lock(&this->m_mutex);
+#endif
+}
+
+
+/// @details
+/// 
+void
+Mutex::unlock(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::LeaveCriticalSection(&this->m_cs);
+#else
+    ::pthread_mutex_unlock(&this->m_mutex);
+#endif
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// Condition
+
+/// @details
+/// 
+Condition::Condition(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::InitializeConditionVariable(&this->m_cond);
+#else
+    ::pthread_cond_init(&this->m_cond, 0);
+#endif
+}
+
+
+/// @details
+/// 
+Condition::~Condition(void)
+{
+#if ! defined(ARGON_ON_WIN32)
+    ::pthread_cond_destroy(&this->m_cond);
+#endif
+}
+
+
+/// @details
+/// 
+void
+Condition::wait(Mutex &mutex)
+{
+#if defined(ARGON_ON_WIN32)
+    ::SleepConditionVariableCS(&this->m_cond, &mutex.m_cs, INFINITE);
+#else
+    ::pthread_cond_wait(&this->m_cond, &mutex.m_mutex);
+#endif
+}
+
+
+/// @details
+/// 
+void
+Condition::broadcast(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::WakeAllConditionVariable(&this->m_cond);
+#else
+    ::pthread_cond_broadcast(&this->m_cond);
+#endif
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// ThreadLocal
+
+/// @details
+/// 
+ThreadLocal::ThreadLocal(void)
+{
+#if defined(ARGON_ON_WIN32)
+    this->m_key = ::TlsAlloc();
+    if(this->m_key == TLS_OUT_OF_INDEXES)
+        throw std::runtime_error("can not allocate thread-local storage");
+#else
+    if(::pthread_key_create(&this->m_key, 0) != 0)
+        throw std::runtime_error("can not allocate thread-local storage");
+#endif
+}
+
+
+/// @details
+/// 
+ThreadLocal::~ThreadLocal(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::TlsFree(this->m_key);
+#else
+    ::pthread_key_delete(this->m_key);
+#endif
+}
+
+
+/// @details
+/// 
+void*
+ThreadLocal::get(void) const
+{
+#if defined(ARGON_ON_WIN32)
+    return ::TlsGetValue(this->m_key);
+#else
+    return ::pthread_getspecific(this->m_key);
+#endif
+}
+
+
+/// @details
+/// 
+void
+ThreadLocal::set(void *value)
+{
+#if defined(ARGON_ON_WIN32)
+    ::TlsSetValue(this->m_key, value);
+#else
+    ::pthread_setspecific(this->m_key, value);
+#endif
+}
+
+
+
+static ThreadLocal      thread_ids;
+static atomic_word      thread_id_next = 0;
+
+
+/// @details
+/// The id is kept as thread-local pointer value, 0 means the thread
+/// has no id yet.
+atomic_word
+thread_id(void)
+{
+    atomic_word id = static_cast<atomic_word>(reinterpret_cast<size_t>(thread_ids.get()));
+    if(! id)
+    {
+        id = atomic_increment(&thread_id_next);
+        thread_ids.set(reinterpret_cast<void*>(static_cast<size_t>(id)));
+    }
+    return id;
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
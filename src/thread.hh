@@ -0,0 +1,417 @@
+//
+// thread.hh - Threads, locks, atomic operations and a bounded lock-free queue
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Threads, locks, atomic operations and a bounded lock-free queue
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_THREAD_HH
+#define INFORMAVE_ARGON_THREAD_HH
+
+#include "argon/argon_config.hh"
+#include "argon/fwd.hh"
+
+#include <vector>
+#include <cstddef>
+
+#if defined(ARGON_ON_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// Word for atomic operations
+typedef unsigned long atomic_word;
+
+
+/// @brief Full memory barrier
+inline void memory_barrier(void)
+{
+#if defined(ARGON_ON_WIN32)
+    ::MemoryBarrier();
+#elif defined(__GNUC__)
+    __sync_synchronize();
+#else
+# error "no atomic operations for this compiler"
+#endif
+}
+
+
+/// @brief Atomically increment, returns the new value
+inline atomic_word atomic_increment(volatile atomic_word *p)
+{
+#if defined(ARGON_ON_WIN32)
+    return static_cast<atomic_word>(::InterlockedIncrement(reinterpret_cast<volatile LONG*>(p)));
+#else
+    return __sync_add_and_fetch(p, 1);
+#endif
+}
+
+
+/// @brief Atomically decrement, returns the new value
+inline atomic_word atomic_decrement(volatile atomic_word *p)
+{
+#if defined(ARGON_ON_WIN32)
+    return static_cast<atomic_word>(::InterlockedDecrement(reinterpret_cast<volatile LONG*>(p)));
+#else
+    return __sync_sub_and_fetch(p, 1);
+#endif
+}
+
+
+/// @brief Set *p to desired if it is expected, returns true on success
+inline bool atomic_cas(volatile atomic_word *p, atomic_word expected, atomic_word desired)
+{
+#if defined(ARGON_ON_WIN32)
+    return static_cast<atomic_word>(::InterlockedCompareExchange(reinterpret_cast<volatile LONG*>(p),
+                                                                 static_cast<LONG>(desired),
+                                                                 static_cast<LONG>(expected))) == expected;
+#else
+    return __sync_bool_compare_and_swap(p, expected, desired);
+#endif
+}
+
+
+/// @brief Read with acquire semantics
+inline atomic_word atomic_load(const volatile atomic_word *p)
+{
+    atomic_word v = *p;
+    memory_barrier();
+    return v;
+}
+
+
+/// @brief Write with release semantics
+inline void atomic_store(volatile atomic_word *p, atomic_word v)
+{
+    memory_barrier();
+    *p = v;
+}
+
+
+/// @brief Seconds from a monotonic clock
+double monotonic_time(void);
+
+
+/// @brief Back off while waiting for another thread
+///
+/// Spins first, then yields and finally sleeps. Pass a counter which
+/// starts at 0 for each wait.
+void thread_pause(unsigned int &round);
+
+
+/// @brief Id of the calling thread
+///
+/// Ids are numbered from 1 in the order the threads ask for them.
+atomic_word thread_id(void);
+
+
+
+//--------------------------------------------------------------------------
+/// Thread
+///
+/// Derived classes implement run(). The thread must be joined before
+/// the object is destroyed, run() must not throw.
+///
+/// @since 0.0.1
+/// @brief Thread
+class Thread
+{
+public:
+    Thread(void);
+
+    virtual ~Thread(void);
+
+    /// @brief Start the thread, throws std::runtime_error on failure
+    void start(void);
+
+    /// @brief Wait until run() returns
+    void join(void);
+
+protected:
+    virtual void run(void) = 0;
+
+private:
+#if defined(ARGON_ON_WIN32)
+    static DWORD WINAPI entry(LPVOID arg);
+
+    HANDLE      m_handle;
+#else
+    static void* entry(void *arg);
+
+    pthread_t   m_handle;
+#endif
+    bool        m_running;
+
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Mutex
+///
+/// @since 0.0.1
+/// @brief Mutex
+class Mutex
+{
+    friend class Condition;
+
+public:
+    Mutex(void);
+
+    ~Mutex(void);
+
+    void lock(void);
+
+    void unlock(void);
+
+private:
+#if defined(ARGON_ON_WIN32)
+    CRITICAL_SECTION   m_cs;
+#else
+    pthread_mutex_t    m_mutex;
+#endif
+
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Scoped lock
+///
+/// @since 0.0.1
+/// @brief Scoped lock
+class ScopedLock
+{
+public:
+    explicit ScopedLock(Mutex &mutex)
+        : m_mutex(mutex)
+    {
+        this->m_mutex.lock();
+    }
+
+    ~ScopedLock(void)
+    {
+        this->m_mutex.unlock();
+    }
+
+private:
+    Mutex &m_mutex;
+
+    ScopedLock(const ScopedLock&);
+    ScopedLock& operator=(const ScopedLock&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Condition variable
+///
+/// wait() must be called with the mutex locked, it may return without
+/// a broadcast(), so callers check their condition in a loop.
+///
+/// @since 0.0.1
+/// @brief Condition variable
+class Condition
+{
+public:
+    Condition(void);
+
+    ~Condition(void);
+
+    void wait(Mutex &mutex);
+
+    void broadcast(void);
+
+private:
+#if defined(ARGON_ON_WIN32)
+    CONDITION_VARIABLE   m_cond;
+#else
+    pthread_cond_t       m_cond;
+#endif
+
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Thread-local pointer
+///
+/// Each thread sees its own value, NULL until the thread sets it.
+///
+/// @since 0.0.1
+/// @brief Thread-local pointer
+class ThreadLocal
+{
+public:
+    ThreadLocal(void);
+
+    ~ThreadLocal(void);
+
+    void* get(void) const;
+
+    void set(void *value);
+
+private:
+#if defined(ARGON_ON_WIN32)
+    DWORD            m_key;
+#else
+    pthread_key_t    m_key;
+#endif
+
+    ThreadLocal(const ThreadLocal&);
+    ThreadLocal& operator=(const ThreadLocal&);
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Bounded lock-free queue
+///
+/// Ring buffer for any number of producers and consumers. Each cell
+/// carries a sequence number which tells producers and consumers
+/// whether the cell is free or filled for the current round, so
+/// push and pop only need one compare-and-swap on the shared index.
+/// The capacity is rounded up to a power of two. T must be copyable
+/// without throwing (pointers).
+///
+/// @since 0.0.1
+/// @brief Bounded lock-free queue
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : m_cells(),
+          m_mask(0),
+          m_head(0),
+          m_tail(0)
+    {
+        size_t size = 2;
+        while(size < capacity)
+            size *= 2;
+        this->m_cells.resize(size);
+        this->m_mask = size - 1;
+        for(size_t i = 0; i < size; ++i)
+            this->m_cells[i].seq = static_cast<atomic_word>(i);
+    }
+
+    /// @brief Add an item, returns false if the queue is full
+    bool try_push(const T &item)
+    {
+        atomic_word pos = atomic_load(&this->m_tail);
+        for(;;)
+        {
+            Cell &cell = this->m_cells[pos & this->m_mask];
+            long diff = static_cast<long>(atomic_load(&cell.seq) - pos);
+            if(diff == 0)
+            {
+                if(atomic_cas(&this->m_tail, pos, pos + 1))
+                {
+                    cell.data = item;
+                    atomic_store(&cell.seq, pos + 1);
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;
+            pos = atomic_load(&this->m_tail);
+        }
+    }
+
+    /// @brief Remove an item, returns false if the queue is empty
+    bool try_pop(T &item)
+    {
+        atomic_word pos = atomic_load(&this->m_head);
+        for(;;)
+        {
+            Cell &cell = this->m_cells[pos & this->m_mask];
+            long diff = static_cast<long>(atomic_load(&cell.seq) - (pos + 1));
+            if(diff == 0)
+            {
+                if(atomic_cas(&this->m_head, pos, pos + 1))
+                {
+                    item = cell.data;
+                    atomic_store(&cell.seq, static_cast<atomic_word>(pos + this->m_mask + 1));
+                    return true;
+                }
+            }
+            else if(diff < 0)
+                return false;
+            pos = atomic_load(&this->m_head);
+        }
+    }
+
+    /// @brief Number of queued items (a snapshot)
+    size_t size(void) const
+    {
+        atomic_word head = atomic_load(&this->m_head);
+        atomic_word tail = atomic_load(&this->m_tail);
+        return static_cast<size_t>(tail - head);
+    }
+
+    inline size_t capacity(void) const
+    {
+        return this->m_mask + 1;
+    }
+
+protected:
+    struct Cell
+    {
+        Cell(void) : seq(0), data() {}
+
+        volatile atomic_word   seq;
+        T                      data;
+    };
+
+    std::vector<Cell>        m_cells;
+    atomic_word              m_mask;
+    volatile atomic_word     m_head;
+    volatile atomic_word     m_tail;
+
+private:
+    BoundedQueue(const BoundedQueue&);
+    BoundedQueue& operator=(const BoundedQueue&);
+};
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
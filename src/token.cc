@@ -38,7 +38,7 @@ ARGON_NAMESPACE_BEGIN
 
 /// @details
 /// 
-SourceInfo::SourceInfo(String file, std::streamsize chpos, size_t len, size_t line)
+SourceInfo::SourceInfo(const String *file, std::streamsize chpos, size_t len, size_t line)
     : m_file(file), 
       m_offset(chpos),
       m_len(len),
@@ -58,7 +58,7 @@ SourceInfo::expand(const SourceInfo &info)
     if(m_line == 0 || m_line > info.m_line)
         m_line = info.m_line == 0 ? m_line : info.m_line;
 
-    if(m_file.empty())
+    if(m_file == 0)
         m_file = info.m_file;
 
     if(m_offset == 0 || info.m_offset < m_offset)
@@ -110,7 +110,7 @@ Token::setData(const String &str)
 
 /// @details
 /// 
-String 
+const String&
 Token::data(void) const
 {
     return this->m_data;
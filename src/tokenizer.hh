@@ -29,11 +29,14 @@
 
 
 #include "argon/token.hh"
+#include "argon/exceptions.hh"
+#include "utf8.hh"
+#include "keywords.hh"
 
 #include <iterator>
 #include <vector>
+#include <string>
 #include <cctype>
-#include <locale>
 #include <cassert>
 #include <algorithm>
 
@@ -44,95 +47,270 @@ ARGON_NAMESPACE_BEGIN
 
 
 
-template <typename CharT, typename TraitsT, size_t N>
-std::basic_string<CharT, TraitsT>
-inline _str(const char (&src)[N])
+//--------------------------------------------------------------------------
+/// Stream input for the Tokenizer
+///
+/// Reads characters one by one from a stream buffer. Captured token
+/// data is collected in a temporary buffer.
+///
+/// @since 0.0.1
+/// @brief Stream input for the Tokenizer
+template<typename CharT, typename TraitsT = std::char_traits<CharT> >
+class StreamInput
 {
-    return std::basic_string<CharT, TraitsT>(src, src+N-1);
-}
+public:
+    typedef std::istreambuf_iterator<CharT, TraitsT>     streambuf_iterator;
+    typedef CharT                                        char_type;
+    typedef TraitsT                                      traits_type;
+    typedef std::basic_string<CharT, TraitsT>            string_type;
+
+    StreamInput(streambuf_iterator in)
+        : m_in(in),
+          m_buf()
+    {}
+
+    /// Read the next character, returns false on EOF
+    inline bool get(char_type &c)
+    {
+        if(this->m_in != streambuf_iterator())
+        {
+            c = *this->m_in++;
+            return true;
+        }
+        return false;
+    }
+
+    inline bool eof(void) const
+    {
+        return !(this->m_in != streambuf_iterator());
+    }
 
+    /// Start capturing token data
+    inline void mark(void)
+    {
+        this->m_buf.clear();
+    }
 
+    /// Add the current character to the captured data
+    inline void capture(char_type c)
+    {
+        this->m_buf.push_back(c);
+    }
+
+    /// Captured data in the input encoding
+    inline const char_type* data(void) const
+    {
+        return this->m_buf.empty() ? 0 : &this->m_buf[0];
+    }
+
+    /// Number of captured characters
+    inline size_t length(void) const
+    {
+        return this->m_buf.size();
+    }
 
-template <typename CharT, typename TraitsT>
-std::basic_string<CharT, TraitsT>
-inline upper(const std::basic_string<CharT, TraitsT> &str)
+    /// Captured data as String
+    inline String captured(void) const
+    {
+        return String(string_type(this->m_buf.begin(), this->m_buf.end()));
+    }
+
+    /// Characters outside ASCII are printable but never part of the
+    /// other classes, like the bytes of Utf8Input
+    static inline bool isAlnum(char_type c) { return isAscii(c) && ::isalnum(c); }
+
+    /// Letters and digits, and the characters outside ASCII which
+    /// can be part of an identifier (see utf8_is_ident_cp())
+    inline bool isIdent(char_type c) const
+    {
+        return isAscii(c) ? ::isalnum(c) != 0 : utf8_is_ident_cp(static_cast<unsigned long>(c));
+    }
+    static inline bool isDigit(char_type c) { return isAscii(c) && ::isdigit(c); }
+    static inline bool isPrint(char_type c) { return ! isAscii(c) || ::isprint(c); }
+
+    /// Every character counts as one source position
+    static inline bool isLead(char_type c) { return true; }
+
+    /// The stream decodes the characters, all of them are valid
+    static inline bool isValid(char_type c) { return true; }
+
+protected:
+    static inline bool isAscii(char_type c) { return static_cast<unsigned long>(c) < 0x80; }
+
+    streambuf_iterator       m_in;
+    std::vector<char_type>   m_buf;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// UTF-8 buffer input for the Tokenizer
+///
+/// Reads the raw bytes of a contiguous (usually memory mapped) UTF-8
+/// buffer. Nothing is copied while scanning; captured token data is a
+/// range of the input buffer and only decoded when the token payload
+/// is requested.
+///
+/// @since 0.0.1
+/// @brief UTF-8 buffer input for the Tokenizer
+class Utf8Input
 {
-    std::basic_string<CharT, TraitsT> out;
-    out.resize(str.length());
-    std::locale loc;
-    const std::ctype<char>& ct = std::use_facet<std::ctype<char> >(loc);
-    std::transform(str.begin(), str.end(), out.begin(), std::bind1st(std::mem_fun(&std::ctype<char>::toupper), &ct));
-    return out;
-}
+public:
+    typedef char                               char_type;
+    typedef std::string                        string_type;
 
+    /// The byte 0xFF never appears in well-formed UTF-8 and is used
+    /// as EOF marker. The Tokenizer rejects it in the input (see
+    /// isValid()), so it can not end a script early.
+    struct traits_type
+    {
+        typedef int int_type;
+        static inline int_type eof(void) { return -1; }
+        static inline int_type to_int_type(char c) { return static_cast<signed char>(c); }
+    };
+
+    Utf8Input(const char *begin, const char *end)
+        : m_p(begin),
+          m_cur(begin),
+          m_end(end),
+          m_mark(begin),
+          m_ident(false)
+    {
+        /// Skip the byte order mark
+        if(end - begin >= 3 && static_cast<unsigned char>(begin[0]) == 0xEF
+           && static_cast<unsigned char>(begin[1]) == 0xBB
+           && static_cast<unsigned char>(begin[2]) == 0xBF)
+        {
+            this->m_p = this->m_cur = this->m_mark = begin + 3;
+        }
+    }
+
+    /// Read the next byte, returns false on EOF
+    ///
+    /// A lead byte outside ASCII decodes its sequence for isIdent().
+    inline bool get(char_type &c)
+    {
+        if(this->m_p != this->m_end)
+        {
+            this->m_cur = this->m_p;
+            c = *this->m_p++;
+            if(static_cast<unsigned char>(c) >= 0xC0)
+                this->m_ident = utf8_is_ident_cp(utf8_peek_cp(this->m_cur, this->m_end));
+            return true;
+        }
+        this->m_cur = this->m_end;
+        return false;
+    }
+
+    inline bool eof(void) const
+    {
+        return this->m_p == this->m_end;
+    }
+
+    /// Start capturing at the current character
+    inline void mark(void)
+    {
+        this->m_mark = this->m_cur;
+    }
+
+    /// Nothing to do, the captured data is the range [mark, current)
+    inline void capture(char_type)
+    {}
+
+    /// Captured data as raw UTF-8 bytes
+    inline const char_type* data(void) const
+    {
+        return this->m_mark;
+    }
+
+    /// Number of captured bytes
+    inline size_t length(void) const
+    {
+        return this->m_cur - this->m_mark;
+    }
+
+    /// Captured data as String
+    inline String captured(void) const
+    {
+        return utf8_decode(this->m_mark, this->m_cur);
+    }
+
+    /// Bytes of multi-byte sequences are never part of the
+    /// ASCII character classes
+    static inline bool isAlnum(char_type c) { return c >= 0 && ::isalnum(c); }
+    static inline bool isDigit(char_type c) { return c >= 0 && ::isdigit(c); }
+    static inline bool isPrint(char_type c) { return c < 0 || ::isprint(c); }
+
+    /// Letters and digits; the bytes of a sequence outside ASCII are
+    /// classified by its code point (see utf8_is_ident_cp())
+    inline bool isIdent(char_type c) const
+    {
+        return c >= 0 ? ::isalnum(c) != 0 : this->m_ident;
+    }
+
+    /// Continuation bytes don't count as source positions
+    static inline bool isLead(char_type c) { return ! utf8_is_cont(static_cast<unsigned char>(c)); }
+
+    /// False for bytes which never appear in UTF-8 (0xC0, 0xC1 and
+    /// 0xF5 to 0xFF)
+    static inline bool isValid(char_type c) { return utf8_is_valid(static_cast<unsigned char>(c)); }
+
+protected:
+    const char   *m_p;
+    const char   *m_cur;
+    const char   *m_end;
+    const char   *m_mark;
+    bool          m_ident;    ///< isIdent() of the last sequence outside ASCII
+};
 
 
 
 //--------------------------------------------------------------------------
 /// Tokenizer
 ///
+/// The input policy (StreamInput or Utf8Input) defines how characters
+/// are read and how token data is captured.
+///
 /// @since 0.0.1
 /// @brief Tokenizer
-template<typename CharT, typename TraitsT = std::char_traits<CharT> >
+template<typename InputT>
 class Tokenizer
 {
 public:
-    typedef std::istreambuf_iterator<CharT, TraitsT>             streambuf_iterator;
-    typedef std::map< std::basic_string<CharT, TraitsT>, int >   map_type;
-    typedef CharT                                                char_type;
-    typedef TraitsT                                              traits_type;
+    typedef InputT                                       input_type;
+    typedef typename InputT::char_type                   char_type;
+    typedef typename InputT::traits_type                 traits_type;
+    typedef typename InputT::string_type                 string_type;
 
 
-    /// Create new Tokenizer from input stream iterator
-    Tokenizer(streambuf_iterator in)
+    /// Create new Tokenizer from the given input
+    ///
+    /// Keywords are looked up in a static table (see keywords.hh),
+    /// so creating a Tokenizer is cheap.
+    Tokenizer(input_type in)
         : m_in(in),
           m_char(),
-          m_keywords(),
-          m_templates(),
           m_line(1),
           m_charpos(0),
-          m_srcname("<input>")
+          m_srcname(0)
     {
         /// We need to consume the first character for initial state.
         consume();
-
-
-        /// Add your keywords here
-        this->m_keywords[ _str<CharT, TraitsT>("CONNECTION") ] = ARGON_TOK_CONNECTION;
-        this->m_keywords[ _str<CharT, TraitsT>("TYPE")       ] = ARGON_TOK_TYPE;
-        this->m_keywords[ _str<CharT, TraitsT>("DBCSTR")     ] = ARGON_TOK_DBCSTR;
-        this->m_keywords[ _str<CharT, TraitsT>("PROGRAM.")   ] = ARGON_TOK_PROGRAM;
-        this->m_keywords[ _str<CharT, TraitsT>("TASK")       ] = ARGON_TOK_TASK;
-        this->m_keywords[ _str<CharT, TraitsT>("AS")         ] = ARGON_TOK_AS;
-        this->m_keywords[ _str<CharT, TraitsT>("BEGIN")      ] = ARGON_TOK_BEGIN;
-        this->m_keywords[ _str<CharT, TraitsT>("END")        ] = ARGON_TOK_END;
-
-        this->m_keywords[ _str<CharT, TraitsT>("DECLARE")     ] = ARGON_TOK_DECLARE;
-        this->m_keywords[ _str<CharT, TraitsT>("TABLE")       ] = ARGON_TOK_TABLE;
-        this->m_keywords[ _str<CharT, TraitsT>("VIEW")        ] = ARGON_TOK_VIEW;
-        this->m_keywords[ _str<CharT, TraitsT>("PROCEDURE")   ] = ARGON_TOK_PROCEDURE;
-        this->m_keywords[ _str<CharT, TraitsT>("SQL")         ] = ARGON_TOK_SQL;
-
-        this->m_keywords[ _str<CharT, TraitsT>("LOG")         ] = ARGON_TOK_LOG;
-        this->m_keywords[ _str<CharT, TraitsT>("EXEC")        ] = ARGON_TOK_EXEC;
-
-        /// Additional map with names
-        this->m_templates[ _str<CharT, TraitsT>("VOID")         ] = ARGON_TOK_TEMPLATE;
-        this->m_templates[ _str<CharT, TraitsT>("FETCH")        ] = ARGON_TOK_TEMPLATE;
-        this->m_templates[ _str<CharT, TraitsT>("STORE")        ] = ARGON_TOK_TEMPLATE;
-        this->m_templates[ _str<CharT, TraitsT>("TRANSFER")     ] = ARGON_TOK_TEMPLATE;
     }
 
 
 
     /// Consume next character
     /// Returns false on EOF, otherwise true
-    bool consume(void)
+    inline bool consume(void)
     {
-        if(this->m_in != streambuf_iterator())
+        if(this->m_in.get(this->m_char))
         {
-            this->m_charpos++;
-            this->m_char = *this->m_in++;
+            if(! input_type::isValid(this->m_char))
+                throw CompileError(SourceInfo(this->m_srcname, this->m_charpos, 1, this->m_line),
+                                   String("invalid UTF-8 byte in script"));
+            if(input_type::isLead(this->m_char))
+                this->m_charpos++;
             return true;
         }
         this->m_char = traits_type::eof();
@@ -217,19 +395,29 @@ public:
         case ',':
             consume();
             return Token(ARGON_TOK_COMMA, si);
+        case ':':
+            consume();
+            return Token(ARGON_TOK_COLON, si);
         case '=':
             consume();
             return Token(ARGON_TOK_ASSIGNOP, si);
 
         case '<':
             consume();
-            assert(m_char == '-');
+            assert(m_char == '-' || m_char == '<');
             consume();
             return Token(ARGON_TOK_ASSIGNOP, si);
 
 
         case '$':
-            return this->readColumn(start, len, line);
+            return this->readColumn(start, len, line, ARGON_TOK_COLUMN);
+
+        case '%':
+            return this->readColumn(start, len, line, ARGON_TOK_RESCOLUMN);
+
+        case '@':
+            consume();
+            return Token(ARGON_TOK_STDVAL, si);
 
 
         case '/':
@@ -243,8 +431,6 @@ public:
                 assert(!"/ err token");
             //return ARGON_TOK_DIV;
 
-            // case '%':
-            //     return Token(ARGON_TOK_TERM, start, len, line);
         default:
             return this->readMulti(start, len, line);
         };
@@ -256,7 +442,7 @@ public:
     /// Returns true if EOF is reached
     bool eof(void) const
     {
-        return !(this->m_in != streambuf_iterator());
+        return this->m_in.eof();
     }
 
 
@@ -279,7 +465,7 @@ public:
                 traits_type::to_int_type(c) != traits_type::eof();
                 c = getnc())
             {
-                if(! isprint(c))
+                if(! input_type::isPrint(c))
                     break;
             };
         }
@@ -305,31 +491,34 @@ public:
         }
     }
 
-    Token readColumn(std::streamsize start, size_t len, size_t line)
+    /// Read a column name after $ or %
+    Token readColumn(std::streamsize start, size_t len, size_t line, int id)
     {
-        std::vector<char_type> v;
-            
         char_type c;
         bool par = false;
 
         c = getnc();
         if(c == '(')
+        {
             par = true;
+            c = getnc();
+        }
                 
+        this->m_in.mark();
             
         for(;
             traits_type::to_int_type(c) != traits_type::eof();
             c = getnc())
         {
-            if((par && c != ')') || isalnum(c))
-                v.push_back(c);
+            if((par && c != ')') || this->m_in.isIdent(c) || c == '_')
+                this->m_in.capture(c);
             else
                 break;
         };
+        String s(this->m_in.captured());
         if(par && c == ')')
             consume(); // skip )
-        std::basic_string<char_type> s(v.begin(), v.end());
-        Token tok(ARGON_TOK_COLUMN, SourceInfo(m_srcname, start, len, line));
+        Token tok(id, SourceInfo(m_srcname, start, len, line));
         tok.setData(s);
         return tok;
     }
@@ -342,31 +531,33 @@ public:
     /// Support for escaping
     Token readLiteral(std::streamsize start, size_t len, size_t line)
     {
-        std::vector<char_type> v;
         char_type c;
 
-        for(c = getnc();
+        c = getnc();
+        this->m_in.mark();
+
+        for(;
             traits_type::to_int_type(c) != traits_type::eof();
             c = getnc())
         {
             if(c != '"')
-                v.push_back(c);
+                this->m_in.capture(c);
             else
                 break;
         };
+        String s(this->m_in.captured());
         if(c == '"')
             consume(); // skip "
-        std::basic_string<char_type> s(v.begin(), v.end());
         Token tok(ARGON_TOK_LITERAL, SourceInfo(m_srcname, start, len, line));
-        tok.setData(String(s));
+        tok.setData(s);
         return tok;
     }
 
 
     Token readMulti(std::streamsize start, size_t len, size_t line)
     {
-        std::vector<char_type> v;
-        v.push_back(this->m_char);
+        this->m_in.mark();
+        this->m_in.capture(this->m_char);
             
         char_type c;
 
@@ -374,62 +565,45 @@ public:
             traits_type::to_int_type(c) != traits_type::eof();
             c = getnc())
         {
-            if(::isalnum(c) || c == '.')
-                v.push_back(c);
+            if(this->m_in.isIdent(c) || c == '.' || c == '_')
+                this->m_in.capture(c);
             else
                 break;
         };
-        std::basic_string<char_type> s(v.begin(), v.end());
-
-        std::basic_string<char_type> up(upper(s));
-
-        {
-            typename map_type::iterator i = this->m_keywords.find(up);
-            if(i != this->m_keywords.end())
-            {
-                Token tok(i->second, SourceInfo(m_srcname, start, len, line));
-                tok.setData(up);
-                return tok;
-            }
-        }
-
+        const Keyword *kw = find_keyword(this->m_in.data(), this->m_in.length());
+        if(kw)
         {
-            typename map_type::iterator i = this->m_templates.find(up);
-            if(i != this->m_templates.end())
-            {
-                Token tok(i->second, SourceInfo(m_srcname, start, len, line));
-                tok.setData(up);
-                return tok;
-            }
+            Token tok(kw->id, SourceInfo(m_srcname, start, len, line));
+            // a context keyword keeps its spelling for the ID fallback
+            tok.setData(kw->context ? this->m_in.captured() : String(kw->name));
+            return tok;
         }
 
-        if(isdigit(s[0]))
+        if(input_type::isDigit(this->m_in.data()[0]))
         {
             Token tok(ARGON_TOK_NUMBER, SourceInfo(m_srcname, start, len, line));
-            /// @bug add number value
+            tok.setData(this->m_in.captured());
             return tok;
         }
             
         Token tok(ARGON_TOK_ID, SourceInfo(m_srcname, start, len, line));
-        String x(s);
-        tok.setData(x);
+        tok.setData(this->m_in.captured());
         return tok;
     }
 
 
-    void setSourceName(const String &str)
+    /// Set the source file of the tokens, interned by the engine
+    void setSourceName(const String *file)
     {
-        this->m_srcname = str;
+        this->m_srcname = file;
     }
 
 protected:
-    streambuf_iterator  m_in;
+    input_type          m_in;
     char_type           m_char;
-    map_type            m_keywords;
-    map_type            m_templates;
     size_t              m_line;
     std::streamsize     m_charpos;
-    String      m_srcname;
+    const String       *m_srcname;
 };
 
 
@@ -0,0 +1,1657 @@
+//
+// transfer.cc - Batched transfer runtime (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Batched transfer runtime (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/transfer.hh"
+#include "thread.hh"
+#include "stmtcache.hh"
+#include "utf8.hh"
+
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+#include <cctype>
+#include <cassert>
+
+ARGON_NAMESPACE_BEGIN
+
+
+namespace dal = informave::db::dal;
+
+
+/// Parses [+-]digits[.digits], returns false if the string is not a
+/// decimal number or does not fit into a decimal value
+static bool parse_decimal(const String &str, Value &value)
+{
+    const long long limit = (std::numeric_limits<long long>::max() - 9) / 10;
+    size_t i = 0;
+    bool neg = false, dot = false, digits = false;
+    long long unscaled = 0;
+    unsigned int scale = 0;
+
+    if(i < str.length() && (str[i] == L'-' || str[i] == L'+'))
+        neg = (str[i++] == L'-');
+
+    for(; i < str.length(); ++i)
+    {
+        wchar_t c = str[i];
+        if(c == L'.' && ! dot)
+        {
+            dot = true;
+            continue;
+        }
+        if(c < L'0' || c > L'9' || unscaled > limit || scale == Value::max_scale)
+            return false;
+        unscaled = unscaled * 10 + (c - L'0');
+        digits = true;
+        if(dot)
+            ++scale;
+    }
+    if(! digits)
+        return false;
+
+    if(neg)
+        unscaled = -unscaled;
+    value = dot ? Value::decimal(unscaled, scale) : Value(unscaled);
+    return true;
+}
+
+
+/// Reads exactly n digits at pos, returns -1 on error
+static int read_digits(const String &str, size_t &pos, size_t n)
+{
+    int v = 0;
+    for(size_t end = pos + n; pos < end; ++pos)
+    {
+        if(pos >= str.length() || str[pos] < L'0' || str[pos] > L'9')
+            return -1;
+        v = v * 10 + (str[pos] - L'0');
+    }
+    return v;
+}
+
+
+/// Parses YYYY-MM-DD[( |T)HH:MM:SS[.fraction]]
+static bool parse_date(const String &str, DateTime &dt)
+{
+    size_t pos = 0;
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    unsigned int fraction = 0;
+
+    if((year = read_digits(str, pos, 4)) < 0 || str[pos++] != L'-'
+       || (month = read_digits(str, pos, 2)) < 0 || str[pos++] != L'-'
+       || (day = read_digits(str, pos, 2)) < 0)
+        return false;
+
+    if(pos < str.length())
+    {
+        if((str[pos] != L' ' && str[pos] != L'T') || ++pos == str.length()
+           || (hour = read_digits(str, pos, 2)) < 0 || str[pos++] != L':'
+           || (minute = read_digits(str, pos, 2)) < 0 || str[pos++] != L':'
+           || (second = read_digits(str, pos, 2)) < 0)
+            return false;
+
+        if(pos < str.length() && str[pos] == L'.')
+        {
+            unsigned int digits = 0;
+            for(++pos; pos < str.length() && digits < 9; ++pos, ++digits)
+            {
+                if(str[pos] < L'0' || str[pos] > L'9')
+                    return false;
+                fraction = fraction * 10 + (str[pos] - L'0');
+            }
+            for(; digits < 9; ++digits)
+                fraction *= 10;
+        }
+        if(pos != str.length())
+            return false;
+    }
+
+    dt.year = static_cast<short>(year);
+    dt.month = static_cast<unsigned char>(month);
+    dt.day = static_cast<unsigned char>(day);
+    dt.hour = static_cast<unsigned char>(hour);
+    dt.minute = static_cast<unsigned char>(minute);
+    dt.second = static_cast<unsigned char>(second);
+    dt.fraction = fraction;
+    return true;
+}
+
+
+/// @details
+/// Numbers which do not fit into a decimal are returned as float.
+Value
+parse_number(const String &str)
+{
+    Value v;
+    if(parse_decimal(str, v))
+        return v;
+
+    wchar_t *end = 0;
+    double d = std::wcstod(str.c_str(), &end);
+    if(str.empty() || *end != L'\0')
+        throw std::runtime_error("invalid number: " + std::string(str));
+    return Value(d);
+}
+
+
+/// @details
+/// Numeric and date values are converted from their string
+/// representation. If that fails, the string is kept.
+Value
+to_value(const db::IVariant &var)
+{
+    if(var.isnull())
+        return Value::null();
+
+    switch(var.datatype())
+    {
+    case dal::DAL_TYPE_BOOL:
+    case dal::DAL_TYPE_SMALLINT:
+    case dal::DAL_TYPE_USMALLINT:
+    case dal::DAL_TYPE_INT:
+        return Value(var.asInt());
+    case dal::DAL_TYPE_UINT:
+    case dal::DAL_TYPE_BIGINT:
+    case dal::DAL_TYPE_UBIGINT:
+        return Value(var.asBigint());
+    case dal::DAL_TYPE_FLOAT:
+    case dal::DAL_TYPE_DOUBLE:
+        return Value(var.asDouble());
+    case dal::DAL_TYPE_NUMERIC:
+    {
+        String s = var.asStr();
+        Value v;
+        return parse_decimal(s, v) ? v : Value(s);
+    }
+    case dal::DAL_TYPE_DATE:
+    case dal::DAL_TYPE_DATETIME:
+    {
+        String s = var.asStr();
+        DateTime dt;
+        return parse_date(s, dt) ? Value::date(dt) : Value(s);
+    }
+    default:
+        return Value(var.asStr());
+    }
+}
+
+
+/// @details
+/// Decimals and dates are bound as strings, the driver converts them
+/// to the column type.
+db::Variant
+to_variant(const Value &value)
+{
+    switch(value.type())
+    {
+    case Value::type_void:
+    case Value::type_null:
+        return db::Variant();
+    case Value::type_int:
+        return db::Variant(static_cast<signed long long>(value.asInt()));
+    case Value::type_float:
+        return db::Variant(value.asDouble());
+    case Value::type_decimal:
+    case Value::type_date:
+        return db::Variant(value.asString());
+    case Value::type_string:
+        return db::Variant(String(std::wstring(value.strData(), value.strLength())));
+    case Value::type_lob:
+        break;
+    }
+    throw std::runtime_error("LOB values can not be bound");
+}
+
+
+/// Letters, digits and '_', not starting with a digit. Letters
+/// outside ASCII count as in names of the script.
+static bool regular_identifier(const wchar_t *begin, const wchar_t *end)
+{
+    if(begin == end || (*begin >= L'0' && *begin <= L'9'))
+        return false;
+    for(; begin != end; ++begin)
+    {
+        unsigned long c = static_cast<unsigned long>(*begin);
+        if(c >= 0x80 ? ! utf8_is_ident_cp(c) : ! (std::isalnum(static_cast<int>(c)) || c == '_'))
+            return false;
+    }
+    return true;
+}
+
+
+/// @details
+/// Quotes inside a quoted part are doubled.
+String
+sql_identifier(const String &name)
+{
+    const wchar_t *s = name.data();
+    const size_t len = name.length();
+    if(len && (s[0] == L'"' || s[0] == L'[' || s[0] == L'`'))
+        return name;
+
+    std::wstring sql;
+    for(size_t begin = 0, end = 0; end <= len; begin = ++end)
+    {
+        while(end < len && s[end] != L'.')
+            ++end;
+        if(begin)
+            sql.push_back(L'.');
+        if(regular_identifier(s + begin, s + end))
+        {
+            sql.append(s + begin, s + end);
+            continue;
+        }
+        sql.push_back(L'"');
+        for(size_t i = begin; i < end; ++i)
+        {
+            if(s[i] == L'"')
+                sql.push_back(L'"');
+            sql.push_back(s[i]);
+        }
+        sql.push_back(L'"');
+    }
+    return String(sql);
+}
+
+
+
+/// Store a dbwtl value in a column, like to_value() without building
+/// a Value for each cell
+static void fetch_value(ColumnVector &col, size_t row, const db::IVariant &var)
+{
+    if(var.isnull())
+    {
+        col.setNull(row);
+        return;
+    }
+
+    switch(var.datatype())
+    {
+    case dal::DAL_TYPE_BOOL:
+    case dal::DAL_TYPE_SMALLINT:
+    case dal::DAL_TYPE_USMALLINT:
+    case dal::DAL_TYPE_INT:
+        col.setInt(row, var.asInt());
+        break;
+    case dal::DAL_TYPE_UINT:
+    case dal::DAL_TYPE_BIGINT:
+    case dal::DAL_TYPE_UBIGINT:
+        col.setInt(row, var.asBigint());
+        break;
+    case dal::DAL_TYPE_FLOAT:
+    case dal::DAL_TYPE_DOUBLE:
+        col.setFloat(row, var.asDouble());
+        break;
+    case dal::DAL_TYPE_NUMERIC:
+    {
+        String s = var.asStr();
+        Value v;
+        if(parse_decimal(s, v))
+            col.set(row, v);
+        else
+            col.setString(row, s.data(), s.length());
+        break;
+    }
+    case dal::DAL_TYPE_DATE:
+    case dal::DAL_TYPE_DATETIME:
+    {
+        String s = var.asStr();
+        DateTime dt;
+        if(parse_date(s, dt))
+            col.setDate(row, dt);
+        else
+            col.setString(row, s.data(), s.length());
+        break;
+    }
+    default:
+    {
+        String s = var.asStr();
+        col.setString(row, s.data(), s.length());
+        break;
+    }
+    }
+}
+
+
+/// Value of a column for binding, like to_variant()
+static db::Variant bind_value(const ColumnVector &col, size_t row)
+{
+    if(col.isNull(row))
+        return db::Variant();
+
+    switch(col.type())
+    {
+    case ColumnVector::col_int:
+        return db::Variant(static_cast<signed long long>(col.intAt(row)));
+    case ColumnVector::col_float:
+        return db::Variant(col.floatAt(row));
+    case ColumnVector::col_string:
+        return db::Variant(String(std::wstring(col.strData(row), col.strLength(row))));
+    case ColumnVector::col_value:
+        return to_variant(col.valueAt(row));
+    default:
+        return to_variant(col.get(row));
+    }
+}
+
+
+/// Bind all columns of a row
+static void bind_row(db::Statement &stmt, const RowBatch &batch, size_t row)
+{
+    for(size_t c = 0; c < batch.columns(); ++c)
+        stmt.bind(static_cast<int>(c + 1), bind_value(batch.column(c), row));
+}
+
+
+/// @details
+/// 
+Value
+standard_value(Value::value_type type)
+{
+    switch(type)
+    {
+    case Value::type_int:
+        return Value(0);
+    case Value::type_decimal:
+        return Value::decimal(0, 0);
+    case Value::type_float:
+        return Value(0.0);
+    case Value::type_string:
+        return Value(L"");
+    default:
+        return Value();
+    }
+}
+
+
+/// Copy the column of a copy or default rule, converted by the
+/// kernel of the rule. A destination column is already in the row
+/// order of @a dest.
+static void copy_column(const ColumnRule &rule, const RowBatch &src, RowBatch &dest,
+                        const size_t *sel, size_t rows)
+{
+    ColumnVector &col = dest.column(rule.dest);
+    if(rule.convert && rule.result)
+        rule.convert(dest.column(rule.src), col, 0, rows);
+    else if(rule.convert)
+        rule.convert(src.column(rule.src), col, sel, rows);
+    else if(rule.result)
+        col.copy(dest.column(rule.src), rows);
+    else if(sel)
+        col.gather(src.column(rule.src), sel, rows);
+    else
+        col.copy(src.column(rule.src), rows);
+}
+
+
+/// @details
+/// Each rule runs over all rows before the next rule is applied. The
+/// active rows of @a src become rows [0, n) of @a dest, without a
+/// selection a copy moves whole arrays. Columns without a rule are
+/// NULL.
+void
+apply_rules(const RuleList &rules, const RowBatch &src, RowBatch &dest)
+{
+    const size_t rows = src.active();
+    const size_t *sel = src.isSelective() && rows ? &src.selection()[0] : 0;
+
+    dest.clear();
+    dest.resize(rows);
+
+    for(RuleList::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        ColumnVector &col = dest.column(i->dest);
+        switch(i->type)
+        {
+        case ColumnRule::rule_copy:
+            copy_column(*i, src, dest, sel, rows);
+            break;
+        case ColumnRule::rule_const:
+            col.fill(i->value, rows);
+            break;
+        case ColumnRule::rule_null:
+            col.fillNull(rows);
+            break;
+        case ColumnRule::rule_default:
+        {
+            copy_column(*i, src, dest, sel, rows);
+            Value dflt = standard_value(col.valueType());
+            col.fillNulls(dflt.isVoid() ? i->value : dflt, rows);
+            break;
+        }
+        }
+    }
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////// CachedStatement
+
+/// @details
+/// 
+void
+CachedStatement::prepare(db::Connection &dbc, const String &sql, StatementCache *cache)
+{
+    this->release();
+    if(cache)
+        this->m_stmt = cache->acquire(dbc, sql);
+    else
+    {
+        std::auto_ptr<db::Statement> stmt(dbc.newStatement());
+        stmt->prepare(sql);
+        this->m_stmt = stmt.release();
+    }
+    this->m_cache = cache;
+}
+
+
+/// @details
+/// 
+void
+CachedStatement::release(void)
+{
+    if(! this->m_stmt)
+        return;
+    if(this->m_cache)
+        this->m_cache->release(this->m_stmt);
+    else
+        delete this->m_stmt;
+    this->m_stmt = 0;
+    this->m_cache = 0;
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////// Savepoint
+
+/// @details
+/// The address of the object tells the savepoints of nested writers
+/// apart.
+Savepoint::Savepoint(db::Connection &dbc)
+    : m_dbc(dbc),
+      m_name(),
+      m_release(true)
+{
+    std::wstringstream ss;
+    ss << L"argon_sp_" << std::hex << reinterpret_cast<size_t>(this);
+    this->m_name = ss.str();
+}
+
+
+/// @details
+/// 
+void
+Savepoint::set(void)
+{
+    this->m_dbc.savepoint(this->m_name);
+}
+
+
+/// @details
+/// 
+void
+Savepoint::rollback(void)
+{
+    this->m_dbc.rollback(this->m_name);
+}
+
+
+/// @details
+/// Only the driver's error is taken as "not supported", a driver
+/// which aborts the transaction on a failed statement supports the
+/// release.
+void
+Savepoint::release(void)
+{
+    if(! this->m_release)
+        return;
+    try
+    {
+        this->m_dbc.directCmd(String("RELEASE SAVEPOINT ") + this->m_name);
+    }
+    catch(db::Exception &)
+    {
+        this->m_release = false;
+    }
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// BatchReader
+
+/// @details
+/// 
+BatchReader::BatchReader(db::Connection &dbc, const String &sql,
+                         const std::vector<Value> &params, StatementCache *cache)
+    : m_dbc(dbc),
+      m_sql(sql),
+      m_params(params),
+      m_cache(cache),
+      m_stmt(),
+      m_result(0),
+      m_used()
+{}
+
+
+/// @details
+/// 
+void
+BatchReader::open(void)
+{
+    this->m_stmt.prepare(this->m_dbc, this->m_sql, this->m_cache);
+    for(size_t i = 0; i < this->m_params.size(); ++i)
+        this->m_stmt->bind(static_cast<int>(i + 1), to_variant(this->m_params[i]));
+    this->m_stmt->execute();
+    this->m_result = &this->m_stmt->resultset();
+    this->m_result->first();
+}
+
+
+/// @details
+/// 
+size_t
+BatchReader::fetch(RowBatch &batch)
+{
+    assert(this->m_result && batch.columns() == this->columnCount());
+
+    const size_t cols = batch.columns();
+    const size_t used = this->m_used.size();
+    size_t n = 0;
+
+    batch.clear();
+    while(n < batch.capacity() && ! this->m_result->eof())
+    {
+        if(used)
+        {
+            for(size_t i = 0; i < used; ++i)
+            {
+                const size_t c = this->m_used[i];
+                fetch_value(batch.column(c), n, this->m_result->column(c + 1));
+            }
+        }
+        else
+        {
+            for(size_t c = 0; c < cols; ++c)
+                fetch_value(batch.column(c), n, this->m_result->column(c + 1));
+        }
+        ++n;
+        this->m_result->next();
+    }
+    batch.resize(n);
+    return n;
+}
+
+
+/// @details
+/// 
+size_t
+BatchReader::columnCount(void) const
+{
+    assert(this->m_result);
+    return this->m_result->columnCount();
+}
+
+
+/// @details
+/// 
+size_t
+BatchReader::columnIndex(const String &name) const
+{
+    size_t i = this->findColumn(name);
+    if(i == npos)
+        throw std::runtime_error("unknown source column: " + std::string(name));
+    return i;
+}
+
+
+/// Compare ignoring the case
+static bool same_name(const String &a, const String &b)
+{
+    if(a.length() != b.length())
+        return false;
+    for(size_t i = 0; i < a.length(); ++i)
+    {
+        if(std::towlower(a.data()[i]) != std::towlower(b.data()[i]))
+            return false;
+    }
+    return true;
+}
+
+
+/// @details
+/// 
+size_t
+BatchReader::findColumn(const String &name) const
+{
+    assert(this->m_result);
+    const size_t cols = this->m_result->columnCount();
+    size_t found = npos;
+    for(size_t i = 0; i < cols; ++i)
+    {
+        String col = this->m_result->columnName(i + 1);
+        if(col == name)
+            return i;
+        if(found == npos && same_name(col, name))
+            found = i;
+    }
+    return found;
+}
+
+
+const size_t BatchReader::npos;
+
+
+/// @details
+/// 
+void
+BatchReader::useColumns(const std::vector<size_t> &cols)
+{
+    this->m_used = cols;
+}
+
+
+/// @details
+/// Matches the types fetch() stores, other declared types are read
+/// as strings.
+Value::value_type
+BatchReader::columnType(size_t col) const
+{
+    assert(this->m_result);
+    switch(this->m_result->describeColumn(col + 1).getDatatype())
+    {
+    case dal::DAL_TYPE_BOOL:
+    case dal::DAL_TYPE_SMALLINT:
+    case dal::DAL_TYPE_USMALLINT:
+    case dal::DAL_TYPE_INT:
+    case dal::DAL_TYPE_UINT:
+    case dal::DAL_TYPE_BIGINT:
+    case dal::DAL_TYPE_UBIGINT:
+        return Value::type_int;
+    case dal::DAL_TYPE_FLOAT:
+    case dal::DAL_TYPE_DOUBLE:
+        return Value::type_float;
+    case dal::DAL_TYPE_NUMERIC:
+        return Value::type_decimal;
+    case dal::DAL_TYPE_DATE:
+    case dal::DAL_TYPE_DATETIME:
+        return Value::type_date;
+    case dal::DAL_TYPE_UNKNOWN:
+    case dal::DAL_TYPE_CUSTOM:
+        return Value::type_void;
+    default:
+        return Value::type_string;
+    }
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// BatchWriter
+
+/// Connections with an open writer transaction, per thread
+static ThreadLocal open_transactions;
+
+
+/// Record that the calling thread opened a transaction on @a dbc
+static void enter_transaction(db::Connection *dbc)
+{
+    std::vector<db::Connection*> *conns =
+        static_cast<std::vector<db::Connection*>*>(open_transactions.get());
+    if(! conns)
+    {
+        conns = new std::vector<db::Connection*>();
+        open_transactions.set(conns);
+    }
+    conns->push_back(dbc);
+}
+
+
+/// The list is freed with its last entry, so threads leave nothing
+/// behind
+static void leave_transaction(db::Connection *dbc)
+{
+    std::vector<db::Connection*> *conns =
+        static_cast<std::vector<db::Connection*>*>(open_transactions.get());
+    if(! conns)
+        return;
+    std::vector<db::Connection*>::iterator i = std::find(conns->begin(), conns->end(), dbc);
+    if(i != conns->end())
+        conns->erase(i);
+    if(conns->empty())
+    {
+        delete conns;
+        open_transactions.set(0);
+    }
+}
+
+
+/// @details
+/// 
+bool
+BatchWriter::inTransaction(db::Connection &dbc)
+{
+    const std::vector<db::Connection*> *conns =
+        static_cast<const std::vector<db::Connection*>*>(open_transactions.get());
+    return conns && std::find(conns->begin(), conns->end(), &dbc) != conns->end();
+}
+
+
+/// @details
+/// 
+BatchWriter::BatchWriter(db::Connection &dbc, const String &table,
+                         const std::vector<String> &columns, size_t commitInterval,
+                         StatementCache *cache)
+    : m_dbc(dbc),
+      m_target(),
+      m_sql(),
+      m_columns(columns.size()),
+      m_commitInterval(commitInterval),
+      m_pending(0),
+      m_rows(0),
+      m_rejected(0),
+      m_inTrans(false),
+      m_isolate(false),
+      m_cache(cache),
+      m_stmt(),
+      m_savepoint(dbc)
+{
+    std::wstringstream ss;
+    ss << L"INSERT INTO " << sql_identifier(table) << L" (";
+    for(size_t i = 0; i < columns.size(); ++i)
+        ss << (i ? L", " : L"") << sql_identifier(columns[i]);
+    ss << L")";
+    this->m_target = ss.str();
+    ss << L" VALUES (";
+    for(size_t i = 0; i < columns.size(); ++i)
+        ss << (i ? L", ?" : L"?");
+    ss << L")";
+    this->m_sql = ss.str();
+}
+
+
+/// @details
+/// 
+BatchWriter::~BatchWriter(void)
+{
+    if(this->m_inTrans)
+    {
+        leave_transaction(&this->m_dbc);
+        try
+        {
+            this->m_dbc.rollback();
+        }
+        catch(...)
+        {}
+    }
+}
+
+
+/// @details
+/// 
+void
+BatchWriter::open(void)
+{
+    this->m_stmt.prepare(this->m_dbc, this->m_sql, this->m_cache);
+    this->begin();
+}
+
+
+/// @details
+/// 
+void
+BatchWriter::begin(void)
+{
+    if(this->m_inTrans || inTransaction(this->m_dbc))
+        return;
+    this->m_dbc.beginTrans();
+    this->m_inTrans = true;
+    enter_transaction(&this->m_dbc);
+}
+
+
+/// @details
+/// The rows never reach the client. A failing row fails the
+/// statement, none of the rows is inserted then.
+void
+BatchWriter::insertFrom(const String &select)
+{
+    this->begin();
+
+    CachedStatement stmt;
+    stmt.prepare(this->m_dbc, this->m_target + String(" ") + select, this->m_cache);
+    stmt->execute();
+    this->m_rows += static_cast<size_t>(stmt->affectedRows());
+}
+
+
+/// @details
+/// The statement is prepared once, each row only binds the new
+/// values.
+void
+BatchWriter::write(const RowBatch &batch)
+{
+    assert(this->m_stmt.get() && batch.columns() == this->m_columns);
+
+    if(this->m_isolate)
+    {
+        this->writeIsolated(batch);
+        return;
+    }
+
+    for(size_t i = 0; i < batch.active(); ++i)
+    {
+        bind_row(*this->m_stmt, batch, batch.activeRow(i));
+        this->m_stmt->execute();
+        ++this->m_rows;
+
+        if(this->m_inTrans && this->m_commitInterval && ++this->m_pending == this->m_commitInterval)
+        {
+            this->beforeCommit();
+            this->m_dbc.commit();
+            this->m_dbc.beginTrans();
+            this->m_pending = 0;
+        }
+    }
+}
+
+
+/// @details
+/// Only the errors the driver reports for a row (db::Exception) are
+/// caught, any other exception fails the transfer. @a sqlstate is the
+/// state of a db::SqlstateException, HY000 for other driver errors.
+/// Drivers differ in the state a failed statement is left in, so it
+/// is prepared again.
+bool
+BatchWriter::insert(const RowBatch &batch, size_t begin, size_t end, size_t &failed,
+                    String &sqlstate, String &error)
+{
+    size_t r = begin;
+    try
+    {
+        for(; r < end; ++r)
+        {
+            bind_row(*this->m_stmt, batch, batch.activeRow(r));
+            this->m_stmt->execute();
+        }
+        return true;
+    }
+    catch(db::SqlstateException &e)
+    {
+        failed = r;
+        sqlstate = String(e.sqlstate());
+        error = String(e.what());
+    }
+    catch(db::Exception &e)
+    {
+        failed = r;
+        sqlstate = String("HY000");
+        error = String(e.what());
+    }
+    this->m_stmt->prepare(this->m_sql);
+    return false;
+}
+
+
+/// @details
+/// Rows are executed one by one, so the failing row is known and
+/// isolated in one step. Clean batches cost one savepoint, each bad
+/// row a rollback and the rows before it once more. A row which
+/// fails again after the rollback is not a row error and the
+/// transfer fails.
+void
+BatchWriter::writeIsolated(const RowBatch &batch)
+{
+    size_t begin = 0;
+    while(begin < batch.active())
+    {
+        size_t failed = 0;
+        String sqlstate, error;
+
+        this->m_savepoint.set();
+        if(this->insert(batch, begin, batch.active(), failed, sqlstate, error))
+        {
+            this->m_savepoint.release();
+            this->m_rows += batch.active() - begin;
+            break;
+        }
+
+        this->m_savepoint.rollback();
+        size_t again = 0;
+        String state, fatal;
+        if(failed > begin && ! this->insert(batch, begin, failed, again, state, fatal))
+            throw std::runtime_error(std::string(fatal));
+        this->m_savepoint.release();
+        this->m_rows += failed - begin;
+
+        ++this->m_rejected;
+        this->rejectRow(batch, batch.activeRow(failed), sqlstate, error);
+        begin = failed + 1;
+    }
+
+    if(this->m_inTrans && this->m_commitInterval)
+    {
+        this->m_pending += batch.active();
+        if(this->m_pending >= this->m_commitInterval)
+        {
+            this->beforeCommit();
+            this->m_dbc.commit();
+            this->m_dbc.beginTrans();
+            this->m_pending = 0;
+        }
+    }
+}
+
+
+/// @details
+/// 
+void
+BatchWriter::close(void)
+{
+    if(this->m_inTrans)
+    {
+        this->beforeCommit();
+        this->m_inTrans = false;
+        leave_transaction(&this->m_dbc);
+        this->m_dbc.commit();
+    }
+    this->m_stmt.release();
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// StoreBuffer
+
+/// @details
+/// 
+StoreBuffer::StoreBuffer(const String &table, const std::vector<String> &columns, size_t capacity)
+    : m_table(table),
+      m_columns(columns),
+      m_batch(columns.size(), std::max<size_t>(capacity, 1)),
+      m_rows(0),
+      m_flushes(0)
+{}
+
+
+/// @details
+/// Columns without a rule are NULL.
+bool
+StoreBuffer::add(const RuleList &rules, const ArgumentList &args)
+{
+    const size_t r = this->m_batch.rows();
+    assert(r < this->m_batch.capacity());
+    this->m_batch.resize(r + 1);
+
+    for(RuleList::const_iterator i = rules.begin(); i != rules.end(); ++i)
+    {
+        if(i->type == ColumnRule::rule_const)
+            this->m_batch.set(r, i->dest, i->value);
+        else if(i->type == ColumnRule::rule_copy && i->src < args.size())
+            this->m_batch.set(r, i->dest, args[i->src]);
+    }
+    return this->m_batch.rows() == this->m_batch.capacity();
+}
+
+
+/// @details
+/// The buffer is emptied even if the insert fails, the rows are not
+/// tried twice.
+void
+StoreBuffer::flush(db::Connection &dbc, StatementCache *cache)
+{
+    if(! this->m_batch.rows())
+        return;
+
+    BatchWriter writer(dbc, this->m_table, this->m_columns, 0, cache);
+    try
+    {
+        writer.open();
+        writer.write(this->m_batch);
+        writer.close();
+    }
+    catch(...)
+    {
+        this->m_batch.clear();
+        throw;
+    }
+    this->m_rows += this->m_batch.rows();
+    ++this->m_flushes;
+    this->m_batch.clear();
+}
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////// Key range chunks
+
+/// Split points between @a lo and @a hi for @a n chunks of equal width
+static void sample_splits(const Value &lo, const Value &hi, size_t n, std::vector<Value> &splits)
+{
+    if(lo.type() == Value::type_int && hi.type() == Value::type_int)
+    {
+        long long min = lo.asInt();
+        unsigned long long span = static_cast<unsigned long long>(hi.asInt() - min);
+        if(span < n)
+            n = static_cast<size_t>(span) + 1;
+        for(size_t i = 1; i < n; ++i)
+        {
+            // span * i / n without overflow
+            unsigned long long off = (span / n) * i + (span % n) * i / n;
+            splits.push_back(Value(static_cast<long long>(min + off)));
+        }
+    }
+    else
+    {
+        double min = lo.asDouble();
+        double width = hi.asDouble() - min;
+        for(size_t i = 1; i < n && width > 0; ++i)
+            splits.push_back(Value(min + width * i / n));
+    }
+}
+
+
+/// @details
+/// 
+ChunkList
+split_key_range(db::Connection &dbc, const String &from, const String &key,
+                size_t chunks, const std::vector<Value> &splits, const String &columns)
+{
+    std::vector<Value> bounds(splits);
+    const String column = sql_identifier(key);
+
+    if(bounds.empty() && chunks > 1)
+    {
+        std::auto_ptr<db::Statement> stmt(dbc.newStatement());
+        stmt->prepare(String("SELECT MIN(") + column + String("), MAX(") + column + String(") FROM ") + from);
+        stmt->execute();
+        db::Result &res = stmt->resultset();
+        res.first();
+        Value lo = to_value(res.column(1));
+        Value hi = to_value(res.column(2));
+
+        if(! lo.isNull() && ! hi.isNull())
+        {
+            if(lo.type() == Value::type_string || lo.type() == Value::type_date
+               || lo.type() == Value::type_lob)
+                throw std::runtime_error("key column " + std::string(key)
+                                         + " is not numeric, parallel() needs split values");
+            sample_splits(lo, hi, chunks, bounds);
+        }
+    }
+
+    const String select = String("SELECT ") + columns + String(" FROM ") + from + String(" WHERE ") + column;
+    ChunkList list;
+    KeyChunk chunk;
+
+    if(bounds.empty())
+    {
+        chunk.sql = select + String(" IS NOT NULL");
+        list.push_back(chunk);
+    }
+    else
+    {
+        chunk.sql = select + String(" < ?");
+        chunk.params.push_back(bounds.front());
+        list.push_back(chunk);
+
+        for(size_t i = 1; i < bounds.size(); ++i)
+        {
+            chunk.sql = select + String(" >= ? AND ") + column + String(" < ?");
+            chunk.params.clear();
+            chunk.params.push_back(bounds[i - 1]);
+            chunk.params.push_back(bounds[i]);
+            list.push_back(chunk);
+        }
+
+        chunk.sql = select + String(" >= ?");
+        chunk.params.clear();
+        chunk.params.push_back(bounds.back());
+        list.push_back(chunk);
+    }
+
+    chunk.sql = select + String(" IS NULL");
+    chunk.params.clear();
+    list.push_back(chunk);
+
+    return list;
+}
+
+
+
+//..............................................................................
+///////////////////////////////////////////////////////////////////// StageStats
+
+/// @details
+/// 
+void
+StageStats::merge(const StageStats &s)
+{
+    this->batches += s.batches;
+    this->stall += s.stall;
+    this->depthMax = std::max(this->depthMax, s.depthMax);
+    this->depthSum += s.depthSum;
+}
+
+
+/// @details
+/// 
+double
+StageStats::depthAvg(void) const
+{
+    return this->batches ? double(this->depthSum) / double(this->batches) : 0;
+}
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// Pipeline
+
+/// Batch in flight. The evaluated rows travel with the source rows,
+/// so the values of a slot (and the heap blocks they share) are only
+/// touched by one stage at a time.
+struct PipelineSlot
+{
+    PipelineSlot(size_t inColumns, size_t outColumns, size_t capacity)
+        : in(inColumns, capacity),
+          out(outColumns, capacity)
+    {}
+
+    RowBatch   in;
+    RowBatch   out;
+};
+
+
+typedef BoundedQueue<PipelineSlot*> SlotQueue;
+
+
+/// State shared by all pipeline stages. A null slot marks the end of
+/// the input.
+struct PipelineState
+{
+    PipelineState(size_t slots, size_t evaluators, size_t readers, const ChunkList &chunks)
+        : free(slots),
+          input(slots + evaluators),
+          output(slots + std::max<size_t>(evaluators, 1)),
+          evaluators(evaluators),
+          readers(readers),
+          chunks(chunks),
+          nextChunk(0),
+          aborted(0),
+          failed(0),
+          error()
+    {}
+
+    /// @brief Queue the readers push to
+    SlotQueue& readerOutput(void)
+    {
+        return this->evaluators ? this->input : this->output;
+    }
+
+    /// @brief Index of the next chunk to read, chunks.size() if all are taken
+    size_t takeChunk(void)
+    {
+        size_t i = static_cast<size_t>(atomic_increment(&this->nextChunk)) - 1;
+        return std::min(i, this->chunks.size());
+    }
+
+    /// @brief Stop all stages, the first error is kept
+    void fail(const std::string &msg)
+    {
+        if(atomic_cas(&this->failed, 0, 1))
+            this->error = msg;
+        this->abort();
+    }
+
+    void abort(void)
+    {
+        atomic_store(&this->aborted, 1);
+    }
+
+    bool isAborted(void) const
+    {
+        return atomic_load(&this->aborted) != 0;
+    }
+
+    SlotQueue              free;      ///< empty slots, writer -> readers
+    SlotQueue              input;     ///< read batches, readers -> evaluators
+    SlotQueue              output;    ///< evaluated batches, evaluators -> writer
+    const size_t           evaluators;
+    volatile atomic_word   readers;   ///< running readers, the last one ends the input
+    const ChunkList       &chunks;
+    volatile atomic_word   nextChunk;
+    volatile atomic_word   aborted;
+    volatile atomic_word   failed;
+    std::string            error;
+};
+
+
+/// Push a slot, waits while the queue is full. Returns false if the
+/// pipeline is aborted.
+static bool push_wait(PipelineState &state, SlotQueue &queue, PipelineSlot *slot, StageStats &stats)
+{
+    if(queue.try_push(slot))
+        return true;
+
+    double t0 = monotonic_time();
+    unsigned int round = 0;
+    while(! queue.try_push(slot))
+    {
+        if(state.isAborted())
+            return false;
+        thread_pause(round);
+    }
+    stats.stall += monotonic_time() - t0;
+    return true;
+}
+
+
+/// Pop a slot, waits while the queue is empty. Returns false if the
+/// pipeline is aborted.
+static bool pop_wait(PipelineState &state, SlotQueue &queue, PipelineSlot *&slot, StageStats &stats)
+{
+    if(queue.try_pop(slot))
+        return true;
+
+    double t0 = monotonic_time();
+    unsigned int round = 0;
+    while(! queue.try_pop(slot))
+    {
+        if(state.isAborted())
+            return false;
+        thread_pause(round);
+    }
+    stats.stall += monotonic_time() - t0;
+    return true;
+}
+
+
+/// Count a batch passed to the next stage
+static void record_push(StageStats &stats, const SlotQueue &queue)
+{
+    size_t depth = queue.size();
+    ++stats.batches;
+    stats.depthSum += depth;
+    stats.depthMax = std::max(stats.depthMax, depth);
+}
+
+
+
+//--------------------------------------------------------------------------
+/// Reader stage
+///
+/// Reads from a single reader, or takes key range chunks from the
+/// shared queue and reads them on its own connection. Without
+/// evaluator threads the reader applies the rules itself.
+///
+/// @since 0.0.1
+/// @brief Reader stage
+class ReaderStage : public Thread
+{
+public:
+    ReaderStage(PipelineState &state, BatchReader *reader, db::Connection *dbc,
+                const RuleList &rules, const std::vector<size_t> &columns,
+                StatementCache *cache = 0)
+        : Thread(),
+          stats(),
+          chunks(0),
+          m_state(state),
+          m_reader(reader),
+          m_dbc(dbc),
+          m_rules(rules),
+          m_columns(columns),
+          m_cache(cache),
+          m_chunk()
+    {}
+
+    StageStats       stats;
+    size_t           chunks;
+
+protected:
+    /// Fetch the next batch, moves on to the next chunk if the current
+    /// one is exhausted
+    size_t fetch(RowBatch &batch)
+    {
+        if(this->m_reader)
+            return this->m_reader->fetch(batch);
+
+        for(;;)
+        {
+            if(this->m_chunk.get())
+            {
+                size_t n = this->m_chunk->fetch(batch);
+                if(n)
+                    return n;
+                this->m_chunk.reset();
+            }
+
+            size_t i = this->m_state.takeChunk();
+            if(i == this->m_state.chunks.size() || this->m_state.isAborted())
+                return 0;
+            const KeyChunk &chunk = this->m_state.chunks[i];
+            this->m_chunk.reset(new BatchReader(*this->m_dbc, chunk.sql, chunk.params, this->m_cache));
+            this->m_chunk->open();
+            this->m_chunk->useColumns(this->m_columns);
+            ++this->chunks;
+        }
+    }
+
+    virtual void run(void)
+    {
+        try
+        {
+            SlotQueue &target = this->m_state.readerOutput();
+            PipelineSlot *slot = 0;
+            for(;;)
+            {
+                if(! pop_wait(this->m_state, this->m_state.free, slot, this->stats))
+                    return;
+                if(this->fetch(slot->in) == 0)
+                {
+                    this->m_state.free.try_push(slot);
+                    break;
+                }
+                if(! this->m_state.evaluators)
+                    apply_rules(this->m_rules, slot->in, slot->out);
+                if(! push_wait(this->m_state, target, slot, this->stats))
+                    return;
+                record_push(this->stats, target);
+            }
+
+            // the last reader ends the input
+            if(atomic_decrement(&this->m_state.readers) == 0)
+            {
+                size_t n = std::max<size_t>(this->m_state.evaluators, 1);
+                for(size_t i = 0; i < n; ++i)
+                {
+                    if(! push_wait(this->m_state, target, 0, this->stats))
+                        return;
+                }
+            }
+        }
+        catch(std::exception &e)
+        {
+            this->m_state.fail(e.what());
+        }
+        catch(...)
+        {
+            this->m_state.fail("unknown error in transfer reader");
+        }
+    }
+
+    PipelineState                 &m_state;
+    BatchReader                   *m_reader;
+    db::Connection                *m_dbc;
+    const RuleList                &m_rules;
+    const std::vector<size_t>     &m_columns;   ///< columns fetched from the chunks
+    StatementCache                *m_cache;
+    std::auto_ptr<BatchReader>     m_chunk;
+};
+
+
+
+//--------------------------------------------------------------------------
+/// Rule evaluator stage
+///
+/// @since 0.0.1
+/// @brief Rule evaluator stage
+class EvaluatorStage : public Thread
+{
+public:
+    EvaluatorStage(PipelineState &state, const RuleList &rules)
+        : Thread(),
+          stats(),
+          m_state(state),
+          m_rules(rules)
+    {}
+
+    StageStats       stats;
+
+protected:
+    virtual void run(void)
+    {
+        try
+        {
+            PipelineSlot *slot = 0;
+            for(;;)
+            {
+                if(! pop_wait(this->m_state, this->m_state.input, slot, this->stats))
+                    return;
+                if(! slot)
+                    break;
+                apply_rules(this->m_rules, slot->in, slot->out);
+                if(! push_wait(this->m_state, this->m_state.output, slot, this->stats))
+                    return;
+                record_push(this->stats, this->m_state.output);
+            }
+            push_wait(this->m_state, this->m_state.output, 0, this->stats);
+        }
+        catch(std::exception &e)
+        {
+            this->m_state.fail(e.what());
+        }
+        catch(...)
+        {
+            this->m_state.fail("unknown error in transfer evaluator");
+        }
+    }
+
+    PipelineState    &m_state;
+    const RuleList   &m_rules;
+};
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// Transfer
+
+/// @details
+/// 
+Transfer::Transfer(BatchReader &reader, BatchWriter &writer, const RuleList &rules,
+                   const TransferOptions &opts)
+    : m_reader(reader),
+      m_writer(writer),
+      m_rules(rules),
+      m_opts(opts),
+      m_stats(),
+      m_chunks(),
+      m_readerDbcs(),
+      m_cache(0)
+{
+    if(this->m_opts.batchSize == 0)
+        this->m_opts.batchSize = 1;
+}
+
+
+/// @details
+/// 
+void
+Transfer::partition(const ChunkList &chunks, const std::vector<db::Connection*> &readers,
+                    StatementCache *cache)
+{
+    assert(! readers.empty());
+    this->m_chunks = chunks;
+    this->m_readerDbcs = readers;
+    this->m_cache = cache;
+}
+
+
+/// @details
+/// 
+void
+Transfer::run(void)
+{
+    this->m_stats = TransferStats();
+
+    if(this->m_opts.evaluators > 0 || ! this->m_readerDbcs.empty())
+        this->runPipelined();
+    else
+        this->runSerial();
+
+    this->m_stats.rows = this->m_writer.rows();
+}
+
+
+/// @details
+/// 
+void
+Transfer::runSerial(void)
+{
+    RowBatch in(this->m_reader.columnCount(), this->m_opts.batchSize);
+    RowBatch out(this->m_writer.columns(), this->m_opts.batchSize);
+
+    this->m_stats.readers = 1;
+
+    while(this->m_reader.fetch(in))
+    {
+        this->beforeBatch(in);
+        apply_rules(this->m_rules, in, out);
+        this->m_writer.write(out);
+        this->afterBatch(in);
+        ++this->m_stats.writer.batches;
+    }
+}
+
+
+/// Join and delete the stage threads
+template<typename T>
+static void join_stages(std::vector<T*> &stages)
+{
+    for(size_t i = 0; i < stages.size(); ++i)
+    {
+        if(stages[i])
+            stages[i]->join();
+        delete stages[i];
+    }
+    stages.clear();
+}
+
+
+/// @details
+/// The calling thread is the writer stage, so beforeBatch() and
+/// afterBatch() never run concurrently with other engine code.
+void
+Transfer::runPipelined(void)
+{
+    const size_t evaluators = this->m_opts.evaluators;
+    const size_t readers = std::max<size_t>(this->m_readerDbcs.size(), 1);
+    const size_t slots = std::max<size_t>(this->m_opts.queueDepth, readers + 1);
+
+    std::vector<PipelineSlot> pool(slots, PipelineSlot(this->m_reader.columnCount(),
+                                                       this->m_writer.columns(),
+                                                       this->m_opts.batchSize));
+    PipelineState state(slots, evaluators, readers, this->m_chunks);
+    for(size_t i = 0; i < slots; ++i)
+        state.free.try_push(&pool[i]);
+
+    this->m_stats.pipelined = true;
+    this->m_stats.queueCapacity = slots;
+    this->m_stats.readers = readers;
+
+    std::vector<ReaderStage*> readerStages;
+    std::vector<EvaluatorStage*> evalStages;
+
+    try
+    {
+        for(size_t i = 0; i < readers; ++i)
+        {
+            readerStages.push_back(0);
+            if(this->m_readerDbcs.empty())
+                readerStages.back() = new ReaderStage(state, &this->m_reader, 0, this->m_rules,
+                                                      this->m_reader.usedColumns());
+            else
+                readerStages.back() = new ReaderStage(state, 0, this->m_readerDbcs[i], this->m_rules,
+                                                      this->m_reader.usedColumns(), this->m_cache);
+            readerStages.back()->start();
+        }
+        for(size_t i = 0; i < evaluators; ++i)
+        {
+            evalStages.push_back(0);
+            evalStages.back() = new EvaluatorStage(state, this->m_rules);
+            evalStages.back()->start();
+        }
+
+        // one end marker per evaluator, or one from the last reader
+        size_t done = 0;
+        while(done < std::max<size_t>(evaluators, 1))
+        {
+            PipelineSlot *slot = 0;
+            if(! pop_wait(state, state.output, slot, this->m_stats.writer) || state.isAborted())
+                break;
+            if(! slot)
+            {
+                ++done;
+                continue;
+            }
+            this->beforeBatch(slot->in);
+            this->m_writer.write(slot->out);
+            this->afterBatch(slot->in);
+            ++this->m_stats.writer.batches;
+            state.free.try_push(slot);
+        }
+    }
+    catch(...)
+    {
+        state.abort();
+        join_stages(readerStages);
+        join_stages(evalStages);
+        throw;
+    }
+
+    for(size_t i = 0; i < readerStages.size(); ++i)
+    {
+        readerStages[i]->join();
+        this->m_stats.reader.merge(readerStages[i]->stats);
+        this->m_stats.chunks += readerStages[i]->chunks;
+    }
+    for(size_t i = 0; i < evalStages.size(); ++i)
+    {
+        evalStages[i]->join();
+        this->m_stats.evaluator.merge(evalStages[i]->stats);
+    }
+    join_stages(readerStages);
+    join_stages(evalStages);
+
+    if(state.failed)
+        throw std::runtime_error(state.error);
+}
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
@@ -0,0 +1,202 @@
+//
+// utf8.hh - UTF-8 helpers
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief UTF-8 helpers
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#ifndef INFORMAVE_ARGON_UTF8_HH
+#define INFORMAVE_ARGON_UTF8_HH
+
+#include "argon/fwd.hh"
+
+#include <string>
+#include <cstddef>
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// @brief Returns true if the byte is a UTF-8 continuation byte
+inline bool utf8_is_cont(unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+
+/// @brief Returns false for bytes which never appear in UTF-8
+inline bool utf8_is_valid(unsigned char c)
+{
+    return c != 0xC0 && c != 0xC1 && c < 0xF5;
+}
+
+
+/// @brief Returns true if a code point outside ASCII can be part of
+/// an identifier
+///
+/// Letters of every script can, the Latin-1 signs, the punctuation
+/// and symbol blocks and the specials can't. The rule does not depend
+/// on the locale, so a script is split into the same tokens
+/// everywhere. UTF-16 surrogates (Win32 wchar_t) stand for letters
+/// outside the BMP.
+inline bool utf8_is_ident_cp(unsigned long cp)
+{
+    if(cp < 0xC0)
+        return cp == 0xAA || cp == 0xB5 || cp == 0xBA;
+    if(cp == 0xD7 || cp == 0xF7)
+        return false;
+    if((cp >= 0x2000 && cp <= 0x2BFF) || (cp >= 0x3000 && cp <= 0x303F))
+        return false;
+    return cp != 0xFEFF && (cp < 0xFFF0 || cp > 0xFFFF);
+}
+
+
+/// @brief Code point of the sequence starting at the lead byte @a p,
+/// U+FFFD if it is malformed or ends after @a end
+inline unsigned long utf8_peek_cp(const char *p, const char *end)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char *e = reinterpret_cast<const unsigned char*>(end);
+    unsigned char c = *s++;
+
+    unsigned long cp;
+    int n;
+    if(c < 0x80)                { return c; }
+    else if((c & 0xE0) == 0xC0) { cp = c & 0x1F; n = 1; }
+    else if((c & 0xF0) == 0xE0) { cp = c & 0x0F; n = 2; }
+    else if((c & 0xF8) == 0xF0) { cp = c & 0x07; n = 3; }
+    else                        { return 0xFFFD; }
+
+    for(; n > 0 && s != e && utf8_is_cont(*s); --n)
+        cp = (cp << 6) | (*s++ & 0x3F);
+    return n == 0 ? cp : 0xFFFD;
+}
+
+
+/// @brief Append a code point to a wide string
+///
+/// On platforms with a 16 bit wchar_t (Win32), code points outside the
+/// BMP are encoded as surrogate pairs.
+inline void utf8_append_cp(std::wstring &out, unsigned long cp)
+{
+    if(sizeof(wchar_t) == 2 && cp > 0xFFFF)
+    {
+        cp -= 0x10000;
+        out.push_back(static_cast<wchar_t>(0xD800 + (cp >> 10)));
+        out.push_back(static_cast<wchar_t>(0xDC00 + (cp & 0x3FF)));
+    }
+    else
+        out.push_back(static_cast<wchar_t>(cp));
+}
+
+
+/// @brief Decode the UTF-8 byte range [begin, end) to a String
+///
+/// Invalid sequences are replaced by U+FFFD. Pure ASCII input is
+/// copied without any decoding work.
+inline String utf8_decode(const char *begin, const char *end)
+{
+    std::wstring out;
+    out.reserve(end - begin);
+
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(begin);
+    const unsigned char *e = reinterpret_cast<const unsigned char*>(end);
+
+    while(p != e)
+    {
+        unsigned char c = *p++;
+        if(c < 0x80)
+        {
+            out.push_back(static_cast<wchar_t>(c));
+            continue;
+        }
+
+        unsigned long cp;
+        int n;
+        if((c & 0xE0) == 0xC0)      { cp = c & 0x1F; n = 1; }
+        else if((c & 0xF0) == 0xE0) { cp = c & 0x0F; n = 2; }
+        else if((c & 0xF8) == 0xF0) { cp = c & 0x07; n = 3; }
+        else                        { utf8_append_cp(out, 0xFFFD); continue; }
+
+        for(; n > 0 && p != e && utf8_is_cont(*p); --n)
+            cp = (cp << 6) | (*p++ & 0x3F);
+
+        utf8_append_cp(out, n == 0 ? cp : 0xFFFD);
+    }
+    return String(out);
+}
+
+
+/// @brief Encode a String as UTF-8
+inline std::string utf8_encode(const String &str)
+{
+    const std::wstring &in = str;
+    std::string out;
+    out.reserve(in.length());
+
+    for(std::wstring::const_iterator i = in.begin(); i != in.end(); ++i)
+    {
+        unsigned long cp = static_cast<unsigned long>(*i);
+
+        if(sizeof(wchar_t) == 2 && cp >= 0xD800 && cp <= 0xDBFF && (i+1) != in.end())
+        {
+            unsigned long lo = static_cast<unsigned long>(*++i);
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        }
+
+        if(cp < 0x80)
+            out.push_back(static_cast<char>(cp));
+        else if(cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if(cp < 0x10000)
+        {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    return out;
+}
+
+
+ARGON_NAMESPACE_END
+
+#endif
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
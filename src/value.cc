@@ -24,7 +24,411 @@
 /// @author Daniel Vogelbacher
 /// @since 0.1
 
-#include "argon/dtsengine.hh"
+#include "argon/value.hh"
+#include "thread.hh"
+
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <cwchar>
+#include <stdexcept>
+#include <new>
+
+ARGON_NAMESPACE_BEGIN
+
+
+/// 10^n for decimal scales
+static const long long pow10_table[Value::max_scale + 1] =
+{
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL,
+    1000000000000LL, 10000000000000LL, 100000000000000LL,
+    1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL
+};
+
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////// DateTime
+
+/// @details
+/// 
+bool
+DateTime::operator==(const DateTime &o) const
+{
+    return this->year == o.year && this->month == o.month && this->day == o.day
+        && this->hour == o.hour && this->minute == o.minute && this->second == o.second
+        && this->fraction == o.fraction;
+}
+
+
+
+//..............................................................................
+////////////////////////////////////////////////////////////////////////// Value
+
+/// @details
+/// 
+Value::Value(const String &str)
+    : m_type(type_void),
+      m_len(0)
+{
+    this->assignString(str.data(), str.length());
+}
+
+
+/// @details
+/// 
+Value::Value(const wchar_t *str)
+    : m_type(type_void),
+      m_len(0)
+{
+    this->assignString(str, std::wcslen(str));
+}
+
+
+/// @details
+/// 
+Value::Value(const wchar_t *str, size_t len)
+    : m_type(type_void),
+      m_len(0)
+{
+    this->assignString(str, len);
+}
+
+
+/// @details
+/// Heap blocks are shared, everything else is a plain copy.
+Value::Value(const Value &v)
+    : m_type(v.m_type),
+      m_len(v.m_len),
+      m_data(v.m_data)
+{
+    if(this->isHeap())
+        atomic_increment(&this->m_data.heap->refs);
+}
+
+
+/// @details
+/// 
+Value&
+Value::operator=(const Value &v)
+{
+    if(v.isHeap())
+        atomic_increment(&v.m_data.heap->refs);
+    if(this->isHeap())
+        this->release();
+
+    this->m_type = v.m_type;
+    this->m_len = v.m_len;
+    this->m_data = v.m_data;
+    return *this;
+}
+
+
+/// @details
+/// 
+void
+Value::release(void)
+{
+    if(atomic_decrement(&this->m_data.heap->refs) == 0)
+        ::operator delete(this->m_data.heap);
+}
+
+
+/// @details
+/// 
+void
+Value::assignString(const wchar_t *str, size_t len)
+{
+    this->m_type = type_string;
+    if(len <= short_string_max)
+    {
+        this->m_len = static_cast<unsigned char>(len);
+        std::memcpy(this->m_data.str, str, len * sizeof(wchar_t));
+    }
+    else
+    {
+        HeapBlock *block = static_cast<HeapBlock*>(::operator new(sizeof(HeapBlock) + len * sizeof(wchar_t)));
+        block->refs = 1;
+        block->size = len;
+        std::memcpy(block + 1, str, len * sizeof(wchar_t));
+        this->m_len = heap_len;
+        this->m_data.heap = block;
+    }
+}
+
+
+/// @details
+/// 
+Value
+Value::null(void)
+{
+    Value v;
+    v.m_type = type_null;
+    return v;
+}
+
+
+/// @details
+/// 
+Value
+Value::decimal(long long unscaled, unsigned int scale)
+{
+    if(scale > max_scale)
+        throw std::runtime_error("decimal scale out of range");
+
+    Value v;
+    v.m_type = type_decimal;
+    v.m_data.dec.unscaled = unscaled;
+    v.m_data.dec.scale = scale;
+    return v;
+}
+
+
+/// @details
+/// 
+Value
+Value::date(const DateTime &dt)
+{
+    Value v;
+    v.m_type = type_date;
+    v.m_data.date = dt;
+    return v;
+}
+
+
+/// @details
+/// 
+Value
+Value::lob(const void *data, size_t size)
+{
+    Value v;
+    HeapBlock *block = static_cast<HeapBlock*>(::operator new(sizeof(HeapBlock) + size));
+    block->refs = 1;
+    block->size = size;
+    std::memcpy(block + 1, data, size);
+    v.m_type = type_lob;
+    v.m_data.heap = block;
+    return v;
+}
+
+
+/// @details
+/// 
+long long
+Value::asInt(void) const
+{
+    switch(this->m_type)
+    {
+    case type_int:
+        return this->m_data.i;
+    case type_decimal:
+        return this->m_data.dec.unscaled / pow10_table[this->m_data.dec.scale];
+    case type_float:
+        return static_cast<long long>(this->m_data.f);
+    default:
+        throw std::runtime_error("value is not a number");
+    }
+}
+
+
+/// @details
+/// 
+double
+Value::asDouble(void) const
+{
+    switch(this->m_type)
+    {
+    case type_int:
+        return static_cast<double>(this->m_data.i);
+    case type_decimal:
+        return static_cast<double>(this->m_data.dec.unscaled)
+            / static_cast<double>(pow10_table[this->m_data.dec.scale]);
+    case type_float:
+        return this->m_data.f;
+    default:
+        throw std::runtime_error("value is not a number");
+    }
+}
+
+
+/// @details
+/// 
+long long
+Value::asDecimal(unsigned int &scale) const
+{
+    switch(this->m_type)
+    {
+    case type_int:
+        scale = 0;
+        return this->m_data.i;
+    case type_decimal:
+        scale = this->m_data.dec.scale;
+        return this->m_data.dec.unscaled;
+    case type_float:
+        throw std::runtime_error("float value has no exact decimal representation");
+    default:
+        throw std::runtime_error("value is not a number");
+    }
+}
+
+
+/// @details
+/// 
+const DateTime&
+Value::asDate(void) const
+{
+    if(this->m_type != type_date)
+        throw std::runtime_error("value is not a date");
+    return this->m_data.date;
+}
+
+
+/// @details
+/// 
+const wchar_t*
+Value::strData(void) const
+{
+    if(this->m_type != type_string)
+        throw std::runtime_error("value is not a string");
+    if(this->m_len == heap_len)
+        return static_cast<const wchar_t*>(this->heapData());
+    return this->m_data.str;
+}
+
+
+/// @details
+/// 
+size_t
+Value::strLength(void) const
+{
+    if(this->m_type != type_string)
+        throw std::runtime_error("value is not a string");
+    if(this->m_len == heap_len)
+        return this->m_data.heap->size;
+    return this->m_len;
+}
+
+
+/// @details
+/// 
+const char*
+Value::lobData(void) const
+{
+    if(this->m_type != type_lob)
+        throw std::runtime_error("value is not a LOB");
+    return static_cast<const char*>(this->heapData());
+}
+
+
+/// @details
+/// 
+size_t
+Value::lobSize(void) const
+{
+    if(this->m_type != type_lob)
+        throw std::runtime_error("value is not a LOB");
+    return this->m_data.heap->size;
+}
+
+
+/// @details
+/// NULL and void are represented as empty string, dates in ISO
+/// format.
+String
+Value::asString(void) const
+{
+    std::wstringstream ss;
+
+    switch(this->m_type)
+    {
+    case type_void:
+    case type_null:
+        return String();
+    case type_string:
+        return String(std::wstring(this->strData(), this->strLength()));
+    case type_int:
+        ss << this->m_data.i;
+        break;
+    case type_float:
+        ss << std::setprecision(15) << this->m_data.f;
+        break;
+    case type_decimal:
+    {
+        const Decimal &d = this->m_data.dec;
+        if(d.scale == 0)
+        {
+            ss << d.unscaled;
+            break;
+        }
+        long long p = pow10_table[d.scale];
+        long long ip = d.unscaled / p;
+        long long fp = d.unscaled % p;
+        if(d.unscaled < 0)
+        {
+            ss << L'-';
+            ip = -ip;
+            fp = -fp;
+        }
+        ss << ip << L'.' << std::setw(d.scale) << std::setfill(L'0') << fp;
+        break;
+    }
+    case type_date:
+    {
+        const DateTime &dt = this->m_data.date;
+        ss << std::setfill(L'0')
+           << std::setw(4) << dt.year << L'-'
+           << std::setw(2) << int(dt.month) << L'-'
+           << std::setw(2) << int(dt.day) << L' '
+           << std::setw(2) << int(dt.hour) << L':'
+           << std::setw(2) << int(dt.minute) << L':'
+           << std::setw(2) << int(dt.second);
+        if(dt.fraction)
+            ss << L'.' << std::setw(9) << dt.fraction;
+        break;
+    }
+    case type_lob:
+        throw std::runtime_error("LOB can not be converted to string");
+    }
+    return ss.str();
+}
+
+
+/// @details
+/// 
+bool
+Value::operator==(const Value &v) const
+{
+    if(this->m_type != v.m_type)
+        return false;
+
+    switch(this->m_type)
+    {
+    case type_void:
+    case type_null:
+        return true;
+    case type_int:
+        return this->m_data.i == v.m_data.i;
+    case type_float:
+        return this->m_data.f == v.m_data.f;
+    case type_decimal:
+        return this->m_data.dec.unscaled == v.m_data.dec.unscaled
+            && this->m_data.dec.scale == v.m_data.dec.scale;
+    case type_date:
+        return this->m_data.date == v.m_data.date;
+    case type_string:
+        return this->strLength() == v.strLength()
+            && std::wmemcmp(this->strData(), v.strData(), this->strLength()) == 0;
+    case type_lob:
+        return this->lobSize() == v.lobSize()
+            && std::memcmp(this->lobData(), v.lobData(), this->lobSize()) == 0;
+    }
+    return false;
+}
+
+
+ARGON_NAMESPACE_END
 
 
 //
@@ -0,0 +1,533 @@
+//
+// vm.cc - Bytecode and interpreter for task bodies (definition)
+//
+// Copyright (C)         informave.org
+//   2010,               Daniel Vogelbacher <daniel@vogelbacher.name>
+// 
+// Lesser GPL 3.0 License
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+// 
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+/// @file
+/// @brief Bytecode and interpreter for task bodies (definition)
+/// @author Daniel Vogelbacher
+/// @since 0.1
+
+#include "argon/vm.hh"
+#include "argon/dtsengine.hh"
+#include "argon/exceptions.hh"
+#include "argon/rowbatch.hh"
+#include "argon/transfer.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cassert>
+
+#if defined(__GNUC__) && ! defined(ARGON_VM_SWITCH_DISPATCH)
+#define ARGON_VM_THREADED
+#endif
+
+ARGON_NAMESPACE_BEGIN
+
+
+//..............................................................................
+/////////////////////////////////////////////////////////////////////////// Code
+
+/// @details
+/// 
+Code::Code(void)
+    : m_code(),
+      m_strings(),
+      m_values(),
+      m_readsRow(false)
+{}
+
+
+/// @details
+/// 
+void
+Code::emit(opcode op, unsigned int arg)
+{
+    Instr i;
+    i.op = op;
+    i.arg = arg;
+    this->m_code.push_back(i);
+}
+
+
+/// @details
+/// 
+unsigned int
+Code::addString(const String &str)
+{
+    this->m_strings.push_back(str);
+    return static_cast<unsigned int>(this->m_strings.size() - 1);
+}
+
+
+/// @details
+/// 
+unsigned int
+Code::addValue(const Value &value)
+{
+    this->m_values.push_back(value);
+    return static_cast<unsigned int>(this->m_values.size() - 1);
+}
+
+
+/// @details
+/// Template arguments (objects and identifiers) are not part of the
+/// body and skipped.
+void
+Code::compile(Processor &proc, TaskNode *node)
+{
+    this->m_code.clear();
+
+    for(Node *child = node->firstChild(); child; child = child->nextSibling())
+    {
+        if(child->kind() != Node::kind_object && child->kind() != Node::kind_id)
+            this->compileStatement(proc, child, CodeScope(node));
+    }
+
+    this->finish();
+}
+
+
+/// @details
+/// Token nodes only carry source information and are skipped. The
+/// arguments of exec task are passed in order and must match the
+/// parameters of the called task.
+void
+Code::compileStatement(Processor &proc, Node *node, const CodeScope &scope)
+{
+    switch(node->kind())
+    {
+    case Node::kind_log:
+        this->compileLog(proc, static_cast<LogNode*>(node), scope);
+        break;
+    case Node::kind_taskexec:
+    {
+        Identifier id = static_cast<TaskExecNode*>(node)->taskid();
+        unsigned int slot = proc.resolveSymbol(id, node->getSourceInfo());
+        Task *task = dynamic_cast<Task*>(proc.slot(slot));
+        if(! task)
+            throw TypeMismatch(id, "TASK", proc.slot(slot)->type(), node->getSourceInfo());
+
+        size_t args = 0;
+        for(Node *arg = node->firstChild(); arg; arg = arg->nextSibling())
+        {
+            if(arg->kind() == Node::kind_token)
+                continue;
+            this->compileArg(arg, scope);
+            ++args;
+        }
+        if(args != task->node()->params.size())
+        {
+            std::stringstream ss;
+            ss << "task " << std::string(id.str()) << " takes " << task->node()->params.size()
+               << " arguments, " << args << " given";
+            throw CompileError(node->getSourceInfo(), ss.str());
+        }
+        this->emit(op_call, slot);
+        break;
+    }
+    case Node::kind_token:
+        break;
+    case Node::kind_colassign:
+        throw CompileError(node->getSourceInfo(), "column assignments are only allowed in transfer tasks");
+    case Node::kind_section:
+        throw CompileError(node->getSourceInfo(), "sections are only allowed in transfer tasks");
+    default:
+        throw std::runtime_error("can not compile node: " + std::string(node->str()));
+    }
+}
+
+
+/// @details
+/// 
+void
+Code::finish(void)
+{
+    this->emit(op_ret);
+}
+
+
+/// The field of the rejected row @a id names in an except section,
+/// -1 if it names none
+static int reject_field(const CodeScope &scope, const Identifier &id)
+{
+    if(! scope.results)
+        return -1;
+    if(id.name() == String("sqlstate"))
+        return 0;
+    if(id.name() == String("sqlerror"))
+        return 1;
+    return -1;
+}
+
+
+/// @details
+/// A source column is read from the current row, so the code runs
+/// for each row then (see readsRow()).
+void
+Code::compileArg(Node *node, const CodeScope &scope)
+{
+    switch(node->kind())
+    {
+    case Node::kind_literal:
+        this->emit(op_arg_const, this->addValue(Value(static_cast<LiteralNode*>(node)->m_data)));
+        break;
+    case Node::kind_number:
+        try
+        {
+            this->emit(op_arg_const, this->addValue(parse_number(static_cast<NumberNode*>(node)->m_data)));
+        }
+        catch(std::runtime_error &e)
+        {
+            throw CompileError(node->getSourceInfo(), e.what());
+        }
+        break;
+    case Node::kind_id:
+    {
+        Identifier id = static_cast<IdNode*>(node)->data();
+        int i = scope.task ? scope.task->paramIndex(id) : -1;
+        if(i >= 0)
+            this->emit(op_arg_param, static_cast<unsigned int>(i));
+        else if((i = reject_field(scope, id)) >= 0)
+            this->emit(op_arg_reject, static_cast<unsigned int>(i));
+        else
+            throw CompileError(node->getSourceInfo(), std::string(id.str()) + " is not a parameter of the task");
+        break;
+    }
+    case Node::kind_column:
+    {
+        ColumnNode *col = static_cast<ColumnNode*>(node);
+        if(col->m_result)
+        {
+            if(! scope.results)
+                throw CompileError(node->getSourceInfo(), "destination columns can only be passed "
+                                   "from the except section of a transfer");
+            std::vector<String>::const_iterator i =
+                std::find(scope.results->begin(), scope.results->end(), col->colname());
+            if(i == scope.results->end())
+                throw CompileError(node->getSourceInfo(), std::string(col->colname())
+                                   + " is not assigned by the rules of the transfer");
+            this->emit(op_arg_result, static_cast<unsigned int>(i - scope.results->begin()));
+            break;
+        }
+        if(! scope.columns)
+            throw CompileError(node->getSourceInfo(), "source columns can only be passed from the "
+                               "before, rules and after sections of a transfer");
+        std::vector<String>::const_iterator i =
+            std::find(scope.columns->begin(), scope.columns->end(), col->colname());
+        assert(i != scope.columns->end());
+        this->emit(op_arg_column, static_cast<unsigned int>(i - scope.columns->begin()));
+        this->m_readsRow = true;
+        break;
+    }
+    default:
+        throw CompileError(node->getSourceInfo(), "can not pass this value to a task");
+    }
+}
+
+
+/// @details
+/// Consecutive literals are merged into a single constant. A
+/// parameter, sqlstate and sqlerror hide a symbol of the same name.
+void
+Code::compileLog(Processor &proc, LogNode *node, const CodeScope &scope)
+{
+    this->emit(op_log_begin);
+
+    bool merge = false;
+    for(Node *child = node->firstChild(); child; child = child->nextSibling())
+    {
+        switch(child->kind())
+        {
+        case Node::kind_literal:
+            if(merge)
+                this->m_strings.back().append(static_cast<LiteralNode*>(child)->m_data);
+            else
+                this->emit(op_log_lit, this->addString(static_cast<LiteralNode*>(child)->m_data));
+            merge = true;
+            break;
+        case Node::kind_id:
+        {
+            Identifier id = static_cast<IdNode*>(child)->data();
+            int i = scope.task ? scope.task->paramIndex(id) : -1;
+            if(i >= 0)
+                this->emit(op_log_param, static_cast<unsigned int>(i));
+            else if((i = reject_field(scope, id)) >= 0)
+                this->emit(op_log_reject, static_cast<unsigned int>(i));
+            else
+                this->emit(op_log_sym, proc.resolveSymbol(id, child->getSourceInfo()));
+            merge = false;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    this->emit(op_log_end);
+}
+
+
+/// @details
+/// 
+String
+Code::str(void) const
+{
+    static const char *names[op_count] =
+        { "ret", "log_begin", "log_lit", "log_sym", "log_param", "log_reject", "log_end",
+          "arg_const", "arg_param", "arg_column", "arg_result", "arg_reject", "call" };
+
+    std::wstringstream ss;
+    for(size_t i = 0; i < this->m_code.size(); ++i)
+    {
+        const Instr &in = this->m_code[i];
+        ss << i << L": " << String(names[in.op]);
+        switch(in.op)
+        {
+        case op_log_lit:
+            ss << L" \"" << this->string(in.arg) << L"\"";
+            break;
+        case op_arg_const:
+            ss << L" " << this->value(in.arg).asString();
+            break;
+        case op_log_sym:
+        case op_log_param:
+        case op_log_reject:
+        case op_arg_param:
+        case op_arg_column:
+        case op_arg_result:
+        case op_arg_reject:
+        case op_call:
+            ss << L" #" << in.arg;
+            break;
+        default:
+            break;
+        }
+        ss << std::endl;
+    }
+    return ss.str();
+}
+
+
+
+//..............................................................................
+//////////////////////////////////////////////////////////////////// Interpreter
+
+/// @details
+/// 
+Interpreter::Interpreter(Processor &proc, const ArgumentList *params)
+    : m_proc(proc),
+      m_log(),
+      m_params(params),
+      m_args(),
+      m_batch(0),
+      m_columns(0),
+      m_row(0)
+{}
+
+
+/// @details
+/// 
+void
+Interpreter::setRow(const RowBatch &batch, const std::vector<size_t> &columns, size_t row)
+{
+    this->m_batch = &batch;
+    this->m_columns = &columns;
+    this->m_row = row;
+}
+
+
+/// @details
+/// 
+void
+Interpreter::setReject(const RowBatch &batch, size_t row, const String &sqlstate,
+                       const String &error)
+{
+    this->m_batch = &batch;
+    this->m_columns = 0;
+    this->m_row = row;
+    this->m_reject[0] = Value(sqlstate);
+    this->m_reject[1] = Value(error);
+}
+
+
+/// @details
+/// The calling task may pass fewer values than there are parameters
+/// only if it is the main task, the others are NULL.
+Value
+Interpreter::param(unsigned int i) const
+{
+    if(this->m_params && i < this->m_params->size())
+        return (*this->m_params)[i];
+    return Value::null();
+}
+
+
+#if defined(ARGON_VM_THREADED)
+# define VM_DISPATCH()  __extension__ ({ goto *labels[ip->op]; })
+# define VM_BEGIN       VM_DISPATCH();
+# define VM_END
+# define VM_OP(op)      L_##op:
+# define VM_NEXT()      ++ip; VM_DISPATCH()
+#else
+# define VM_BEGIN       for(;;) { switch(ip->op) {
+# define VM_END         default: assert(! "invalid opcode"); return; } }
+# define VM_OP(op)      case op:
+# define VM_NEXT()      ++ip; continue
+#endif
+
+
+/// @details
+/// The code is verified by Code::compile(), so the loop does no
+/// bounds checks. Every body ends with op_ret.
+void
+Interpreter::exec(const Code &code)
+{
+#if defined(ARGON_VM_THREADED)
+    static void *const labels[op_count] =
+    {
+        __extension__ &&L_op_ret,
+        __extension__ &&L_op_log_begin,
+        __extension__ &&L_op_log_lit,
+        __extension__ &&L_op_log_sym,
+        __extension__ &&L_op_log_param,
+        __extension__ &&L_op_log_reject,
+        __extension__ &&L_op_log_end,
+        __extension__ &&L_op_arg_const,
+        __extension__ &&L_op_arg_param,
+        __extension__ &&L_op_arg_column,
+        __extension__ &&L_op_arg_result,
+        __extension__ &&L_op_arg_reject,
+        __extension__ &&L_op_call
+    };
+#endif
+
+    const Instr *ip = code.instructions();
+    this->m_args.clear();
+
+    VM_BEGIN
+
+    VM_OP(op_ret)
+    {
+        return;
+    }
+
+    VM_OP(op_log_begin)
+    {
+        this->m_log.clear();
+        VM_NEXT();
+    }
+
+    VM_OP(op_log_lit)
+    {
+        this->m_log.append(code.string(ip->arg));
+        VM_NEXT();
+    }
+
+    VM_OP(op_log_sym)
+    {
+        this->m_log.append(this->m_proc.slot(ip->arg)->str());
+        VM_NEXT();
+    }
+
+    VM_OP(op_log_param)
+    {
+        this->m_log.append(this->param(ip->arg).asString());
+        VM_NEXT();
+    }
+
+    VM_OP(op_log_reject)
+    {
+        this->m_log.append(this->m_reject[ip->arg].asString());
+        VM_NEXT();
+    }
+
+    VM_OP(op_log_end)
+    {
+        this->m_proc.print(String("[LOG]: ") + this->m_log);
+        VM_NEXT();
+    }
+
+    VM_OP(op_arg_const)
+    {
+        this->m_args.push_back(code.value(ip->arg));
+        VM_NEXT();
+    }
+
+    VM_OP(op_arg_param)
+    {
+        this->m_args.push_back(this->param(ip->arg));
+        VM_NEXT();
+    }
+
+    VM_OP(op_arg_column)
+    {
+        // set by setRow() before code which reads the row runs
+        assert(this->m_batch);
+        this->m_args.push_back(this->m_batch->value(this->m_row, (*this->m_columns)[ip->arg]));
+        VM_NEXT();
+    }
+
+    VM_OP(op_arg_result)
+    {
+        // set by setReject() before an except section runs
+        assert(this->m_batch);
+        this->m_args.push_back(this->m_batch->value(this->m_row, ip->arg));
+        VM_NEXT();
+    }
+
+    VM_OP(op_arg_reject)
+    {
+        this->m_args.push_back(this->m_reject[ip->arg]);
+        VM_NEXT();
+    }
+
+    VM_OP(op_call)
+    {
+        // the slot type and the number of arguments were checked by
+        // Code::compile()
+        Task *task = static_cast<Task*>(this->m_proc.slot(ip->arg));
+        this->m_proc.call(task, this->m_args);
+        this->m_args.clear();
+        VM_NEXT();
+    }
+
+    VM_END
+}
+
+#undef VM_DISPATCH
+#undef VM_BEGIN
+#undef VM_END
+#undef VM_OP
+#undef VM_NEXT
+
+
+ARGON_NAMESPACE_END
+
+
+//
+// Local Variables:
+// mode: C++
+// c-file-style: "bsd"
+// c-basic-offset: 4
+// indent-tabs-mode: nil
+// End:
+//
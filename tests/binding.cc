@@ -0,0 +1,124 @@
+//
+// Column binding: rule columns are resolved when a transfer opens,
+// unknown source or destination columns fail with the position of the
+// rule before a row is written. %column reads a column assigned by an
+// earlier rule, names match ignoring the case.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    "   $id <- $ID;\n"
+    "   $name <- $name;\n"
+    "   $ref <- %id;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+// unknown source column on line 7
+static const char *bad_source =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    "   $id <- $id;\n"
+    "   $name <- $nmae;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+// unknown destination column on line 6
+static const char *bad_dest =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    "   $ident <- $id;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+// %ref is assigned after it is read
+static const char *bad_order =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    "   $id <- %ref;\n"
+    "   $ref <- $id;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Runs a script, returns the error message or an empty string
+static std::string run(db::Connection &src, db::Connection &dst, const char *text)
+{
+    dst.directCmd("DELETE FROM t");
+
+    ScriptRun runner;
+    runner.engine().transferOptions().batchSize = 10;
+    runner.engine().addConnection("src", &src);
+    runner.engine().addConnection("dst", &dst);
+    runner.exec(text);
+    return runner.error();
+}
+
+
+int main(void)
+{
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    src->connect(":memory:");
+    dst->connect(":memory:");
+
+    src->directCmd("CREATE TABLE t (id INTEGER, name TEXT, unused TEXT)");
+    dst->directCmd("CREATE TABLE t (id INTEGER, name TEXT, ref INTEGER)");
+    for(int i = 0; i < 25; ++i)
+    {
+        std::stringstream ss;
+        ss << "INSERT INTO t VALUES (" << i << ", 'n" << i << "', 'x')";
+        src->directCmd(ss.str());
+    }
+
+    std::string ok = run(*src, *dst, script);
+    long long copied = count_rows(*dst, "SELECT COUNT(*) FROM t WHERE ref = id AND name = 'n' || id");
+    std::string source = run(*src, *dst, bad_source);
+    long long sourceRows = count_rows(*dst, "SELECT COUNT(*) FROM t");
+    std::string dest = run(*src, *dst, bad_dest);
+    std::string order = run(*src, *dst, bad_order);
+
+    if(! ok.empty() || copied != 25)
+    {
+        std::cerr << "transfer: " << copied << " rows " << ok << std::endl;
+        ++errors;
+    }
+    if(source.find(":7:") == std::string::npos || source.find("nmae") == std::string::npos
+       || sourceRows != 0)
+    {
+        std::cerr << "unknown source column: " << source << std::endl;
+        ++errors;
+    }
+    if(dest.find(":6:") == std::string::npos || dest.find("ident") == std::string::npos)
+    {
+        std::cerr << "unknown destination column: " << dest << std::endl;
+        ++errors;
+    }
+    if(order.find(":6:") == std::string::npos)
+    {
+        std::cerr << "%column before its assignment: " << order << std::endl;
+        ++errors;
+    }
+
+    return errors;
+}
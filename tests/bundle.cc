@@ -0,0 +1,177 @@
+//
+// Bundles: a written bundle loads the same tree as its source. A
+// bundle with a flipped byte, another format version, a truncated
+// bundle and a bundle older than its source are not used, the source
+// is parsed instead.
+//
+
+#include "test_util.hh"
+
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+
+using namespace informave::argon;
+
+
+struct TreeEngine : public DTSEngine
+{
+    ParseTree* tree(void) { return this->m_tree.get(); }
+};
+
+
+/// Source position of every node
+struct Positions
+{
+    Positions(std::wstringstream &out) : m_out(out)
+    {}
+
+    void operator()(Node *node)
+    {
+        SourceInfo si = node->getSourceInfo();
+        this->m_out << node->kind() << L" " << si.sourceName() << L":" << si.linenum() << L":"
+                    << si.offset() << L"+" << si.length() << std::endl;
+    }
+
+    std::wstringstream &m_out;
+};
+
+
+static const char *srcfile = "bundle_test.argon";
+static const char *bundlefile = "bundle_test.argc";
+
+// the version word follows the magic and the byte order mark
+static const size_t version_offset = 8;
+
+
+static const char *script =
+    "connection src;\n"
+    "connection dst type \"sqlite:libsqlite\" dbcstr \":memory:\";\n"
+    "program.\n"
+    "task mark(id) as void begin log \"marked\" id; end;\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"s\", parallel(2, id))]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    "   $name <- @$name;\n"
+    "   $ref <- %id;\n"
+    "   $price <- 2.5;\n"
+    "   $note <- null;\n"
+    " after:\n"
+    "   exec task mark($id);\n"
+    "end;\n"
+    "task main() as void begin log \"start\" mark; exec task copy; end;\n";
+
+static const char *changed_script =
+    "program.\n"
+    "task main() as void begin log \"changed\"; end;\n";
+
+
+static std::string read_file(const char *path)
+{
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+
+static void write_file(const char *path, const std::string &data)
+{
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+}
+
+
+/// Tree printout and node positions of the loaded script
+static std::wstring printout(TreeEngine &engine)
+{
+    std::wstringstream out;
+    Processor proc(engine);
+    foreach_node(engine.tree(), PrintTreeVisitor(proc, out), 1);
+    Positions op(out);
+    walk_node(static_cast<Node*>(engine.tree()), op, -1);
+    return out.str();
+}
+
+
+/// Loads the bundle (or the source), @a used is set if the bundle was used
+static std::wstring load(bool &used)
+{
+    TreeEngine engine;
+    used = engine.loadBundle(bundlefile, srcfile);
+    return printout(engine);
+}
+
+
+/// Writes @a data as bundle and checks that the source is loaded
+static int rejected(const char *what, const std::string &data, const std::wstring &expect)
+{
+    write_file(bundlefile, data);
+    bool used = true;
+    std::wstring tree = load(used);
+    if(used || tree != expect)
+    {
+        std::cerr << what << ": " << (used ? "bundle used" : "wrong tree") << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(void)
+{
+    int errors = 0;
+
+    std::remove(bundlefile);
+    write_file(srcfile, script);
+
+    std::wstring source, bundled;
+    std::string bundle;
+    bool used = false;
+    {
+        TreeEngine engine;
+        engine.load(srcfile);
+        source = printout(engine);
+        engine.writeBundle(bundlefile, srcfile);
+    }
+    bundle = read_file(bundlefile);
+
+    bundled = load(used);
+    if(! used || bundled != source)
+    {
+        std::wcerr << L"round trip, bundle " << (used ? L"used" : L"not used") << std::endl
+                   << L"source:" << std::endl << source
+                   << L"bundle:" << std::endl << bundled;
+        ++errors;
+    }
+
+    std::string flipped(bundle);
+    flipped[flipped.size() - 5] ^= 0x10;
+    errors += rejected("flipped byte", flipped, source);
+
+    std::string version(bundle);
+    unsigned int v;
+    std::memcpy(&v, version.data() + version_offset, sizeof(v));
+    ++v;
+    std::memcpy(&version[version_offset], &v, sizeof(v));
+    errors += rejected("other version", version, source);
+
+    errors += rejected("truncated", bundle.substr(0, bundle.size() - 10), source);
+    errors += rejected("header only", bundle.substr(0, 20), source);
+
+    // the source changes after the bundle was written
+    std::wstring changed;
+    write_file(srcfile, changed_script);
+    {
+        TreeEngine engine;
+        engine.load(srcfile);
+        changed = printout(engine);
+    }
+    errors += rejected("stale", bundle, changed);
+
+    std::remove(bundlefile);
+    std::remove(srcfile);
+
+    return errors;
+}
@@ -0,0 +1,156 @@
+//
+// Connection pool: two tasks read the same pooled source at the same
+// time, a task called from a finalization section shares the
+// connection of its caller, an unused connection is never opened and
+// a connection which can not be opened is reported with its line.
+//
+
+#include "test_util.hh"
+
+#include <cstdio>
+
+using namespace informave::argon;
+
+
+static const char *dbfile = "connpool.db";
+
+
+// dst1 has no factory, so stage runs on the connection copy1 holds
+static const char *script =
+    "connection src;\n"
+    "connection dst1;\n"
+    "connection dst2;\n"
+    "connection unused type \"sqlite:libsqlite\" dbcstr \"/nonexistent/connpool.db\";\n"
+    "program.\n"
+    "task stage() as transfer[table(dst1, \"staged\"), table(dst1, \"t\")]\n"
+    "begin $id <- $id; end;\n"
+    "task copy1() as transfer[table(dst1, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    " finalization:\n"
+    "   exec task stage;\n"
+    "end;\n"
+    "task copy2() as transfer[table(dst2, \"t\"), table(src, \"t\")]\n"
+    "begin $id <- $id; end;\n"
+    "task main() as void\n"
+    "begin\n"
+    "   exec task copy1;\n"
+    "   exec task copy2;\n"
+    "end;\n";
+
+
+struct CountingFactory : public ConnectionFactory
+{
+    CountingFactory(db::Database::Environment &e)
+        : env(e),
+          opened(0)
+    {}
+
+    virtual db::Connection* newConnection(void)
+    {
+        std::auto_ptr<db::Connection> dbc(env.newConnection());
+        dbc->connect(dbfile);
+        ++opened;
+        return dbc.release();
+    }
+
+    db::Database::Environment   &env;
+    int                          opened;
+};
+
+
+// bad is used by main, its definition is on line 2
+static const char *bad_script =
+    "connection dbo;\n"
+    "connection bad type \"sqlite:libsqlite\" dbcstr \"/nonexistent/connpool.db\";\n"
+    "program.\n"
+    "task copy() as transfer[table(dbo, \"t\"), table(bad, \"t\")]\n"
+    "begin $id <- $id; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+int main(void)
+{
+    const int rows = 20000;
+    int errors = 0;
+
+    std::remove(dbfile);
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst1(env.newConnection());
+    std::auto_ptr<db::Connection> dst2(env.newConnection());
+    src->connect(dbfile);
+    dst1->connect(":memory:");
+    dst2->connect(":memory:");
+
+    src->directCmd("CREATE TABLE t (id INTEGER)");
+    dst1->directCmd("CREATE TABLE t (id INTEGER)");
+    dst1->directCmd("CREATE TABLE staged (id INTEGER)");
+    dst2->directCmd("CREATE TABLE t (id INTEGER)");
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO t (id) VALUES (?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            ins->execute();
+        }
+        src->commit();
+    }
+
+    CountingFactory factory(env);
+
+    {
+        ScriptRun runner;
+        runner.engine().setJobs(2);
+        runner.engine().poolOptions().maxSize = 2;
+        runner.engine().addConnection("src", src.get(), &factory);
+        runner.engine().addConnection("dst1", dst1.get());
+        runner.engine().addConnection("dst2", dst2.get());
+        if(runner.exec(script) < 0)
+        {
+            std::cerr << "failed: " << runner.error() << std::endl;
+            ++errors;
+        }
+    }
+
+    std::string error;
+    {
+        ScriptRun runner;
+        runner.engine().addConnection("dbo", dst2.get());
+        runner.exec(bad_script, String("bad.argon"));
+        error = runner.error();
+    }
+
+    if(error.find("bad.argon:2: (AEC7001)") == std::string::npos)
+    {
+        std::cerr << "bad connection not reported: " << error << std::endl;
+        ++errors;
+    }
+
+    if(count_rows(*dst1, "SELECT COUNT(*) FROM t") != rows
+       || count_rows(*dst1, "SELECT COUNT(*) FROM staged") != rows
+       || count_rows(*dst2, "SELECT COUNT(*) FROM t") != rows)
+    {
+        std::cerr << "wrong row count" << std::endl;
+        ++errors;
+    }
+
+    // the pool of src has two connections at most
+    if(factory.opened > 1)
+    {
+        std::cerr << "factory opened " << factory.opened << " connections" << std::endl;
+        ++errors;
+    }
+
+    std::cout << "rows: " << rows << "  connections opened by the factory: "
+              << factory.opened << std::endl;
+
+    src.reset();
+    std::remove(dbfile);
+
+    return errors;
+}
@@ -0,0 +1,202 @@
+//
+// Conversion kernels: a kernel converts a whole column of one type
+// pair and gives the values of a Value conversion cell by cell. A
+// column of another type than the kernel's is copied. Reports a
+// matrix of the common type pairs: cells per second of the kernel (or
+// of the array copy for equal types) and of converting generic
+// values cell by cell.
+//
+
+#include "test_util.hh"
+
+#include <iomanip>
+
+using namespace informave::argon;
+
+static int errors = 0;
+
+#define CHECK(expr) if(!(expr)) { std::cout << "failed: " #expr << std::endl; ++errors; }
+
+
+static const char* type_name(Value::value_type type)
+{
+    switch(type)
+    {
+    case Value::type_int:     return "int";
+    case Value::type_decimal: return "decimal";
+    case Value::type_float:   return "float";
+    case Value::type_date:    return "date";
+    case Value::type_string:  return "string";
+    default:                  return "?";
+    }
+}
+
+
+/// Rows of a column of @a type, every seventh row NULL
+static void fill(ColumnVector &col, Value::value_type type, size_t rows)
+{
+    DateTime dt = { 2010, 12, 24, 18, 30, 0, 0 };
+    col.clear();
+    for(size_t r = 0; r < rows; ++r)
+    {
+        const long long v = static_cast<long long>(r) * 7919 - 500000;
+        if(r % 7 == 0)
+            continue;
+        switch(type)
+        {
+        case Value::type_int:
+            col.setInt(r, v);
+            break;
+        case Value::type_decimal:
+            col.set(r, Value::decimal(v, static_cast<unsigned int>(r % 4)));
+            break;
+        case Value::type_float:
+            col.setFloat(r, v / 8.0);
+            break;
+        case Value::type_date:
+            col.setDate(r, dt);
+            break;
+        default:
+            col.setString(r, L"a column value", 14);
+            break;
+        }
+    }
+}
+
+
+/// The conversion of a generic value
+static Value convert_value(const Value &v, Value::value_type to)
+{
+    if(v.isNull() || v.type() == to)
+        return v;
+    switch(to)
+    {
+    case Value::type_float:
+        return Value(v.asDouble());
+    case Value::type_decimal:
+    {
+        unsigned int scale = 0;
+        long long unscaled = v.asDecimal(scale);
+        return Value::decimal(unscaled, scale);
+    }
+    case Value::type_string:
+        return Value(v.asString());
+    default:
+        return v;
+    }
+}
+
+
+static void generic(const ColumnVector &src, ColumnVector &dest, Value::value_type to, size_t rows)
+{
+    dest.clear();
+    for(size_t r = 0; r < rows; ++r)
+        dest.set(r, convert_value(src.get(r), to));
+}
+
+
+int main(void)
+{
+    const size_t rows = 1000;
+    const int rounds = 200;
+
+    static const Value::value_type pairs[][2] =
+    {
+        { Value::type_int,     Value::type_int },
+        { Value::type_int,     Value::type_float },
+        { Value::type_int,     Value::type_decimal },
+        { Value::type_int,     Value::type_string },
+        { Value::type_decimal, Value::type_decimal },
+        { Value::type_decimal, Value::type_float },
+        { Value::type_decimal, Value::type_string },
+        { Value::type_float,   Value::type_float },
+        { Value::type_float,   Value::type_string },
+        { Value::type_date,    Value::type_date },
+        { Value::type_date,    Value::type_string },
+        { Value::type_string,  Value::type_string }
+    };
+
+    ColumnVector src(rows), dest(rows), expect(rows);
+
+    std::cout << std::setw(20) << std::left << "pair" << std::right
+              << std::setw(16) << "kernel/s" << std::setw(16) << "generic/s" << std::endl;
+
+    for(size_t p = 0; p < sizeof(pairs) / sizeof(pairs[0]); ++p)
+    {
+        const Value::value_type from = pairs[p][0], to = pairs[p][1];
+        ColumnVector::Kernel kernel = ColumnVector::kernel(from, to);
+        fill(src, from, rows);
+
+        // equal types are copied, other pairs without a kernel are
+        // converted by the driver
+        CHECK(from != to || kernel == 0);
+
+        generic(src, expect, to, rows);
+        double kernelRate = 0;
+        if(kernel || from == to)
+        {
+            if(kernel)
+                kernel(src, dest, 0, rows);
+            else
+                dest.copy(src, rows);
+            bool same = true;
+            for(size_t r = 0; r < rows; ++r)
+                same = same && dest.get(r) == expect.get(r);
+            if(! same)
+                std::cout << "failed: " << type_name(from) << " -> " << type_name(to) << std::endl;
+            errors += same ? 0 : 1;
+
+            double t0 = wall_time();
+            for(int i = 0; i < rounds; ++i)
+            {
+                if(kernel)
+                    kernel(src, dest, 0, rows);
+                else
+                    dest.copy(src, rows);
+            }
+            double elapsed = wall_time() - t0;
+            kernelRate = elapsed > 0 ? rounds * rows / elapsed : 0;
+        }
+
+        double t0 = wall_time();
+        for(int i = 0; i < rounds; ++i)
+            generic(src, expect, to, rows);
+        double elapsed = wall_time() - t0;
+        double genericRate = elapsed > 0 ? rounds * rows / elapsed : 0;
+
+        std::cout << std::setw(8) << std::left << type_name(from) << " -> "
+                  << std::setw(8) << type_name(to) << std::right << std::setw(16);
+        if(kernel || from == to)
+            std::cout << static_cast<long long>(kernelRate);
+        else
+            std::cout << "-";
+        std::cout << std::setw(16) << static_cast<long long>(genericRate) << std::endl;
+    }
+
+    // the fetched values are not of the declared type: copied
+    {
+        fill(src, Value::type_string, rows);
+        ColumnVector::kernel(Value::type_int, Value::type_float)(src, dest, 0, rows);
+        CHECK(dest.type() == ColumnVector::col_string && dest.get(1) == src.get(1));
+    }
+
+    // a copy rule with a kernel honours the selection
+    {
+        RowBatch in(1, rows), out(1, rows);
+        fill(in.column(0), Value::type_int, rows);
+        in.resize(rows);
+        std::vector<size_t> sel;
+        sel.push_back(8);
+        sel.push_back(7);
+        in.select(sel);
+
+        RuleList rules(1);
+        rules[0].type = ColumnRule::rule_copy;
+        rules[0].convert = ColumnVector::kernel(Value::type_int, Value::type_string);
+        apply_rules(rules, in, out);
+        CHECK(out.rows() == 2 && out.column(0).type() == ColumnVector::col_string);
+        CHECK(out.value(0, 0) == Value(in.value(8, 0).asString()) && out.value(1, 0).isNull());
+    }
+
+    return errors;
+}
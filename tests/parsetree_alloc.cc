@@ -0,0 +1,128 @@
+//
+// Tree-size benchmark: heap allocations while building and destroying
+// the parse tree of a large generated script.
+//
+
+#include <argon/dtsengine>
+
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+static size_t g_allocs = 0;
+static size_t g_frees = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    ++g_allocs;
+    void *p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    if(p)
+    {
+        ++g_frees;
+        std::free(p);
+    }
+}
+
+
+using namespace informave::argon;
+
+struct BenchEngine : public DTSEngine
+{
+    ParseTree* tree(void) { return this->m_tree.get(); }
+
+    void drop(void) { this->m_tree.reset(); }
+};
+
+
+struct CountVisitor : public Visitor
+{
+    CountVisitor(size_t &count) : Visitor(), m_count(count)
+    {}
+
+    virtual void visit(LogNode *node) { ++m_count; }
+    virtual void visit(TaskExecNode *node) { ++m_count; }
+    virtual void visit(LiteralNode *node) { ++m_count; }
+    virtual void visit(IdNode *node) { ++m_count; }
+
+    size_t &m_count;
+};
+
+
+static std::string genScript(int tasks)
+{
+    std::stringstream ss;
+    ss << "program." << std::endl;
+    for(int i = 0; i < tasks; ++i)
+    {
+        ss << "task t" << i << "() as void" << std::endl
+           << "begin" << std::endl
+           << "   log \"task " << i << "\" t" << i << ";" << std::endl
+           << "   exec task t" << (i + 1) % tasks << ";" << std::endl
+           << "end;" << std::endl;
+    }
+    return ss.str();
+}
+
+
+int main(void)
+{
+    const int sizes[] = { 100, 1000, 10000 };
+
+    for(size_t n = 0; n < sizeof(sizes) / sizeof(sizes[0]); ++n)
+    {
+        std::string script = genScript(sizes[n]);
+
+        BenchEngine engine;
+
+        size_t a0 = g_allocs;
+        std::clock_t c0 = std::clock();
+        engine.load(script.data(), script.size());
+        std::clock_t c1 = std::clock();
+        size_t loadAllocs = g_allocs - a0;
+
+        // walk all task bodies, this must not touch the heap
+        size_t visited = 0;
+        size_t w0 = g_allocs;
+        for(int pass = 0; pass < 10; ++pass)
+        {
+            for(Node *task = engine.tree()->firstChild(); task; task = task->nextSibling())
+                foreach_child(task, CountVisitor(visited));
+        }
+        size_t walkAllocs = g_allocs - w0;
+
+        const Arena &arena = engine.tree()->arena();
+        size_t objects = arena.objectCount();
+        size_t chunks = arena.chunkCount();
+
+        size_t f0 = g_frees;
+        std::clock_t c2 = std::clock();
+        engine.drop();
+        std::clock_t c3 = std::clock();
+        size_t dropFrees = g_frees - f0;
+
+        std::cout << "tasks: " << sizes[n]
+                  << "  tree objects: " << objects
+                  << "  arena chunks: " << chunks
+                  << "  load allocs: " << loadAllocs
+                  << " (" << double(loadAllocs) / objects << "/object)"
+                  << "  teardown frees: " << dropFrees
+                  << "  walk allocs: " << walkAllocs
+                  << "  load: " << double(c1 - c0) / CLOCKS_PER_SEC << "s"
+                  << "  teardown: " << double(c3 - c2) / CLOCKS_PER_SEC << "s"
+                  << std::endl;
+
+        if(objects == 0 || chunks == 0 || visited == 0 || walkAllocs != 0)
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+//
+// Projection pushdown: a table or view source selects only the
+// columns the task references. The source view has a column that
+// fails when it is evaluated, so selecting it breaks the transfer,
+// also for a partitioned read. Reports rows per second for a
+// 200 column table read as table (projected) and as sql (SELECT *).
+//
+
+#include "test_util.hh"
+
+#include <cstdio>
+
+using namespace informave::argon;
+
+
+static const char *view_script =
+    "connection src type \"sqlite:libsqlite\" dbcstr \"projection.db\";\n"
+    "connection dst;\n"
+    "program.\n"
+    "task mark(extra) as void begin end;\n"
+    "task copy() as transfer[table(dst, \"t\"), view(src, \"v\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    "   $name <- $NAME;\n"
+    " after:\n"
+    "   exec task mark($extra);\n"
+    "end;\n"
+    "task split() as transfer[table(dst, \"t\"), view(src, \"v\", parallel(2, id))]\n"
+    "begin $id <- $id; $name <- @$name; end;\n"
+    "task main() as void begin exec task copy; exec task split; end;\n";
+
+static const char *wide_table =
+    "connection src type \"sqlite:libsqlite\" dbcstr \"projection.db\";\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"narrow\"), table(src, \"wide\")]\n"
+    "begin $a <- $c0; $b <- $c100; $c <- $c199; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+static const char *wide_sql =
+    "connection src type \"sqlite:libsqlite\" dbcstr \"projection.db\";\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"narrow\"), sql(src, \"SELECT * FROM wide\")]\n"
+    "begin $a <- $c0; $b <- $c100; $c <- $c199; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+static const char *dbfile = "projection.db";
+
+
+/// Runs a script and returns the elapsed seconds, -1 if it failed
+static double run(db::Connection &dst, const char *text)
+{
+    ScriptRun runner;
+    runner.engine().addConnection("dst", &dst);
+    double elapsed = runner.exec(text);
+    if(elapsed < 0)
+        std::cerr << runner.error() << std::endl;
+    return elapsed;
+}
+
+
+int main(void)
+{
+    const int rows = 500;
+    const int wideRows = 10000;
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    std::remove(dbfile);
+    src->connect(dbfile);
+    dst->connect(":memory:");
+
+    // abs() of the smallest integer raises an overflow error
+    src->directCmd("CREATE TABLE s (id INTEGER, name TEXT, extra TEXT)");
+    src->directCmd("CREATE VIEW v AS SELECT id, name, extra,"
+                   " abs(-9223372036854775807 - 1) AS broken FROM s");
+    dst->directCmd("CREATE TABLE t (id INTEGER, name TEXT)");
+
+    std::stringstream create;
+    create << "CREATE TABLE wide (";
+    for(int c = 0; c < 200; ++c)
+        create << (c ? ", " : "") << "c" << c << " TEXT";
+    create << ")";
+    src->directCmd(create.str());
+    dst->directCmd("CREATE TABLE narrow (a TEXT, b TEXT, c TEXT)");
+
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO s (id, name, extra) VALUES (?, ?, 'x')");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            ins->bind(2, db::Variant(String("some name")));
+            ins->execute();
+        }
+
+        std::stringstream sql;
+        sql << "INSERT INTO wide VALUES (";
+        for(int c = 0; c < 200; ++c)
+            sql << (c ? ", " : "") << "?";
+        sql << ")";
+        std::auto_ptr<db::Statement> wide(src->newStatement());
+        wide->prepare(sql.str());
+        for(int c = 0; c < 200; ++c)
+            wide->bind(c + 1, db::Variant(String("a wide column value")));
+        for(int i = 0; i < wideRows; ++i)
+            wide->execute();
+        src->commit();
+    }
+    src.reset();
+
+    double view = run(*dst, view_script);
+    long long viewRows = count_rows(*dst, "SELECT COUNT(*) FROM t WHERE name = 'some name'");
+
+    double projected = run(*dst, wide_table);
+    double all = run(*dst, wide_sql);
+    long long wideCopied = count_rows(*dst, "SELECT COUNT(*) FROM narrow"
+                                      " WHERE a = b AND b = c AND c = 'a wide column value'");
+
+    if(view < 0 || viewRows != 2 * rows)
+    {
+        std::cerr << "view source: " << viewRows << " rows" << std::endl;
+        ++errors;
+    }
+    if(projected < 0 || all < 0 || wideCopied != 2 * wideRows)
+    {
+        std::cerr << "wide source: " << wideCopied << " rows" << std::endl;
+        ++errors;
+    }
+
+    std::cout << "200 columns, 3 used: table " << (projected > 0 ? wideRows / projected : 0)
+              << " rows/s, SELECT * " << (all > 0 ? wideRows / all : 0) << " rows/s" << std::endl;
+
+    std::remove(dbfile);
+
+    return errors;
+}
@@ -0,0 +1,176 @@
+//
+// INSERT ... SELECT pushdown: a transfer with one connection for both
+// ends and rules the database can evaluate runs as one statement and
+// gives the rows of the row path. Other tasks take the row path, the
+// explain output names the path and the reason. Column names which
+// are no plain SQL identifiers are quoted. Reports rows per second
+// for both paths.
+//
+
+#include "test_util.hh"
+
+#include <cwchar>
+
+using namespace informave::argon;
+
+
+// one rule of each kind
+static const char *rules =
+    "begin\n"
+    "   $id <- $id;\n"
+    "   $name <- @$name;\n"
+    "   $amount <- @$amount;\n"
+    "   $ref <- %id;\n"
+    "   $tag <- \"it's\";\n"
+    "   $price <- 2.0;\n"
+    "   $note <- null;\n";
+
+
+/// Script copying s to t, @a src is the connection of the source,
+/// @a after the statements of the after section
+static std::string script(const char *src, const char *after = 0)
+{
+    std::stringstream ss;
+    ss << "connection db;\n"
+       << "connection other;\n"
+       << "program.\n"
+       << "task mark() as void begin end;\n"
+       << "task copy() as transfer[table(db, \"t\"), table(" << src << ", \"s\")]\n"
+       << rules
+       << (after ? " after:\n   " : "") << (after ? after : "") << "\n"
+       << "end;\n"
+       << "task main() as void begin exec task copy; end;\n";
+    return ss.str();
+}
+
+
+// a column name the database only accepts quoted
+static const char *quoted_script =
+    "connection db;\n"
+    "connection other;\n"
+    "program.\n"
+    "task copy() as transfer[table(db, \"qt\"), table(db, \"qs\")]\n"
+    "begin\n"
+    "   $id <- $id;\n"
+    "   $(unit price) <- @$(unit price);\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Runs a script with explain on, returns the elapsed seconds or -1
+static double run(db::Connection &db, db::Connection &other, const std::string &text,
+                  std::wstring &explain)
+{
+    db.directCmd("DELETE FROM t");
+
+    ScriptRun runner;
+    runner.engine().transferOptions().explain = true;
+    runner.engine().addConnection("db", &db);
+    runner.engine().addConnection("other", &other);
+    double elapsed = runner.exec(text);
+    if(elapsed < 0)
+        std::cerr << runner.error() << std::endl;
+
+    std::wstring out = runner.output();
+    std::wstring::size_type pos = out.find(L"[EXPLAIN] copy: ");
+    explain = pos == std::wstring::npos ? std::wstring()
+        : out.substr(pos + 16, out.find(L'\n', pos) - pos - 16);
+    return elapsed;
+}
+
+
+/// Rows of t as the rules define them
+static long long correct_rows(db::Connection &db)
+{
+    return count_rows(db, "SELECT COUNT(*) FROM t WHERE ref = id AND tag = 'it''s'"
+                      " AND typeof(price) = 'real' AND price = 2.0 AND note IS NULL"
+                      " AND ((id % 2 = 0 AND name = '' AND amount = 0)"
+                      "   OR (id % 2 = 1 AND name = 'n' || id AND amount = id))");
+}
+
+
+static bool starts_with(const std::wstring &s, const wchar_t *prefix)
+{
+    return s.compare(0, std::wcslen(prefix), prefix) == 0;
+}
+
+
+int main(void)
+{
+    const int rows = 20000;
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> db(env.newConnection());
+    std::auto_ptr<db::Connection> other(env.newConnection());
+    db->connect(":memory:");
+    other->connect(":memory:");
+
+    const char *source = "CREATE TABLE s (id INTEGER, name TEXT, amount INTEGER)";
+    db->directCmd(source);
+    other->directCmd(source);
+    db->directCmd("CREATE TABLE t (id INTEGER, name TEXT, amount INTEGER, ref INTEGER,"
+                  " tag TEXT, price REAL, note TEXT)");
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        db::Connection &dbc = pass ? *other : *db;
+        std::auto_ptr<db::Statement> ins(dbc.newStatement());
+        ins->prepare("INSERT INTO s (id, name, amount) VALUES (?, ?, ?)");
+        dbc.beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            std::stringstream name;
+            name << "n" << i;
+            ins->bind(1, db::Variant(i));
+            ins->bind(2, i % 2 ? db::Variant(String(name.str())) : db::Variant());
+            ins->bind(3, i % 2 ? db::Variant(i) : db::Variant());
+            ins->execute();
+        }
+        dbc.commit();
+    }
+
+    std::wstring pushed, remote, section;
+    double fast = run(*db, *other, script("db"), pushed);
+    long long fastRows = correct_rows(*db);
+    double slow = run(*db, *other, script("other"), remote);
+    long long slowRows = correct_rows(*db);
+    run(*db, *other, script("db", "exec task mark;"), section);
+
+    std::wstring quoted;
+    db->directCmd("CREATE TABLE qs (id INTEGER, \"unit price\" INTEGER)");
+    db->directCmd("CREATE TABLE qt (id INTEGER, \"unit price\" INTEGER)");
+    db->directCmd("INSERT INTO qs VALUES (1, 5)");
+    db->directCmd("INSERT INTO qs VALUES (2, NULL)");
+    run(*db, *other, quoted_script, quoted);
+
+    if(fast < 0 || fastRows != rows || ! starts_with(pushed, L"INSERT ... SELECT")
+       || pushed.find(L"COALESCE(name, '')") == std::wstring::npos)
+    {
+        std::wcerr << L"pushdown: " << fastRows << L" rows, " << pushed << std::endl;
+        ++errors;
+    }
+    if(slow < 0 || slowRows != rows
+       || remote != L"row path, source and destination use different connections")
+    {
+        std::wcerr << L"row path: " << slowRows << L" rows, " << remote << std::endl;
+        ++errors;
+    }
+    if(section != L"row path, statements run for each batch")
+    {
+        std::wcerr << L"after section: " << section << std::endl;
+        ++errors;
+    }
+    if(! starts_with(quoted, L"INSERT ... SELECT")
+       || quoted.find(L"COALESCE(\"unit price\", 0)") == std::wstring::npos
+       || count_rows(*db, "SELECT SUM(\"unit price\") FROM qt") != 5
+       || count_rows(*db, "SELECT COUNT(*) FROM qt") != 2)
+    {
+        std::wcerr << L"quoted column: " << quoted << std::endl;
+        ++errors;
+    }
+
+    std::cout << "rows: " << rows << "  INSERT ... SELECT: " << (fast > 0 ? rows / fast : 0)
+              << " rows/s  row path: " << (slow > 0 ? rows / slow : 0) << " rows/s" << std::endl;
+
+    return errors;
+}
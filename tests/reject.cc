@@ -0,0 +1,239 @@
+//
+// Rejected rows: rows the destination does not accept go to the
+// except section of the task or to the reject sink of the engine, the
+// other rows of their batch are written. Without either the transfer
+// fails. Writers nested on one connection isolate their own rows.
+// Reports rows per second for clean and dirty sources.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+// bad stores the id and state of the rows of copy which name is NULL,
+// wrong marks rows which ran a section for another state
+static const char *except_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task bad(id, state) as store[table(dst, \"bad\")] begin $n <- id; $state <- state; end;\n"
+    "task wrong() as store[table(dst, \"bad\")] begin $n <- 1; $state <- \"wrong\"; end;\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    "   $name <- $name;\n"
+    " except \"42\":\n"
+    "   exec task wrong;\n"
+    " except:\n"
+    "   exec task wrong;\n"
+    " except \"HY000\":\n"
+    "   exec task bad(%id, sqlstate);\n"
+    " except \"23\":\n"
+    "   exec task bad(%id, sqlstate);\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+// no section handles the rows, so copy fails
+static const char *unhandled_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    "   $name <- $name;\n"
+    " except \"42\":\n"
+    "   log \"wrong state \" sqlstate;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin $id <- $id; $name <- $name; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+struct CountingSink : public RejectSink
+{
+    CountingSink(void)
+        : rows(0),
+          wrongRow(0)
+    {}
+
+    virtual void reject(const RejectRecord &rec)
+    {
+        ++rows;
+        // id is the first column, bad rows have ids divisible by 50
+        if(rec.task != String("copy") || rec.values.size() != 2 || rec.values[0].asInt() % 50 != 0
+           || ! rec.values[1].isNull() || rec.error.empty())
+            ++wrongRow;
+    }
+
+    int rows;
+    int wrongRow;
+};
+
+
+/// Passes each rejected row to a second writer on the same connection,
+/// which rejects it again if its id is even
+struct NestedWriter : public BatchWriter
+{
+    NestedWriter(db::Connection &dbc, BatchWriter &inner)
+        : BatchWriter(dbc, "t", columns(), 0),
+          inner(inner)
+    {
+        this->isolateFailures(true);
+    }
+
+    static std::vector<String> columns(void)
+    {
+        std::vector<String> cols;
+        cols.push_back("id");
+        cols.push_back("name");
+        return cols;
+    }
+
+    virtual void rejectRow(const RowBatch &batch, size_t row, const String &, const String &)
+    {
+        RowBatch one(2, 1);
+        one.resize(1);
+        one.set(0, 0, batch.value(row, 0));
+        if(batch.value(row, 0).asInt() % 2)
+            one.set(0, 1, Value(String("odd")));
+        inner.write(one);
+    }
+
+    BatchWriter &inner;
+};
+
+
+/// Runs a script and returns the elapsed seconds, -1 if it failed
+static double run(db::Connection &src, db::Connection &dst, const char *text, RejectSink *sink)
+{
+    dst.directCmd("DELETE FROM t");
+    dst.directCmd("DELETE FROM bad");
+
+    ScriptRun runner;
+    runner.engine().transferOptions().batchSize = 500;
+    runner.engine().transferOptions().commitInterval = 2000;
+    runner.engine().setRejectSink(sink);
+    runner.engine().addConnection("src", &src);
+    runner.engine().addConnection("dst", &dst);
+    return runner.exec(text);
+}
+
+
+int main(void)
+{
+    const int rows = 20000;
+    const int dirty = rows / 50;
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    src->connect(":memory:");
+    dst->connect(":memory:");
+
+    src->directCmd("CREATE TABLE t (id INTEGER, name TEXT)");
+    dst->directCmd("CREATE TABLE t (id INTEGER, name TEXT NOT NULL)");
+    dst->directCmd("CREATE TABLE bad (n INTEGER, state TEXT)");
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO t (id, name) VALUES (?, ?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            ins->bind(2, db::Variant(String("some name")));
+            ins->execute();
+        }
+        src->commit();
+    }
+
+    double clean = run(*src, *dst, script, 0);
+
+    src->directCmd("UPDATE t SET name = NULL WHERE id % 50 = 0");
+
+    double handled = run(*src, *dst, except_script, 0);
+    long long handledRows = count_rows(*dst, "SELECT COUNT(*) FROM t");
+    long long handledBad = count_rows(*dst, "SELECT COUNT(*) FROM bad WHERE n % 50 = 0"
+                                      " AND LENGTH(state) = 5 AND state <> 'wrong'");
+    long long handledAll = count_rows(*dst, "SELECT COUNT(*) FROM bad");
+
+    double unhandled = run(*src, *dst, unhandled_script, 0);
+
+    CountingSink sink;
+    double sunk = run(*src, *dst, script, &sink);
+    long long sunkRows = count_rows(*dst, "SELECT COUNT(*) FROM t");
+
+    double failed = run(*src, *dst, script, 0);
+    long long failedRows = count_rows(*dst, "SELECT COUNT(*) FROM t");
+
+    if(clean < 0 || handled < 0 || handledRows != rows - dirty || handledBad != dirty
+       || handledAll != dirty)
+    {
+        std::cerr << "except section: " << handledRows << " rows, " << handledBad << " of "
+                  << handledAll << " rejected" << std::endl;
+        ++errors;
+    }
+    if(unhandled >= 0)
+    {
+        std::cerr << "rows no except section handles did not fail the transfer" << std::endl;
+        ++errors;
+    }
+    if(sunk < 0 || sunkRows != rows - dirty || sink.rows != dirty || sink.wrongRow)
+    {
+        std::cerr << "reject sink: " << sunkRows << " rows, " << sink.rows << " rejected, "
+                  << sink.wrongRow << " wrong" << std::endl;
+        ++errors;
+    }
+    if(failed >= 0 || failedRows != 0)
+    {
+        std::cerr << "transfer without handler did not fail" << std::endl;
+        ++errors;
+    }
+
+    // nested writers on one connection
+    {
+        dst->directCmd("DELETE FROM t");
+        dst->directCmd("CREATE TABLE t2 (id INTEGER, name TEXT NOT NULL)");
+        BatchWriter inner(*dst, "t2", NestedWriter::columns(), 0);
+        inner.isolateFailures(true);
+        NestedWriter outer(*dst, inner);
+        outer.open();
+        inner.open();
+
+        RowBatch batch(2, 10);
+        batch.resize(10);
+        for(int i = 0; i < 10; ++i)
+        {
+            batch.set(i, 0, Value(i));
+            if(i % 5)
+                batch.set(i, 1, Value(String("name")));
+        }
+        outer.write(batch);
+        inner.close();
+        outer.close();
+
+        // 0 and 5 are rejected by t, 0 again by t2
+        if(count_rows(*dst, "SELECT COUNT(*) FROM t") != 8 || outer.rejected() != 2
+           || count_rows(*dst, "SELECT COUNT(*) FROM t2 WHERE id = 5") != 1 || inner.rejected() != 1)
+        {
+            std::cerr << "nested writers: " << outer.rejected() << " and " << inner.rejected()
+                      << " rejected" << std::endl;
+            ++errors;
+        }
+    }
+
+    std::cout << "rows: " << rows << "  clean: " << (clean > 0 ? rows / clean : 0) << " rows/s"
+              << "  " << dirty << " bad rows: " << (sunk > 0 ? rows / sunk : 0) << " rows/s" << std::endl;
+
+    return errors;
+}
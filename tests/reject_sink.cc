@@ -0,0 +1,220 @@
+//
+// Reject sinks: rows with injected errors (NULL in a NOT NULL column)
+// are written as records to a reject table and a reject file, the
+// other rows arrive. A reject table on the destination connection
+// keeps its records when the transfer rolls back. Reports rows per
+// second with 0, 1 and 5 percent bad rows.
+//
+
+#include "test_util.hh"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+
+using namespace informave::argon;
+
+
+static const char *rejectfile = "reject_sink.txt";
+
+
+// copy is defined on line 4
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin $id <- $id; $name <- $name; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+// copy fails after its first batch, missing does not exist
+static const char *failing_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    "   $name <- $name;\n"
+    " after:\n"
+    "   exec task fail;\n"
+    "end;\n"
+    "task fail() as transfer[table(dst, \"t\"), table(dst, \"missing\")]\n"
+    "begin $id <- $id; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Lines of the reject file
+static int count_lines(const char *path, const std::string &expect)
+{
+    std::ifstream in(path);
+    std::string line;
+    int n = 0;
+    while(std::getline(in, line))
+    {
+        if(line.find(expect) != std::string::npos)
+            ++n;
+    }
+    return n;
+}
+
+
+struct Databases
+{
+    Databases(void)
+        : env("sqlite:libsqlite")
+    {
+        src.reset(env.newConnection());
+        dst.reset(env.newConnection());
+        rejects.reset(env.newConnection());
+        src->connect(":memory:");
+        dst->connect(":memory:");
+        rejects->connect(":memory:");
+        src->directCmd("CREATE TABLE t (id INTEGER, name TEXT)");
+        dst->directCmd("CREATE TABLE t (id INTEGER, name TEXT NOT NULL)");
+        rejects->directCmd("CREATE TABLE rejects (task TEXT, sqlstate TEXT, source TEXT,"
+                           " error TEXT, rowdata TEXT)");
+    }
+
+    /// Fill the source, every @a every row has a NULL name (0: none)
+    void fill(int rows, int every)
+    {
+        src->directCmd("DELETE FROM t");
+        dst->directCmd("DELETE FROM t");
+        rejects->directCmd("DELETE FROM rejects");
+
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO t (id, name) VALUES (?, ?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            if(every && i % every == every - 1)
+                ins->bind(2, db::Variant());
+            else
+                ins->bind(2, db::Variant(String("some name")));
+            ins->execute();
+        }
+        src->commit();
+    }
+
+    db::Database::Environment        env;
+    std::auto_ptr<db::Connection>    src;
+    std::auto_ptr<db::Connection>    dst;
+    std::auto_ptr<db::Connection>    rejects;
+};
+
+
+/// Copies @a rows rows with one bad row in @a every, returns the rows
+/// per second or -1 if the result is not correct
+static double run(Databases &db, int rows, int every)
+{
+    const int bad = every ? rows / every : 0;
+    db.fill(rows, every);
+    std::remove(rejectfile);
+
+    double elapsed = 0;
+    size_t tableRecords = 0, fileRecords = 0;
+    try
+    {
+        RejectTable table(*db.rejects, "rejects", 100);
+        RejectFile file(rejectfile, 100);
+
+        for(int pass = 0; pass < 2; ++pass)
+        {
+            db.dst->directCmd("DELETE FROM t");
+
+            ScriptRun runner;
+            runner.engine().setRejectSink(pass == 0 ? static_cast<RejectSink*>(&table) : &file);
+            runner.engine().addConnection("src", db.src.get());
+            runner.engine().addConnection("dst", db.dst.get());
+
+            double t = runner.exec(script);
+            if(t < 0)
+                throw std::runtime_error(runner.error());
+            elapsed += t;
+        }
+        tableRecords = table.records();
+        fileRecords = file.records();
+    }
+    catch(std::exception &e)
+    {
+        std::cerr << every << ": " << e.what() << std::endl;
+        return -1;
+    }
+
+    long long copied = count_rows(*db.dst, "SELECT COUNT(*) FROM t");
+    long long stored = count_rows(*db.rejects, "SELECT COUNT(*) FROM rejects"
+                                  " WHERE task = 'copy' AND source = '<buffer>:4'"
+                                  " AND rowdata LIKE 'id=%, name=NULL' AND error <> ''"
+                                  " AND LENGTH(sqlstate) = 5");
+    int lines = count_lines(rejectfile, "name=NULL");
+
+    std::remove(rejectfile);
+
+    if(copied != rows - bad || tableRecords != size_t(bad) || stored != bad
+       || fileRecords != size_t(bad) || lines != bad)
+    {
+        std::cerr << "1 in " << every << " bad: " << copied << " copied, " << stored
+                  << " in the reject table, " << lines << " in the reject file" << std::endl;
+        return -1;
+    }
+    return elapsed > 0 ? 2 * rows / elapsed : 0;
+}
+
+
+/// Rejects rows into a table on the destination connection of a
+/// transfer which fails, returns false if the records were lost
+static bool rollback(Databases &db)
+{
+    const int rows = 500;
+    db.fill(rows, 10);
+    db.dst->directCmd("CREATE TABLE rejects (task TEXT, sqlstate TEXT, source TEXT,"
+                      " error TEXT, rowdata TEXT)");
+    {
+        // smaller than the rejected rows of a batch
+        RejectTable table(*db.dst, "rejects", 20);
+        ScriptRun runner;
+        runner.engine().setRejectSink(&table);
+        runner.engine().addConnection("src", db.src.get());
+        runner.engine().addConnection("dst", db.dst.get());
+        if(runner.exec(failing_script) >= 0)
+        {
+            std::cerr << "copy did not fail" << std::endl;
+            return false;
+        }
+        table.flush();
+    }
+
+    long long copied = count_rows(*db.dst, "SELECT COUNT(*) FROM t");
+    long long stored = count_rows(*db.dst, "SELECT COUNT(*) FROM rejects");
+    if(copied != 0 || stored != rows / 10)
+    {
+        std::cerr << "failed transfer: " << copied << " copied, " << stored
+                  << " in the reject table" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+int main(void)
+{
+    const int rows = 20000;
+
+    Databases db;
+
+    bool kept = rollback(db);
+    double clean = run(db, rows, 0);
+    double one = run(db, rows, 100);
+    double five = run(db, rows, 20);
+
+    std::cout << "rows: " << rows
+              << "  clean: " << clean << " rows/s"
+              << "  1% bad: " << one << " rows/s"
+              << "  5% bad: " << five << " rows/s" << std::endl;
+
+    return (! kept || clean < 0 || one < 0 || five < 0) ? 1 : 0;
+}
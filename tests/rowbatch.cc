@@ -0,0 +1,172 @@
+//
+// RowBatch: columns keep their type, NULLs live in the validity
+// bitmap, strings in the arena of the column. Mixed types fall back
+// to generic values, @ fills the NULL rows. Applying copy rules to a
+// warm batch must not touch the heap. Reports cells per second for
+// the copy rules.
+//
+
+#include "test_util.hh"
+
+#include <cstdlib>
+#include <new>
+
+static size_t g_allocs = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    ++g_allocs;
+    void *p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+
+
+using namespace informave::argon;
+
+static int errors = 0;
+
+#define CHECK(expr) if(!(expr)) { std::cout << "failed: " #expr << std::endl; ++errors; }
+
+
+static ColumnRule rule(ColumnRule::rule_type type, size_t dest, size_t src, const Value &value = Value())
+{
+    ColumnRule r;
+    r.type = type;
+    r.dest = dest;
+    r.src = src;
+    r.value = value;
+    return r;
+}
+
+
+static const wchar_t name[] = L"a name longer than the inline buffer";
+
+
+/// id, name (every third NULL), amount (decimal), rows of @a batch
+static void fill(RowBatch &batch, size_t rows)
+{
+    batch.clear();
+    for(size_t r = 0; r < rows; ++r)
+    {
+        batch.column(0).setInt(r, static_cast<long long>(r));
+        if(r % 3)
+            batch.column(1).setString(r, name, sizeof(name) / sizeof(wchar_t) - 1);
+        else
+            batch.column(1).setNull(r);
+        batch.set(r, 2, Value::decimal(static_cast<long long>(r) * 100 + 5, 2));
+    }
+    batch.resize(rows);
+}
+
+
+int main(void)
+{
+    const size_t rows = 1000;
+    DateTime dt = { 2010, 12, 24, 18, 30, 0, 0 };
+
+    RowBatch src(3, rows);
+    fill(src, rows);
+
+    CHECK(src.column(0).type() == ColumnVector::col_int);
+    CHECK(src.column(1).type() == ColumnVector::col_string);
+    CHECK(src.column(2).type() == ColumnVector::col_decimal);
+    CHECK(src.column(0).intAt(42) == 42);
+    CHECK(src.column(1).isNull(3) && ! src.column(1).isNull(4));
+    CHECK(src.value(4, 1) == Value(name));
+    CHECK(src.value(3, 1).isNull());
+    CHECK(src.value(7, 2) == Value::decimal(705, 2));
+
+    // a value of another type keeps the rows stored before
+    {
+        ColumnVector col(8);
+        col.setInt(0, 1);
+        col.setString(1, L"two", 3);
+        col.setDate(2, dt);
+        CHECK(col.type() == ColumnVector::col_value);
+        CHECK(col.get(0) == Value(1) && col.get(1) == Value(L"two"));
+        CHECK(col.get(2) == Value::date(dt) && col.get(3).isNull());
+        col.clear();
+        CHECK(col.type() == ColumnVector::col_empty && col.get(0).isNull());
+        col.setFloat(5, 2.5);
+        CHECK(col.type() == ColumnVector::col_float && col.floatAt(5) == 2.5);
+    }
+
+    RuleList rules;
+    rules.push_back(rule(ColumnRule::rule_copy, 0, 0));
+    rules.push_back(rule(ColumnRule::rule_copy, 1, 1));
+    rules.push_back(rule(ColumnRule::rule_copy, 2, 2));
+    rules.push_back(rule(ColumnRule::rule_const, 3, 0, Value(L"imported")));
+    rules.push_back(rule(ColumnRule::rule_null, 4, 0));
+
+    RowBatch dest(6, rows);
+    apply_rules(rules, src, dest);
+    CHECK(dest.rows() == rows);
+    CHECK(dest.value(999, 0) == Value(999));
+    CHECK(dest.value(998, 1) == src.value(998, 1) && dest.value(999, 1).isNull());
+    CHECK(dest.value(500, 2) == Value::decimal(50005, 2));
+    CHECK(dest.value(17, 3) == Value(L"imported"));
+    CHECK(dest.value(17, 4).isNull());
+    CHECK(dest.value(17, 5).isNull());    // no rule
+
+    // only the selected rows are evaluated, in the selection order
+    {
+        std::vector<size_t> sel;
+        sel.push_back(10);
+        sel.push_back(4);
+        sel.push_back(3);
+        src.select(sel);
+        RowBatch picked(6, rows);
+        apply_rules(rules, src, picked);
+        CHECK(picked.rows() == 3 && src.active() == 3 && src.activeRow(1) == 4);
+        CHECK(picked.value(0, 0) == Value(10) && picked.value(1, 0) == Value(4));
+        CHECK(picked.value(1, 1) == src.value(4, 1) && picked.value(2, 1).isNull());
+        CHECK(picked.value(2, 3) == Value(L"imported"));
+        src.selectAll();
+        CHECK(src.active() == rows);
+    }
+
+    // @: NULLs become the standard value of the fetched type, the
+    // declared one if the batch has no value
+    {
+        RuleList defaults;
+        defaults.push_back(rule(ColumnRule::rule_default, 0, 1, Value(L"")));
+        defaults.push_back(rule(ColumnRule::rule_default, 1, 2, Value::decimal(0, 0)));
+        defaults.push_back(rule(ColumnRule::rule_default, 2, 2, Value(0)));
+        src.column(2).setNull(8);
+        src.column(2).setNull(64);
+        RowBatch filled(3, rows);
+        apply_rules(defaults, src, filled);
+        CHECK(filled.value(3, 0) == Value(L"") && filled.value(4, 0) == src.value(4, 1));
+        CHECK(filled.value(8, 1) == Value::decimal(0, 0) && filled.value(64, 1) == Value::decimal(0, 0));
+        CHECK(filled.value(7, 1) == Value::decimal(705, 2));
+        CHECK(filled.column(1).type() == ColumnVector::col_decimal);
+
+        src.column(2).fillNull(rows);
+        apply_rules(defaults, src, filled);
+        CHECK(filled.value(8, 2) == Value(0) && filled.value(999, 2) == Value(0));
+        fill(src, rows);
+    }
+
+    // warm batches: fetching and copying reuses the arrays and arenas
+    size_t a0 = g_allocs;
+    const int rounds = 2000;
+    double t0 = wall_time();
+    for(int i = 0; i < rounds; ++i)
+        apply_rules(rules, src, dest);
+    double elapsed = wall_time() - t0;
+    fill(src, rows);
+    apply_rules(rules, src, dest);
+    CHECK(g_allocs == a0);
+
+    std::cout << "apply_rules: " << rows << " rows x " << rules.size() << " rules: "
+              << (elapsed > 0 ? rounds * rows * rules.size() / elapsed : 0) << " cells/s" << std::endl;
+
+    return errors;
+}
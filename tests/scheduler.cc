@@ -0,0 +1,178 @@
+//
+// Scheduler: independent transfers of the main task run at the same
+// time, dependent ones and log lines keep their order. The error of a
+// failing statement keeps its type and position. Reports the run time
+// with one and with four jobs.
+//
+
+#include "test_util.hh"
+
+#include <argon/exceptions.hh>
+
+#include <cstring>
+
+using namespace informave::argon;
+
+
+// copy1 and copy2 are independent, stage1 reads what copy1 wrote
+static const char *script =
+    "connection src1;\n"
+    "connection src2;\n"
+    "connection dst1;\n"
+    "connection dst2;\n"
+    "program.\n"
+    "task copy1() as transfer[table(dst1, \"t\"), table(src1, \"t\")]\n"
+    "begin $id <- $id; $name <- $name; end;\n"
+    "task copy2() as transfer[table(dst2, \"t\"), table(src2, \"t\")]\n"
+    "begin $id <- $id; $name <- $name; end;\n"
+    "task stage1() as transfer[table(dst1, \"staged\"), table(dst1, \"T\")]\n"
+    "begin $id <- $id; end;\n"
+    "task main() as void\n"
+    "begin\n"
+    "   log \"start\";\n"
+    "   exec task copy1;\n"
+    "   exec task copy2;\n"
+    "   exec task stage1;\n"
+    "   log \"done\";\n"
+    "end;\n";
+
+
+// broken reads a column t does not have, line 9
+static const char *failing_script =
+    "connection src1;\n"
+    "connection src2;\n"
+    "connection dst1;\n"
+    "connection dst2;\n"
+    "program.\n"
+    "task copy2() as transfer[table(dst2, \"t\"), table(src2, \"t\")]\n"
+    "begin $id <- $id; $name <- $name; end;\n"
+    "task broken() as transfer[table(dst1, \"t\"), table(src1, \"t\")]\n"
+    "begin $id <- $nosuch; end;\n"
+    "task main() as void\n"
+    "begin\n"
+    "   exec task copy2;\n"
+    "   exec task broken;\n"
+    "end;\n";
+
+
+struct Databases
+{
+    Databases(void)
+        : env("sqlite:libsqlite")
+    {
+        for(int i = 0; i < 4; ++i)
+        {
+            dbc[i].reset(env.newConnection());
+            dbc[i]->connect(":memory:");
+            dbc[i]->directCmd("CREATE TABLE t (id INTEGER, name TEXT)");
+        }
+        dbc[2]->directCmd("CREATE TABLE staged (id INTEGER)");
+    }
+
+    void fill(int rows)
+    {
+        for(int s = 0; s < 2; ++s)
+        {
+            std::auto_ptr<db::Statement> ins(dbc[s]->newStatement());
+            ins->prepare("INSERT INTO t (id, name) VALUES (?, ?)");
+            dbc[s]->beginTrans();
+            for(int i = 0; i < rows; ++i)
+            {
+                ins->bind(1, db::Variant(i));
+                ins->bind(2, db::Variant(String("some name")));
+                ins->execute();
+            }
+            dbc[s]->commit();
+        }
+    }
+
+    db::Database::Environment        env;
+    std::auto_ptr<db::Connection>    dbc[4];   // src1, src2, dst1, dst2
+};
+
+
+/// Runs the script and returns the elapsed seconds, or -1 if the
+/// result is not correct
+static double run(Databases &db, long long rows, size_t jobs)
+{
+    db.dbc[2]->directCmd("DELETE FROM t");
+    db.dbc[2]->directCmd("DELETE FROM staged");
+    db.dbc[3]->directCmd("DELETE FROM t");
+
+    ScriptRun runner;
+    runner.engine().setJobs(jobs);
+    runner.engine().addConnection("src1", db.dbc[0].get());
+    runner.engine().addConnection("src2", db.dbc[1].get());
+    runner.engine().addConnection("dst1", db.dbc[2].get());
+    runner.engine().addConnection("dst2", db.dbc[3].get());
+    double elapsed = runner.exec(script);
+
+    std::wstring out = runner.output();
+    std::wstring::size_type start = out.find(L"[LOG]: start");
+    std::wstring::size_type done = out.find(L"[LOG]: done");
+
+    if(elapsed < 0 || start == std::wstring::npos || done == std::wstring::npos || done < start
+       || count_rows(*db.dbc[2], "SELECT COUNT(*) FROM staged") != rows
+       || count_rows(*db.dbc[3], "SELECT COUNT(*) FROM t") != rows)
+    {
+        std::wcerr << jobs << L" jobs: wrong result" << std::endl;
+        return -1;
+    }
+    return elapsed;
+}
+
+
+/// Runs the failing script, returns false if its error lost the type
+/// or the position
+static bool failure(Databases &db)
+{
+    db.dbc[3]->directCmd("DELETE FROM t");
+
+    CaptureOutput capture;
+    DTSEngine engine;
+    engine.setJobs(4);
+    engine.addConnection("src1", db.dbc[0].get());
+    engine.addConnection("src2", db.dbc[1].get());
+    engine.addConnection("dst1", db.dbc[2].get());
+    engine.addConnection("dst2", db.dbc[3].get());
+    engine.load(failing_script, std::strlen(failing_script), String("<buffer>"));
+    try
+    {
+        engine.exec();
+    }
+    catch(CompileError &e)
+    {
+        if(std::string(e.what()).find("<buffer>:9") != std::string::npos)
+            return true;
+        std::cerr << "wrong position: " << e.what() << std::endl;
+        return false;
+    }
+    catch(std::exception &e)
+    {
+        std::cerr << "error lost its type: " << e.what() << std::endl;
+        return false;
+    }
+    std::cerr << "broken did not fail" << std::endl;
+    return false;
+}
+
+
+int main(void)
+{
+    const int rows = 50000;
+
+    Databases db;
+    db.fill(rows);
+
+    bool typed = failure(db);
+
+    double serial = run(db, rows, 1);
+    double parallel = run(db, rows, 4);
+
+    std::wcout << L"rows per transfer: " << rows
+               << L"  1 job: " << serial << L"s"
+               << L"  4 jobs: " << parallel << L"s"
+               << std::endl;
+
+    return (! typed || serial < 0 || parallel < 0) ? 1 : 0;
+}
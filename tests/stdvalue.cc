@@ -0,0 +1,99 @@
+//
+// Standard value operator: @$col replaces NULL by 0, 0.0 or an empty
+// string, by the type of the fetched values or, for a batch without
+// values, by the declared column type. @NULL does not compile.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    "   $id <- $id;\n"
+    "   $name <- @$name;\n"
+    "   $amount <- @$amount;\n"
+    "   $price <- @$price;\n"
+    "   $tag <- @\"x\";\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+static const char *bad_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin $id <- @NULL; end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Runs a script, returns false if it failed
+static bool run(db::Connection &src, db::Connection &dst, const char *text)
+{
+    ScriptRun runner;
+    runner.engine().transferOptions().batchSize = 10;
+    runner.engine().addConnection("src", &src);
+    runner.engine().addConnection("dst", &dst);
+    return runner.exec(text) >= 0;
+}
+
+
+int main(void)
+{
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    src->connect(":memory:");
+    dst->connect(":memory:");
+
+    // ids 0-9: every second value NULL, ids 10-19 (the second batch):
+    // all NULL
+    src->directCmd("CREATE TABLE t (id INTEGER, name TEXT, amount INTEGER, price REAL)");
+    dst->directCmd("CREATE TABLE t (id INTEGER, name TEXT, amount INTEGER, price REAL, tag TEXT)");
+    for(int i = 0; i < 20; ++i)
+    {
+        std::stringstream ss;
+        if(i < 10 && i % 2)
+            ss << "INSERT INTO t VALUES (" << i << ", 'n" << i << "', " << i << ", 1.5)";
+        else
+            ss << "INSERT INTO t VALUES (" << i << ", NULL, NULL, NULL)";
+        src->directCmd(ss.str());
+    }
+
+    bool ok = run(*src, *dst, script);
+    bool badFailed = ! run(*src, *dst, bad_script);
+
+    if(! ok || count_rows(*dst, "SELECT COUNT(*) FROM t") != 20)
+    {
+        std::cerr << "transfer failed" << std::endl;
+        ++errors;
+    }
+    if(count_rows(*dst, "SELECT COUNT(*) FROM t WHERE name IS NULL OR amount IS NULL"
+                  " OR price IS NULL OR tag <> 'x'") != 0)
+    {
+        std::cerr << "NULL values left" << std::endl;
+        ++errors;
+    }
+    if(count_rows(*dst, "SELECT COUNT(*) FROM t WHERE name = '' AND typeof(amount) = 'integer'"
+                  " AND amount = 0 AND typeof(price) = 'real' AND price = 0") != 15
+       || count_rows(*dst, "SELECT COUNT(*) FROM t WHERE name = 'n' || id AND amount = id"
+                     " AND price = 1.5") != 5)
+    {
+        std::cerr << "wrong standard values" << std::endl;
+        ++errors;
+    }
+    if(! badFailed)
+    {
+        std::cerr << "@NULL compiled" << std::endl;
+        ++errors;
+    }
+
+    return errors;
+}
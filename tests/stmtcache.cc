@@ -0,0 +1,116 @@
+//
+// Statement cache: a transfer called after every batch of another
+// transfer prepares its statements once and reuses them afterwards.
+// (Source and destination of the called transfer are not those of
+// the caller, a connection can not run two transactions.)
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+// mark runs once per batch of copy
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "connection marks;\n"
+    "program.\n"
+    "task mark() as transfer[table(marks, \"marks\"), table(src, \"one\")]\n"
+    "begin $id <- $id; end;\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    " after:\n"
+    "   exec task mark;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Number after @a label in the pool line of @a conn
+static long pool_counter(const std::wstring &out, const std::wstring &conn, const std::wstring &label)
+{
+    std::wstring::size_type line = out.find(L"[POOL] " + conn + L":");
+    if(line == std::wstring::npos)
+        return -1;
+    std::wstring::size_type end = out.find(L'\n', line);
+    std::wstring::size_type pos = out.find(label, line);
+    if(pos == std::wstring::npos || pos > end)
+        return -1;
+    std::wstringstream ss(out.substr(pos + label.size()));
+    long n = -1;
+    ss >> n;
+    return n;
+}
+
+
+int main(void)
+{
+    const int rows = 1000;
+    const int batch = 50;
+    const int batches = rows / batch;
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    std::auto_ptr<db::Connection> marks(env.newConnection());
+    src->connect(":memory:");
+    dst->connect(":memory:");
+    marks->connect(":memory:");
+
+    src->directCmd("CREATE TABLE t (id INTEGER)");
+    src->directCmd("CREATE TABLE one (id INTEGER)");
+    src->directCmd("INSERT INTO one (id) VALUES (1)");
+    dst->directCmd("CREATE TABLE t (id INTEGER)");
+    marks->directCmd("CREATE TABLE marks (id INTEGER)");
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO t (id) VALUES (?)");
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            ins->execute();
+        }
+    }
+
+    std::wstring log;
+    {
+        ScriptRun runner;
+        runner.engine().transferOptions().batchSize = batch;
+        runner.engine().addConnection("src", src.get());
+        runner.engine().addConnection("dst", dst.get());
+        runner.engine().addConnection("marks", marks.get());
+        if(runner.exec(script) < 0)
+        {
+            std::cerr << "failed: " << runner.error() << std::endl;
+            ++errors;
+        }
+        log = runner.output();
+    }
+
+    if(count_rows(*dst, "SELECT COUNT(*) FROM t") != rows
+       || count_rows(*marks, "SELECT COUNT(*) FROM marks") != batches)
+    {
+        std::cerr << "wrong row count" << std::endl;
+        ++errors;
+    }
+
+    // the first mark prepares its insert, the column probe of marks
+    // and its query, every later mark finds them prepared
+    long hits = pool_counter(log, L"marks", L"statements ");
+    long misses = pool_counter(log, L"marks", L"hits ");
+    long srcHits = pool_counter(log, L"src", L"statements ");
+    if(hits != 2 * (batches - 1) || misses != 2 || srcHits != batches - 1)
+    {
+        std::wcerr << L"marks statements: " << hits << L" hits " << misses << L" misses, "
+                   << L"src statements: " << srcHits << L" hits" << std::endl;
+        ++errors;
+    }
+
+    std::wcout << L"mark called " << batches << L" times, insert statement: "
+               << hits << L" hits " << misses << L" misses" << std::endl;
+
+    return errors;
+}
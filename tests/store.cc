@@ -0,0 +1,218 @@
+//
+// Store tasks: a store called after every batch of a transfer writes
+// its rows in batches, inside the transaction of the transfer, and a
+// task running after a store sees the stored rows. A store called
+// with source columns saves one row per source row.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+// mark runs once per batch of copy and once more from main, count
+// reads what mark stored
+static const char *script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task mark() as store[table(dst, \"marks\")]\n"
+    "begin $id <- 1; $note <- \"batch\"; $missing <- null; end;\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    " after:\n"
+    "   exec task mark;\n"
+    "end;\n"
+    "task count() as transfer[table(dst, \"counted\"), sql(dst, \"SELECT COUNT(*) AS n FROM marks\")]\n"
+    "begin $n <- $n; end;\n"
+    "task main() as void\n"
+    "begin\n"
+    "   exec task copy;\n"
+    "   exec task mark;\n"
+    "   exec task count;\n"
+    "end;\n";
+
+
+// save is called once per source row with the id and a constant,
+// the task called in between does not split its batches
+static const char *args_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "program.\n"
+    "task save(id, note) as store[table(dst, \"saved\")]\n"
+    "begin $id <- id; $note <- note; end;\n"
+    "task touch() as void begin end;\n"
+    "task copy() as transfer[table(dst, \"t\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    " after:\n"
+    "   exec task save($id, \"row\");\n"
+    "   exec task touch;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+// copy fails in its third batch, the marks of the first two batches
+// go to another connection and stay
+static const char *failing_script =
+    "connection src;\n"
+    "connection dst;\n"
+    "connection marks;\n"
+    "program.\n"
+    "task mark() as store[table(marks, \"marks\")]\n"
+    "begin $id <- 1; $note <- \"batch\"; end;\n"
+    "task copy() as transfer[table(dst, \"strict\"), table(src, \"t\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $id <- $id;\n"
+    " after:\n"
+    "   exec task mark;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Number after @a label in the line starting with @a prefix
+static long counter(const std::wstring &out, const std::wstring &prefix, const std::wstring &label)
+{
+    std::wstring::size_type line = out.find(prefix);
+    if(line == std::wstring::npos)
+        return -1;
+    std::wstring::size_type end = out.find(L'\n', line);
+    std::wstring::size_type pos = out.find(label, line);
+    if(pos == std::wstring::npos || pos > end)
+        return -1;
+    std::wstringstream ss(out.substr(pos + label.size()));
+    long n = -1;
+    ss >> n;
+    return n;
+}
+
+
+int main(void)
+{
+    const int rows = 1000;
+    const int batch = 10;
+    const int calls = rows / batch + 1;
+    int errors = 0;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dst(env.newConnection());
+    src->connect(":memory:");
+    dst->connect(":memory:");
+
+    src->directCmd("CREATE TABLE t (id INTEGER)");
+    dst->directCmd("CREATE TABLE t (id INTEGER)");
+    dst->directCmd("CREATE TABLE marks (id INTEGER, note TEXT, missing TEXT)");
+    dst->directCmd("CREATE TABLE counted (n INTEGER)");
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO t (id) VALUES (?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            ins->bind(1, db::Variant(i));
+            ins->execute();
+        }
+        src->commit();
+    }
+
+    std::wstring log;
+    {
+        ScriptRun runner;
+        runner.engine().transferOptions().batchSize = batch;
+        runner.engine().transferOptions().commitInterval = 250;
+        runner.engine().addConnection("src", src.get());
+        runner.engine().addConnection("dst", dst.get());
+        if(runner.exec(script) < 0)
+        {
+            std::cerr << "failed: " << runner.error() << std::endl;
+            ++errors;
+        }
+        log = runner.output();
+    }
+
+    if(count_rows(*dst, "SELECT COUNT(*) FROM t") != rows
+       || count_rows(*dst, "SELECT COUNT(*) FROM marks WHERE id = 1 AND note = 'batch'"
+                     " AND missing IS NULL") != calls)
+    {
+        std::cerr << "wrong row count" << std::endl;
+        ++errors;
+    }
+
+    // count ran after the last mark
+    if(count_rows(*dst, "SELECT MAX(n) FROM counted") != calls)
+    {
+        std::cerr << "count did not see all marks" << std::endl;
+        ++errors;
+    }
+
+    long stored = counter(log, L"[STORE] mark:", L": ");
+    long batches = counter(log, L"[STORE] mark:", L"rows in ");
+    if(stored != calls || batches < 1 || batches >= calls)
+    {
+        std::wcerr << L"mark: " << stored << L" rows in " << batches << L" batches" << std::endl;
+        ++errors;
+    }
+
+    // one row per source row, inserted in batches
+    dst->directCmd("DELETE FROM t");
+    dst->directCmd("CREATE TABLE saved (id INTEGER, note TEXT)");
+    {
+        ScriptRun runner;
+        runner.engine().transferOptions().batchSize = batch;
+        runner.engine().transferOptions().commitInterval = 250;
+        runner.engine().addConnection("src", src.get());
+        runner.engine().addConnection("dst", dst.get());
+        if(runner.exec(args_script) < 0)
+        {
+            std::cerr << "failed: " << runner.error() << std::endl;
+            ++errors;
+        }
+        log = runner.output();
+    }
+    if(count_rows(*dst, "SELECT COUNT(DISTINCT id) FROM saved WHERE note = 'row'") != rows
+       || count_rows(*dst, "SELECT COUNT(*) FROM saved") != rows)
+    {
+        std::cerr << "save did not store one row per source row" << std::endl;
+        ++errors;
+    }
+    long saves = counter(log, L"[STORE] save:", L"rows in ");
+    if(saves < 1 || saves > rows / batch + rows / 250)
+    {
+        std::wcerr << L"save: " << saves << L" batches" << std::endl;
+        ++errors;
+    }
+
+    // rows buffered before a task fails are stored
+    std::auto_ptr<db::Connection> marks(env.newConnection());
+    marks->connect(":memory:");
+    marks->directCmd("CREATE TABLE marks (id INTEGER, note TEXT)");
+    dst->directCmd("CREATE TABLE strict (id INTEGER CHECK (id <> 25))");
+    {
+        ScriptRun runner;
+        runner.engine().transferOptions().batchSize = batch;
+        runner.engine().transferOptions().commitInterval = 250;
+        runner.engine().addConnection("src", src.get());
+        runner.engine().addConnection("dst", dst.get());
+        runner.engine().addConnection("marks", marks.get());
+        if(runner.exec(failing_script) >= 0)
+        {
+            std::cerr << "copy into strict did not fail" << std::endl;
+            ++errors;
+        }
+    }
+    long long kept = count_rows(*marks, "SELECT COUNT(*) FROM marks");
+    if(kept != 2)
+    {
+        std::cerr << "failed transfer: " << kept << " marks stored" << std::endl;
+        ++errors;
+    }
+
+    std::wcout << L"mark called " << calls << L" times, " << batches << L" inserts" << std::endl;
+
+    return errors;
+}
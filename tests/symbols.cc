@@ -0,0 +1,130 @@
+//
+// Symbol resolution: unknown symbols and symbols of the wrong kind
+// must be reported with their line while compiling, before any task
+// runs. Context keywords may name connections and tasks.
+//
+
+#include "test_util.hh"
+
+#include <argon/exceptions.hh>
+
+using namespace informave::argon;
+
+
+typedef enum {
+    compiled,
+    not_declared,
+    type_mismatch,
+    failed
+} result_type;
+
+
+/// Compiles and runs @a script, @a what is the error message
+static result_type compile(const std::string &script, std::string &what)
+{
+    CaptureOutput capture;
+    DTSEngine engine;
+    try
+    {
+        engine.load(script.data(), script.size());
+        engine.exec();
+    }
+    catch(NotDeclared &e)
+    {
+        what = e.what();
+        return not_declared;
+    }
+    catch(TypeMismatch &e)
+    {
+        what = e.what();
+        return type_mismatch;
+    }
+    catch(std::exception &e)
+    {
+        what = e.what();
+        return failed;
+    }
+    return compiled;
+}
+
+
+/// Checks that @a script fails with @a expect on line @a line
+static int fails(const char *what, const std::string &script, result_type expect, int line)
+{
+    std::string error;
+    result_type result = compile(script, error);
+
+    std::stringstream pos;
+    pos << "<buffer>:" << line << ":";
+    if(result != expect || error.find(pos.str()) != 0)
+    {
+        std::cerr << what << ": " << (result == compiled ? "compiled" : error) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(void)
+{
+    int errors = 0;
+    std::string error;
+
+    if(compile("program.\n"
+               "task main() as void begin log \"x\" foo; exec task foo; end;\n"
+               "task foo() as void begin log \"in foo\"; end;\n", error) != compiled)
+    {
+        std::cerr << "valid script: " << error << std::endl;
+        ++errors;
+    }
+
+    // section names, null and pool are context keywords
+    if(compile("connection pool type \"sqlite:libsqlite\" dbcstr \":memory:\" pool 1 2;\n"
+               "program.\n"
+               "task after() as void begin log \"in after\"; end;\n"
+               "task rules() as transfer[table(pool, \"t\"), sql(pool, \"SELECT 1 AS id\")]\n"
+               "begin\n"
+               "   rules:\n"
+               "   $id <- null;\n"
+               "   after:\n"
+               "   exec task after;\n"
+               "end;\n"
+               "task main() as void begin log \"x\" after rules; exec task after; end;\n",
+               error) != compiled)
+    {
+        std::cerr << "keywords as names: " << error << std::endl;
+        ++errors;
+    }
+
+    // unknown symbol in log, the task must not run
+    errors += fails("unknown log symbol",
+                    "program.\n"
+                    "task main() as void\n"
+                    "begin\n"
+                    "   log \"x\";\n"
+                    "   log \"y\" nosuch;\n"
+                    "end;\n", not_declared, 5);
+
+    errors += fails("unknown task",
+                    "program.\n"
+                    "task main() as void begin exec task nosuch; end;\n", not_declared, 2);
+
+    // exec task on a connection
+    errors += fails("exec task on a connection",
+                    "connection db type \"sqlite:libsqlite\" dbcstr \":memory:\";\n"
+                    "program.\n"
+                    "task main() as void\n"
+                    "begin\n"
+                    "   exec task db;\n"
+                    "end;\n", type_mismatch, 5);
+
+    // a transfer object naming a task
+    errors += fails("object on a task",
+                    "program.\n"
+                    "task other() as void begin end;\n"
+                    "task copy() as transfer[table(other, \"t\"), sql(other, \"SELECT 1 AS id\")]\n"
+                    "begin $id <- $id; end;\n"
+                    "task main() as void begin exec task copy; end;\n", type_mismatch, 3);
+
+    return errors;
+}
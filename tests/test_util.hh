@@ -0,0 +1,155 @@
+//
+// Helpers shared by the tests: a stream buffer discarding its output,
+// row counts, wall clock time and a runner for one script.
+//
+
+#ifndef INFORMAVE_ARGON_TEST_UTIL_HH
+#define INFORMAVE_ARGON_TEST_UTIL_HH
+
+#include <argon/argon_config.hh>
+#include <argon/dtsengine>
+
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <memory>
+
+#if defined(ARGON_ON_WIN32)
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+
+template<typename CharT>
+struct NullBuf : public std::basic_streambuf<CharT>
+{
+    typedef typename std::basic_streambuf<CharT>::int_type int_type;
+
+    virtual int_type overflow(int_type c) { return std::char_traits<CharT>::not_eof(c); }
+};
+
+
+/// First column of the first row of @a sql
+inline long long count_rows(informave::argon::db::Connection &dbc, const char *sql)
+{
+    std::auto_ptr<informave::argon::db::Statement> stmt(dbc.newStatement());
+    stmt->prepare(sql);
+    stmt->execute();
+    stmt->resultset().first();
+    return stmt->resultset().column(1).asBigint();
+}
+
+
+/// Seconds since an arbitrary start
+inline double wall_time(void)
+{
+#if defined(ARGON_ON_WIN32)
+    LARGE_INTEGER freq, now;
+    ::QueryPerformanceFrequency(&freq);
+    ::QueryPerformanceCounter(&now);
+    return double(now.QuadPart) / double(freq.QuadPart);
+#else
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+#endif
+}
+
+
+/// Discards std::cout and collects std::wcout while it exists
+class CaptureOutput
+{
+public:
+    CaptureOutput(void)
+        : m_nullbuf(),
+          m_log(),
+          m_cout(std::cout.rdbuf(&m_nullbuf)),
+          m_wcout(std::wcout.rdbuf(m_log.rdbuf()))
+    {}
+
+    ~CaptureOutput(void)
+    {
+        std::cout.rdbuf(this->m_cout);
+        std::wcout.rdbuf(this->m_wcout);
+    }
+
+    /// Everything written to std::wcout so far
+    std::wstring str(void) const
+    {
+        return this->m_log.str();
+    }
+
+private:
+    NullBuf<char>         m_nullbuf;
+    std::wstringstream    m_log;
+    std::streambuf       *m_cout;
+    std::wstreambuf      *m_wcout;
+
+    CaptureOutput(const CaptureOutput&);
+    CaptureOutput& operator=(const CaptureOutput&);
+};
+
+
+/// Runs one script on a new engine, the output is captured
+///
+/// Set up engine() (connections, options) before exec().
+class ScriptRun
+{
+public:
+    ScriptRun(void)
+        : m_capture(),
+          m_engine(new informave::argon::DTSEngine()),
+          m_error()
+    {}
+
+    informave::argon::DTSEngine& engine(void)
+    {
+        return *this->m_engine;
+    }
+
+    /// Loads and runs @a text, then destroys the engine so the lines
+    /// it prints on shutdown are part of output(). Returns the
+    /// seconds exec() took, -1 if loading or running threw.
+    double exec(const std::string &text,
+                const informave::argon::String &srcname = informave::argon::String("<buffer>"))
+    {
+        double elapsed = -1;
+        try
+        {
+            this->m_engine->load(text.data(), text.size(), srcname);
+            double t0 = wall_time();
+            this->m_engine->exec();
+            elapsed = wall_time() - t0;
+        }
+        catch(std::exception &e)
+        {
+            this->m_error = e.what();
+        }
+        this->m_engine.reset();
+        return elapsed;
+    }
+
+    /// Message of the exception exec() caught, empty if it passed
+    const std::string& error(void) const
+    {
+        return this->m_error;
+    }
+
+    std::wstring output(void) const
+    {
+        return this->m_capture.str();
+    }
+
+private:
+    CaptureOutput                                   m_capture;
+    std::auto_ptr<informave::argon::DTSEngine>      m_engine;
+    std::string                                     m_error;
+
+    ScriptRun(const ScriptRun&);
+    ScriptRun& operator=(const ScriptRun&);
+};
+
+
+#endif
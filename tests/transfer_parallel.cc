@@ -0,0 +1,119 @@
+//
+// Partitioned transfer: read a skewed SQLite table with one reader
+// and with four key range readers (sampled and with split values),
+// check that every row arrives once and report rows per second.
+//
+
+#include "test_util.hh"
+
+#include <cstdio>
+
+using namespace informave::argon;
+
+
+static const char *dbfile = "transfer_parallel.db";
+
+
+static std::string script(const std::string &source)
+{
+    std::stringstream ss;
+    ss << "connection dbi type \"sqlite:libsqlite\" dbcstr \"" << dbfile << "\";\n"
+       << "connection dbo;\n"
+       << "program.\n"
+       << "task copy() as transfer[table(dbo, \"customers\"), " << source << "]\n"
+       << "begin\n"
+       << " rules:\n"
+       << "   $cust_no <- $c_number;\n"
+       << "   $cust_name <- $name;\n"
+       << "end;\n"
+       << "task main() as void begin exec task copy; end;\n";
+    return ss.str();
+}
+
+
+/// Runs the script and returns the elapsed seconds, or -1 if the
+/// destination rows are not correct
+static double run(db::Connection &dest, long long rows, const std::string &source)
+{
+    dest.directCmd("DELETE FROM customers");
+
+    ScriptRun runner;
+    runner.engine().addConnection("dbo", &dest);
+    double elapsed = runner.exec(script(source));
+
+    long long copied = count_rows(dest, "SELECT COUNT(*) FROM customers");
+    long long checked = count_rows(dest, "SELECT COUNT(DISTINCT cust_name) FROM customers"
+                                   " WHERE cust_name = 'customer ' || cust_no"
+                                   " OR (cust_no IS NULL AND cust_name LIKE 'nokey %')");
+    if(elapsed < 0 || copied != rows || checked != rows)
+    {
+        std::wcerr << source.c_str() << L": copied " << copied << L" rows, "
+                   << checked << L" correct " << runner.error().c_str() << std::endl;
+        return -1;
+    }
+    return elapsed;
+}
+
+
+static double rate(long long rows, double elapsed)
+{
+    return elapsed > 0 ? rows / elapsed : 0;
+}
+
+
+int main(void)
+{
+    const int rows = 50000;
+
+    std::remove(dbfile);
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dest(env.newConnection());
+    src->connect(dbfile);
+    dest->connect(":memory:");
+
+    src->directCmd("CREATE TABLE c_data (c_number INTEGER, name TEXT)");
+    dest->directCmd("CREATE TABLE customers (cust_no INTEGER, cust_name TEXT)");
+
+    // most keys are dense, a few are far out and some are NULL
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO c_data (c_number, name) VALUES (?, ?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            std::wstringstream name;
+            if(i % 1000 == 999)
+            {
+                name << L"nokey " << i;
+                ins->bind(1, db::Variant());
+            }
+            else
+            {
+                long long key = i < rows - 5000 ? i : 1000000000LL + i;
+                name << L"customer " << key;
+                ins->bind(1, db::Variant(key));
+            }
+            ins->bind(2, db::Variant(String(name.str())));
+            ins->execute();
+        }
+        src->commit();
+    }
+    src.reset();
+
+    double single = run(*dest, rows, "table(dbi, \"c_data\")");
+    double sampled = run(*dest, rows, "table(dbi, \"c_data\", parallel(4, c_number))");
+    double split = run(*dest, rows, "sql(dbi, \"SELECT c_number, name FROM c_data\","
+                       " parallel(4, c_number, 10000, 20000, 30000, 40000))");
+
+    std::wcout << L"rows: " << rows
+               << L"  one reader: " << rate(rows, single) << L" rows/s"
+               << L"  4 readers sampled: " << rate(rows, sampled) << L" rows/s"
+               << L"  4 readers split: " << rate(rows, split) << L" rows/s"
+               << std::endl;
+
+    std::remove(dbfile);
+
+    return (single < 0 || sampled < 0 || split < 0) ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+//
+// Transfer benchmark: copy a SQLite table into another SQLite
+// database, once row by row, once with the default batch and
+// commit sizes and once pipelined, and report rows per second.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+static const char *script =
+    "connection dbi;\n"
+    "connection dbo;\n"
+    "program.\n"
+    "task copy() as transfer[table(dbo, \"customers\"), table(dbi, \"c_data\")]\n"
+    "begin\n"
+    " rules:\n"
+    "   $cust_no <- $c_number;\n"
+    "   $cust_name <- $name;\n"
+    "   $cust_street <- $street;\n"
+    "   $imported <- 1;\n"
+    "   $note <- NULL;\n"
+    "end;\n"
+    "task main() as void begin exec task copy; end;\n";
+
+
+/// Runs the script and returns the elapsed seconds, or -1 if the
+/// destination rows are not correct
+static double run(db::Connection &src, db::Connection &dest, long long rows,
+                  const TransferOptions &opts)
+{
+    dest.directCmd("DELETE FROM customers");
+
+    ScriptRun runner;
+    runner.engine().transferOptions() = opts;
+    runner.engine().addConnection("dbi", &src);
+    runner.engine().addConnection("dbo", &dest);
+    double elapsed = runner.exec(script);
+
+    long long copied = count_rows(dest, "SELECT COUNT(*) FROM customers");
+    long long checked = count_rows(dest, "SELECT COUNT(*) FROM customers"
+                                   " WHERE cust_name = 'customer ' || cust_no"
+                                   " AND imported = 1 AND note IS NULL");
+    if(elapsed < 0 || copied != rows || checked != rows)
+    {
+        std::wcerr << L"copied " << copied << L" rows, " << checked << L" correct "
+                   << runner.error().c_str() << std::endl;
+        return -1;
+    }
+    return elapsed;
+}
+
+
+static double rate(long long rows, double elapsed)
+{
+    return elapsed > 0 ? rows / elapsed : 0;
+}
+
+
+int main(void)
+{
+    const int rows = 50000;
+
+    db::Database::Environment env("sqlite:libsqlite");
+    std::auto_ptr<db::Connection> src(env.newConnection());
+    std::auto_ptr<db::Connection> dest(env.newConnection());
+    src->connect(":memory:");
+    dest->connect(":memory:");
+
+    src->directCmd("CREATE TABLE c_data (c_number INTEGER, name TEXT, street TEXT)");
+    dest->directCmd("CREATE TABLE customers (cust_no INTEGER, cust_name TEXT, cust_street TEXT,"
+                    " imported INTEGER, note TEXT)");
+
+    {
+        std::auto_ptr<db::Statement> ins(src->newStatement());
+        ins->prepare("INSERT INTO c_data (c_number, name, street) VALUES (?, ?, ?)");
+        src->beginTrans();
+        for(int i = 0; i < rows; ++i)
+        {
+            std::wstringstream name;
+            name << L"customer " << i;
+            ins->bind(1, db::Variant(i));
+            ins->bind(2, db::Variant(String(name.str())));
+            ins->bind(3, db::Variant(String("Main Street")));
+            ins->execute();
+        }
+        src->commit();
+    }
+
+    TransferOptions rowwise;
+    rowwise.batchSize = 1;
+    rowwise.commitInterval = 1;
+    TransferOptions pipelined;
+    pipelined.evaluators = 2;
+
+    double single = run(*src, *dest, rows, rowwise);
+    double batched = run(*src, *dest, rows, TransferOptions());
+    double piped = run(*src, *dest, rows, pipelined);
+
+    std::wcout << L"rows: " << rows
+               << L"  row by row: " << rate(rows, single) << L" rows/s"
+               << L"  batched: " << rate(rows, batched) << L" rows/s"
+               << L"  pipelined: " << rate(rows, piped) << L" rows/s"
+               << std::endl;
+
+    return (single < 0 || batched < 0 || piped < 0) ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+//
+// UTF-8 input: a script loaded from a UTF-8 buffer gives the same
+// parse tree, source positions included, as the script read from a
+// wide character stream. An identifier outside ASCII is one token on
+// both inputs. A byte which never appears in UTF-8 is a compile error
+// and does not end the script.
+//
+
+#include "test_util.hh"
+
+using namespace informave::argon;
+
+
+struct TreeEngine : public DTSEngine
+{
+    ParseTree* tree(void) { return this->m_tree.get(); }
+};
+
+
+/// One line per node: kind, text and source position
+struct DumpNode
+{
+    DumpNode(std::wstringstream &out) : m_out(out)
+    {}
+
+    void operator()(Node *node)
+    {
+        SourceInfo si = node->getSourceInfo();
+        this->m_out << node->kind() << L" " << node->str() << L" " << si.linenum() << L":"
+                    << si.offset() << L"+" << si.length() << std::endl;
+    }
+
+    std::wstringstream &m_out;
+};
+
+
+static std::wstring dump(TreeEngine &engine)
+{
+    std::wstringstream out;
+    DumpNode op(out);
+    walk_node(static_cast<Node*>(engine.tree()), op, -1);
+    return out.str();
+}
+
+
+// the same script, Grüße and 東京 in UTF-8 and as wide characters,
+// the task größe has a name outside ASCII
+static const char *utf8_script =
+    "program.\n"
+    "// Gr\xc3\xbc\xc3\x9f" "e\r\n"
+    "task main() as void\n"
+    "begin\n"
+    "   log \"Gr\xc3\xbc\xc3\x9f" "e, \xe6\x9d\xb1\xe4\xba\xac\" gr\xc3\xb6\xc3\x9f" "e;\n"
+    "   exec task gr\xc3\xb6\xc3\x9f" "e;\n"
+    "end;\n"
+    "task gr\xc3\xb6\xc3\x9f" "e() as void begin log \"\xc3\xa4\"; end;\n";
+
+static const wchar_t *wide_script =
+    L"program.\n"
+    L"// Grüße\r\n"
+    L"task main() as void\n"
+    L"begin\n"
+    L"   log \"Grüße, 東京\" größe;\n"
+    L"   exec task größe;\n"
+    L"end;\n"
+    L"task größe() as void begin log \"ä\"; end;\n";
+
+// 0xFF after the last task, on line 3
+static const char *bad_script =
+    "program.\n"
+    "task main() as void begin log \"a\"; end;\n"
+    "\xff garbage";
+
+
+int main(void)
+{
+    int errors = 0;
+
+    std::wstring fromBuffer, fromStream;
+    {
+        CaptureOutput capture;
+
+        TreeEngine buffered;
+        buffered.load(utf8_script, std::char_traits<char>::length(utf8_script));
+        fromBuffer = dump(buffered);
+
+        std::wstringstream in(wide_script);
+        TreeEngine streamed;
+        streamed.load(std::istreambuf_iterator<wchar_t>(in));
+        fromStream = dump(streamed);
+    }
+
+    if(fromBuffer != fromStream || fromBuffer.find(L"東京") == std::wstring::npos
+       || fromBuffer.find(L" größe ") == std::wstring::npos)
+    {
+        std::wcerr << L"UTF-8 buffer:" << std::endl << fromBuffer
+                   << L"wide stream:" << std::endl << fromStream;
+        ++errors;
+    }
+
+    ScriptRun runner;
+    runner.exec(bad_script);
+    if(runner.error().find("<buffer>:3:") == std::string::npos)
+    {
+        std::cerr << "0xFF byte not reported: " << runner.error() << std::endl;
+        ++errors;
+    }
+
+    return errors;
+}
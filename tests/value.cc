@@ -0,0 +1,87 @@
+//
+// Value: scalars and short strings must not touch the heap.
+//
+
+#include <argon/dtsengine>
+
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+static size_t g_allocs = 0;
+
+void* operator new(size_t size) throw(std::bad_alloc)
+{
+    ++g_allocs;
+    void *p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+
+
+using namespace informave::argon;
+
+static int errors = 0;
+
+#define CHECK(expr) if(!(expr)) { std::cout << "failed: " #expr << std::endl; ++errors; }
+
+
+int main(void)
+{
+    DateTime dt = { 2010, 12, 24, 18, 30, 0, 0 };
+
+    size_t a0 = g_allocs;
+    {
+        ArgumentList args;
+        args.push_back(Value(42));
+        args.push_back(Value::decimal(-1205, 2));
+        args.push_back(Value::date(dt));
+        args.push_back(Value(L"short"));
+
+        ArgumentList copy(args);
+        Value v = copy[1];
+        v = copy[3];
+
+        CHECK(args.isInline());
+        CHECK(copy[0].asInt() == 42);
+        CHECK(copy[1].asInt() == -12);
+        CHECK(v == Value(L"short"));
+        CHECK(Value::null().isNull() && ! Value::null().isVoid());
+        CHECK(Value().isVoid());
+    }
+    CHECK(g_allocs == a0);
+
+    // long strings live on the heap and are shared by copies
+    a0 = g_allocs;
+    {
+        Value s(L"a string that is too long for inline storage");
+        Value t(s);
+        Value u;
+        u = t;
+        CHECK(s.isHeap() && t.strData() == s.strData() && u.strData() == s.strData());
+        CHECK(s.strLength() == 44);
+    }
+    CHECK(g_allocs == a0 + 1);
+
+    // growing beyond the inline capacity
+    ArgumentList many;
+    for(int i = 0; i < 10; ++i)
+        many.push_back(Value(i));
+    CHECK(! many.isInline() && many.size() == 10 && many[9].asInt() == 9);
+
+    CHECK(Value::decimal(-1205, 2).asString() == String(L"-12.05"));
+    CHECK(Value::decimal(5, 3).asString() == String(L"0.005"));
+    CHECK(Value::date(dt).asString() == String(L"2010-12-24 18:30:00"));
+    CHECK(Value(7) != Value(L"7"));
+
+    std::cout << "sizeof(Value): " << sizeof(Value)
+              << "  inline string chars: " << Value::short_string_max << std::endl;
+
+    return errors;
+}
@@ -0,0 +1,118 @@
+//
+// Dispatch benchmark: running a task body through the bytecode
+// interpreter versus walking its nodes with a visitor.
+//
+
+#include "test_util.hh"
+
+#include <ctime>
+#include <map>
+
+using namespace informave::argon;
+
+
+struct BenchEngine : public DTSEngine
+{
+    ParseTree* tree(void) { return this->m_tree.get(); }
+};
+
+
+typedef std::map<Identifier, TaskNode*> TaskNodes;
+
+
+/// The task body walk as it was done before the bytecode compiler
+struct WalkVisitor : public Visitor
+{
+    WalkVisitor(Processor &proc, const TaskNodes &tasks)
+        : Visitor(), m_proc(proc), m_tasks(tasks)
+    {}
+
+    virtual void visit(LogNode *node)
+    {
+        LogCmd cmd(this->m_proc, node);
+        cmd.exec();
+    }
+
+    virtual void visit(TaskExecNode *node)
+    {
+        this->m_proc.getSymbol<Task>(node->taskid());
+        foreach_child(this->m_tasks.find(node->taskid())->second, WalkVisitor(*this), 1);
+    }
+
+    Processor &m_proc;
+    const TaskNodes &m_tasks;
+};
+
+
+int main(void)
+{
+    std::stringstream ss;
+    ss << "program." << std::endl
+       << "task leaf() as void begin log \"leaf\"; end;" << std::endl
+       << "task main() as void" << std::endl
+       << "begin" << std::endl;
+    for(int i = 0; i < 8; ++i)
+    {
+        ss << "   log \"rule \" \"" << i << "\" leaf;" << std::endl
+           << "   exec task leaf;" << std::endl;
+    }
+    ss << "end;" << std::endl;
+    std::string script = ss.str();
+
+    NullBuf<char> nullbuf;
+    NullBuf<wchar_t> wnullbuf;
+    std::streambuf *cout_buf = std::cout.rdbuf(&nullbuf);
+    std::wstreambuf *wcout_buf = std::wcout.rdbuf(&wnullbuf);
+
+    BenchEngine engine;
+    engine.load(script.data(), script.size());
+    Processor proc(engine);
+    proc.compile(engine.tree());
+
+    TaskNodes tasks;
+    for(Node *n = engine.tree()->firstChild(); n; n = n->nextSibling())
+    {
+        if(n->kind() == Node::kind_task)
+            tasks[static_cast<TaskNode*>(n)->id] = static_cast<TaskNode*>(n);
+    }
+    Task *main_task = proc.getSymbol<Task>(engine.ident("main"));
+    TaskNode *main_node = tasks[engine.ident("main")];
+
+    // both ways must produce the same log
+    std::wstringstream vm_out, walk_out;
+    std::wcout.rdbuf(vm_out.rdbuf());
+    main_task->run(ArgumentList());
+    std::wcout.rdbuf(walk_out.rdbuf());
+    foreach_child(main_node, WalkVisitor(proc, tasks), 1);
+    std::wcout.rdbuf(&wnullbuf);
+
+    const int runs = 20000;
+
+    std::clock_t c0 = std::clock();
+    for(int i = 0; i < runs; ++i)
+        foreach_child(main_node, WalkVisitor(proc, tasks), 1);
+    std::clock_t c1 = std::clock();
+    for(int i = 0; i < runs; ++i)
+        main_task->run(ArgumentList());
+    std::clock_t c2 = std::clock();
+
+    std::cout.rdbuf(cout_buf);
+    std::wcout.rdbuf(wcout_buf);
+
+    double walk = double(c1 - c0) / CLOCKS_PER_SEC;
+    double vm = double(c2 - c1) / CLOCKS_PER_SEC;
+
+    std::cout << "task runs: " << runs
+              << "  instructions: " << main_task->code().size()
+              << "  visitor walk: " << walk << "s"
+              << "  bytecode: " << vm << "s"
+              << "  speedup: " << (vm > 0 ? walk / vm : 0) << "x"
+              << std::endl;
+
+    if(vm_out.str() != walk_out.str() || vm_out.str().empty())
+    {
+        std::cout << "output mismatch" << std::endl;
+        return 1;
+    }
+    return 0;
+}